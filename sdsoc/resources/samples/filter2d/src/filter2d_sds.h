@@ -20,7 +20,12 @@ int filter2d_init_sds(size_t in_height, size_t in_width, size_t out_height,
 				uint32_t out_fourcc, void **priv);
 
 void filter2d_sds(unsigned char *frm_data_in, unsigned char *frm_data_out,
-		int height, int width, const coeff_t coeff, void *priv);
+		int height, int width, const coeff_t coeff, int keep_chroma,
+		void *priv);
+
+void filter2d_band_sds(unsigned char *frm_data_in, unsigned char *frm_data_out,
+		int height, int width, int band_height, const coeff_t coeff,
+		int keep_chroma, void *priv);
 #endif
 
 #ifdef __cplusplus
@@ -10,6 +10,8 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #endif
+#include <linux/videodev2.h>
+
 #include "filter2d_sds.h"
 
 using namespace cv;
@@ -18,15 +20,8 @@ using namespace cv;
 extern "C" {
 #endif
 
-void filter2d_cv(unsigned char *frm_data_in, unsigned char *frm_data_out,
-				int height, int width, const coeff_t coeff)
+static void filter2d_luma_cv(const Mat &in, Mat &out, const coeff_t coeff)
 {
-	Mat src(height, width, CV_8UC3, frm_data_in);
-	Mat dst(height, width, CV_8UC3, frm_data_out);
-	Mat grayIn(height, width, CV_8UC1);
-	Mat grayOut(height, width, CV_8UC1);
-
-
 	// convert kernel from short to int
 	int coeff_i[KSIZE][KSIZE];
 	for(int i=0; i<KSIZE; i++)
@@ -38,11 +33,155 @@ void filter2d_cv(unsigned char *frm_data_in, unsigned char *frm_data_out,
 	Point anchor = Point(-1, -1);
 
 	//filter
+	filter2D(in, out, -1, kernel, anchor, 0, BORDER_DEFAULT);
+}
+
+void filter2d_cv(unsigned char *frm_data_in, unsigned char *frm_data_out,
+				int height, int width, const coeff_t coeff)
+{
+	Mat src(height, width, CV_8UC3, frm_data_in);
+	Mat dst(height, width, CV_8UC3, frm_data_out);
+	Mat grayIn(height, width, CV_8UC1);
+	Mat grayOut(height, width, CV_8UC1);
+
 	cvtColor(src, grayIn, CV_RGB2GRAY);
-	filter2D(grayIn, grayOut, -1, kernel, anchor, 0, BORDER_DEFAULT);
+	filter2d_luma_cv(grayIn, grayOut, coeff);
 	cvtColor(grayOut, dst, CV_GRAY2RGB);
 }
 
+/*
+ * Filter the Y plane of YUYV/UYVY/NV12/NV21 frames in place of the RGB
+ * round trip. Chroma is either copied from the input or set to neutral
+ * gray, which matches the output of filter2d_cv.
+ */
+void filter2d_yuv_cv(unsigned char *frm_data_in, unsigned char *frm_data_out,
+				int height, int width, int stride_in, int stride_out,
+				uint32_t fourcc, int keep_chroma, const coeff_t coeff)
+{
+	switch (fourcc) {
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+		{
+			Mat srcY(height, width, CV_8UC1, frm_data_in, stride_in);
+			Mat dstY(height, width, CV_8UC1, frm_data_out, stride_out);
+			Mat srcUV(height/2, width, CV_8UC1, frm_data_in + stride_in*height,
+					stride_in);
+			Mat dstUV(height/2, width, CV_8UC1, frm_data_out + stride_out*height,
+					stride_out);
+
+			filter2d_luma_cv(srcY, dstY, coeff);
+			if (keep_chroma)
+				srcUV.copyTo(dstUV);
+			else
+				dstUV.setTo(Scalar::all(128));
+			break;
+		}
+		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
+		{
+			int yc = fourcc == V4L2_PIX_FMT_UYVY;
+			Mat src(height, width, CV_8UC2, frm_data_in, stride_in);
+			Mat dst(height, width, CV_8UC2, frm_data_out, stride_out);
+			Mat grayIn(height, width, CV_8UC1);
+			Mat grayOut(height, width, CV_8UC1);
+
+			extractChannel(src, grayIn, yc);
+			filter2d_luma_cv(grayIn, grayOut, coeff);
+			if (keep_chroma) {
+				// grayOut is channel 0, src channels 1 and 2
+				const Mat in[] = { grayOut, src };
+				int from_to[] = { 0, yc, 2 - yc, 1 - yc };
+				mixChannels(in, 2, &dst, 1, from_to, 2);
+			} else {
+				dst.setTo(Scalar::all(128));
+				insertChannel(grayOut, dst, yc);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+/*
+ * Filter output lines [line_start, line_end) of a frame, fourcc 0 is RGB.
+ * The kernel is applied to a ROI of the luma of the band plus one line of
+ * context on each side, so the result matches a full frame run and bands
+ * can be processed concurrently.
+ */
+void filter2d_lines_cv(unsigned char *frm_data_in, unsigned char *frm_data_out,
+				int height, int width, int stride_in, int stride_out,
+				uint32_t fourcc, int keep_chroma, const coeff_t coeff,
+				int line_start, int line_end)
+{
+	int ctx_start = line_start > KSIZE/2 ? line_start - KSIZE/2 : 0;
+	int ctx_end = line_end + KSIZE/2 < height ? line_end + KSIZE/2 : height;
+	int lines = line_end - line_start;
+	Range band(line_start, line_end);
+	Range ctx_band(line_start - ctx_start, line_end - ctx_start);
+
+	if (lines <= 0)
+		return;
+
+	switch (fourcc) {
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+		{
+			Mat srcY(height, width, CV_8UC1, frm_data_in, stride_in);
+			Mat dstY(height, width, CV_8UC1, frm_data_out, stride_out);
+			Mat srcUV(height/2, width, CV_8UC1, frm_data_in + stride_in*height,
+					stride_in);
+			Mat dstUV(height/2, width, CV_8UC1, frm_data_out + stride_out*height,
+					stride_out);
+			Range uv_band(line_start/2, line_end/2);
+			Mat dstY_band = dstY.rowRange(band);
+
+			filter2d_luma_cv(srcY.rowRange(band), dstY_band, coeff);
+			if (keep_chroma)
+				srcUV.rowRange(uv_band).copyTo(dstUV.rowRange(uv_band));
+			else
+				dstUV.rowRange(uv_band).setTo(Scalar::all(128));
+			break;
+		}
+		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
+		{
+			int yc = fourcc == V4L2_PIX_FMT_UYVY;
+			Mat src(height, width, CV_8UC2, frm_data_in, stride_in);
+			Mat dst(height, width, CV_8UC2, frm_data_out, stride_out);
+			Mat grayIn(ctx_end - ctx_start, width, CV_8UC1);
+			Mat grayOut(lines, width, CV_8UC1);
+			Mat src_band = src.rowRange(band);
+			Mat dst_band = dst.rowRange(band);
+
+			extractChannel(src.rowRange(ctx_start, ctx_end), grayIn, yc);
+			filter2d_luma_cv(grayIn.rowRange(ctx_band), grayOut, coeff);
+			if (keep_chroma) {
+				const Mat in[] = { grayOut, src_band };
+				int from_to[] = { 0, yc, 2 - yc, 1 - yc };
+				mixChannels(in, 2, &dst_band, 1, from_to, 2);
+			} else {
+				dst_band.setTo(Scalar::all(128));
+				insertChannel(grayOut, dst_band, yc);
+			}
+			break;
+		}
+		default:
+		{
+			Mat src(height, width, CV_8UC3, frm_data_in, stride_in);
+			Mat dst(height, width, CV_8UC3, frm_data_out, stride_out);
+			Mat grayIn(ctx_end - ctx_start, width, CV_8UC1);
+			Mat grayOut(lines, width, CV_8UC1);
+			Mat dst_band = dst.rowRange(band);
+
+			cvtColor(src.rowRange(ctx_start, ctx_end), grayIn, CV_RGB2GRAY);
+			filter2d_luma_cv(grayIn.rowRange(ctx_band), grayOut, coeff);
+			cvtColor(grayOut, dst_band, CV_GRAY2RGB);
+			break;
+		}
+	}
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,76 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+struct bench_opts {
+	size_t width;
+	size_t height;
+	unsigned int iterations;
+};
+
+struct perf_counter {
+	uint64_t tot;
+	uint64_t cnt;
+	uint64_t calls;
+};
+
+static inline uint64_t perf_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void perf_reset(struct perf_counter *pc)
+{
+	pc->tot = pc->cnt = pc->calls = 0;
+}
+
+static inline void perf_start(struct perf_counter *pc)
+{
+	pc->cnt = perf_now_ns();
+	pc->calls++;
+}
+
+static inline void perf_stop(struct perf_counter *pc)
+{
+	pc->tot += perf_now_ns() - pc->cnt;
+}
+
+static inline double perf_avg_ms(const struct perf_counter *pc)
+{
+	return pc->calls ? (double)pc->tot / pc->calls / 1e6 : 0;
+}
+
+/* Megapixels per second for a frame of @pixels processed in @ms */
+static inline double perf_mpix(size_t pixels, double ms)
+{
+	return ms > 0 ? pixels / (ms * 1e3) : 0;
+}
+
+void bench_fill_random(unsigned char *buf, size_t size);
+
+void bench_cvt_color(const struct bench_opts *opts);
+void bench_stencil(const struct bench_opts *opts);
+void bench_stereo_bm(const struct bench_opts *opts);
+void bench_remap(const struct bench_opts *opts);
+void bench_lk_flow(const struct bench_opts *opts);
+void bench_tracker(const struct bench_opts *opts);
+void bench_fast(const struct bench_opts *opts);
+void bench_harris(const struct bench_opts *opts);
+void bench_canny(const struct bench_opts *opts);
+void bench_hog(const struct bench_opts *opts);
+void bench_resize(const struct bench_opts *opts);
+void bench_bilateral(const struct bench_opts *opts);
+void bench_median(const struct bench_opts *opts);
+void bench_integral(const struct bench_opts *opts);
+void bench_histogram(const struct bench_opts *opts);
+void bench_analytics(const struct bench_opts *opts);
+void bench_inrange(const struct bench_opts *opts);
+void bench_morph(const struct bench_opts *opts);
+
+#endif /* BENCH_H */
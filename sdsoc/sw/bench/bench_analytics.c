@@ -0,0 +1,208 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analytics.h"
+#include "bench.h"
+#include "parallel.h"
+
+/* grid of the region statistics */
+#define BENCH_ANALYTICS_GRID_COLS	8
+#define BENCH_ANALYTICS_GRID_ROWS	6
+
+#define BENCH_ANALYTICS_CELLS	(BENCH_ANALYTICS_GRID_COLS * BENCH_ANALYTICS_GRID_ROWS)
+
+static const struct bench_analytics_run {
+	const char *name;
+	unsigned int flags;
+} analytics_runs[] = {
+	{ "mean", VLIB_ANALYTICS_MEAN_STDDEV },
+	{ "minmax", VLIB_ANALYTICS_MIN_MAX },
+	{ "hist", VLIB_ANALYTICS_HISTOGRAM },
+	{ "all", VLIB_ANALYTICS_MEAN_STDDEV | VLIB_ANALYTICS_MIN_MAX |
+			VLIB_ANALYTICS_HISTOGRAM | VLIB_ANALYTICS_GRID },
+};
+
+/*
+ * xf::meanStdDev, xf::minMaxLoc and xf::calcHist in software, one pass
+ * each, and a pass over every grid cell.
+ */
+static void bench_analytics_ref(const unsigned char *src, size_t w, size_t h,
+							struct vlib_analytics_stats *st,
+							struct vlib_analytics_cell *cells)
+{
+	double sum = 0, sum_sq = 0, n = (double)w * h;
+
+	for (size_t i=0; i<w*h; i++) {
+		sum += src[i];
+		sum_sq += src[i] * src[i];
+	}
+	st->mean = sum / n;
+	st->stddev = sqrt(sum_sq / n - (sum / n) * (sum / n));
+
+	st->min = 255;
+	st->max = 0;
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			unsigned char v = src[y * w + x];
+
+			if (v < st->min || (!y && !x)) {
+				st->min = v;
+				st->min_x = x;
+				st->min_y = y;
+			}
+			if (v > st->max || (!y && !x)) {
+				st->max = v;
+				st->max_x = x;
+				st->max_y = y;
+			}
+		}
+	}
+
+	memset(st->hist, 0, sizeof(st->hist));
+	for (size_t i=0; i<w*h; i++) {
+		st->hist[src[i]]++;
+	}
+
+	for (size_t cy=0; cy<BENCH_ANALYTICS_GRID_ROWS; cy++) {
+		for (size_t cx=0; cx<BENCH_ANALYTICS_GRID_COLS; cx++) {
+			struct vlib_analytics_cell *c = cells + cy * BENCH_ANALYTICS_GRID_COLS + cx;
+			size_t cnt = 0;
+
+			sum = 0;
+			c->min = 255;
+			c->max = 0;
+			for (size_t y=0; y<h; y++) {
+				if (y * BENCH_ANALYTICS_GRID_ROWS / h != cy) {
+					continue;
+				}
+				for (size_t x=cx*w/BENCH_ANALYTICS_GRID_COLS;
+					x<(cx+1)*w/BENCH_ANALYTICS_GRID_COLS; x++) {
+					unsigned char v = src[y * w + x];
+
+					sum += v;
+					cnt++;
+					c->min = v < c->min ? v : c->min;
+					c->max = v > c->max ? v : c->max;
+				}
+			}
+			c->mean = sum / cnt;
+		}
+	}
+}
+
+/* selected statistics differing from the reference */
+static size_t bench_analytics_diff(const struct vlib_analytics *an,
+							unsigned int flags,
+							const struct vlib_analytics_stats *ref,
+							const struct vlib_analytics_cell *ref_cells)
+{
+	const struct vlib_analytics_stats *st = vlib_analytics_get_stats(an);
+	const struct vlib_analytics_cell *cells = vlib_analytics_get_cells(an);
+	size_t diff = 0;
+
+	if (flags & VLIB_ANALYTICS_MEAN_STDDEV) {
+		diff += fabsf(st->mean - ref->mean) > 1e-3f;
+		diff += fabsf(st->stddev - ref->stddev) > 1e-3f;
+	}
+	if (flags & VLIB_ANALYTICS_MIN_MAX) {
+		diff += st->min != ref->min || st->min_x != ref->min_x ||
+				st->min_y != ref->min_y;
+		diff += st->max != ref->max || st->max_x != ref->max_x ||
+				st->max_y != ref->max_y;
+	}
+	if (flags & VLIB_ANALYTICS_HISTOGRAM) {
+		for (size_t i=0; i<VLIB_HISTOGRAM_BINS; i++) {
+			diff += st->hist[i] != ref->hist[i];
+		}
+	}
+	if (flags & VLIB_ANALYTICS_GRID) {
+		for (size_t c=0; c<BENCH_ANALYTICS_CELLS; c++) {
+			diff += fabsf(cells[c].mean - ref_cells[c].mean) > 1e-3f ||
+					cells[c].min != ref_cells[c].min ||
+					cells[c].max != ref_cells[c].max;
+		}
+	}
+
+	return diff;
+}
+
+/*
+ * Frame statistics of an 8-bit frame: separate passes as the xf kernels
+ * vs. the single pass for subsets of the statistics, single threaded and
+ * on all cores. Statistics differing from the separate passes are
+ * counted.
+ */
+void bench_analytics(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t cores = vlib_parallel_get_num_threads();
+	unsigned char *src = malloc(w * h);
+	struct vlib_analytics_stats ref;
+	struct vlib_analytics_cell ref_cells[BENCH_ANALYTICS_CELLS];
+	struct perf_counter pc;
+
+	if (!src || w < BENCH_ANALYTICS_GRID_COLS || h < BENCH_ANALYTICS_GRID_ROWS) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	/* no 0 and 255 but one of each, to check the locations */
+	bench_fill_random(src, w * h);
+	for (size_t i=0; i<w*h; i++) {
+		src[i] = 1 + src[i] % 254;
+	}
+	src[(h / 3) * w + w / 5] = 0;
+	src[(h / 2) * w + w - 1] = 255;
+
+	printf("%-8s %-16s %10s %10s %6s\n", "stats", "path", "ms", "Mpix/s",
+			"diff");
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		bench_analytics_ref(src, w, h, &ref, ref_cells);
+		perf_stop(&pc);
+	}
+	printf("%-8s %-16s %10.2f %10.1f %6d\n", "all", "xf passes",
+			perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)), 0);
+
+	for (size_t k=0; k<sizeof(analytics_runs)/sizeof(analytics_runs[0]); k++) {
+		const struct bench_analytics_run *run = &analytics_runs[k];
+		struct vlib_analytics *an;
+
+		an = vlib_analytics_create(w, h, 1, run->flags,
+								BENCH_ANALYTICS_GRID_COLS,
+								BENCH_ANALYTICS_GRID_ROWS);
+		if (!an) {
+			printf("%-8s unsupported\n", run->name);
+			continue;
+		}
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char path[32];
+
+			vlib_parallel_set_num_threads(threads);
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_analytics_run(an, src, w);
+				perf_stop(&pc);
+			}
+
+			snprintf(path, sizeof(path), "fused %zu thr", threads);
+			printf("%-8s %-16s %10.2f %10.1f %6zu\n", run->name, path,
+					perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)),
+					bench_analytics_diff(an, run->flags, &ref, ref_cells));
+		}
+
+		vlib_parallel_set_num_threads(0);
+		vlib_analytics_destroy(an);
+	}
+
+out:
+	free(src);
+}
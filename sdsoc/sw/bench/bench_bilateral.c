@@ -0,0 +1,157 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "bilateral.h"
+#include "parallel.h"
+
+/* range sigma of all runs */
+#define BENCH_BILATERAL_SIGMA_COLOR	20.0f
+
+/* window sizes of xf::bilateralFilter, sigma_space = (N - 1) / 4 */
+static const int bilateral_windows[] = { 5, 7, 9, 15 };
+
+/* flat blocks of random level with noise, edges between the blocks */
+static void bench_bilateral_scene(unsigned char *img, size_t w, size_t h)
+{
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			unsigned int b = (x / 64 * 7919 + y / 64 * 104729) % 97;
+			int v = 40 + b * 2 + (rand() % 21) + (rand() % 21) - 20;
+
+			img[y * w + x] = v < 0 ? 0 : v > 255 ? 255 : v;
+		}
+	}
+}
+
+/*
+ * The brute force window of xf::bilateralFilter: spatial and range
+ * weights from tables, every tap of the window, replicated borders.
+ */
+static void bench_bilateral_ref(const unsigned char *src, long w, long h,
+								unsigned char *dst, int win, float sigma_space,
+								float sigma_color)
+{
+	int r = win / 2;
+	float ws[31 * 31], wr[256];
+
+	for (int j=-r; j<=r; j++) {
+		for (int i=-r; i<=r; i++) {
+			ws[(j + r) * win + i + r] =
+				expf(-(i * i + j * j) / (2 * sigma_space * sigma_space));
+		}
+	}
+	for (int d=0; d<256; d++) {
+		wr[d] = expf(-(d * d) / (2 * sigma_color * sigma_color));
+	}
+
+	for (long y=0; y<h; y++) {
+		for (long x=0; x<w; x++) {
+			int c = src[y * w + x];
+			float s = 0, n = 0;
+
+			for (int j=-r; j<=r; j++) {
+				long yy = y + j < 0 ? 0 : y + j >= h ? h - 1 : y + j;
+				const float *wsr = ws + (j + r) * win + r;
+
+				for (int i=-r; i<=r; i++) {
+					long xx = x + i < 0 ? 0 : x + i >= w ? w - 1 : x + i;
+					int v = src[yy * w + xx];
+					float wt = wsr[i] * wr[abs(v - c)];
+
+					s += wt * v;
+					n += wt;
+				}
+			}
+			dst[y * w + x] = s / n + 0.5f;
+		}
+	}
+}
+
+/*
+ * Bilateral filter of an 8-bit frame: the brute force window vs. the
+ * bilateral grid with the same sigmas, single threaded and on all cores.
+ * The mean and largest difference to the window and the PSNR are shown.
+ */
+void bench_bilateral(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t cores = vlib_parallel_get_num_threads();
+	unsigned char *src = malloc(w * h);
+	unsigned char *ref = malloc(w * h);
+	unsigned char *dst = malloc(w * h);
+
+	if (!src || !ref || !dst) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_bilateral_scene(src, w, h);
+
+	printf("%-6s %-16s %10s %10s %8s %8s %8s\n", "window", "path", "ms",
+			"Mpix/s", "meandiff", "maxdiff", "PSNR");
+
+	for (size_t k=0; k<sizeof(bilateral_windows)/sizeof(bilateral_windows[0]); k++) {
+		int win = bilateral_windows[k];
+		float sigma_space = (win - 1) / 4.0f;
+		struct vlib_bilateral *bf;
+		struct perf_counter pc;
+		char name[16];
+
+		snprintf(name, sizeof(name), "%dx%d", win, win);
+
+		perf_reset(&pc);
+		perf_start(&pc);
+		bench_bilateral_ref(src, w, h, ref, win, sigma_space,
+							BENCH_BILATERAL_SIGMA_COLOR);
+		perf_stop(&pc);
+		printf("%-6s %-16s %10.2f %10.1f\n", name, "window",
+				perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)));
+
+		bf = vlib_bilateral_create(w, h, 1, sigma_space,
+								BENCH_BILATERAL_SIGMA_COLOR);
+		if (!bf) {
+			printf("%-6s unsupported\n", name);
+			continue;
+		}
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char path[32];
+			double sum = 0, mse = 0;
+			int maxdiff = 0;
+
+			vlib_parallel_set_num_threads(threads);
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_bilateral(bf, src, w, dst, w);
+				perf_stop(&pc);
+			}
+
+			for (size_t i=0; i<w*h; i++) {
+				int d = abs(dst[i] - ref[i]);
+
+				sum += d;
+				mse += d * d;
+				maxdiff = d > maxdiff ? d : maxdiff;
+			}
+			mse /= w * h;
+
+			snprintf(path, sizeof(path), "grid %zu thr", threads);
+			printf("%-6s %-16s %10.2f %10.1f %8.2f %8d %8.1f\n", name, path,
+					perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)),
+					sum / (w * h), maxdiff,
+					mse > 0 ? 10 * log10(255 * 255 / mse) : INFINITY);
+		}
+
+		vlib_parallel_set_num_threads(0);
+		vlib_bilateral_destroy(bf);
+	}
+
+out:
+	free(src);
+	free(ref);
+	free(dst);
+}
@@ -0,0 +1,217 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "canny.h"
+#include "parallel.h"
+
+static const int canny_thresholds[][2] = {
+	{ 30, 60 }, { 60, 120 }, { 120, 240 },
+};
+
+/* 3x3 box blurred noise, edges of every direction and length */
+static void bench_canny_scene(unsigned char *img, unsigned char *noise,
+							size_t w, size_t h)
+{
+	bench_fill_random(noise, w * h);
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			unsigned int s = 0, n = 0;
+
+			for (size_t j=y?y-1:0; j<=y+1 && j<h; j++) {
+				for (size_t i=x?x-1:0; i<=x+1 && i<w; i++) {
+					s += noise[j * w + i];
+					n++;
+				}
+			}
+			img[y * w + x] = s / n;
+		}
+	}
+}
+
+/*
+ * The xf stages one pixel at a time: Sobel, L1 magnitude, xFAngle,
+ * xFFindmax3x3, then the hysteresis over the whole frame from a stack.
+ */
+static void bench_canny_ref(const unsigned char *img, long w, long h, int low,
+							int high, int16_t *mag, uint8_t *dir,
+							uint8_t *out, uint32_t *stack)
+{
+	const int tg22 = 13573;
+	size_t n = 0;
+
+	for (long y=0; y<h; y++) {
+		for (long x=0; x<w; x++) {
+			const unsigned char *c = img + y * w + x;
+			int gx, gy, xa, ya;
+
+			if (x == 0 || y == 0 || x == w - 1 || y == h - 1) {
+				mag[y * w + x] = 0;
+				dir[y * w + x] = 0;
+				continue;
+			}
+
+			gx = c[-w + 1] - c[-w - 1] + 2 * (c[1] - c[-1]) + c[w + 1] - c[w - 1];
+			gy = c[w - 1] - c[-w - 1] + 2 * (c[w] - c[-w]) + c[w + 1] - c[-w + 1];
+			xa = abs(gx);
+			ya = abs(gy) << 15;
+			mag[y * w + x] = abs(gx) + abs(gy);
+
+			if (ya < xa * tg22) {
+				dir[y * w + x] = 0;
+			} else if (ya > xa * tg22 + (xa << 16)) {
+				dir[y * w + x] = 90;
+			} else {
+				dir[y * w + x] = (gx ^ gy) < 0 ? 45 : 135;
+			}
+		}
+	}
+
+	for (long y=0; y<h; y++) {
+		for (long x=0; x<w; x++) {
+			int m = mag[y * w + x], a, b, max;
+
+#define M(i, j)	(((i) < 0 || (j) < 0 || (i) >= w || (j) >= h) ? 0 : mag[(j) * w + (i)])
+			switch (dir[y * w + x]) {
+			case 0:
+				a = M(x - 1, y);
+				b = M(x + 1, y);
+				max = m > a && m >= b;
+				break;
+			case 90:
+				a = M(x, y - 1);
+				b = M(x, y + 1);
+				max = m > a && m >= b;
+				break;
+			case 45:
+				a = M(x + 1, y - 1);
+				b = M(x - 1, y + 1);
+				max = m > a && m > b;
+				break;
+			default:
+				a = M(x - 1, y - 1);
+				b = M(x + 1, y + 1);
+				max = m > a && m > b;
+				break;
+			}
+#undef M
+
+			out[y * w + x] = 0;
+			if (m > low && max) {
+				out[y * w + x] = m > high ? 255 : 1;
+				if (m > high) {
+					stack[n++] = y * w + x;
+				}
+			}
+		}
+	}
+
+	while (n) {
+		uint32_t p = stack[--n];
+		long y = p / w, x = p % w;
+
+		for (long j=y-1; j<=y+1; j++) {
+			for (long i=x-1; i<=x+1; i++) {
+				if (i >= 0 && j >= 0 && i < w && j < h && out[j * w + i] == 1) {
+					out[j * w + i] = 255;
+					stack[n++] = j * w + i;
+				}
+			}
+		}
+	}
+
+	for (long i=0; i<w*h; i++) {
+		if (out[i] == 1) {
+			out[i] = 0;
+		}
+	}
+}
+
+/*
+ * Canny on a noise scene: the xf stages pixel by pixel with a hysteresis
+ * over the whole frame vs. the tiled pipeline, single threaded and on all
+ * cores, for the thresholds of the filter modes. The reference runs once
+ * per threshold pair.
+ */
+void bench_canny(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	unsigned char *img = malloc(w * h);
+	unsigned char *noise = malloc(w * h);
+	int16_t *mag = malloc(w * h * sizeof(*mag));
+	uint8_t *dir = malloc(w * h);
+	uint8_t *ref = malloc(w * h);
+	uint8_t *edges = malloc(w * h);
+	uint32_t *stack = malloc(w * h * sizeof(*stack));
+	struct vlib_canny *cn = vlib_canny_create(w, h);
+	size_t cores = vlib_parallel_get_num_threads();
+
+	if (!img || !noise || !mag || !dir || !ref || !edges || !stack || !cn) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_canny_scene(img, noise, w, h);
+
+	printf("%-8s %-16s %10s %10s %10s %7s %6s\n", "low/high", "path", "ms",
+			"Mpix/s", "edges", "rounds", "match");
+
+	for (size_t i=0; i<sizeof(canny_thresholds)/sizeof(canny_thresholds[0]); i++) {
+		int low = canny_thresholds[i][0], high = canny_thresholds[i][1];
+		struct perf_counter pc;
+		char thr[16];
+		size_t count = 0;
+
+		snprintf(thr, sizeof(thr), "%d/%d", low, high);
+
+		perf_reset(&pc);
+		perf_start(&pc);
+		bench_canny_ref(img, w, h, low, high, mag, dir, ref, stack);
+		perf_stop(&pc);
+		for (size_t k=0; k<w*h; k++) {
+			count += ref[k] != 0;
+		}
+		printf("%-8s %-16s %10.2f %10.1f %10zu\n", thr, "reference",
+				perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)), count);
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			struct vlib_canny_stats stats;
+			char name[32];
+
+			vlib_parallel_set_num_threads(threads);
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_canny_compute(cn, img, w, edges, w, low, high);
+				perf_stop(&pc);
+			}
+			vlib_canny_get_stats(cn, &stats);
+
+			count = 0;
+			for (size_t k=0; k<w*h; k++) {
+				count += edges[k] != 0;
+			}
+
+			snprintf(name, sizeof(name), "tiled %zu thr", threads);
+			printf("%-8s %-16s %10.2f %10.1f %10zu %7zu %6s\n", thr, name,
+					perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)),
+					count, stats.rounds,
+					memcmp(edges, ref, w * h) ? "no" : "yes");
+		}
+
+		vlib_parallel_set_num_threads(0);
+	}
+
+out:
+	vlib_canny_destroy(cn);
+	free(img);
+	free(noise);
+	free(mag);
+	free(dir);
+	free(ref);
+	free(edges);
+	free(stack);
+}
@@ -0,0 +1,110 @@
+#include <drm/drm_fourcc.h>
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "cvt_color.h"
+#include "image.h"
+
+static const uint32_t cvt_fourccs[] = {
+	V4L2_PIX_FMT_YUYV,
+	V4L2_PIX_FMT_UYVY,
+	V4L2_PIX_FMT_NV12,
+	V4L2_PIX_FMT_NV21,
+	V4L2_PIX_FMT_YUV420,
+	V4L2_PIX_FMT_YVU420,
+	DRM_FORMAT_YUV444,
+	V4L2_PIX_FMT_GREY,
+	V4L2_PIX_FMT_RGB24,
+	V4L2_PIX_FMT_BGR24,
+	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_ABGR8888,
+};
+
+/* bytes per pixel of the first plane */
+static size_t cvt_bpp(uint32_t fourcc)
+{
+	switch (fourcc) {
+		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
+			return 2;
+		case V4L2_PIX_FMT_RGB24:
+		case V4L2_PIX_FMT_BGR24:
+			return 3;
+		case DRM_FORMAT_XRGB8888:
+		case DRM_FORMAT_ABGR8888:
+			return 4;
+		default:
+			return 1;
+	}
+}
+
+static double cvt_run(const struct bench_opts *opts, uint32_t src_fourcc,
+					uint32_t dst_fourcc, unsigned int scale)
+{
+	size_t sw = opts->width & ~3, sh = opts->height & ~3;
+	size_t dw = sw / scale, dh = sh / scale;
+	size_t ss = sw * cvt_bpp(src_fourcc), ds = dw * cvt_bpp(dst_fourcc);
+	unsigned char *sb = malloc(vlib_image_size(src_fourcc, sh, ss));
+	unsigned char *db = malloc(vlib_image_size(dst_fourcc, dh, ds));
+	struct vlib_image src, dst;
+	struct perf_counter pc;
+	double ms = 0;
+
+	if (!sb || !db) {
+		goto out;
+	}
+
+	bench_fill_random(sb, vlib_image_size(src_fourcc, sh, ss));
+	if (vlib_image_init(&src, src_fourcc, sw, sh, ss, sb) ||
+		vlib_image_init(&dst, dst_fourcc, dw, dh, ds, db)) {
+		goto out;
+	}
+
+	/* warm up caches and page in the buffers */
+	vlib_cvt_color(&src, &dst);
+
+	perf_reset(&pc);
+	for (unsigned int i=0; i<opts->iterations; i++) {
+		perf_start(&pc);
+		vlib_cvt_color(&src, &dst);
+		perf_stop(&pc);
+	}
+	ms = perf_avg_ms(&pc);
+
+out:
+	free(sb);
+	free(db);
+	return ms;
+}
+
+/*
+ * Throughput of every supported conversion pair, full size and with the
+ * fused 2x2 downscale. MPix/s is given in source pixels.
+ */
+void bench_cvt_color(const struct bench_opts *opts)
+{
+	size_t pixels = (opts->width & ~3) * (opts->height & ~3);
+
+	printf("%-6s %-6s %10s %10s %10s %10s\n", "src", "dst",
+			"1:1 ms", "MPix/s", "2:1 ms", "MPix/s");
+
+	for (size_t i=0; i<sizeof(cvt_fourccs)/sizeof(cvt_fourccs[0]); i++) {
+		for (size_t j=0; j<sizeof(cvt_fourccs)/sizeof(cvt_fourccs[0]); j++) {
+			uint32_t s = cvt_fourccs[i], d = cvt_fourccs[j];
+			double full, half;
+
+			if (!vlib_cvt_color_supported(s, d)) {
+				continue;
+			}
+
+			full = cvt_run(opts, s, d, 1);
+			half = cvt_run(opts, s, d, 2);
+			printf("%-6.4s %-6.4s %10.2f %10.1f %10.2f %10.1f\n",
+					(const char *)&s, (const char *)&d,
+					full, perf_mpix(pixels, full),
+					half, perf_mpix(pixels, half));
+		}
+	}
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "corners.h"
+#include "fast.h"
+#include "parallel.h"
+
+static const int fast_thresholds[] = { 10, 20, 40 };
+
+/* 3x3 box blurred noise, a dense field of corners */
+static void bench_fast_scene(unsigned char *img, unsigned char *noise,
+							size_t w, size_t h)
+{
+	bench_fill_random(noise, w * h);
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			unsigned int s = 0, n = 0;
+
+			for (size_t j=y?y-1:0; j<=y+1 && j<h; j++) {
+				for (size_t i=x?x-1:0; i<=x+1 && i<w; i++) {
+					s += noise[j * w + i];
+					n++;
+				}
+			}
+			img[y * w + x] = s / n;
+		}
+	}
+}
+
+/*
+ * FAST-9 with NMS: the whole frame into one raster order list vs. the
+ * bucketed grid keeping the strongest corners per cell, single threaded
+ * and on all cores, for several thresholds.
+ */
+void bench_fast(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	unsigned char *img = malloc(w * h);
+	unsigned char *noise = malloc(w * h);
+	size_t cores = vlib_parallel_get_num_threads();
+	struct vlib_corners list = { 0 };
+
+	if (!img || !noise || vlib_corners_init(&list, w * h / 4)) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fast_scene(img, noise, w, h);
+
+	printf("%-9s %-16s %10s %10s %10s\n", "threshold", "path", "ms", "Mpix/s",
+			"corners");
+
+	for (size_t i=0; i<sizeof(fast_thresholds)/sizeof(fast_thresholds[0]); i++) {
+		struct vlib_fast_params params;
+		struct vlib_corners cells = { 0 };
+		struct vlib_fast *fd;
+		struct perf_counter pc;
+
+		perf_reset(&pc);
+		for (unsigned int n=0; n<opts->iterations; n++) {
+			perf_start(&pc);
+			vlib_fast_detect(img, w, w, h, fast_thresholds[i], 1, &list);
+			perf_stop(&pc);
+		}
+		printf("%-9d %-16s %10.2f %10.1f %10zu\n", fast_thresholds[i], "list",
+				perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)),
+				list.count);
+
+		vlib_fast_default_params(&params);
+		params.threshold = fast_thresholds[i];
+		fd = vlib_fast_create(&params, w, h);
+		if (!fd || vlib_corners_init(&cells, vlib_fast_capacity(fd))) {
+			printf("%-9d grid unsupported\n", fast_thresholds[i]);
+			vlib_fast_destroy(fd);
+			continue;
+		}
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char name[32];
+
+			vlib_parallel_set_num_threads(threads);
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_fast_detect_grid(fd, img, w, &cells);
+				perf_stop(&pc);
+			}
+
+			snprintf(name, sizeof(name), "grid %zu thr", threads);
+			printf("%-9d %-16s %10.2f %10.1f %10zu\n", fast_thresholds[i], name,
+					perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)),
+					cells.count);
+		}
+
+		vlib_parallel_set_num_threads(0);
+		vlib_corners_free(&cells);
+		vlib_fast_destroy(fd);
+	}
+
+out:
+	vlib_corners_free(&list);
+	free(img);
+	free(noise);
+}
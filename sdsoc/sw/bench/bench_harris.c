@@ -0,0 +1,206 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "corners.h"
+#include "harris.h"
+#include "parallel.h"
+
+static const int harris_blocks[] = { 3, 5, 7 };
+
+/* 3x3 box blurred noise, a dense field of corners */
+static void bench_harris_scene(unsigned char *img, unsigned char *noise,
+							size_t w, size_t h)
+{
+	bench_fill_random(noise, w * h);
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			unsigned int s = 0, n = 0;
+
+			for (size_t j=y?y-1:0; j<=y+1 && j<h; j++) {
+				for (size_t i=x?x-1:0; i<=x+1 && i<w; i++) {
+					s += noise[j * w + i];
+					n++;
+				}
+			}
+			img[y * w + x] = s / n;
+		}
+	}
+}
+
+/*
+ * The stages of the xf kernel one after the other, each over the whole
+ * frame into its own image: Sobel, products, box filter, response and
+ * suppression. Returns the number of corners and their score sum.
+ */
+static size_t bench_harris_staged(const unsigned char *img, long w, long h,
+								const struct vlib_harris_params *p,
+								int16_t *prod, int32_t *resp,
+								int64_t *checksum)
+{
+	static const int32_t div[] = { 3641, 1311, 669 };
+	const long rb = p->block_size / 2, nr = p->nms_radius;
+	int16_t *xx = prod, *yy = prod + w * h, *xy = prod + 2 * w * h;
+	size_t n = 0;
+
+	*checksum = 0;
+
+	for (long y=0; y<h; y++) {
+		for (long x=0; x<w; x++) {
+			const unsigned char *c = img + y * w + x;
+			int gx, gy;
+
+			if (x == 0 || y == 0 || x == w - 1 || y == h - 1) {
+				xx[y * w + x] = yy[y * w + x] = xy[y * w + x] = 0;
+				continue;
+			}
+
+			gx = c[-w + 1] - c[-w - 1] + 2 * (c[1] - c[-1]) + c[w + 1] - c[w - 1];
+			gy = c[w - 1] - c[-w - 1] + 2 * (c[w] - c[-w]) + c[w + 1] - c[-w + 1];
+			xx[y * w + x] = (gx * gx) >> 6;
+			yy[y * w + x] = (gy * gy) >> 6;
+			xy[y * w + x] = (gx * gy) >> 6;
+		}
+	}
+
+	for (long y=0; y<h; y++) {
+		for (long x=0; x<w; x++) {
+			int32_t s[3] = { 0 }, a, b, c, t;
+
+			for (long j=y-rb; j<=y+rb; j++) {
+				for (long i=x-rb; i<=x+rb; i++) {
+					if (i < 0 || j < 0 || i >= w || j >= h) {
+						continue;
+					}
+					s[0] += xx[j * w + i];
+					s[1] += yy[j * w + i];
+					s[2] += xy[j * w + i];
+				}
+			}
+
+			a = (s[0] * div[rb - 1]) >> 17;
+			b = (s[1] * div[rb - 1]) >> 17;
+			c = (s[2] * div[rb - 1]) >> 17;
+			t = a + b;
+			resp[y * w + x] = a * b - c * c -
+							(int32_t)(((int64_t)t * t * p->k) >> 16);
+		}
+	}
+
+	for (long y=0; y<h; y++) {
+		for (long x=0; x<w; x++) {
+			int32_t s = resp[y * w + x];
+			int max = s > p->threshold;
+
+			for (long j=y-nr; j<=y+nr && max; j++) {
+				for (long i=x-nr; i<=x+nr; i++) {
+					if (i < 0 || j < 0 || i >= w || j >= h ||
+						(i == x && j == y)) {
+						continue;
+					}
+					if (resp[j * w + i] >= s) {
+						max = 0;
+						break;
+					}
+				}
+			}
+
+			if (max) {
+				*checksum += s;
+				n++;
+			}
+		}
+	}
+
+	return n;
+}
+
+/*
+ * Harris corners of a noise scene: the stages of the xf kernel over whole
+ * frames vs. the fused line buffer pass, single threaded and on all
+ * cores, for each block size. The cells of the fused pass keep all
+ * corners here, so both find the same ones. The staged version runs once
+ * per size.
+ */
+void bench_harris(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	unsigned char *img = malloc(w * h);
+	unsigned char *noise = malloc(w * h);
+	int16_t *prod = malloc(3 * w * h * sizeof(*prod));
+	int32_t *resp = malloc(w * h * sizeof(*resp));
+	size_t cores = vlib_parallel_get_num_threads();
+
+	if (!img || !noise || !prod || !resp) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_harris_scene(img, noise, w, h);
+
+	printf("%-6s %-16s %10s %10s %10s %8s\n", "block", "path", "ms", "Mpix/s",
+			"corners", "match");
+
+	for (size_t i=0; i<sizeof(harris_blocks)/sizeof(harris_blocks[0]); i++) {
+		struct vlib_harris_params params;
+		struct vlib_corners corners = { 0 };
+		struct vlib_harris *hd;
+		struct perf_counter pc;
+		int64_t ref_sum;
+		size_t ref;
+
+		vlib_harris_default_params(&params);
+		params.block_size = harris_blocks[i];
+		/* a 3x3 maximum per 2x2 pixels at most */
+		params.max_per_cell = params.cell_size * params.cell_size / 4;
+
+		perf_reset(&pc);
+		perf_start(&pc);
+		ref = bench_harris_staged(img, w, h, &params, prod, resp, &ref_sum);
+		perf_stop(&pc);
+		printf("%-6d %-16s %10.2f %10.1f %10zu\n", params.block_size, "staged",
+				perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)), ref);
+
+		hd = vlib_harris_create(&params, w, h);
+		if (!hd || vlib_corners_init(&corners, vlib_harris_capacity(hd))) {
+			printf("%-6d unsupported\n", params.block_size);
+			vlib_harris_destroy(hd);
+			continue;
+		}
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char name[32];
+			int64_t sum = 0;
+
+			vlib_parallel_set_num_threads(threads);
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_harris_detect(hd, img, w, &corners);
+				perf_stop(&pc);
+			}
+
+			for (size_t k=0; k<corners.count; k++) {
+				sum += corners.score[k];
+			}
+
+			snprintf(name, sizeof(name), "fused %zu thr", threads);
+			printf("%-6d %-16s %10.2f %10.1f %10zu %8s\n", params.block_size,
+					name, perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)),
+					corners.count,
+					corners.count == ref && sum == ref_sum ? "yes" : "no");
+		}
+
+		vlib_parallel_set_num_threads(0);
+		vlib_corners_free(&corners);
+		vlib_harris_destroy(hd);
+	}
+
+out:
+	free(img);
+	free(noise);
+	free(prod);
+	free(resp);
+}
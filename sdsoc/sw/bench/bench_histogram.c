@@ -0,0 +1,142 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "histogram.h"
+#include "parallel.h"
+
+/* xf::calcHist in software: one counter per bin, one pass */
+static void bench_histogram_ref(const unsigned char *src, size_t n,
+							uint32_t *hist)
+{
+	memset(hist, 0, VLIB_HISTOGRAM_BINS * sizeof(*hist));
+	for (size_t i=0; i<n; i++) {
+		hist[src[i]]++;
+	}
+}
+
+/*
+ * xf::calcHist, xf::equalizeHist and xf::OtsuThreshold one after the
+ * other, each with its own histogram pass.
+ */
+static uint8_t bench_histogram_xf(const unsigned char *src, size_t n,
+							unsigned char *dst, uint32_t *hist)
+{
+	uint32_t h[VLIB_HISTOGRAM_BINS];
+	uint8_t lut[VLIB_HISTOGRAM_BINS];
+
+	bench_histogram_ref(src, n, hist);
+
+	bench_histogram_ref(src, n, h);
+	vlib_histogram_equalize_lut(h, lut);
+	for (size_t i=0; i<n; i++) {
+		dst[i] = lut[src[i]];
+	}
+
+	bench_histogram_ref(src, n, h);
+
+	return vlib_histogram_otsu(h);
+}
+
+static void bench_histogram_print(const char *path, double ms, size_t pixels,
+							const uint32_t *hist, const uint32_t *ref,
+							const unsigned char *dst, const unsigned char *dst_ref,
+							int otsu)
+{
+	size_t bins = 0, diff = 0;
+
+	for (size_t i=0; i<VLIB_HISTOGRAM_BINS; i++) {
+		bins += hist[i] != ref[i];
+	}
+	for (size_t i=0; i<pixels; i++) {
+		diff += dst[i] != dst_ref[i];
+	}
+
+	printf("%-20s %10.2f %10.1f %6zu %8zu %6d\n", path, ms,
+			perf_mpix(pixels, ms), bins, diff, otsu);
+}
+
+/*
+ * Histogram, equalization and Otsu threshold of an 8-bit frame of low
+ * contrast: three passes as the xf kernels vs. one histogram on all
+ * cores with the table and threshold derived from it, and the single
+ * streaming pass mapping with the table of the previous frame. Bins and
+ * pixels differing from the xf passes are counted.
+ */
+void bench_histogram(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t cores = vlib_parallel_get_num_threads();
+	unsigned char *src = malloc(w * h);
+	unsigned char *ref = malloc(w * h);
+	unsigned char *dst = malloc(w * h);
+	uint32_t hist_ref[VLIB_HISTOGRAM_BINS], hist[VLIB_HISTOGRAM_BINS];
+	uint8_t lut[VLIB_HISTOGRAM_BINS];
+	struct perf_counter pc;
+	int otsu = 0;
+
+	if (!src || !ref || !dst) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fill_random(src, w * h);
+	for (size_t i=0; i<w*h; i++) {
+		src[i] = 96 + src[i] / 4;
+	}
+
+	printf("%-20s %10s %10s %6s %8s %6s\n", "path", "ms", "Mpix/s", "bins",
+			"diff", "otsu");
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		otsu = bench_histogram_xf(src, w * h, ref, hist_ref);
+		perf_stop(&pc);
+	}
+	bench_histogram_print("xf 3 passes", perf_avg_ms(&pc), w * h, hist_ref,
+						hist_ref, ref, ref, otsu);
+
+	for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+		char path[32];
+
+		vlib_parallel_set_num_threads(threads);
+
+		memset(dst, 0, w * h);
+		perf_reset(&pc);
+		for (unsigned int n=0; n<opts->iterations; n++) {
+			perf_start(&pc);
+			vlib_histogram(src, w, w, h, 1, hist);
+			vlib_histogram_equalize_lut(hist, lut);
+			otsu = vlib_histogram_otsu(hist);
+			vlib_histogram_lut(src, w, dst, w, w, h, 1, lut, NULL);
+			perf_stop(&pc);
+		}
+		snprintf(path, sizeof(path), "shared %zu thr", threads);
+		bench_histogram_print(path, perf_avg_ms(&pc), w * h, hist, hist_ref,
+							dst, ref, otsu);
+
+		/* the same frame again, mapped with the table of the last run */
+		memset(dst, 0, w * h);
+		perf_reset(&pc);
+		for (unsigned int n=0; n<opts->iterations; n++) {
+			perf_start(&pc);
+			vlib_histogram_lut(src, w, dst, w, w, h, 1, lut, hist);
+			vlib_histogram_equalize_lut(hist, lut);
+			otsu = vlib_histogram_otsu(hist);
+			perf_stop(&pc);
+		}
+		snprintf(path, sizeof(path), "stream %zu thr", threads);
+		bench_histogram_print(path, perf_avg_ms(&pc), w * h, hist, hist_ref,
+							dst, ref, otsu);
+	}
+
+	vlib_parallel_set_num_threads(0);
+
+out:
+	free(src);
+	free(ref);
+	free(dst);
+}
@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "hog.h"
+#include "parallel.h"
+
+/* window strides of the runs, in pixels */
+static const int hog_strides[] = { 8, 16 };
+
+/* 3x3 box blurred noise, gradients of every orientation */
+static void bench_hog_scene(unsigned char *img, unsigned char *noise,
+							size_t w, size_t h)
+{
+	bench_fill_random(noise, w * h);
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			unsigned int s = 0, n = 0;
+
+			for (size_t j=y?y-1:0; j<=y+1 && j<h; j++) {
+				for (size_t i=x?x-1:0; i<=x+1 && i<w; i++) {
+					s += noise[j * w + i];
+					n++;
+				}
+			}
+			img[y * w + x] = s / n;
+		}
+	}
+}
+
+/*
+ * HOG detection with a random linear SVM: a descriptor per window from its
+ * own pixels followed by its SVM score, as xf::HOGDescriptor and xf::SVM
+ * per window, vs. the cells and blocks of the frame shared by all windows
+ * and scored in place, single threaded and on all cores. The per window
+ * version runs once per stride.
+ */
+void bench_hog(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	unsigned char *img = malloc(w * h);
+	unsigned char *noise = malloc(w * h);
+	size_t cores = vlib_parallel_get_num_threads();
+	struct vlib_hog_params params;
+
+	if (!img || !noise) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_hog_scene(img, noise, w, h);
+	vlib_hog_default_params(&params);
+
+	printf("%-6s %-16s %10s %10s %10s %8s\n", "stride", "path", "ms",
+			"Mpix/s", "windows", "match");
+
+	for (size_t i=0; i<sizeof(hog_strides)/sizeof(hog_strides[0]); i++) {
+		struct vlib_hog *hog;
+		struct perf_counter pc;
+		size_t cols, rows, n;
+		float *weights = NULL, *ref = NULL, *scores = NULL;
+		int16_t *desc = NULL;
+
+		params.win_stride = hog_strides[i];
+		hog = vlib_hog_create(&params, w, h);
+		if (!hog) {
+			printf("%-6d unsupported\n", params.win_stride);
+			continue;
+		}
+
+		vlib_hog_get_windows(hog, &cols, &rows);
+		n = vlib_hog_descriptor_size(hog);
+		weights = malloc(n * sizeof(*weights));
+		desc = malloc(n * sizeof(*desc));
+		ref = malloc(cols * rows * sizeof(*ref));
+		scores = malloc(cols * rows * sizeof(*scores));
+		if (!weights || !desc || !ref || !scores) {
+			printf("setup failed\n");
+			goto next;
+		}
+
+		for (size_t k=0; k<n; k++) {
+			weights[k] = (rand() % 2001 - 1000) / 20000.0f;
+		}
+		if (vlib_hog_set_svm(hog, weights, -0.5f)) {
+			printf("%-6d unsupported\n", params.win_stride);
+			goto next;
+		}
+
+		perf_reset(&pc);
+		perf_start(&pc);
+		for (size_t y=0; y<rows; y++) {
+			for (size_t x=0; x<cols; x++) {
+				vlib_hog_describe(hog, img, w, x * params.win_stride,
+								y * params.win_stride, desc);
+				ref[y * cols + x] = vlib_hog_svm_score(hog, desc);
+			}
+		}
+		perf_stop(&pc);
+		printf("%-6d %-16s %10.2f %10.1f %10zu\n", params.win_stride,
+				"per window", perf_avg_ms(&pc),
+				perf_mpix(w * h, perf_avg_ms(&pc)), cols * rows);
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char name[32];
+			size_t same = 0;
+
+			vlib_parallel_set_num_threads(threads);
+
+			perf_reset(&pc);
+			for (unsigned int k=0; k<opts->iterations; k++) {
+				perf_start(&pc);
+				vlib_hog_detect(hog, img, w, scores, cols * sizeof(*scores));
+				perf_stop(&pc);
+			}
+
+			for (size_t k=0; k<cols*rows; k++) {
+				same += scores[k] == ref[k];
+			}
+
+			snprintf(name, sizeof(name), "shared %zu thr", threads);
+			printf("%-6d %-16s %10.2f %10.1f %10zu %8s\n", params.win_stride,
+					name, perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)),
+					cols * rows, same == cols * rows ? "yes" : "no");
+		}
+
+		vlib_parallel_set_num_threads(0);
+
+next:
+		free(weights);
+		free(desc);
+		free(ref);
+		free(scores);
+		vlib_hog_destroy(hog);
+	}
+
+out:
+	free(img);
+	free(noise);
+}
@@ -0,0 +1,176 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "inrange.h"
+#include "parallel.h"
+
+/* numbers of color ranges of the runs */
+static const size_t inrange_colors[] = { 1, 4, 16, VLIB_INRANGE_MAX_COLORS };
+
+/* xf::colorthresholding in software: every range compared on every pixel */
+static void bench_inrange_ref(const unsigned char *src, size_t n,
+							const uint8_t (*low)[3], const uint8_t (*high)[3],
+							size_t colors, unsigned char *dst)
+{
+	for (size_t i=0; i<n; i++, src+=3) {
+		unsigned char m = 0;
+
+		for (size_t c=0; c<colors; c++) {
+			m |= src[0] >= low[c][0] && src[0] <= high[c][0] &&
+				src[1] >= low[c][1] && src[1] <= high[c][1] &&
+				src[2] >= low[c][2] && src[2] <= high[c][2] ? 255 : 0;
+		}
+		dst[i] = m;
+	}
+}
+
+/* xf::rgb2hsv in software with hue in 0..179, rounded to nearest */
+static void bench_inrange_hsv(const unsigned char *src, size_t n,
+							unsigned char *dst)
+{
+	for (size_t i=0; i<n; i++, src+=3, dst+=3) {
+		int r = src[0], g = src[1], b = src[2];
+		int v = r > g ? (r > b ? r : b) : (g > b ? g : b);
+		int vmin = r < g ? (r < b ? r : b) : (g < b ? g : b);
+		int diff = v - vmin;
+		float h;
+
+		if (!diff) {
+			h = 0;
+		} else if (v == r) {
+			h = 30.0f * (g - b) / diff;
+		} else if (v == g) {
+			h = 60.0f + 30.0f * (b - r) / diff;
+		} else {
+			h = 120.0f + 30.0f * (r - g) / diff;
+		}
+		h += h < 0 ? 180 : 0;
+
+		dst[0] = h + 0.5f;
+		dst[1] = v ? 255.0f * diff / v + 0.5f : 0;
+		dst[2] = v;
+	}
+}
+
+static void bench_inrange_print(size_t colors, const char *path, double ms,
+							size_t pixels, const unsigned char *dst,
+							const unsigned char *ref)
+{
+	size_t diff = 0;
+
+	for (size_t i=0; i<pixels; i++) {
+		diff += dst[i] != ref[i];
+	}
+
+	printf("%-6zu %-16s %10.2f %10.1f %8zu\n", colors, path, ms,
+			perf_mpix(pixels, ms), diff);
+}
+
+/*
+ * Multi-color thresholding of a 3 channel frame: every range on every
+ * pixel as xf::colorthresholding vs. the bit mask tables, single threaded
+ * and on all cores, for growing numbers of colors. Then RGB input through
+ * a separate HSV conversion vs. the fused conversion, where pixels
+ * differing from the separate pass are counted; the fused conversion
+ * rounds as the float one, so there should be none.
+ */
+void bench_inrange(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t cores = vlib_parallel_get_num_threads();
+	unsigned char *src = malloc(w * h * 3);
+	unsigned char *hsv = malloc(w * h * 3);
+	unsigned char *ref = malloc(w * h);
+	unsigned char *dst = malloc(w * h);
+	uint8_t low[VLIB_INRANGE_MAX_COLORS][3], high[VLIB_INRANGE_MAX_COLORS][3];
+	struct perf_counter pc;
+
+	if (!src || !hsv || !ref || !dst) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fill_random(src, w * h * 3);
+
+	/* narrow hue bands of a wide saturation and value range */
+	for (size_t c=0; c<VLIB_INRANGE_MAX_COLORS; c++) {
+		low[c][0] = c * 180 / VLIB_INRANGE_MAX_COLORS;
+		high[c][0] = low[c][0] + 2;
+		low[c][1] = 60 + c;
+		high[c][1] = 255;
+		low[c][2] = 40;
+		high[c][2] = 255 - c;
+	}
+
+	printf("%-6s %-16s %10s %10s %8s\n", "colors", "path", "ms", "Mpix/s",
+			"diff");
+
+	for (size_t k=0; k<sizeof(inrange_colors)/sizeof(inrange_colors[0]); k++) {
+		size_t colors = inrange_colors[k];
+		struct vlib_inrange *ir = vlib_inrange_create(low, high, colors);
+
+		if (!ir) {
+			printf("%-6zu unsupported\n", colors);
+			continue;
+		}
+
+		perf_reset(&pc);
+		for (unsigned int n=0; n<opts->iterations; n++) {
+			perf_start(&pc);
+			bench_inrange_ref(src, w * h, low, high, colors, ref);
+			perf_stop(&pc);
+		}
+		bench_inrange_print(colors, "compare", perf_avg_ms(&pc), w * h, ref,
+							ref);
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char path[32];
+
+			vlib_parallel_set_num_threads(threads);
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_inrange(ir, src, w * 3, dst, w, w, h);
+				perf_stop(&pc);
+			}
+
+			snprintf(path, sizeof(path), "lut %zu thr", threads);
+			bench_inrange_print(colors, path, perf_avg_ms(&pc), w * h, dst,
+								ref);
+		}
+
+		vlib_parallel_set_num_threads(0);
+
+		if (colors == VLIB_INRANGE_MAX_COLORS) {
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				bench_inrange_hsv(src, w * h, hsv);
+				vlib_inrange(ir, hsv, w * 3, ref, w, w, h);
+				perf_stop(&pc);
+			}
+			bench_inrange_print(colors, "rgb2hsv + lut", perf_avg_ms(&pc),
+								w * h, ref, ref);
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_inrange_rgb(ir, src, w * 3, dst, w, w, h);
+				perf_stop(&pc);
+			}
+			bench_inrange_print(colors, "fused rgb", perf_avg_ms(&pc),
+								w * h, dst, ref);
+		}
+
+		vlib_inrange_destroy(ir);
+	}
+
+out:
+	free(src);
+	free(hsv);
+	free(ref);
+	free(dst);
+}
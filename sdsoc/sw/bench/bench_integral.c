@@ -0,0 +1,187 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "integral.h"
+#include "parallel.h"
+
+/* box of the box sum runs */
+#define BENCH_INTEGRAL_BOX	15
+
+/* xf::integral in software: one pass, each pixel from its neighbours */
+static void bench_integral_ref(const unsigned char *src, size_t w, size_t h,
+							uint64_t *dst)
+{
+	for (size_t y=0; y<h; y++) {
+		uint64_t row = 0;
+
+		for (size_t x=0; x<w; x++) {
+			row += src[y * w + x];
+			dst[y * w + x] = row + (y ? dst[(y - 1) * w + x] : 0);
+		}
+	}
+}
+
+/* integral element @x of a row of @depth, 0 left of or above the frame */
+static inline uint32_t bench_integral_at(const void *row,
+							enum vlib_integral_depth depth, long x)
+{
+	if (!row || x < 0) {
+		return 0;
+	}
+
+	return depth == VLIB_INTEGRAL_32 ? ((const uint32_t *)row)[x] :
+			(uint32_t)((const uint64_t *)row)[x];
+}
+
+/* box sums of output row @y from the integral rows @y and @y - box */
+static void bench_integral_box_row(const void *a, const void *b,
+							enum vlib_integral_depth depth, size_t w,
+							uint32_t *dst)
+{
+	long k = BENCH_INTEGRAL_BOX;
+
+	for (long x=k-1; x<(long)w; x++) {
+		dst[x] = bench_integral_at(b, depth, x) -
+				bench_integral_at(b, depth, x - k) -
+				bench_integral_at(a, depth, x) +
+				bench_integral_at(a, depth, x - k);
+	}
+}
+
+static void bench_integral_print(const char *path, double ms, size_t pixels,
+							size_t diff, size_t bytes)
+{
+	printf("%-20s %10.2f %10.1f %8zu %10zu\n", path, ms,
+			perf_mpix(pixels, ms), diff, bytes / 1024);
+}
+
+/* full frame integrals of @depth, on 1 thread and all cores */
+static void bench_integral_frame(const struct bench_opts *opts,
+							const unsigned char *src, const uint64_t *ref,
+							void *dst, enum vlib_integral_depth depth)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t cores = vlib_parallel_get_num_threads();
+	struct perf_counter pc;
+
+	for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+		char path[32];
+		size_t diff = 0;
+
+		vlib_parallel_set_num_threads(threads);
+
+		memset(dst, 0, w * h * depth);
+		perf_reset(&pc);
+		for (unsigned int n=0; n<opts->iterations; n++) {
+			perf_start(&pc);
+			vlib_integral(src, w, dst, w * depth, w, h, depth);
+			perf_stop(&pc);
+		}
+
+		for (size_t i=0; i<w*h; i++) {
+			uint64_t v = depth == VLIB_INTEGRAL_32 ?
+						((uint32_t *)dst)[i] : ((uint64_t *)dst)[i];
+
+			diff += v != ref[i];
+		}
+
+		snprintf(path, sizeof(path), "scan %d-bit %zu thr", depth * 8,
+				threads);
+		bench_integral_print(path, perf_avg_ms(&pc), w * h, diff,
+							w * h * depth);
+	}
+
+	vlib_parallel_set_num_threads(0);
+}
+
+/*
+ * Integral image of an 8-bit frame: the sequential pass of xf::integral
+ * vs. the vector scan with the column sums on all cores, 32-bit where the
+ * frame allows it and 64-bit, differences to the sequential pass counted.
+ * Then box sums from the full frame of integrals vs. the rolling integral
+ * rows, with the memory of the integrals in KB.
+ */
+void bench_integral(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t k = BENCH_INTEGRAL_BOX;
+	enum vlib_integral_depth depth = vlib_integral_depth(w, h);
+	unsigned char *src = malloc(w * h);
+	uint64_t *ref = malloc(w * h * sizeof(*ref));
+	uint64_t *dst = malloc(w * h * sizeof(*dst));
+	uint32_t *box = calloc(w * h, sizeof(*box));
+	uint32_t *box_ref = calloc(w * h, sizeof(*box_ref));
+	struct vlib_integral_rows *ir = vlib_integral_rows_create(w, k + 1);
+	struct perf_counter pc;
+	size_t diff = 0;
+
+	if (!src || !ref || !dst || !box || !box_ref || !ir || h < k || w < k) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fill_random(src, w * h);
+
+	printf("%-20s %10s %10s %8s %10s\n", "path", "ms", "Mpix/s", "diff",
+			"KB");
+
+	perf_reset(&pc);
+	perf_start(&pc);
+	bench_integral_ref(src, w, h, ref);
+	perf_stop(&pc);
+	bench_integral_print("sequential 64-bit", perf_avg_ms(&pc), w * h, 0,
+						w * h * sizeof(*ref));
+
+	if (depth == VLIB_INTEGRAL_32) {
+		bench_integral_frame(opts, src, ref, dst, VLIB_INTEGRAL_32);
+	}
+	bench_integral_frame(opts, src, ref, dst, VLIB_INTEGRAL_64);
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		vlib_integral(src, w, dst, w * depth, w, h, depth);
+		for (size_t y=k-1; y<h; y++) {
+			const uint8_t *d = (const uint8_t *)dst;
+
+			bench_integral_box_row(y >= k ? d + (y - k) * w * depth : NULL,
+								d + y * w * depth, depth, w, box_ref + y * w);
+		}
+		perf_stop(&pc);
+	}
+	bench_integral_print("box frame", perf_avg_ms(&pc), w * h, 0,
+						w * h * depth);
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		vlib_integral_rows_reset(ir);
+		for (size_t y=0; y<h; y++) {
+			const uint32_t *b = vlib_integral_rows_push(ir, src + y * w);
+
+			if (y >= k - 1) {
+				const uint32_t *a = vlib_integral_rows_get(ir,
+										(long)y - (long)k);
+
+				bench_integral_box_row(a, b, VLIB_INTEGRAL_32, w, box + y * w);
+			}
+		}
+		perf_stop(&pc);
+	}
+	for (size_t i=0; i<w*h; i++) {
+		diff += box[i] != box_ref[i];
+	}
+	bench_integral_print("box rolling rows", perf_avg_ms(&pc), w * h, diff,
+						(k + 1) * w * sizeof(uint32_t));
+
+out:
+	vlib_integral_rows_destroy(ir);
+	free(src);
+	free(ref);
+	free(dst);
+	free(box);
+	free(box_ref);
+}
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "lk_flow.h"
+#include "parallel.h"
+
+/* motion of the next frame, in pixels */
+#define LK_FLOW_SHIFT		1
+
+static const int lk_flow_windows[] = { 5, 11, 25 };
+
+/* IxIx, IxIy, IyIy, IxIt and IyIt of one pixel as the xf kernel */
+static void bench_lk_flow_products(const unsigned char *prev,
+								const unsigned char *next, long w, long h,
+								long x, long y, int *p)
+{
+	const unsigned char *c = prev + y * w + x;
+	int ix, iy, dt;
+
+	if (x == 0 || y == 0 || x == w - 1 || y == h - 1) {
+		p[0] = p[1] = p[2] = p[3] = p[4] = 0;
+		return;
+	}
+
+	ix = (c[1] - c[-1]) / 2;
+	iy = (c[w] - c[-w]) / 2;
+	dt = c[0] - next[y * w + x];
+	p[0] = ix * ix;
+	p[1] = ix * iy;
+	p[2] = iy * iy;
+	p[3] = dt * ix;
+	p[4] = dt * iy;
+}
+
+/* the whole window summed for every pixel */
+static void bench_lk_flow_window(const unsigned char *prev,
+								const unsigned char *next, long w, long h,
+								int ws, float *fx, float *fy)
+{
+	long r = ws / 2;
+
+	for (long y=0; y<h; y++) {
+		for (long x=0; x<w; x++) {
+			int s[5] = { 0 }, p[5];
+			float det;
+
+			for (long j=y-r; j<=y+r; j++) {
+				for (long i=x-r; i<=x+r; i++) {
+					if (i < 0 || j < 0 || i >= w || j >= h) {
+						continue;
+					}
+					bench_lk_flow_products(prev, next, w, h, i, j, p);
+					for (int k=0; k<5; k++) {
+						s[k] += p[k];
+					}
+				}
+			}
+
+			det = (float)s[0] * s[2] - (float)s[1] * s[1];
+			if (det <= 1.0f) {
+				fx[y * w + x] = 0;
+				fy[y * w + x] = 0;
+			} else {
+				float i00 = (float)s[2] / det;
+				float i01 = (float)-s[1] / det;
+				float i11 = (float)s[0] / det;
+
+				fx[y * w + x] = i00 * s[3] + i01 * s[4];
+				fy[y * w + x] = i01 * s[3] + i11 * s[4];
+			}
+		}
+	}
+}
+
+/*
+ * Dense Lucas-Kanade flow of a smooth random scene moving right: the
+ * window loop of the xf kernel evaluated per pixel vs. the box summed
+ * product images, single threaded and on all cores, for increasing
+ * window sizes. The window loop runs once per size.
+ */
+void bench_lk_flow(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	unsigned char *noise = malloc((w + LK_FLOW_SHIFT) * h);
+	unsigned char *scene = malloc((w + LK_FLOW_SHIFT) * h);
+	unsigned char *prev = malloc(w * h);
+	unsigned char *next = malloc(w * h);
+	float *flow = malloc(4 * w * h * sizeof(*flow));
+	size_t cores = vlib_parallel_get_num_threads();
+	size_t sw = w + LK_FLOW_SHIFT;
+
+	if (!noise || !scene || !prev || !next || !flow) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	/* 3x3 box blurred noise, so that the gradients are meaningful */
+	bench_fill_random(noise, sw * h);
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<sw; x++) {
+			unsigned int s = 0, n = 0;
+
+			for (size_t j=y?y-1:0; j<=y+1 && j<h; j++) {
+				for (size_t i=x?x-1:0; i<=x+1 && i<sw; i++) {
+					s += noise[j * sw + i];
+					n++;
+				}
+			}
+			scene[y * sw + x] = s / n;
+		}
+	}
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			prev[y * w + x] = scene[y * sw + x + LK_FLOW_SHIFT];
+			next[y * w + x] = scene[y * sw + x];
+		}
+	}
+
+	printf("%-6s %-16s %10s %10s %10s\n", "window", "path", "ms", "Mpix/s",
+			"max diff");
+
+	for (size_t i=0; i<sizeof(lk_flow_windows)/sizeof(lk_flow_windows[0]); i++) {
+		int ws = lk_flow_windows[i];
+		float *rx = flow, *ry = flow + w * h;
+		float *fx = flow + 2 * w * h, *fy = flow + 3 * w * h;
+		struct vlib_lk_flow *lk = vlib_lk_flow_create(w, h, ws);
+		struct perf_counter pc;
+
+		if (!lk) {
+			printf("%-6d unsupported\n", ws);
+			continue;
+		}
+
+		perf_reset(&pc);
+		perf_start(&pc);
+		bench_lk_flow_window(prev, next, w, h, ws, rx, ry);
+		perf_stop(&pc);
+		printf("%-6d %-16s %10.2f %10.1f\n", ws, "window loop",
+				perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)));
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char name[32];
+			float diff = 0;
+
+			vlib_parallel_set_num_threads(threads);
+			vlib_lk_flow_compute(lk, prev, w, next, w, fx, fy,
+								w * sizeof(*fx));
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_lk_flow_compute(lk, prev, w, next, w, fx, fy,
+									w * sizeof(*fx));
+				perf_stop(&pc);
+			}
+
+			for (size_t k=0; k<w*h; k++) {
+				diff = fmaxf(diff, fmaxf(fabsf(fx[k] - rx[k]),
+										fabsf(fy[k] - ry[k])));
+			}
+
+			snprintf(name, sizeof(name), "box sum %zu thr", threads);
+			printf("%-6d %-16s %10.2f %10.1f %10g\n", ws, name,
+					perf_avg_ms(&pc), perf_mpix(w * h, perf_avg_ms(&pc)),
+					diff);
+		}
+
+		vlib_lk_flow_destroy(lk);
+	}
+
+	vlib_parallel_set_num_threads(0);
+
+out:
+	free(noise);
+	free(scene);
+	free(prev);
+	free(next);
+	free(flow);
+}
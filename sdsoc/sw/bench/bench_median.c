@@ -0,0 +1,159 @@
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "image.h"
+#include "median.h"
+#include "parallel.h"
+#include "stencil.h"
+
+/* rows of the per pixel sort, it takes seconds per frame for large windows */
+#define BENCH_MEDIAN_REF_ROWS	16
+
+static const size_t median_windows[] = { 3, 7, 15, 31 };
+
+/*
+ * The xFMedianProc path in software: the window of every pixel is
+ * gathered with replicated borders and sorted.
+ */
+static void bench_median_ref(const unsigned char *src, long w, long h,
+							long rows, unsigned char *dst, long win,
+							unsigned char *buf)
+{
+	long r = win / 2;
+
+	for (long y=0; y<rows; y++) {
+		for (long x=0; x<w; x++) {
+			long n = 0;
+
+			for (long j=y-r; j<=y+r; j++) {
+				long yy = j < 0 ? 0 : j >= h ? h - 1 : j;
+
+				for (long i=x-r; i<=x+r; i++) {
+					long xx = i < 0 ? 0 : i >= w ? w - 1 : i;
+					unsigned char v = src[yy * w + xx];
+					long k = n++;
+
+					while (k && buf[k - 1] > v) {
+						buf[k] = buf[k - 1];
+						k--;
+					}
+					buf[k] = v;
+				}
+			}
+			dst[y * w + x] = buf[n / 2];
+		}
+	}
+}
+
+static void bench_median_print(size_t win, const char *path, double ms,
+							size_t pixels, const unsigned char *dst,
+							const unsigned char *ref, size_t n)
+{
+	char name[16];
+	size_t diff = 0;
+
+	for (size_t i=0; i<n; i++) {
+		diff += dst[i] != ref[i];
+	}
+
+	snprintf(name, sizeof(name), "%zux%zu", win, win);
+	printf("%-6s %-16s %10.2f %10.1f %8zu\n", name, path, ms,
+			perf_mpix(pixels, ms), diff);
+}
+
+/*
+ * Median of an 8-bit frame: per pixel sort of the window as xf::medianBlur
+ * vs. the constant time histograms, single threaded and on all cores, and
+ * the 3x3 sorting network of the stencil chains. The sort only runs on
+ * the top rows, pixels differing from it there are counted.
+ */
+void bench_median(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t rows = h < BENCH_MEDIAN_REF_ROWS ? h : BENCH_MEDIAN_REF_ROWS;
+	size_t cores = vlib_parallel_get_num_threads();
+	unsigned char *src = malloc(w * h);
+	unsigned char *ref = malloc(w * rows);
+	unsigned char *dst = malloc(w * h);
+	unsigned char *buf = malloc(31 * 31);
+	struct perf_counter pc;
+
+	if (!src || !ref || !dst || !buf) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fill_random(src, w * h);
+
+	printf("%-6s %-16s %10s %10s %8s\n", "window", "path", "ms", "Mpix/s",
+			"diff");
+
+	for (size_t k=0; k<sizeof(median_windows)/sizeof(median_windows[0]); k++) {
+		size_t win = median_windows[k];
+		struct vlib_median *md;
+
+		perf_reset(&pc);
+		perf_start(&pc);
+		bench_median_ref(src, w, h, rows, ref, win, buf);
+		perf_stop(&pc);
+		bench_median_print(win, "sort (top rows)", perf_avg_ms(&pc), w * rows,
+						ref, ref, w * rows);
+
+		if (win == 3) {
+			struct vlib_stencil_stage st = { VLIB_STENCIL_MEDIAN, 3 };
+			struct vlib_stencil_chain *sc;
+			struct vlib_image si, di;
+
+			sc = vlib_stencil_chain_create(&st, 1, w, h, 0);
+			if (sc &&
+				!vlib_image_init(&si, V4L2_PIX_FMT_GREY, w, h, w, src) &&
+				!vlib_image_init(&di, V4L2_PIX_FMT_GREY, w, h, w, dst)) {
+				perf_reset(&pc);
+				for (unsigned int n=0; n<opts->iterations; n++) {
+					perf_start(&pc);
+					vlib_stencil_chain_run(sc, &si, &di);
+					perf_stop(&pc);
+				}
+				bench_median_print(win, "network", perf_avg_ms(&pc), w * h,
+								dst, ref, w * rows);
+			}
+			vlib_stencil_chain_destroy(sc);
+		}
+
+		md = vlib_median_create(w, h, 1, win);
+		if (!md) {
+			printf("%zux%zu unsupported\n", win, win);
+			continue;
+		}
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char path[32];
+
+			vlib_parallel_set_num_threads(threads);
+
+			memset(dst, 0, w * h);
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_median(md, src, w, dst, w);
+				perf_stop(&pc);
+			}
+
+			snprintf(path, sizeof(path), "histogram %zu thr", threads);
+			bench_median_print(win, path, perf_avg_ms(&pc), w * h, dst, ref,
+							w * rows);
+		}
+
+		vlib_parallel_set_num_threads(0);
+		vlib_median_destroy(md);
+	}
+
+out:
+	free(src);
+	free(ref);
+	free(dst);
+	free(buf);
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "morph.h"
+#include "parallel.h"
+
+static const size_t morph_ksizes[] = { 3, 7, 15, 31 };
+
+/* kernel of the composite runs */
+#define BENCH_MORPH_COMPOSITE_KSIZE	15
+
+/*
+ * xf::erode in software: the fixed 3x3 minimum with replicated borders,
+ * applied (ksize - 1) / 2 times for a ksize x ksize kernel.
+ */
+static void bench_morph_ref(const unsigned char *src, long w, long h,
+							unsigned char *dst, size_t ksize,
+							unsigned char *tmp)
+{
+	const unsigned char *s = src;
+
+	memcpy(dst, src, w * h);
+	for (size_t n=0; n<ksize/2; n++) {
+		memcpy(tmp, dst, w * h);
+		s = tmp;
+
+		for (long y=0; y<h; y++) {
+			for (long x=0; x<w; x++) {
+				unsigned char m = 255;
+
+				for (long j=y-1; j<=y+1; j++) {
+					long yy = j < 0 ? 0 : j >= h ? h - 1 : j;
+
+					for (long i=x-1; i<=x+1; i++) {
+						long xx = i < 0 ? 0 : i >= w ? w - 1 : i;
+
+						m = s[yy * w + xx] < m ? s[yy * w + xx] : m;
+					}
+				}
+				dst[y * w + x] = m;
+			}
+		}
+	}
+}
+
+static void bench_morph_print(const char *name, const char *path, double ms,
+							size_t pixels, const unsigned char *dst,
+							const unsigned char *ref)
+{
+	size_t diff = 0;
+
+	for (size_t i=0; i<pixels; i++) {
+		diff += dst[i] != ref[i];
+	}
+
+	printf("%-10s %-16s %10.2f %10.1f %8zu\n", name, path, ms,
+			perf_mpix(pixels, ms), diff);
+}
+
+/*
+ * Morphology of an 8-bit frame: erosion by repeated 3x3 passes as the
+ * fixed xf::erode vs. van Herk/Gil-Werman, single threaded and on all
+ * cores, for growing kernels. Then the opening and the top-hat as
+ * separate frame passes vs. fused strips. Pixels differing from the 3x3
+ * passes or from the separate passes are counted.
+ */
+void bench_morph(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t cores = vlib_parallel_get_num_threads();
+	unsigned char *src = malloc(w * h);
+	unsigned char *ref = malloc(w * h);
+	unsigned char *dst = malloc(w * h);
+	unsigned char *tmp = malloc(w * h);
+	struct vlib_morph *mp;
+	struct perf_counter pc;
+
+	if (!src || !ref || !dst || !tmp) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fill_random(src, w * h);
+
+	printf("%-10s %-16s %10s %10s %8s\n", "kernel", "path", "ms", "Mpix/s",
+			"diff");
+
+	for (size_t k=0; k<sizeof(morph_ksizes)/sizeof(morph_ksizes[0]); k++) {
+		size_t ksize = morph_ksizes[k];
+		char name[16];
+
+		snprintf(name, sizeof(name), "%zux%zu", ksize, ksize);
+
+		mp = vlib_morph_create(w, h, 1, ksize, ksize);
+		if (!mp) {
+			printf("%-10s unsupported\n", name);
+			continue;
+		}
+
+		perf_reset(&pc);
+		for (unsigned int n=0; n<opts->iterations; n++) {
+			perf_start(&pc);
+			bench_morph_ref(src, w, h, ref, ksize, tmp);
+			perf_stop(&pc);
+		}
+		bench_morph_print(name, "xf 3x3 passes", perf_avg_ms(&pc), w * h,
+						ref, ref);
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			char path[32];
+
+			vlib_parallel_set_num_threads(threads);
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_morph(mp, VLIB_MORPH_ERODE, src, w, dst, w);
+				perf_stop(&pc);
+			}
+
+			snprintf(path, sizeof(path), "vhgw %zu thr", threads);
+			bench_morph_print(name, path, perf_avg_ms(&pc), w * h, dst, ref);
+		}
+
+		vlib_parallel_set_num_threads(0);
+		vlib_morph_destroy(mp);
+	}
+
+	mp = vlib_morph_create(w, h, 1, BENCH_MORPH_COMPOSITE_KSIZE,
+						BENCH_MORPH_COMPOSITE_KSIZE);
+	if (!mp) {
+		printf("composites unsupported\n");
+		goto out;
+	}
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		vlib_morph(mp, VLIB_MORPH_ERODE, src, w, tmp, w);
+		vlib_morph(mp, VLIB_MORPH_DILATE, tmp, w, ref, w);
+		perf_stop(&pc);
+	}
+	bench_morph_print("open", "frame passes", perf_avg_ms(&pc), w * h, ref,
+					ref);
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		vlib_morph(mp, VLIB_MORPH_OPEN, src, w, dst, w);
+		perf_stop(&pc);
+	}
+	bench_morph_print("open", "fused", perf_avg_ms(&pc), w * h, dst, ref);
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		vlib_morph(mp, VLIB_MORPH_ERODE, src, w, tmp, w);
+		vlib_morph(mp, VLIB_MORPH_DILATE, tmp, w, ref, w);
+		for (size_t i=0; i<w*h; i++) {
+			ref[i] = src[i] - ref[i];
+		}
+		perf_stop(&pc);
+	}
+	bench_morph_print("top-hat", "frame passes", perf_avg_ms(&pc), w * h,
+					ref, ref);
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		vlib_morph(mp, VLIB_MORPH_TOPHAT, src, w, dst, w);
+		perf_stop(&pc);
+	}
+	bench_morph_print("top-hat", "fused", perf_avg_ms(&pc), w * h, dst, ref);
+
+	vlib_morph_destroy(mp);
+
+out:
+	free(src);
+	free(ref);
+	free(dst);
+	free(tmp);
+}
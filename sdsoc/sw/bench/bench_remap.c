@@ -0,0 +1,143 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "parallel.h"
+#include "remap.h"
+
+/* barrel distortion and a slight rotation, as a lens undistortion map */
+static void bench_remap_init_map(float *mapx, float *mapy, size_t w, size_t h)
+{
+	double f = w * 0.6, cx = w / 2.0, cy = h / 2.0;
+	double c = cos(0.02), s = sin(0.02);
+
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			double xn = (x - cx) / f, yn = (y - cy) / f;
+			double r2 = xn * xn + yn * yn;
+			double k = 1 - 0.2 * r2 + 0.04 * r2 * r2;
+
+			mapx[y * w + x] = (xn * c - yn * s) * k * f + cx;
+			mapy[y * w + x] = (xn * s + yn * c) * k * f + cy;
+		}
+	}
+}
+
+static inline float bench_remap_px(const unsigned char *src, size_t w,
+								size_t h, long x, long y)
+{
+	return x < 0 || y < 0 || x >= (long)w || y >= (long)h ? 0 : src[y * w + x];
+}
+
+/* per pixel float weights from float maps, as xFRemapLI */
+static void bench_remap_float(const float *mapx, const float *mapy,
+							const unsigned char *src, unsigned char *dst,
+							size_t w, size_t h)
+{
+	for (size_t i=0; i<w*h; i++) {
+		float u = mapx[i], v = mapy[i];
+		long x = floorf(u), y = floorf(v);
+		float fx = u - x, fy = v - y;
+		float p = bench_remap_px(src, w, h, x, y) * (1 - fx) +
+				bench_remap_px(src, w, h, x + 1, y) * fx;
+		float q = bench_remap_px(src, w, h, x, y + 1) * (1 - fx) +
+				bench_remap_px(src, w, h, x + 1, y + 1) * fx;
+
+		dst[i] = p * (1 - fy) + q * fy + 0.5f;
+	}
+}
+
+/* largest difference of @dst to @ref */
+static int bench_remap_maxdiff(const unsigned char *dst,
+							const unsigned char *ref, size_t n)
+{
+	int maxdiff = 0;
+
+	for (size_t i=0; i<n; i++) {
+		int d = abs(dst[i] - ref[i]);
+
+		maxdiff = d > maxdiff ? d : maxdiff;
+	}
+
+	return maxdiff;
+}
+
+/*
+ * Lens undistortion of an 8-bit frame: float maps evaluated per pixel vs.
+ * the compiled fixed-point map, single threaded and on all cores. The
+ * largest difference to the float path shows the cost of the 5 bit
+ * coordinate fractions.
+ */
+void bench_remap(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	float *mapx = malloc(w * h * sizeof(*mapx));
+	float *mapy = malloc(w * h * sizeof(*mapy));
+	unsigned char *src = malloc(w * h);
+	unsigned char *ref = malloc(w * h);
+	unsigned char *dst = malloc(w * h);
+	size_t cores = vlib_parallel_get_num_threads();
+	struct vlib_remap *rm = NULL;
+	struct perf_counter pc;
+
+	if (!mapx || !mapy || !src || !ref || !dst) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fill_random(src, w * h);
+	bench_remap_init_map(mapx, mapy, w, h);
+
+	perf_reset(&pc);
+	perf_start(&pc);
+	rm = vlib_remap_create(mapx, mapy, w * sizeof(*mapx), w, h, w, h);
+	perf_stop(&pc);
+	if (!rm) {
+		printf("remap: %zux%zu not supported\n", w, h);
+		goto out;
+	}
+
+	printf("map compile %.2f ms, %zu KiB (float maps %zu KiB)\n\n",
+			perf_avg_ms(&pc), vlib_remap_size(rm) / 1024,
+			2 * w * h * sizeof(*mapx) / 1024);
+	printf("%-16s %10s %10s %8s\n", "path", "ms", "Mpix/s", "maxdiff");
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		bench_remap_float(mapx, mapy, src, ref, w, h);
+		perf_stop(&pc);
+	}
+	printf("%-16s %10.2f %10.1f %8d\n", "float", perf_avg_ms(&pc),
+			perf_mpix(w * h, perf_avg_ms(&pc)), 0);
+
+	for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+		char name[32];
+
+		vlib_parallel_set_num_threads(threads);
+		vlib_remap(rm, src, w, dst, w);
+
+		perf_reset(&pc);
+		for (unsigned int n=0; n<opts->iterations; n++) {
+			perf_start(&pc);
+			vlib_remap(rm, src, w, dst, w);
+			perf_stop(&pc);
+		}
+
+		snprintf(name, sizeof(name), "fixed %zu thr", threads);
+		printf("%-16s %10.2f %10.1f %8d\n", name, perf_avg_ms(&pc),
+				perf_mpix(w * h, perf_avg_ms(&pc)),
+				bench_remap_maxdiff(dst, ref, w * h));
+	}
+
+	vlib_parallel_set_num_threads(0);
+
+out:
+	vlib_remap_destroy(rm);
+	free(mapx);
+	free(mapy);
+	free(src);
+	free(ref);
+	free(dst);
+}
@@ -0,0 +1,240 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "parallel.h"
+#include "resize.h"
+
+/* output size of the runs in fractions of the input size */
+static const struct {
+	const char *name;
+	size_t num;
+	size_t den;
+} resize_scales[] = {
+	{ "2/3", 2, 3 },
+	{ "1/4", 1, 4 },
+	{ "3/2", 3, 2 },
+};
+
+static const struct {
+	const char *name;
+	enum vlib_resize_interp interp;
+} resize_interps[] = {
+	{ "bilinear", VLIB_RESIZE_BILINEAR },
+	{ "area", VLIB_RESIZE_AREA },
+};
+
+/* weight of source pixel @i for output pixel @d, from scratch per pixel */
+static double bench_resize_weight(size_t src, size_t dst, int area, long d,
+								long i)
+{
+	double scale = (double)src / dst;
+
+	if (area && scale > 1) {
+		double s = d * scale, e = s + scale;
+		double lo = i > s ? i : s, hi = i + 1 < e ? i + 1 : e;
+
+		return hi > lo ? (hi - lo) / scale : 0;
+	} else {
+		double f = (d + 0.5) * scale - 0.5;
+
+		if (f < 0) {
+			f = 0;
+		}
+		if (f > src - 1) {
+			f = src - 1;
+		}
+		return fabs(f - i) < 1 ? 1 - fabs(f - i) : 0;
+	}
+}
+
+/*
+ * Source position and weights of every pixel computed while resizing, as
+ * the streaming xf::resize kernels, in float.
+ */
+static void bench_resize_ref(const unsigned char *src, size_t sw, size_t sh,
+							unsigned char *dst, size_t dw, size_t dh, int area)
+{
+	long rx = area && sw > dw ? (long)(sw / dw) + 1 : 1;
+	long ry = area && sh > dh ? (long)(sh / dh) + 1 : 1;
+
+	for (size_t y=0; y<dh; y++) {
+		long cy = (long)((y + 0.5) * sh / dh);
+
+		for (size_t x=0; x<dw; x++) {
+			long cx = (long)((x + 0.5) * sw / dw);
+			double s = 0;
+
+			for (long j=cy-ry; j<=cy+ry; j++) {
+				double wy;
+
+				if (j < 0 || j >= (long)sh) {
+					continue;
+				}
+				wy = bench_resize_weight(sh, dh, area, y, j);
+				if (!wy) {
+					continue;
+				}
+				for (long i=cx-rx; i<=cx+rx; i++) {
+					if (i < 0 || i >= (long)sw) {
+						continue;
+					}
+					s += wy * bench_resize_weight(sw, dw, area, x, i) *
+						src[j * sw + i];
+				}
+			}
+			dst[y * dw + x] = s + 0.5;
+		}
+	}
+}
+
+/*
+ * Leave freed blocks of up to @size bytes filled with a pattern, so that
+ * memory read before it is written shows up in the results. The bytes read
+ * as -0.124 in a double and -1.5 in a float, not as zero or NaN. The returned
+ * block keeps them from being merged into the top of the heap and handed
+ * back to the system, free it when done.
+ */
+static void *bench_resize_dirty_heap(size_t size)
+{
+	void *blocks[32], *fence;
+	size_t n = 0;
+
+	for (size_t b=64; b<=size && n<32; b*=2) {
+		blocks[n] = malloc(b);
+		if (blocks[n]) {
+			memset(blocks[n++], 0xbf, b);
+		}
+	}
+	fence = malloc(64);
+	while (n) {
+		free(blocks[--n]);
+	}
+
+	return fence;
+}
+
+static int bench_resize_maxdiff(const unsigned char *dst,
+								const unsigned char *ref, size_t n)
+{
+	int maxdiff = 0;
+
+	for (size_t k=0; k<n; k++) {
+		int d = abs(dst[k] - ref[k]);
+
+		maxdiff = d > maxdiff ? d : maxdiff;
+	}
+
+	return maxdiff;
+}
+
+/*
+ * Resize of an 8-bit frame: weights computed per pixel vs. the polyphase
+ * tables, single threaded and on all cores, for downscaling and upscaling.
+ * The largest difference to the per pixel result is shown. The tables are
+ * then built again on a heap full of garbage and one frame is resized.
+ */
+void bench_resize(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t cores = vlib_parallel_get_num_threads();
+	unsigned char *src = malloc(w * h);
+
+	if (!src) {
+		printf("setup failed\n");
+		return;
+	}
+
+	bench_fill_random(src, w * h);
+
+	printf("%-6s %-10s %-16s %10s %10s %8s\n", "scale", "interp", "path",
+			"ms", "Mpix/s", "maxdiff");
+
+	for (size_t s=0; s<sizeof(resize_scales)/sizeof(resize_scales[0]); s++) {
+		size_t dw = w * resize_scales[s].num / resize_scales[s].den;
+		size_t dh = h * resize_scales[s].num / resize_scales[s].den;
+		unsigned char *ref = malloc(dw * dh);
+		unsigned char *dst = malloc(dw * dh);
+
+		if (!ref || !dst) {
+			printf("setup failed\n");
+			free(ref);
+			free(dst);
+			break;
+		}
+
+		for (size_t i=0; i<sizeof(resize_interps)/sizeof(resize_interps[0]); i++) {
+			int area = resize_interps[i].interp == VLIB_RESIZE_AREA;
+			struct vlib_resize *rs;
+			struct perf_counter pc;
+			void *fence;
+
+			perf_reset(&pc);
+			perf_start(&pc);
+			bench_resize_ref(src, w, h, ref, dw, dh, area);
+			perf_stop(&pc);
+			printf("%-6s %-10s %-16s %10.2f %10.1f\n", resize_scales[s].name,
+					resize_interps[i].name, "per pixel", perf_avg_ms(&pc),
+					perf_mpix(dw * dh, perf_avg_ms(&pc)));
+
+			rs = vlib_resize_create(w, h, dw, dh, 1, 1,
+									resize_interps[i].interp);
+			if (!rs) {
+				printf("%-6s %-10s unsupported\n", resize_scales[s].name,
+						resize_interps[i].name);
+				continue;
+			}
+
+			for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+				char name[32];
+
+				vlib_parallel_set_num_threads(threads);
+
+				perf_reset(&pc);
+				for (unsigned int n=0; n<opts->iterations; n++) {
+					perf_start(&pc);
+					vlib_resize(rs, src, w, dst, dw);
+					perf_stop(&pc);
+				}
+
+				snprintf(name, sizeof(name), "tables %zu thr", threads);
+				printf("%-6s %-10s %-16s %10.2f %10.1f %8d\n",
+						resize_scales[s].name, resize_interps[i].name, name,
+						perf_avg_ms(&pc), perf_mpix(dw * dh, perf_avg_ms(&pc)),
+						bench_resize_maxdiff(dst, ref, dw * dh));
+			}
+
+			vlib_parallel_set_num_threads(0);
+			vlib_resize_destroy(rs);
+
+			/* the tables are shared and freed with their last resizer */
+			fence = bench_resize_dirty_heap(64 * (w + h) * sizeof(double));
+			rs = vlib_resize_create(w, h, dw, dh, 1, 1,
+									resize_interps[i].interp);
+			if (!rs) {
+				free(fence);
+				continue;
+			}
+
+			perf_reset(&pc);
+			perf_start(&pc);
+			vlib_resize(rs, src, w, dst, dw);
+			perf_stop(&pc);
+			printf("%-6s %-10s %-16s %10.2f %10.1f %8d\n",
+					resize_scales[s].name, resize_interps[i].name,
+					"dirty heap", perf_avg_ms(&pc),
+					perf_mpix(dw * dh, perf_avg_ms(&pc)),
+					bench_resize_maxdiff(dst, ref, dw * dh));
+
+			vlib_resize_destroy(rs);
+			free(fence);
+		}
+
+		free(ref);
+		free(dst);
+	}
+
+	free(src);
+}
@@ -0,0 +1,116 @@
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "image.h"
+#include "stencil.h"
+
+static const struct {
+	const char *name;
+	size_t num_stages;
+	struct vlib_stencil_stage stages[5];
+} stencil_chains[] = {
+	{ "gauss3-sobel", 2, {
+		{ VLIB_STENCIL_GAUSSIAN, 3 },
+		{ VLIB_STENCIL_SOBEL, 3 },
+	} },
+	{ "gauss3-erode3-dilate3", 3, {
+		{ VLIB_STENCIL_GAUSSIAN, 3 },
+		{ VLIB_STENCIL_ERODE, 3 },
+		{ VLIB_STENCIL_DILATE, 3 },
+	} },
+	{ "gauss5-median3-erode3-dilate3", 4, {
+		{ VLIB_STENCIL_GAUSSIAN, 5 },
+		{ VLIB_STENCIL_MEDIAN, 3 },
+		{ VLIB_STENCIL_ERODE, 3 },
+		{ VLIB_STENCIL_DILATE, 3 },
+	} },
+	{ "gauss3-median3-dilate5-erode5-sobel", 5, {
+		{ VLIB_STENCIL_GAUSSIAN, 3 },
+		{ VLIB_STENCIL_MEDIAN, 3 },
+		{ VLIB_STENCIL_DILATE, 5 },
+		{ VLIB_STENCIL_ERODE, 5 },
+		{ VLIB_STENCIL_SOBEL, 3 },
+	} },
+};
+
+static double stencil_run(const struct bench_opts *opts, size_t c,
+						size_t strip_lines, size_t *strip_used,
+						const struct vlib_image *src, struct vlib_image *dst)
+{
+	struct vlib_stencil_chain *sc;
+	struct perf_counter pc;
+
+	sc = vlib_stencil_chain_create(stencil_chains[c].stages,
+								stencil_chains[c].num_stages,
+								opts->width, opts->height, strip_lines);
+	if (!sc) {
+		return 0;
+	}
+
+	*strip_used = vlib_stencil_chain_get_strip_lines(sc);
+
+	vlib_stencil_chain_run(sc, src, dst);
+
+	perf_reset(&pc);
+	for (unsigned int i=0; i<opts->iterations; i++) {
+		perf_start(&pc);
+		vlib_stencil_chain_run(sc, src, dst);
+		perf_stop(&pc);
+	}
+
+	vlib_stencil_chain_destroy(sc);
+
+	return perf_avg_ms(&pc);
+}
+
+/*
+ * Stencil chains of 2 to 5 stages on a luma frame, stage by stage with
+ * full intermediate frames vs. fused row strips sized for L2. Pixels of
+ * the fused output differing from the stage by stage one are counted.
+ */
+void bench_stencil(const struct bench_opts *opts)
+{
+	size_t size = opts->width * opts->height;
+	unsigned char *sb = malloc(size);
+	unsigned char *db = malloc(size);
+	unsigned char *rb = malloc(size);
+	struct vlib_image src, dst, ref;
+
+	if (!sb || !db || !rb ||
+		vlib_image_init(&src, V4L2_PIX_FMT_GREY, opts->width, opts->height,
+						opts->width, sb) ||
+		vlib_image_init(&dst, V4L2_PIX_FMT_GREY, opts->width, opts->height,
+						opts->width, db) ||
+		vlib_image_init(&ref, V4L2_PIX_FMT_GREY, opts->width, opts->height,
+						opts->width, rb)) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fill_random(sb, size);
+
+	printf("%-36s %10s %10s %8s %8s %8s\n", "chain", "frame ms", "fused ms",
+			"strip", "speedup", "diff");
+
+	for (size_t c=0; c<sizeof(stencil_chains)/sizeof(stencil_chains[0]); c++) {
+		size_t strip_frame, strip_fused, diff = 0;
+		double frame = stencil_run(opts, c, opts->height, &strip_frame,
+									&src, &ref);
+		double fused = stencil_run(opts, c, 0, &strip_fused, &src, &dst);
+
+		for (size_t i=0; i<size; i++) {
+			diff += db[i] != rb[i];
+		}
+
+		printf("%-36s %10.2f %10.2f %8zu %7.2fx %8zu\n",
+				stencil_chains[c].name, frame, fused, strip_fused,
+				fused > 0 ? frame / fused : 0, diff);
+	}
+
+out:
+	free(sb);
+	free(db);
+	free(rb);
+}
@@ -0,0 +1,181 @@
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "filter.h"
+#include "parallel.h"
+#include "stereo.h"
+#include "stereo_bm.h"
+
+/* right view of a random scene, left(x) = right(x - STEREO_BM_SHIFT) */
+#define STEREO_BM_SHIFT		24
+
+static const int stereo_bm_ndisp[] = { 32, 64, 128 };
+
+/*
+ * Share of the pixels with a disparity, and of those the share within one
+ * pixel of the known shift, in percent.
+ */
+static void bench_stereo_bm_accuracy(const int16_t *disp, size_t n,
+									int invalid, double *valid, double *good)
+{
+	size_t v = 0, g = 0;
+
+	for (size_t i=0; i<n; i++) {
+		if (disp[i] == invalid) {
+			continue;
+		}
+		v++;
+		g += abs(disp[i] - STEREO_BM_SHIFT * 16) <= 16;
+	}
+
+	*valid = 100.0 * v / n;
+	*good = v ? 100.0 * g / v : 0;
+}
+
+/*
+ * The depth stage without camera parameters on the side-by-side pair, the
+ * left view shown next to the disparity. Pixels of the left half differing
+ * from the left view are counted.
+ */
+static void bench_stereo_bm_stage(const struct bench_opts *opts,
+								const unsigned char *left,
+								const unsigned char *right)
+{
+	size_t w = opts->width, h = opts->height;
+	unsigned char *in = malloc(2 * w * h);
+	unsigned char *out = malloc(2 * w * h);
+	struct filter_init_data fid = {
+		.in_width = 2 * w,
+		.in_height = h,
+		.in_fourcc = V4L2_PIX_FMT_GREY,
+		.out_width = 2 * w,
+		.out_height = h,
+		.out_fourcc = V4L2_PIX_FMT_GREY,
+	};
+	struct filter_s *fs = vlib_stereo_create(NULL);
+	struct perf_counter pc;
+	size_t diff = 0;
+
+	if (!in || !out || !fs || fs->ops->init(fs, &fid)) {
+		printf("stage unsupported\n");
+		goto out;
+	}
+
+	for (size_t y=0; y<h; y++) {
+		memcpy(in + y * 2 * w, left + y * w, w);
+		memcpy(in + y * 2 * w + w, right + y * w, w);
+	}
+
+	perf_reset(&pc);
+	for (unsigned int n=0; n<opts->iterations; n++) {
+		perf_start(&pc);
+		fs->ops->func(fs, in, out, h, 2 * w, 2 * w, h, 2 * w, 2 * w);
+		perf_stop(&pc);
+	}
+
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			diff += out[y * 2 * w + x] != left[y * w + x];
+		}
+	}
+
+	printf("\n%-6s %-8s %10s %8s %10s\n", "stage", "params", "total ms",
+			"fps", "left diff");
+	printf("%-6s %-8s %10.2f %8.1f %10zu\n", "depth", "none",
+			perf_avg_ms(&pc), 1000 / perf_avg_ms(&pc), diff);
+
+out:
+	/* pipeline stages have no destroy, the stage is kept until exit */
+	free(in);
+	free(out);
+}
+
+/*
+ * Block matching on a random textured pair, single threaded vs. one band
+ * per core, for increasing disparity ranges. The pair is a constant shift
+ * of STEREO_BM_SHIFT pixels, so every disparity found should be close to
+ * it. Then the whole depth stage on the pair side by side. Use -w 640
+ * -h 480 for the VGA target.
+ */
+void bench_stereo_bm(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	unsigned char *scene = malloc((w + STEREO_BM_SHIFT) * h);
+	unsigned char *left = malloc(w * h);
+	unsigned char *right = malloc(w * h);
+	int16_t *disp = malloc(w * h * sizeof(*disp));
+	size_t cores = vlib_parallel_get_num_threads();
+
+	if (!scene || !left || !right || !disp) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	bench_fill_random(scene, (w + STEREO_BM_SHIFT) * h);
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			left[y * w + x] = scene[y * (w + STEREO_BM_SHIFT) + x];
+			right[y * w + x] = scene[y * (w + STEREO_BM_SHIFT) + x + STEREO_BM_SHIFT];
+		}
+	}
+
+	printf("%-6s %-8s %12s %10s %10s %8s %8s %8s\n", "ndisp", "threads",
+			"prefilter ms", "match ms", "total ms", "fps", "valid %",
+			"good %");
+
+	for (size_t i=0; i<sizeof(stereo_bm_ndisp)/sizeof(stereo_bm_ndisp[0]); i++) {
+		struct vlib_stereo_bm_params params;
+		struct vlib_stereo_bm *bm;
+
+		vlib_stereo_bm_default_params(&params);
+		params.num_disparities = stereo_bm_ndisp[i];
+		bm = vlib_stereo_bm_create(&params, w, h);
+		if (!bm) {
+			printf("%-6d unsupported\n", stereo_bm_ndisp[i]);
+			continue;
+		}
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			struct vlib_stereo_bm_stats st;
+			double pre = 0, match = 0, valid, good;
+			struct perf_counter pc;
+
+			vlib_parallel_set_num_threads(threads);
+			vlib_stereo_bm_compute(bm, left, w, right, w, disp, w * sizeof(*disp));
+
+			perf_reset(&pc);
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				perf_start(&pc);
+				vlib_stereo_bm_compute(bm, left, w, right, w, disp,
+									w * sizeof(*disp));
+				perf_stop(&pc);
+				vlib_stereo_bm_get_stats(bm, &st);
+				pre += st.prefilter_ms;
+				match += st.match_ms;
+			}
+
+			bench_stereo_bm_accuracy(disp, w * h,
+									(params.min_disparity - 1) * 16,
+									&valid, &good);
+			printf("%-6d %-8zu %12.2f %10.2f %10.2f %8.1f %8.1f %8.1f\n",
+					stereo_bm_ndisp[i], threads, pre / opts->iterations,
+					match / opts->iterations, perf_avg_ms(&pc),
+					1000 / perf_avg_ms(&pc), valid, good);
+		}
+
+		vlib_stereo_bm_destroy(bm);
+	}
+
+	vlib_parallel_set_num_threads(0);
+
+	bench_stereo_bm_stage(opts, left, right);
+
+out:
+	free(scene);
+	free(left);
+	free(right);
+	free(disp);
+}
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "parallel.h"
+#include "tracker.h"
+
+/* motion of the scene per frame, in pixels */
+#define TRACKER_SHIFT_X		2
+#define TRACKER_SHIFT_Y		1
+
+/* frames of one sequence */
+#define TRACKER_FRAMES		20
+
+static const struct {
+	const char *name;
+	enum vlib_tracker_detector detector;
+} tracker_detectors[] = {
+	{ "FAST", VLIB_TRACKER_FAST },
+	{ "Harris", VLIB_TRACKER_HARRIS },
+};
+
+/*
+ * Sparse tracking of a smooth random scene moving right and down with the
+ * FAST and the Harris detector, single threaded and on all cores. The
+ * sequence runs once per iteration. Detection is averaged over the frames
+ * it ran in, the pyramid and the tracking over all frames. The error is
+ * the mean distance of the motion of the tracked points to the true one.
+ */
+void bench_tracker(const struct bench_opts *opts)
+{
+	size_t w = opts->width, h = opts->height;
+	size_t sw = w + TRACKER_FRAMES * TRACKER_SHIFT_X;
+	size_t sh = h + TRACKER_FRAMES * TRACKER_SHIFT_Y;
+	unsigned char *noise = malloc(sw * sh);
+	unsigned char *scene = malloc(sw * sh);
+	size_t cores = vlib_parallel_get_num_threads();
+
+	if (!noise || !scene) {
+		printf("setup failed\n");
+		goto out;
+	}
+
+	/* 3x3 box blurred noise, so that the gradients are meaningful */
+	bench_fill_random(noise, sw * sh);
+	for (size_t y=0; y<sh; y++) {
+		for (size_t x=0; x<sw; x++) {
+			unsigned int s = 0, n = 0;
+
+			for (size_t j=y?y-1:0; j<=y+1 && j<sh; j++) {
+				for (size_t i=x?x-1:0; i<=x+1 && i<sw; i++) {
+					s += noise[j * sw + i];
+					n++;
+				}
+			}
+			scene[y * sw + x] = s / n;
+		}
+	}
+
+	printf("%-8s %-10s %10s %10s %8s %8s\n", "detector", "path",
+			"detect ms", "track ms", "points", "err px");
+
+	for (size_t d=0; d<sizeof(tracker_detectors)/sizeof(tracker_detectors[0]); d++) {
+		struct vlib_tracker_params params;
+		struct vlib_tracker *tr;
+
+		vlib_tracker_default_params(&params);
+		params.detector = tracker_detectors[d].detector;
+		tr = vlib_tracker_create(&params, w, h);
+		if (!tr) {
+			printf("%-8s unsupported\n", tracker_detectors[d].name);
+			continue;
+		}
+
+		for (size_t threads=1; threads<=cores; threads=threads<cores ? cores : threads+1) {
+			double detect = 0, track = 0, err = 0;
+			size_t detects = 0, frames = 0, points = 0;
+			char path[32];
+
+			vlib_parallel_set_num_threads(threads);
+
+			for (unsigned int n=0; n<opts->iterations; n++) {
+				vlib_tracker_reset(tr);
+
+				for (size_t f=0; f<TRACKER_FRAMES; f++) {
+					/* the window moves up and left, the content right and down */
+					size_t ox = (TRACKER_FRAMES - f) * TRACKER_SHIFT_X;
+					size_t oy = (TRACKER_FRAMES - f) * TRACKER_SHIFT_Y;
+					struct vlib_tracker_points pts;
+					struct vlib_tracker_stats st;
+
+					vlib_tracker_process(tr, scene + oy * sw + ox, sw);
+					vlib_tracker_get_stats(tr, &st);
+					vlib_tracker_get_points(tr, &pts);
+
+					if (st.detect_ms > 0) {
+						detect += st.detect_ms;
+						detects++;
+					}
+					track += st.pyramid_ms + st.track_ms;
+					frames++;
+
+					for (size_t i=0; i<pts.count; i++) {
+						if (!pts.age[i]) {
+							continue;
+						}
+						err += hypotf(pts.x[i] - pts.prev_x[i] - TRACKER_SHIFT_X,
+									pts.y[i] - pts.prev_y[i] - TRACKER_SHIFT_Y);
+						points++;
+					}
+				}
+			}
+
+			snprintf(path, sizeof(path), "%zu thr", threads);
+			printf("%-8s %-10s %10.2f %10.2f %8zu %8.3f\n",
+					tracker_detectors[d].name, path,
+					detects ? detect / detects : 0, track / frames,
+					points / frames, points ? err / points : 0);
+		}
+
+		vlib_parallel_set_num_threads(0);
+		vlib_tracker_destroy(tr);
+	}
+
+out:
+	free(noise);
+	free(scene);
+}
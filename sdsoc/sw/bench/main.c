@@ -0,0 +1,122 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+static const struct {
+	const char *name;
+	void (*func)(const struct bench_opts *opts);
+} benches[] = {
+	{ "cvt_color", bench_cvt_color },
+	{ "stencil", bench_stencil },
+	{ "stereo_bm", bench_stereo_bm },
+	{ "remap", bench_remap },
+	{ "lk_flow", bench_lk_flow },
+	{ "tracker", bench_tracker },
+	{ "fast", bench_fast },
+	{ "harris", bench_harris },
+	{ "canny", bench_canny },
+	{ "hog", bench_hog },
+	{ "resize", bench_resize },
+	{ "bilateral", bench_bilateral },
+	{ "median", bench_median },
+	{ "integral", bench_integral },
+	{ "histogram", bench_histogram },
+	{ "analytics", bench_analytics },
+	{ "inrange", bench_inrange },
+	{ "morph", bench_morph },
+};
+
+#define NUM_BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+void bench_fill_random(unsigned char *buf, size_t size)
+{
+	for (size_t i=0; i<size; i++) {
+		buf[i] = rand();
+	}
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [options]\n", argv0);
+	printf("-b, --bench                           Run benchmark (default: all)\n");
+	printf("-L, --list-benches                    List benchmarks\n");
+	printf("-w, --width                           Frame width (default: 1920)\n");
+	printf("-h, --height                          Frame height (default: 1080)\n");
+	printf("-n, --iterations                      Iterations per measurement (default: 30)\n");
+	printf("    --help                            Show this help screen\n");
+}
+
+static struct option opts[] = {
+	{ "bench", required_argument, NULL, 'b' },
+	{ "list-benches", no_argument, NULL, 'L' },
+	{ "width", required_argument, NULL, 'w' },
+	{ "height", required_argument, NULL, 'h' },
+	{ "iterations", required_argument, NULL, 'n' },
+	{ "help", no_argument, NULL, '?' },
+	{ NULL, 0, NULL, 0 }
+};
+
+int main(int argc, char *argv[])
+{
+	struct bench_opts bo = {
+		.width = 1920,
+		.height = 1080,
+		.iterations = 30,
+	};
+	const char *name = NULL;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "b:Lw:h:n:", opts, NULL)) != -1) {
+		switch (c) {
+			case 'b':
+				name = optarg;
+				break;
+			case 'L':
+				for (size_t i=0; i<NUM_BENCHES; i++) {
+					printf("%s\n", benches[i].name);
+				}
+				return EXIT_SUCCESS;
+			case 'w':
+				bo.width = strtoul(optarg, NULL, 0);
+				break;
+			case 'h':
+				bo.height = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				bo.iterations = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (!bo.width || !bo.height || !bo.iterations) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i=0; i<NUM_BENCHES; i++) {
+		if (name && strcmp(name, benches[i].name)) {
+			continue;
+		}
+
+		printf("*** %s (%zux%zu, %u iterations)\n", benches[i].name,
+				bo.width, bo.height, bo.iterations);
+		benches[i].func(&bo);
+		printf("\n");
+		if (name) {
+			return EXIT_SUCCESS;
+		}
+	}
+
+	if (name) {
+		printf("Unknown benchmark '%s'\n", name);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -10,6 +10,18 @@
 #include <unistd.h>
 
 #include "video.h"
+#include "bilateral.h"
+#include "canny.h"
+#include "cvt_color.h"
+#include "histogram.h"
+#include "inrange.h"
+#include "meanshift.h"
+#include "median.h"
+#include "morph.h"
+#include "optflow.h"
+#include "resize.h"
+#include "stereo.h"
+#include "tracker.h"
 
 #if defined (SAMPLE_FILTER2D)
 #include "filter2d.h"
@@ -38,6 +50,103 @@ static void filter_init(struct filter_tbl *ft, void *sv_params)
 		}
 	}
 #endif
+	{
+		struct filter_s *fs = vlib_cvt_color_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_optflow_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_tracker_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_canny_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_meanshift_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_resize_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_bilateral_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_median_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_histogram_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		struct filter_s *fs = vlib_inrange_filter_create();
+		if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
+	{
+		static const enum vlib_morph_op ops[] = {
+			VLIB_MORPH_ERODE,
+			VLIB_MORPH_DILATE,
+			VLIB_MORPH_GRADIENT,
+			VLIB_MORPH_TOPHAT,
+		};
+
+		for (size_t i=0; i<sizeof(ops)/sizeof(ops[0]); i++) {
+			struct filter_s *fs = vlib_morph_filter_create(ops[i]);
+			if (!fs) {
+				printf("Failed to create morphology filter\n");
+			} else if (filter_type_register(ft, fs)) {
+				printf("Failed to register filter %s\n",
+						filter_type_get_display_text(fs));
+			}
+		}
+	}
+	{
+		struct filter_s *fs = vlib_stereo_create(sv_params);
+		if (!fs) {
+			printf("Failed to create stereo filter\n");
+		} else if (filter_type_register(ft, fs)) {
+			printf("Failed to register filter %s\n",
+					filter_type_get_display_text(fs));
+		}
+	}
 }
 
 static struct {
@@ -161,6 +270,7 @@ static void usage(const char *argv0)
 	printf("-l, --filter                          Set filter\n");
 	printf("-m, --filter-mode                     Set filter mode\n");
 	printf("-P, --plane <id>[:<w>x<h>[+<x>+<y>]]  Use specific plane\n");
+	printf("-c, --crop <w>x<h>[+<x>+<y>]          Display a region of the input\n");
 	printf("-b, --buffer-count                    Number of frame buffers\n");
 #ifdef EXPERT_OPTIONS
 	printf("    --vcap-file-file                  File for file source\n");
@@ -186,6 +296,7 @@ static struct option opts[] = {
 	{ "filter", required_argument, NULL, 'l' },
 	{ "vcap-file-file", required_argument, NULL, 'q' },
 	{ "plane", required_argument, NULL, 'P' },
+	{ "crop", required_argument, NULL, 'c' },
 	{ "background-file", required_argument, NULL, 'Q' },
 	{ "buffer-count", required_argument, NULL, 'b' },
 	{ "filter-sv-cam-params", required_argument, NULL, 'Z' },
@@ -330,7 +441,7 @@ int main(int argc, char *argv[])
 	};
 
 	/* Parse command line arguments */
-	while ((c = getopt_long(argc, argv, "d:hpi:o:f:uSLs:Mm:Il:P:b:", opts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "d:hpi:o:f:uSLs:Mm:Il:P:c:b:", opts, NULL)) != -1) {
 		switch (c) {
 			case 'd':
 				sscanf(optarg, "%u", &cfg.dri_card_id);
@@ -427,6 +538,16 @@ int main(int argc, char *argv[])
 					return -1;
 				}
 
+				break;
+			case 'c':
+				ret = sscanf(optarg, "%zux%zu+%zu+%zu", &cfg.crop.width,
+						&cfg.crop.height, &cfg.crop.xoffs, &cfg.crop.yoffs);
+				if (ret != 2 && ret != 4) {
+					fprintf(stderr, "ERROR: Invalid crop specifier '%s'\n",
+							optarg);
+					return -1;
+				}
+
 				break;
 			case 'Q':
 				cfg.drm_background = optarg;
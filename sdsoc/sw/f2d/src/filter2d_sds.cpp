@@ -2,6 +2,7 @@
 #include <imgproc/xf_custom_convolution.hpp>
 #include <linux/videodev2.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "filter2d_sds.h"
 
@@ -15,6 +16,7 @@ using namespace xf;
 struct filter2d_data {
 	xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1> *inLuma;
 	xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1> *outLuma;
+	uint32_t fourcc;	/* YUV format filtered on luma, 0 for RGB */
 };
 
 #pragma SDS data mem_attribute(frm_data_in:NON_CACHEABLE|PHYSICAL_CONTIGUOUS)
@@ -58,6 +60,51 @@ void write_f2d_output(xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1> &outLuma
 	}
 }
 
+/* packed YUV 4:2:2, luma at byte offset yoff of each pixel pair */
+#pragma SDS data mem_attribute(frm_data_in:NON_CACHEABLE|PHYSICAL_CONTIGUOUS)
+#pragma SDS data copy(frm_data_in[0:pcnt*2])
+#pragma SDS data access_pattern(frm_data_in:SEQUENTIAL)
+#pragma SDS data mem_attribute("inLuma.data":NON_CACHEABLE|PHYSICAL_CONTIGUOUS)
+#pragma SDS data copy("inLuma.data"[0:"inLuma.size"])
+#pragma SDS data access_pattern("inLuma.data":SEQUENTIAL)
+void read_f2d_input_yuv(unsigned char *frm_data_in,
+				xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1> &inLuma,
+				int pcnt, int yoff)
+{
+	for (int i=0; i<pcnt; i++) {
+#pragma HLS pipeline II=1
+		uint8_t b0 = frm_data_in[2*i];
+		uint8_t b1 = frm_data_in[2*i+1];
+
+		inLuma.data[i] = yoff ? b1 : b0;
+	}
+}
+
+/* merge filtered luma with the input chroma or neutral gray */
+#pragma SDS data mem_attribute("outLuma.data":NON_CACHEABLE|PHYSICAL_CONTIGUOUS)
+#pragma SDS data copy("outLuma.data"[0:"outLuma.size"])
+#pragma SDS data access_pattern("outLuma.data":SEQUENTIAL)
+#pragma SDS data mem_attribute(frm_data_in:NON_CACHEABLE|PHYSICAL_CONTIGUOUS)
+#pragma SDS data copy(frm_data_in[0:pcnt*2])
+#pragma SDS data access_pattern(frm_data_in:SEQUENTIAL)
+#pragma SDS data mem_attribute(frm_data_out:NON_CACHEABLE|PHYSICAL_CONTIGUOUS)
+#pragma SDS data copy(frm_data_out[0:pcnt*2])
+#pragma SDS data access_pattern(frm_data_out:SEQUENTIAL)
+void write_f2d_output_yuv(xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1> &outLuma,
+					unsigned char *frm_data_in, unsigned char *frm_data_out,
+					int pcnt, int yoff, int keep_chroma)
+{
+	for (int i=0; i<pcnt; i++) {
+#pragma HLS pipeline II=1
+		uint8_t graypix = outLuma.data[i];
+		uint8_t b0 = frm_data_in[2*i];
+		uint8_t b1 = frm_data_in[2*i+1];
+		uint8_t chroma = keep_chroma ? (yoff ? b0 : b1) : 128;
+
+		frm_data_out[2*i] = yoff ? chroma : graypix;
+		frm_data_out[2*i+1] = yoff ? graypix : chroma;
+	}
+}
 
 int filter2d_init_sds(size_t in_height, size_t in_width, size_t out_height,
 		size_t out_width, uint32_t in_fourcc,
@@ -71,16 +118,78 @@ int filter2d_init_sds(size_t in_height, size_t in_width, size_t out_height,
 	f2d->inLuma = new xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1>(in_height, in_width);
 	f2d->outLuma = new xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1>(in_height, in_width);
 
+	switch (in_fourcc == out_fourcc ? in_fourcc : 0) {
+		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+			f2d->fourcc = in_fourcc;
+			break;
+		default:
+			f2d->fourcc = 0;
+			break;
+	}
+
 	*priv = f2d;
 
 	return 0;
 }
 
-void filter2d_sds(unsigned char *frm_data_in, unsigned char *frm_data_out,
-				int height, int width, const coeff_t coeff, void *priv)
+/*
+ * Filter output lines [0, band_height) of a frame. The accelerator treats
+ * the band plus the context lines below it as a frame of its own, so those
+ * context lines are overwritten with border handling and have to be
+ * filtered again by the caller.
+ */
+void filter2d_band_sds(unsigned char *frm_data_in, unsigned char *frm_data_out,
+				int height, int width, int band_height, const coeff_t coeff,
+				int keep_chroma, void *priv)
 {
 	struct filter2d_data *f2d = (struct filter2d_data *) priv;
-	int pcnt = height*width;
+	int rows = band_height + KSIZE/2 < height ? band_height + KSIZE/2 : height;
+	int pcnt = rows*width;
+
+	f2d->inLuma->rows = rows;
+	f2d->inLuma->size = pcnt;
+	f2d->outLuma->rows = rows;
+	f2d->outLuma->size = pcnt;
+
+	switch (f2d->fourcc) {
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+		{
+			/* the luma plane is fed to the accelerator in place */
+			xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1> inY(rows, width, frm_data_in);
+			xf::Mat<XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1> outY(rows, width, frm_data_out);
+			int luma = height*width;
+
+			xf::filter2D<XF_BORDER_CONSTANT, KSIZE, KSIZE, XF_8UC1, XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1>
+				(inY, outY, (short int *) coeff, 0);
+
+			/* chroma lines of the band */
+			if (keep_chroma) {
+				memcpy(frm_data_out + luma, frm_data_in + luma,
+						band_height / 2 * width);
+			} else {
+				memset(frm_data_out + luma, 128, band_height / 2 * width);
+			}
+			return;
+		}
+		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
+		{
+			int yoff = f2d->fourcc == V4L2_PIX_FMT_UYVY;
+
+			read_f2d_input_yuv(frm_data_in, *f2d->inLuma, pcnt, yoff);
+			xf::filter2D<XF_BORDER_CONSTANT, KSIZE, KSIZE, XF_8UC1, XF_8UC1, F2D_HEIGHT, F2D_WIDTH, XF_NPPC1>
+				(*f2d->inLuma, *f2d->outLuma, (short int *) coeff, 0);
+			write_f2d_output_yuv(*f2d->outLuma, frm_data_in, frm_data_out,
+								pcnt, yoff, keep_chroma);
+			return;
+		}
+		default:
+			break;
+	}
 
 	read_f2d_input(frm_data_in, *f2d->inLuma, pcnt);
 
@@ -90,3 +199,11 @@ void filter2d_sds(unsigned char *frm_data_in, unsigned char *frm_data_out,
 
 	write_f2d_output(*f2d->outLuma,  frm_data_out, pcnt);
 }
+
+void filter2d_sds(unsigned char *frm_data_in, unsigned char *frm_data_out,
+				int height, int width, const coeff_t coeff, int keep_chroma,
+				void *priv)
+{
+	filter2d_band_sds(frm_data_in, frm_data_out, height, width, height,
+					coeff, keep_chroma, priv);
+}
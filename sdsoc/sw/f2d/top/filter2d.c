@@ -1,3 +1,6 @@
+#include <linux/videodev2.h>
+
+#include "adapt.h"
 #include "filter.h"
 #include "helper.h"
 
@@ -7,6 +10,18 @@
 /* Foward declaration */
 void filter2d_cv(unsigned char *frm_data_in, unsigned char *frm_data_out,
 				int height, int width, const coeff_t coeff);
+void filter2d_yuv_cv(unsigned char *frm_data_in, unsigned char *frm_data_out,
+				int height, int width, int stride_in, int stride_out,
+				uint32_t fourcc, int keep_chroma, const coeff_t coeff);
+void filter2d_lines_cv(unsigned char *frm_data_in, unsigned char *frm_data_out,
+				int height, int width, int stride_in, int stride_out,
+				uint32_t fourcc, int keep_chroma, const coeff_t coeff,
+				int line_start, int line_end);
+
+/* Mode flags */
+#define F2D_MODE_HW		(1 << 0)
+#define F2D_MODE_CHROMA	(1 << 1)	/* keep chroma of YUV frames */
+#define F2D_MODE_AUTO	(1 << 2)	/* pick HW, SW or a split per resolution */
 
 const coeff_t coeff_blur = {
 	{1,  1, 1},
@@ -77,6 +92,24 @@ const coeff_t coeff_sobel_v = {
 /* store current coefficients */
 coeff_t coeff_cur;
 
+/* YUV format filtered on the Y plane, 0 for RGB */
+static uint32_t f2d_fourcc;
+
+/* frame passed to the adaptive band callbacks */
+struct f2d_frame {
+	struct filter_s *fs;
+	unsigned char *in;
+	unsigned char *out;
+	int height;
+	int width;
+	int stride_in;
+	int stride_out;
+	int keep_chroma;
+};
+
+static struct vlib_adapt *f2d_adapt;
+static unsigned int f2d_adapt_flags;
+
 static struct {
 	filter2d_preset preset;
 	const char *name;
@@ -145,6 +178,30 @@ const coeff_t *filter2d_get_preset_coeff(filter2d_preset preset)
 	return NULL;
 }
 
+#ifdef WITH_SDSOC
+static void filter2d_sw_lines(void *arg, int line_start, int line_end)
+{
+	struct f2d_frame *f = arg;
+
+	filter2d_lines_cv(f->in, f->out, f->height, f->width, f->stride_in,
+					f->stride_out, f2d_fourcc, f->keep_chroma, coeff_cur,
+					line_start, line_end);
+}
+
+static void filter2d_hw_lines(void *arg, int line_start, int line_end)
+{
+	struct f2d_frame *f = arg;
+
+	filter2d_band_sds(f->in, f->out, f->height, f->width, line_end,
+					coeff_cur, f->keep_chroma, f->fs->data);
+}
+
+static const struct vlib_adapt_ops f2d_adapt_ops = {
+	.hw = filter2d_hw_lines,
+	.sw = filter2d_sw_lines,
+};
+#endif
+
 static int filter2d_init(struct filter_s *fs, const struct filter_init_data *fid)
 {
 	/* filter2d requires equal input/output resolution */
@@ -155,36 +212,114 @@ static int filter2d_init(struct filter_s *fs, const struct filter_init_data *fid
 
 	filter2d_set_preset_coeff(fs, FILTER2D_PRESET_SOBEL_H);
 
+	/* YUV frames are filtered on luma directly, skipping the RGB round trip */
+	switch (fid->in_fourcc == fid->out_fourcc ? fid->in_fourcc : 0) {
+		case V4L2_PIX_FMT_YUYV:
+		case V4L2_PIX_FMT_UYVY:
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+			f2d_fourcc = fid->in_fourcc;
+			break;
+		default:
+			f2d_fourcc = 0;
+			break;
+	}
+
 #ifdef WITH_SDSOC
 	filter2d_init_sds(fid->in_height, fid->in_width, fid->out_height,
 					fid->out_width, fid->in_fourcc, fid->out_fourcc,
 					&fs->data);
+
+	if (!f2d_adapt) {
+		f2d_adapt = vlib_adapt_create(fs, &f2d_adapt_ops, KSIZE/2);
+	} else {
+		vlib_adapt_reset(f2d_adapt);
+	}
 #endif
 
 	return 0;
 }
 
+static const char *f2d_modes[] = {
+#ifdef WITH_SDSOC
+	"HW",
+#endif
+	"SW",
+#ifdef WITH_SDSOC
+	"HW Color",
+#endif
+	"SW Color",
+#ifdef WITH_SDSOC
+	"Auto",
+	"Auto Color",
+#endif
+};
+
+static const unsigned int f2d_mode_flags[] = {
+#ifdef WITH_SDSOC
+	F2D_MODE_HW,
+#endif
+	0,
+#ifdef WITH_SDSOC
+	F2D_MODE_HW | F2D_MODE_CHROMA,
+#endif
+	F2D_MODE_CHROMA,
+#ifdef WITH_SDSOC
+	F2D_MODE_AUTO,
+	F2D_MODE_AUTO | F2D_MODE_CHROMA,
+#endif
+};
+
 static void filter2d_func(struct filter_s *fs,
 					unsigned char *frm_data_in, unsigned char *frm_data_out,
 					int height_in, int width_in, int stride_in,
 					int height_out, int width_out, int stride_out)
 {
+	unsigned int flags;
+
 	if (fs->mode >= fs->num_modes) {
 		return;
 	}
 
-	switch (fs->mode) {
-		case 0:
+	flags = f2d_mode_flags[fs->mode];
+
+	if (flags & F2D_MODE_AUTO && f2d_adapt) {
+		struct f2d_frame f = {
+			.fs = fs,
+			.in = frm_data_in,
+			.out = frm_data_out,
+			.height = height_in,
+			.width = width_in,
+			.stride_in = stride_in,
+			.stride_out = stride_out,
+			.keep_chroma = !!(flags & F2D_MODE_CHROMA),
+		};
+
+		/* the cost per frame depends on the mode, profile again */
+		if (flags != f2d_adapt_flags) {
+			vlib_adapt_reset(f2d_adapt);
+			f2d_adapt_flags = flags;
+		}
+
+		vlib_adapt_run(f2d_adapt, &f, width_in, height_in);
+		return;
+	}
+
 #ifdef WITH_SDSOC
-			filter2d_sds(frm_data_in, frm_data_out, height_in, width_in,
-						coeff_cur, fs->data);
-			break;
-		case 1:
+	if (flags & F2D_MODE_HW) {
+		filter2d_sds(frm_data_in, frm_data_out, height_in, width_in,
+					coeff_cur, !!(flags & F2D_MODE_CHROMA), fs->data);
+		return;
+	}
 #endif
-		default:
-			filter2d_cv(frm_data_in, frm_data_out, height_in, width_in,
-						coeff_cur);
-			break;
+
+	if (f2d_fourcc) {
+		filter2d_yuv_cv(frm_data_in, frm_data_out, height_in, width_in,
+					stride_in, stride_out, f2d_fourcc,
+					!!(flags & F2D_MODE_CHROMA), coeff_cur);
+	} else {
+		filter2d_cv(frm_data_in, frm_data_out, height_in, width_in,
+					coeff_cur);
 	}
 }
 
@@ -193,13 +328,6 @@ static struct filter_ops ops = {
 	.func = filter2d_func
 };
 
-static const char *f2d_modes[] = {
-#ifdef WITH_SDSOC
-	"HW",
-#endif
-	"SW",
-};
-
 const static struct filter_s FS = {
 	.display_text = "2D Filter",
 	.dt_comp_string = "xlnx,v-hls-filter2d",
@@ -0,0 +1,68 @@
+#ifndef ADAPT_H
+#define ADAPT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+struct filter_s;
+
+/* Implementation an adaptive filter dispatches a frame to */
+enum vlib_adapt_impl {
+	VLIB_ADAPT_IMPL_HW,			/* whole frame on the accelerator */
+	VLIB_ADAPT_IMPL_SW,			/* whole frame on the CPU */
+	VLIB_ADAPT_IMPL_SPLIT,		/* top band on the accelerator, rest on the CPU */
+};
+
+struct vlib_adapt_status {
+	enum vlib_adapt_impl impl;
+	size_t width;
+	size_t height;
+	size_t hw_lines;			/* output lines [0, hw_lines) on the accelerator */
+	float hw_ms;				/* profiled frame times, 0 if not measured yet */
+	float sw_ms;
+	float split_ms;
+	int profiling;				/* still in warm-up */
+};
+
+/*
+ * Band callbacks of an adaptive filter. Both process output lines
+ * [line_start, line_end) of the frame described by arg. hw is optional and
+ * only called with line_start 0; it may additionally overwrite the
+ * 'overlap' lines following the band, which are rewritten by sw once the
+ * accelerator is done.
+ */
+struct vlib_adapt_ops {
+	void (*hw)(void *arg, int line_start, int line_end);
+	void (*sw)(void *arg, int line_start, int line_end);
+};
+
+struct vlib_adapt;
+
+/*
+ * An adaptive dispatcher profiles the accelerator and the CPU path on the
+ * first frames of a resolution and again periodically, then runs the faster
+ * one. When the two take comparable time the frame is split into an
+ * accelerator band and a CPU band that run concurrently, with the band
+ * boundary rebalanced from the measured per line cost.
+ */
+struct vlib_adapt *vlib_adapt_create(const struct filter_s *fs,
+				const struct vlib_adapt_ops *ops, size_t overlap);
+void vlib_adapt_destroy(struct vlib_adapt *ad);
+void vlib_adapt_reset(struct vlib_adapt *ad);
+int vlib_adapt_run(struct vlib_adapt *ad, void *arg, size_t width,
+				size_t height);
+int vlib_adapt_get_status(const struct vlib_adapt *ad,
+				struct vlib_adapt_status *status);
+int vlib_filter_get_adapt_status(const struct filter_s *fs,
+				struct vlib_adapt_status *status);
+const char *vlib_adapt_impl_name(enum vlib_adapt_impl impl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ADAPT_H */
@@ -0,0 +1,78 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+/* statistics selected at creation */
+#define VLIB_ANALYTICS_MEAN_STDDEV	(1 << 0)
+#define VLIB_ANALYTICS_MIN_MAX		(1 << 1)
+#define VLIB_ANALYTICS_HISTOGRAM	(1 << 2)
+#define VLIB_ANALYTICS_GRID			(1 << 3)
+
+/* frame statistics, only the selected ones are set */
+struct vlib_analytics_stats {
+	float mean;
+	float stddev;
+	uint8_t min;
+	uint8_t max;
+	size_t min_x, min_y;		/* first minimum in raster order */
+	size_t max_x, max_y;		/* first maximum in raster order */
+	uint32_t hist[VLIB_HISTOGRAM_BINS];
+};
+
+/* statistics of a cell of the region grid, e.g. for auto exposure */
+struct vlib_analytics_cell {
+	float mean;
+	uint8_t min;
+	uint8_t max;
+};
+
+struct vlib_analytics;
+
+/*
+ * Statistics of 8-bit images in one pass. xf::meanStdDev, xf::minMaxLoc
+ * and xf::calcHist each read the whole frame; here any subset of them,
+ * and the mean, minimum and maximum of a grid of @grid_cols x @grid_rows
+ * regions, is gathered in a single pass. Rows are reduced 16 pixels at a
+ * time with vector code, row bands on all cores, and the band results
+ * are merged pairwise in a tree, the levels of the tree again on all
+ * cores. Pixels are @pitch bytes apart, e.g. 2 for the luma of YUYV.
+ */
+struct vlib_analytics *vlib_analytics_create(size_t width, size_t height,
+				size_t pitch, unsigned int flags,
+				size_t grid_cols, size_t grid_rows);
+void vlib_analytics_destroy(struct vlib_analytics *an);
+int vlib_analytics_run(struct vlib_analytics *an,
+				const uint8_t *src, size_t stride);
+const struct vlib_analytics_stats *vlib_analytics_get_stats(
+				const struct vlib_analytics *an);
+const struct vlib_analytics_cell *vlib_analytics_get_cells(
+				const struct vlib_analytics *an);
+size_t vlib_analytics_get_num_cells(const struct vlib_analytics *an);
+
+/*
+ * Statistics of the captured luma of every frame through the software
+ * pipeline, taken before the filter. The last frame's statistics are
+ * copied out by vlib_analytics_get(), with up to *@num_cells grid cells,
+ * row by row, and *@num_cells is set to the number copied. Without
+ * VLIB_ANALYTICS_GRID the grid is a single cell. Flags of 0 turn the
+ * statistics off.
+ */
+int vlib_analytics_enable(unsigned int flags, size_t grid_cols,
+				size_t grid_rows);
+int vlib_analytics_get(struct vlib_analytics_stats *stats,
+				struct vlib_analytics_cell *cells, size_t *num_cells);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ANALYTICS_H */
@@ -0,0 +1,48 @@
+#ifndef BILATERAL_H
+#define BILATERAL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+struct vlib_bilateral;
+
+/*
+ * Bilateral filter of 8-bit images on a bilateral grid. Where
+ * xf::bilateralFilter weights every pixel of a WINDOW_SIZE square, pixels
+ * are accumulated into a grid with one cell per sigma_space pixels and
+ * sigma_color intensity levels, the grid is blurred with a separable
+ * [1 4 6 4 1] kernel, a Gaussian of one cell, and each output pixel is
+ * interpolated from the eight cells around its position and intensity.
+ * The work per pixel does not depend on sigma_space. Grid rows are built
+ * and consumed in a ring while the bands of rows run on all cores, so
+ * only a few rows of the grid are kept at a time.
+ *
+ * Pixels are @pitch bytes apart, e.g. 2 for the luma of YUYV. The other
+ * bytes of @dst are left untouched. The spatial and range weights follow
+ * the Gaussians of xf::bilateralFilter without its window truncation.
+ */
+struct vlib_bilateral *vlib_bilateral_create(size_t width, size_t height,
+				size_t pitch, float sigma_space, float sigma_color);
+void vlib_bilateral_destroy(struct vlib_bilateral *bf);
+int vlib_bilateral(const struct vlib_bilateral *bf,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst);
+
+/*
+ * Edge preserving smoothing pipeline stage on luma, chroma is passed
+ * through. The modes select sigma_space/sigma_color.
+ */
+struct filter_s *vlib_bilateral_filter_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BILATERAL_H */
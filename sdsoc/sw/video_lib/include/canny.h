@@ -0,0 +1,60 @@
+#ifndef CANNY_H
+#define CANNY_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* Largest gradient magnitude, |Gx| + |Gy| of the 3x3 Sobel */
+#define VLIB_CANNY_MAX_MAGNITUDE	2040
+
+/* time spent in the stages of the last vlib_canny_compute() call */
+struct vlib_canny_stats {
+	float tiles_ms;				/* gradients, suppression, hysteresis per tile */
+	float propagate_ms;			/* hysteresis across tiles and the output */
+	size_t rounds;				/* exchanges until no edge crossed a tile */
+};
+
+struct vlib_canny;
+
+/*
+ * CPU counterpart of xf::Canny with the L1 norm, followed by the edge
+ * tracing of xf::EdgeTracing. Sobel gradients, magnitude, direction and
+ * non-maximum suppression are computed 8 pixels at a time from a three row
+ * ring. The frame is split into tiles of rows that run on all cores, and
+ * hysteresis first follows the weak pixels within each tile as soon as
+ * its rows are classified. Tiles then pick up the edges that reach their
+ * first or last row from the neighbouring tile and follow them in turn,
+ * freely across the tiles handled by the same core, until no edge crosses
+ * a tile boundary. The result is the same as that of a hysteresis over the
+ * whole frame.
+ *
+ * Pixels with a magnitude above @high start edges, those above @low
+ * continue them. Gradients are zero on the outermost rows and columns.
+ * Edges are written as 255 on 0.
+ */
+struct vlib_canny *vlib_canny_create(size_t width, size_t height);
+void vlib_canny_destroy(struct vlib_canny *cn);
+int vlib_canny_compute(struct vlib_canny *cn,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst, int low, int high);
+void vlib_canny_get_stats(const struct vlib_canny *cn,
+				struct vlib_canny_stats *stats);
+
+/*
+ * Edge detection pipeline stage. The modes select the low and high
+ * thresholds, from many to few edges.
+ */
+struct filter_s *vlib_canny_filter_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CANNY_H */
@@ -11,4 +11,12 @@ struct vlib_plane {
 	size_t yoffs;	/* y offset */
 };
 
+/* region of the captured frame, zero width and height for all of it */
+struct vlib_crop {
+	size_t width;
+	size_t height;
+	size_t xoffs;	/* x offset */
+	size_t yoffs;	/* y offset */
+};
+
 #endif /* COMMON_H */
@@ -0,0 +1,32 @@
+#ifndef CORNERS_H
+#define CORNERS_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Corner list filled by the detectors, in place of the corner image and
+ * cornersImgToList of the xf pipeline. The fields are kept in separate
+ * arrays so that passes over the list touch only the fields they use.
+ */
+struct vlib_corners {
+	size_t count;
+	size_t capacity;
+	uint16_t *x;
+	uint16_t *y;
+	int32_t *score;				/* detector response, larger is stronger */
+};
+
+int vlib_corners_init(struct vlib_corners *corners, size_t capacity);
+void vlib_corners_free(struct vlib_corners *corners);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORNERS_H */
@@ -0,0 +1,47 @@
+#ifndef CVT_COLOR_H
+#define CVT_COLOR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+struct filter_s;
+
+/*
+ * Software color space conversion (BT.601, limited range, same coefficients
+ * as xf_cvt_color_utils.hpp) between any two of the following formats:
+ *
+ *   packed YUV 4:2:2:  YUYV, UYVY
+ *   semi-planar 4:2:0: NV12, NV21
+ *   planar:            YU12 (IYUV), YV12, YUV444 (DRM 'YU24', V4L2 'YM24')
+ *   luma only:         GREY
+ *   packed RGB:        RGB24, BGR24 (V4L2), RGB888, BGR888, ABGR8888,
+ *                      XBGR8888, ARGB8888, XRGB8888 (DRM)
+ *
+ * RGB to RGB conversions are not supported. The destination may be either
+ * the same size as the source or exactly half the width and height, in
+ * which case a 2x2 box downscale is fused into the conversion. Widths must
+ * be even (multiple of four when downscaling), heights even.
+ */
+int vlib_cvt_color_supported(uint32_t src_fourcc, uint32_t dst_fourcc);
+int vlib_cvt_color(const struct vlib_image *src, struct vlib_image *dst);
+int vlib_cvt_color_lines(const struct vlib_image *src, struct vlib_image *dst,
+						size_t start, size_t end);
+
+/* one pixel of BT.601 limited range YUV, bit-exact with vlib_cvt_color() */
+void vlib_cvt_color_rgb2yuv(uint8_t r, uint8_t g, uint8_t b, uint8_t *yuv);
+
+/* Pipeline stage converting the capture format to the display format */
+struct filter_s *vlib_cvt_color_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CVT_COLOR_H */
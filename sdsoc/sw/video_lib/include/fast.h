@@ -0,0 +1,62 @@
+#ifndef FAST_H
+#define FAST_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "corners.h"
+
+/*
+ * FAST-9 corner detection with the corner test and score of xf::fast: a
+ * pixel is a corner if 9 contiguous pixels of the radius 3 circle are all
+ * brighter or all darker than the center by more than @threshold. With
+ * @nms set, only corners whose score is larger than the score of all 8
+ * neighbours are kept, as xf_fast NMS. Corners are appended in raster
+ * order, those beyond the capacity of the list are dropped.
+ *
+ * 16 pixels are tested at a time. The four compass points of the circle
+ * reject most pixels before the full circle is looked at, and only the
+ * corners are scored.
+ */
+int vlib_fast_detect(const uint8_t *img, size_t stride,
+				size_t width, size_t height, int threshold, int nms,
+				struct vlib_corners *corners);
+
+struct vlib_fast_params {
+	int threshold;				/* intensity difference, 1..254 */
+	int nms;					/* 3x3 non-maximum suppression */
+	int cell_size;				/* grid cell edge in pixels, >= 8 */
+	int max_per_cell;			/* strongest corners kept per cell, >= 1 */
+};
+
+struct vlib_fast;
+
+/*
+ * FAST-9 into a grid of cells, for an even spread of corners over the
+ * frame. Row bands of cells run on all cores and every cell keeps only its
+ * max_per_cell strongest corners, so neither a corner image nor a full
+ * frame list is built. The corners are written cell by cell in raster
+ * order of the cells, strongest first within a cell. Cell i of the grid
+ * holds the corners [start[i], start[i + 1]) of the list.
+ */
+void vlib_fast_default_params(struct vlib_fast_params *params);
+struct vlib_fast *vlib_fast_create(const struct vlib_fast_params *params,
+				size_t width, size_t height);
+void vlib_fast_destroy(struct vlib_fast *fd);
+size_t vlib_fast_capacity(const struct vlib_fast *fd);
+int vlib_fast_detect_grid(struct vlib_fast *fd,
+				const uint8_t *img, size_t stride,
+				struct vlib_corners *corners);
+void vlib_fast_get_cells(const struct vlib_fast *fd, size_t *cols,
+				size_t *rows, const size_t **start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FAST_H */
@@ -50,11 +50,31 @@ struct filter_ops {
 				unsigned char *frm_data_in, unsigned char *frm_data_out,
 				int height_in, int width_in, int stride_in,
 				int height_out, int width_out, int stride_out);
+	/*
+	 * Two consecutive input frames. The m2m pipeline passes the newer
+	 * frame as frame_prev and the older one as frame_curr.
+	 */
 	void (*func2)(struct filter_s *fs, 
 			unsigned char *frame_prev, unsigned char *frame_curr,
 		   	unsigned char *frame_out,
 			int height_in, int width_in, int stride_in,
 			int height_out, int width_out, int stride_out);
+	/*
+	 * Optional: process output lines [line_start, line_end) only. Frame
+	 * pointers and sizes describe the whole frame as for func. Allows a
+	 * filter graph to run stages in cache sized strips.
+	 */
+	void (*func_lines)(struct filter_s *fs,
+				unsigned char *frm_data_in, unsigned char *frm_data_out,
+				int height_in, int width_in, int stride_in,
+				int height_out, int width_out, int stride_out,
+				int line_start, int line_end);
+	/*
+	 * Optional: number of input lines func_lines needs to produce output
+	 * lines [0, line_end). Defaults to scaling by height_in/height_out.
+	 */
+	int (*lines_required)(struct filter_s *fs, int line_end,
+				int height_in, int height_out);
 };
 
 /* Helper functions */
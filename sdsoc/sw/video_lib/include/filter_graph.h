@@ -0,0 +1,44 @@
+#ifndef FILTER_GRAPH_H
+#define FILTER_GRAPH_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* Maximum number of stages in a filter graph */
+#define FILTER_GRAPH_MAX_STAGES	8
+
+/* Filter graph modes */
+enum filter_graph_mode {
+	FILTER_GRAPH_MODE_FUSED,	/* run stages interleaved in row strips */
+	FILTER_GRAPH_MODE_FRAME,	/* run each stage on the whole frame */
+};
+
+/*
+ * A filter graph chains registered filters into a single filter_s, which
+ * can be registered and selected like any other filter. Intermediate
+ * frames are allocated once on init. In fused mode stages implementing
+ * func_lines are executed strip by strip so intermediate lines are still
+ * in L2 when the next stage consumes them. Stages without func_lines act
+ * as a barrier and process the whole frame.
+ */
+struct filter_s *filter_graph_create(const char *display_text);
+void filter_graph_destroy(struct filter_s *graph);
+int filter_graph_add_stage(struct filter_s *graph, struct filter_s *stage,
+						uint32_t fourcc, size_t width, size_t height);
+size_t filter_graph_get_num_stages(const struct filter_s *graph);
+struct filter_s *filter_graph_get_stage(const struct filter_s *graph,
+										size_t i);
+int filter_graph_set_strip_lines(struct filter_s *graph, size_t lines);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FILTER_GRAPH_H */
@@ -0,0 +1,62 @@
+#ifndef HARRIS_H
+#define HARRIS_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "corners.h"
+
+struct vlib_harris_params {
+	int block_size;				/* structure tensor window, 3, 5 or 7 */
+	int nms_radius;				/* 1 for 3x3, 2 for 5x5 suppression */
+	int threshold;				/* minimum response, >= 0 */
+	int k;						/* Harris k in Q16, 0..65535 */
+	int cell_size;				/* grid cell edge in pixels, >= 8 */
+	int max_per_cell;			/* strongest corners kept per cell, >= 1 */
+};
+
+struct vlib_harris;
+
+/*
+ * CPU counterpart of xf::cornerHarris. The Sobel gradients, the products
+ * Ix*Ix, Iy*Iy and Ix*Iy, their box filter, the response and the
+ * non-maximum suppression run fused in one pass over the rows: the
+ * products of the last block_size rows are kept in a ring together with
+ * their column sums, and only 2 * nms_radius + 1 rows of the response are
+ * held for the suppression. Row bands of cells run on all cores, and every
+ * band starts its rings a few rows above its first row.
+ *
+ * The fixed point scaling is that of the 3x3 Sobel path of the xf kernel:
+ * products are shifted right by 6, the box filter is a mean and the
+ * response det - k * trace^2 is computed from the means shifted right by
+ * 2, so thresholds carry over. Gradients are zero on the outermost rows
+ * and columns and the box filter sees zeros outside the image. A pixel is
+ * a corner if its response is larger than @threshold and than the
+ * response of every other pixel of its (2 * nms_radius + 1)^2 window.
+ *
+ * As vlib_fast_detect_grid(), every cell keeps its max_per_cell strongest
+ * corners, written cell by cell in raster order of the cells and strongest
+ * first within a cell.
+ */
+void vlib_harris_default_params(struct vlib_harris_params *params);
+struct vlib_harris *vlib_harris_create(
+				const struct vlib_harris_params *params,
+				size_t width, size_t height);
+void vlib_harris_destroy(struct vlib_harris *hd);
+size_t vlib_harris_capacity(const struct vlib_harris *hd);
+int vlib_harris_detect(struct vlib_harris *hd,
+				const uint8_t *img, size_t stride,
+				struct vlib_corners *corners);
+void vlib_harris_get_cells(const struct vlib_harris *hd, size_t *cols,
+				size_t *rows, const size_t **start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HARRIS_H */
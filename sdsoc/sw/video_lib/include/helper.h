@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define ARRAY_SIZE(a)  (sizeof(a)/sizeof((a)[0]))
 #define ERRSTR strerror(errno)
@@ -22,4 +23,7 @@
 
 #define BIT(n)	(1 << (n))
 
+/* Milliseconds elapsed on CLOCK_MONOTONIC since @start */
+float vlib_ms_since(const struct timespec *start);
+
 #endif /* HELPER_H_ */
@@ -0,0 +1,55 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* bins of a histogram of 8-bit pixels */
+#define VLIB_HISTOGRAM_BINS	256
+
+/*
+ * Histogram statistics of 8-bit images. xf::calcHist, xf::equalizeHist
+ * and xf::OtsuThreshold each make their own pass over the frame, and
+ * equalizeHist takes the frame twice to compute the histogram before the
+ * mapping. Here the histogram is computed once, on all cores: every row
+ * band counts into its own histogram, replicated in four banks so that
+ * runs of equal pixels do not wait on the same counter, and the band
+ * histograms are summed up at the end. The equalization table and the
+ * Otsu threshold are both derived from it.
+ *
+ * vlib_histogram_lut() maps an image through a table and, with @hist,
+ * counts its histogram in the same pass. Mapping a frame with the table
+ * of the previous one keeps equalization of a stream single pass.
+ *
+ * Pixels are @pitch bytes apart, e.g. 2 for the luma of YUYV, and the
+ * other bytes of @dst are left untouched.
+ */
+int vlib_histogram(const uint8_t *src, size_t stride, size_t width,
+				size_t height, size_t pitch, uint32_t *hist);
+int vlib_histogram_lut(const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t width, size_t height, size_t pitch,
+				const uint8_t *lut, uint32_t *hist);
+void vlib_histogram_equalize_lut(const uint32_t *hist, uint8_t *lut);
+uint8_t vlib_histogram_otsu(const uint32_t *hist);
+
+/*
+ * Histogram pipeline stage on luma, chroma is passed through. The modes
+ * equalize each frame with its own histogram, equalize a stream with the
+ * table of the previous frame in one pass, or binarize each frame at its
+ * Otsu threshold.
+ */
+struct filter_s *vlib_histogram_filter_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,76 @@
+#ifndef HOG_H
+#define HOG_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* orientation bins per cell, 20 degrees each over 0..180 */
+#define VLIB_HOG_BINS			9
+
+/* descriptor values per block of 2x2 cells */
+#define VLIB_HOG_BLOCK_SIZE		(4 * VLIB_HOG_BINS)
+
+/* fractional bits of the descriptor values */
+#define VLIB_HOG_DESC_FRAC		12
+
+struct vlib_hog_params {
+	int win_width;				/* detection window, a multiple of cell_size */
+	int win_height;
+	int cell_size;				/* cell edge in pixels, 4..16 */
+	int win_stride;				/* window step, a multiple of cell_size */
+};
+
+/* time spent in the stages of the last vlib_hog_detect() call */
+struct vlib_hog_stats {
+	float cells_ms;				/* gradients and cell histograms */
+	float blocks_ms;			/* block normalization */
+	float svm_ms;				/* scores of all windows */
+};
+
+struct vlib_hog;
+
+/*
+ * CPU counterpart of xf::HOGDescriptor followed by xf::SVM, for dense
+ * sliding windows. The cell histograms of the whole frame are computed
+ * once, then every block of 2x2 cells is normalized once, and the
+ * descriptor of a window is the blocks it covers, read in place. Scoring
+ * a window is a dot product over those blocks, so the cost of a frame
+ * grows with its pixels and the windows share all the work up to the
+ * SVM. Cell rows, block rows and window rows run on all cores.
+ *
+ * As the xf kernel, gradients are the centered differences, zero on the
+ * outermost rows and columns, and each pixel votes its L2 magnitude into
+ * the two nearest of the VLIB_HOG_BINS unsigned orientation bins. Blocks
+ * overlap by one cell and are normalized with L2-Hys, clipped at 0.2.
+ * The descriptor holds the blocks of the window in raster order, the
+ * cells of a block in raster order and the bins of a cell in order, as
+ * 16-bit values with VLIB_HOG_DESC_FRAC fractional bits.
+ */
+void vlib_hog_default_params(struct vlib_hog_params *params);
+struct vlib_hog *vlib_hog_create(const struct vlib_hog_params *params,
+				size_t width, size_t height);
+void vlib_hog_destroy(struct vlib_hog *hog);
+size_t vlib_hog_descriptor_size(const struct vlib_hog *hog);
+void vlib_hog_get_windows(const struct vlib_hog *hog, size_t *cols,
+				size_t *rows);
+int vlib_hog_set_svm(struct vlib_hog *hog, const float *weights, float bias);
+int vlib_hog_describe(const struct vlib_hog *hog,
+				const uint8_t *img, size_t stride, size_t x, size_t y,
+				int16_t *desc);
+float vlib_hog_svm_score(const struct vlib_hog *hog, const int16_t *desc);
+int vlib_hog_detect(struct vlib_hog *hog,
+				const uint8_t *img, size_t stride,
+				float *scores, size_t stride_scores);
+void vlib_hog_get_stats(const struct vlib_hog *hog,
+				struct vlib_hog_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOG_H */
@@ -0,0 +1,43 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Maximum number of planes of a supported pixel format */
+#define VLIB_IMAGE_MAX_PLANES	3
+
+/*
+ * Frame descriptor used by the software processing stages. Plane order
+ * follows the fourcc definition (Y, U, V or Y, UV for semi-planar formats).
+ */
+struct vlib_image {
+	uint32_t fourcc;					/* pixel format */
+	size_t width;						/* width in pixels */
+	size_t height;						/* height in lines */
+	size_t num_planes;					/* number of valid planes */
+	unsigned char *plane[VLIB_IMAGE_MAX_PLANES];
+	size_t stride[VLIB_IMAGE_MAX_PLANES];	/* bytes per line per plane */
+};
+
+int vlib_image_init(struct vlib_image *img, uint32_t fourcc, size_t width,
+					size_t height, size_t stride, unsigned char *buf);
+size_t vlib_image_size(uint32_t fourcc, size_t height, size_t stride);
+size_t vlib_image_stride(uint32_t fourcc, size_t width);
+
+static inline unsigned char *vlib_image_line(const struct vlib_image *img,
+											size_t plane, size_t line)
+{
+	return img->plane[plane] + line * img->stride[plane];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IMAGE_H */
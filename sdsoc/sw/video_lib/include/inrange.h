@@ -0,0 +1,56 @@
+#ifndef INRANGE_H
+#define INRANGE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* largest number of color ranges, one bit each */
+#define VLIB_INRANGE_MAX_COLORS	32
+
+struct vlib_inrange;
+
+/*
+ * Multi-color range thresholding of 3 channel images. Where
+ * xf::colorthresholding compares every pixel against each of its
+ * MAXCOLORS ranges, the ranges are compiled into one table of 256 bit
+ * masks per channel: bit i of entry v is set if v lies in range i on that
+ * channel. A pixel is classified by three lookups and an AND, at the same
+ * cost for any number of colors. Pixels inside any range are 255 in the
+ * mask @dst, others 0; bounds are inclusive as in xf::inRange.
+ *
+ * vlib_inrange_rgb() converts RGB pixels to 8-bit HSV on the way, as
+ * xf::rgb2hsv with hue in 0..179 and hue and saturation rounded to
+ * nearest, so that the ranges are given in HSV.
+ */
+struct vlib_inrange *vlib_inrange_create(const uint8_t low[][3],
+				const uint8_t high[][3], size_t num_colors);
+void vlib_inrange_destroy(struct vlib_inrange *ir);
+int vlib_inrange(const struct vlib_inrange *ir,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t width, size_t height);
+int vlib_inrange_rgb(const struct vlib_inrange *ir,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t width, size_t height);
+
+/*
+ * Color detection pipeline stage: frames are converted to RGB in strips,
+ * classified in HSV and shown as a grey mask. The modes select red,
+ * green, blue, yellow or all of them, the last one also with the erode,
+ * dilate, dilate, erode clean-up of the xf color detection example.
+ */
+struct filter_s *vlib_inrange_filter_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INRANGE_H */
@@ -0,0 +1,61 @@
+#ifndef INTEGRAL_H
+#define INTEGRAL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* largest frame whose integral image of 8-bit pixels fits 32 bits */
+#define VLIB_INTEGRAL_MAX_PIXELS_32	(UINT32_MAX / 255)
+
+/* bytes per element of an integral image */
+enum vlib_integral_depth {
+	VLIB_INTEGRAL_32 = 4,
+	VLIB_INTEGRAL_64 = 8,
+};
+
+/*
+ * Integral image of an 8-bit frame, as xf::integral: every output is the
+ * sum of the pixels above and left of it, the pixel itself included.
+ * Where the HLS core walks the frame once, pixel by pixel, the rows are
+ * summed up here 16 pixels at a time with a scan in the vector registers.
+ * The column sums run on all cores: row bands first sum up their columns
+ * separately, then each band starts from the carry of the bands above it.
+ *
+ * Outputs are 32-bit up to VLIB_INTEGRAL_MAX_PIXELS_32 pixels, 64-bit
+ * beyond, vlib_integral_depth() picks the narrowest.
+ */
+enum vlib_integral_depth vlib_integral_depth(size_t width, size_t height);
+int vlib_integral(const uint8_t *src, size_t stride_src,
+				void *dst, size_t stride_dst,
+				size_t width, size_t height,
+				enum vlib_integral_depth depth);
+
+struct vlib_integral_rows;
+
+/*
+ * Rolling integral image, for box sums over a sliding window of rows
+ * without a full frame of integrals. Source rows are pushed top to
+ * bottom, only the last @rows integral rows are kept, e.g. the box height
+ * plus one. Rows are 32-bit and wrap around: the difference of two of
+ * them, and thus a box sum, is exact as long as the box sum fits 32 bits,
+ * whatever the size of the frame.
+ */
+struct vlib_integral_rows *vlib_integral_rows_create(size_t width,
+				size_t rows);
+void vlib_integral_rows_destroy(struct vlib_integral_rows *ir);
+void vlib_integral_rows_reset(struct vlib_integral_rows *ir);
+const uint32_t *vlib_integral_rows_push(struct vlib_integral_rows *ir,
+				const uint8_t *src);
+const uint32_t *vlib_integral_rows_get(const struct vlib_integral_rows *ir,
+				long y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INTEGRAL_H */
@@ -0,0 +1,50 @@
+#ifndef LK_FLOW_H
+#define LK_FLOW_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Largest supported window size */
+#define VLIB_LK_FLOW_MAX_WINDOW		63
+
+/* time spent in the stages of the last vlib_lk_flow_compute() call */
+struct vlib_lk_flow_stats {
+	float products_ms;			/* gradients and the five product images */
+	float flow_ms;				/* window sums and the 2x2 solve */
+};
+
+struct vlib_lk_flow;
+
+/*
+ * CPU counterpart of xf::DenseNonPyrLKOpticalFlow. The gradient products
+ * IxIx, IxIy, IyIy, IxIt and IyIt are computed once per frame into 16-bit
+ * images. Their window sums are then kept as column sums that are updated
+ * by one row from row to row and box summed along the row, so the cost per
+ * pixel does not depend on the window size. Both passes are vectorized and
+ * row bands run on all cores.
+ *
+ * Gradients and the temporal difference are those of the xf kernel and
+ * are zero on the outermost rows and columns. Windows are clipped to the
+ * image. The flow from @prev to @next is written as separate float x and
+ * y images, pixels with an ill-conditioned system get a flow of zero.
+ */
+struct vlib_lk_flow *vlib_lk_flow_create(size_t width, size_t height,
+				int window_size);
+void vlib_lk_flow_destroy(struct vlib_lk_flow *lk);
+int vlib_lk_flow_compute(struct vlib_lk_flow *lk,
+				const uint8_t *prev, size_t stride_prev,
+				const uint8_t *next, size_t stride_next,
+				float *flowx, float *flowy, size_t stride_flow);
+void vlib_lk_flow_get_stats(const struct vlib_lk_flow *lk,
+				struct vlib_lk_flow_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LK_FLOW_H */
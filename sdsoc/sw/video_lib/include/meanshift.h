@@ -0,0 +1,90 @@
+#ifndef MEANSHIFT_H
+#define MEANSHIFT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* color histogram bins, 3 bits of each of R, G and B as xf::MeanShift */
+#define VLIB_MEANSHIFT_BINS		512
+
+struct vlib_meanshift_params {
+	int max_objects;			/* object slots, as MAXOBJ */
+	int max_iterations;			/* mean shift steps per frame, >= 1 */
+	int search_radius;			/* largest move per frame in pixels, >= 1 */
+	float min_similarity;		/* Bhattacharyya coefficient, 0..1 */
+};
+
+/* an object as of the last vlib_meanshift_track() call */
+struct vlib_meanshift_object {
+	int x;						/* top left corner of the window */
+	int y;
+	int width;
+	int height;
+	float similarity;			/* to the target histogram, 0..1 */
+	int iterations;				/* mean shift steps of the last frame */
+	int lost;					/* no longer tracked */
+};
+
+/* time spent in the stages of the last vlib_meanshift_track() call */
+struct vlib_meanshift_stats {
+	float bins_ms;				/* bin image of the search windows */
+	float track_ms;
+	size_t tracked;
+	size_t lost;				/* objects lost in this frame */
+};
+
+struct vlib_meanshift;
+
+/*
+ * CPU counterpart of xf::MeanShift as a tracking service. Objects keep
+ * their window, target histogram and kernel weights from one frame to the
+ * next, so nothing is copied in or out per call. On every frame the color
+ * bins are computed once, only inside the union of the search windows
+ * (the object windows grown by search_radius), and shared by all
+ * objects and iterations. Objects are then tracked on all cores. Each
+ * step weights the pixels of the window by sqrt(target / candidate) of
+ * their bin and moves the window to their weighted mean, within the
+ * search window, until it stops moving.
+ *
+ * Histograms are weighted with an Epanechnikov kernel over the window
+ * ellipse. Unlike the xf kernel, which drops an object as soon as its
+ * window touches the frame border, windows are kept inside the frame and
+ * an object is lost once the Bhattacharyya coefficient of its histogram
+ * falls below min_similarity. Frames are RGB24.
+ */
+void vlib_meanshift_default_params(struct vlib_meanshift_params *params);
+struct vlib_meanshift *vlib_meanshift_create(
+				const struct vlib_meanshift_params *params,
+				size_t width, size_t height);
+void vlib_meanshift_destroy(struct vlib_meanshift *ms);
+int vlib_meanshift_add(struct vlib_meanshift *ms,
+				const uint8_t *rgb, size_t stride,
+				int x, int y, int width, int height);
+void vlib_meanshift_remove(struct vlib_meanshift *ms, int id);
+int vlib_meanshift_track(struct vlib_meanshift *ms,
+				const uint8_t *rgb, size_t stride);
+int vlib_meanshift_get_object(const struct vlib_meanshift *ms, int id,
+				struct vlib_meanshift_object *obj);
+void vlib_meanshift_get_stats(const struct vlib_meanshift *ms,
+				struct vlib_meanshift_stats *stats);
+
+/*
+ * Mean shift tracking pipeline stage. The modes place 1, 4 or 9 objects
+ * in a grid over the center of the frame; an object that is lost starts
+ * over at its place. Shows the frame with the window of every object,
+ * green while tracked and red once lost.
+ */
+struct filter_s *vlib_meanshift_filter_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEANSHIFT_H */
@@ -0,0 +1,52 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* largest window, the counts of a window have to fit 16 bits */
+#define VLIB_MEDIAN_MAX_WINDOW	255
+
+struct vlib_median;
+
+/*
+ * Median filter of 8-bit images with a square window of any odd size, in
+ * constant time per pixel (Perreault and Hebert). Where xf::medianBlur
+ * sorts the WIN_SZ x WIN_SZ window of every pixel with a sorting network,
+ * each column keeps a histogram of the window rows, updated by one pixel
+ * in and one out per row. The window histogram moves along a row by
+ * adding one column histogram and subtracting another, 16 bins at a time
+ * with vector code. Histograms have 16 coarse bins over 16 fine bins
+ * each; the coarse bins locate the median, and the fine bins are only
+ * brought up to date for the coarse bin that holds it.
+ *
+ * The frame is split into strips of columns, processed top to bottom on
+ * all cores so that the histograms of a strip stay in the cache. Pixels
+ * are @pitch bytes apart, e.g. 2 for the luma of YUYV, and the other
+ * bytes of @dst are left untouched. Borders are replicated.
+ */
+struct vlib_median *vlib_median_create(size_t width, size_t height,
+				size_t pitch, size_t window);
+void vlib_median_destroy(struct vlib_median *md);
+int vlib_median(const struct vlib_median *md,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst);
+
+/*
+ * Median pipeline stage on luma, chroma is passed through. The modes
+ * select the window from 7x7 to 31x31.
+ */
+struct filter_s *vlib_median_filter_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEDIAN_H */
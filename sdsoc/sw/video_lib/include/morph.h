@@ -0,0 +1,64 @@
+#ifndef MORPH_H
+#define MORPH_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* largest kernel width or height */
+#define VLIB_MORPH_MAX_KSIZE	255
+
+enum vlib_morph_op {
+	VLIB_MORPH_ERODE,
+	VLIB_MORPH_DILATE,
+	VLIB_MORPH_OPEN,		/* dilate(erode(src)) */
+	VLIB_MORPH_CLOSE,		/* erode(dilate(src)) */
+	VLIB_MORPH_GRADIENT,	/* dilate(src) - erode(src) */
+	VLIB_MORPH_TOPHAT,		/* src - open(src) */
+	VLIB_MORPH_BLACKHAT,	/* close(src) - src */
+};
+
+struct vlib_morph;
+
+/*
+ * Grey level morphology of 8-bit images with a rectangular kernel of any
+ * odd size. Where xf::erode and xf::dilate take the minimum or maximum of
+ * a fixed 3x3 window, the kernel is split into a column and a row pass,
+ * each done with the van Herk/Gil-Werman algorithm: the lines are cut into
+ * blocks of the kernel size, and the extreme of every window is the one
+ * of a suffix of one block and a prefix of the next. That is three
+ * comparisons per pixel and pass for any kernel size. The column pass
+ * compares whole lines 16 pixels at a time; for the row pass, tiles of
+ * 16x16 pixels are transposed so that it runs on vectors as well.
+ *
+ * The frame is processed in strips of lines on all cores. The composite
+ * operations run both of their passes, and the difference to the source,
+ * strip by strip, so intermediate images stay in the cache. Pixels are
+ * @pitch bytes apart, e.g. 2 for the luma of YUYV, and the other bytes of
+ * @dst are left untouched. Borders are replicated, which for minimum and
+ * maximum is the same as leaving out pixels outside the frame.
+ */
+struct vlib_morph *vlib_morph_create(size_t width, size_t height,
+				size_t pitch, size_t kernel_width, size_t kernel_height);
+void vlib_morph_destroy(struct vlib_morph *mp);
+int vlib_morph(const struct vlib_morph *mp, enum vlib_morph_op op,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst);
+
+/*
+ * Morphology pipeline stage for @op on luma, chroma is passed through. The
+ * modes select a square kernel from 3x3 to 31x31.
+ */
+struct filter_s *vlib_morph_filter_create(enum vlib_morph_op op);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MORPH_H */
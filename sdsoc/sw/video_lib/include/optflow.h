@@ -0,0 +1,65 @@
+#ifndef OPTFLOW_H
+#define OPTFLOW_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* Maximum number of pyramid levels */
+#define VLIB_OPTFLOW_MAX_LEVELS		6
+
+struct vlib_optflow_params {
+	int levels;					/* pyramid levels, 1..VLIB_OPTFLOW_MAX_LEVELS */
+	int window_size;			/* odd, 3..31 */
+	int iterations;				/* Lucas-Kanade iterations per level */
+};
+
+/* time spent in the stages of the last vlib_optflow_compute() call */
+struct vlib_optflow_stats {
+	float pyramid_ms;			/* pyramid and gradients of the new frame */
+	float flow_ms;
+};
+
+struct vlib_optflow;
+
+/*
+ * CPU counterpart of xf::densePyrOpticalFlow. Frames are pushed one at a
+ * time and the flow from the previous to the new frame is computed. The
+ * pyramid and gradients of a frame are built once when it is pushed and
+ * kept for the next call, so only one pyramid is built per frame. Rows of
+ * every level are processed on all cores.
+ *
+ * The flow is written as interleaved float (dx, dy) pairs in pixels of
+ * the full resolution image. It is zero for the first frame.
+ */
+void vlib_optflow_default_params(struct vlib_optflow_params *params);
+struct vlib_optflow *vlib_optflow_create(
+				const struct vlib_optflow_params *params,
+				size_t width, size_t height);
+void vlib_optflow_destroy(struct vlib_optflow *of);
+void vlib_optflow_reset(struct vlib_optflow *of);
+int vlib_optflow_compute(struct vlib_optflow *of,
+				const uint8_t *frame, size_t stride,
+				float *flow, size_t stride_flow);
+void vlib_optflow_get_stats(const struct vlib_optflow *of,
+				struct vlib_optflow_stats *stats);
+
+/*
+ * Dense optical flow pipeline stage. Takes two consecutive frames through
+ * func2, the newer one first as in the m2m pipeline, and shows the flow
+ * from the older to the newer frame color coded, hue for the direction and
+ * brightness for the magnitude.
+ */
+struct filter_s *vlib_optflow_filter_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OPTFLOW_H */
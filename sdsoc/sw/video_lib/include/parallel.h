@@ -0,0 +1,33 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+/* Maximum number of threads of the band worker pool */
+#define VLIB_PARALLEL_MAX_THREADS	8
+
+/* Band callback, processes items [start, end) */
+typedef void (*vlib_parallel_func)(void *arg, size_t start, size_t end);
+
+/*
+ * Row band parallelism for the software kernels. Items [0, n) are split
+ * into one contiguous band per thread, band boundaries are multiples of
+ * grain. The calling thread processes the first band, persistent workers
+ * the others. Nested calls, and calls while another thread runs a loop,
+ * are executed serially by the caller.
+ */
+int vlib_parallel_for(size_t n, size_t grain, vlib_parallel_func func,
+				void *arg);
+size_t vlib_parallel_get_num_threads(void);
+int vlib_parallel_set_num_threads(size_t num_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PARALLEL_H */
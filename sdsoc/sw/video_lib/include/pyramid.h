@@ -0,0 +1,26 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * One level of an 8-bit image pyramid: 5x5 Gaussian [1 4 6 4 1] and
+ * decimation with reflect-101 borders, as xf::pyrDown. The destination is
+ * (width + 1) / 2 x (height + 1) / 2 pixels. Rows are processed on all
+ * cores. Width and height must be at least 3.
+ */
+int vlib_pyr_down(const uint8_t *src, size_t stride_src,
+				size_t width, size_t height,
+				uint8_t *dst, size_t stride_dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PYRAMID_H */
@@ -0,0 +1,43 @@
+#ifndef REMAP_H
+#define REMAP_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Largest source width or height a compiled map can address */
+#define VLIB_REMAP_MAX_SRC_SIZE		2046
+
+struct vlib_remap;
+
+/*
+ * Bilinear remap of 8-bit images with a map compiled once, for per-frame
+ * lens undistortion and rectification. Each source coordinate is packed
+ * into 16 bits with 5 fractional bits (the precision of xf::remap), half
+ * the memory of a pair of float maps, and stored in tiles so that a tile
+ * of the output reads a compact region of the source. Tiles that read
+ * only inside the source run a vector path, the others handle the border:
+ * pixels outside the source read as black, as in xf::remap.
+ */
+struct vlib_remap *vlib_remap_create(const float *mapx, const float *mapy,
+				size_t map_stride, size_t width, size_t height,
+				size_t src_width, size_t src_height);
+void vlib_remap_destroy(struct vlib_remap *rm);
+size_t vlib_remap_size(const struct vlib_remap *rm);
+int vlib_remap(const struct vlib_remap *rm,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst);
+int vlib_remap_lines(const struct vlib_remap *rm,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t start, size_t end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REMAP_H */
@@ -0,0 +1,69 @@
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* largest downscale factor per axis of the filtering interpolations */
+#define VLIB_RESIZE_MAX_DOWNSCALE	16
+
+/* interpolations of xf::resize */
+enum vlib_resize_interp {
+	VLIB_RESIZE_NEAREST,
+	VLIB_RESIZE_BILINEAR,
+	VLIB_RESIZE_AREA,			/* box average, bilinear when upscaling */
+};
+
+struct vlib_resize;
+
+/*
+ * Separable polyphase resize of 8-bit images. Where xf::resize computes
+ * the source position and the weights of every pixel while it streams,
+ * the first source pixel and the weights of each output column and line
+ * are computed once per source and output size and shared by all resizers
+ * of the same sizes. Lines are filtered horizontally into 16-bit lines,
+ * which are kept while later output lines still need them, then combined
+ * vertically with vector code.
+ *
+ * A pixel has @channels interleaved values in @pitch bytes, e.g. 3 and 3
+ * for RGB24, or 2 and 4 for the chroma of YUYV starting at its first U.
+ * Output pixels sample the source at their centers, as xf::resize and
+ * OpenCV, and the edges are replicated.
+ */
+struct vlib_resize *vlib_resize_create(size_t src_width, size_t src_height,
+				size_t width, size_t height, size_t channels, size_t pitch,
+				enum vlib_resize_interp interp);
+void vlib_resize_destroy(struct vlib_resize *rs);
+size_t vlib_resize_src_lines(const struct vlib_resize *rs, size_t end);
+int vlib_resize(const struct vlib_resize *rs,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst);
+int vlib_resize_lines(const struct vlib_resize *rs,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t start, size_t end);
+
+/*
+ * Resize pipeline stage, scales the input frame, or a crop region of it, to
+ * the output size. When the output pixel format differs, strips of resized
+ * lines are converted with vlib_cvt_color_lines() while still in the cache,
+ * so cropping, scaling and conversion take a single pass over the frame.
+ * The modes select the interpolation.
+ */
+struct filter_s *vlib_resize_filter_create(void);
+void vlib_resize_filter_set_crop(struct filter_s *fs, size_t x, size_t y,
+								size_t width, size_t height);
+void vlib_resize_filter_destroy(struct filter_s *fs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESIZE_H */
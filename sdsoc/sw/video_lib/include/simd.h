@@ -0,0 +1,983 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Minimal 128-bit vector abstraction for the software image kernels.
+ *
+ * NEON and SSE2 map directly onto intrinsics. Targets without either fall
+ * back to plain C on lane arrays. All three produce bit-identical results,
+ * so a kernel has to be written only once. Define VLIB_SIMD_DISABLE to
+ * force the scalar fallback.
+ *
+ * Shift counts must be compile time constants (NEON immediates), which is
+ * why the shift helpers are macros.
+ */
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(VLIB_SIMD_DISABLE)
+#define VLIB_SIMD_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) && !defined(VLIB_SIMD_DISABLE)
+#define VLIB_SIMD_SSE2
+#include <emmintrin.h>
+#else
+#define VLIB_SIMD_SCALAR
+#endif
+
+/* number of 8-bit lanes per vector */
+#define VLIB_SIMD_WIDTH		16
+
+#if defined(VLIB_SIMD_NEON)
+
+typedef uint8x16_t v_u8;
+typedef uint16x8_t v_u16;
+typedef int16x8_t v_s16;
+typedef int32x4_t v_s32;
+
+static inline v_u8 v_load_u8(const uint8_t *p) { return vld1q_u8(p); }
+static inline void v_store_u8(uint8_t *p, v_u8 a) { vst1q_u8(p, a); }
+static inline v_u8 v_setall_u8(uint8_t x) { return vdupq_n_u8(x); }
+static inline void v_store_lo_u8(uint8_t *p, v_u8 a) { vst1_u8(p, vget_low_u8(a)); }
+static inline void v_store_hi_u8(uint8_t *p, v_u8 a) { vst1_u8(p, vget_high_u8(a)); }
+
+static inline void v_load_deinterleave2_u8(const uint8_t *p, v_u8 *a, v_u8 *b)
+{
+	uint8x16x2_t v = vld2q_u8(p);
+	*a = v.val[0];
+	*b = v.val[1];
+}
+
+static inline void v_load_deinterleave3_u8(const uint8_t *p, v_u8 *a, v_u8 *b,
+										v_u8 *c)
+{
+	uint8x16x3_t v = vld3q_u8(p);
+	*a = v.val[0];
+	*b = v.val[1];
+	*c = v.val[2];
+}
+
+static inline void v_load_deinterleave4_u8(const uint8_t *p, v_u8 *a, v_u8 *b,
+										v_u8 *c, v_u8 *d)
+{
+	uint8x16x4_t v = vld4q_u8(p);
+	*a = v.val[0];
+	*b = v.val[1];
+	*c = v.val[2];
+	*d = v.val[3];
+}
+
+static inline void v_store_interleave2_u8(uint8_t *p, v_u8 a, v_u8 b)
+{
+	uint8x16x2_t v = { { a, b } };
+	vst2q_u8(p, v);
+}
+
+static inline void v_store_interleave3_u8(uint8_t *p, v_u8 a, v_u8 b, v_u8 c)
+{
+	uint8x16x3_t v = { { a, b, c } };
+	vst3q_u8(p, v);
+}
+
+static inline void v_store_interleave4_u8(uint8_t *p, v_u8 a, v_u8 b, v_u8 c,
+										v_u8 d)
+{
+	uint8x16x4_t v = { { a, b, c, d } };
+	vst4q_u8(p, v);
+}
+
+static inline v_u8 v_avg_u8(v_u8 a, v_u8 b) { return vrhaddq_u8(a, b); }
+static inline v_u16 v_pairsum_u8(v_u8 a) { return vpaddlq_u8(a); }
+
+static inline v_s16 v_expand_lo_u8(v_u8 a)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(a)));
+}
+
+static inline v_s16 v_expand_hi_u8(v_u8 a)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(a)));
+}
+
+static inline v_s16 v_load_expand_u8(const uint8_t *p)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+}
+
+static inline v_s16 v_setall_s16(int16_t x) { return vdupq_n_s16(x); }
+static inline v_s16 v_add_s16(v_s16 a, v_s16 b) { return vaddq_s16(a, b); }
+static inline v_s16 v_sub_s16(v_s16 a, v_s16 b) { return vsubq_s16(a, b); }
+static inline v_s16 v_adds_s16(v_s16 a, v_s16 b) { return vqaddq_s16(a, b); }
+static inline v_s16 v_mul_s16(v_s16 a, v_s16 b) { return vmulq_s16(a, b); }
+/* high half of the 32-bit products, (a * b) >> 16 */
+static inline v_s16 v_mulhi_s16(v_s16 a, v_s16 b)
+{
+	return vcombine_s16(vshrn_n_s32(vmull_s16(vget_low_s16(a), vget_low_s16(b)), 16),
+						vshrn_n_s32(vmull_s16(vget_high_s16(a), vget_high_s16(b)), 16));
+}
+#define v_shr_s16(a, n)	vshrq_n_s16(a, n)
+#define v_shl_s16(a, n)	vshlq_n_s16(a, n)
+/* lanes moved up by n, 1 to 7, zeros shifted in */
+#define v_slide_s16(a, n)	vextq_s16(vdupq_n_s16(0), a, 8 - (n))
+
+static inline v_u16 v_setall_u16(uint16_t x) { return vdupq_n_u16(x); }
+static inline v_u16 v_add_u16(v_u16 a, v_u16 b) { return vaddq_u16(a, b); }
+static inline v_u16 v_mul_u16(v_u16 a, v_u16 b) { return vmulq_u16(a, b); }
+#define v_shr_u16(a, n)	vshrq_n_u16(a, n)
+
+static inline v_u16 v_reinterpret_u16_s16(v_s16 a) { return vreinterpretq_u16_s16(a); }
+static inline v_s16 v_reinterpret_s16_u16(v_u16 a) { return vreinterpretq_s16_u16(a); }
+
+/* duplicate lanes 0..3 (lo) or 4..7 (hi) into pairs */
+static inline v_s16 v_dup_lo_s16(v_s16 a) { return vzipq_s16(a, a).val[0]; }
+static inline v_s16 v_dup_hi_s16(v_s16 a) { return vzipq_s16(a, a).val[1]; }
+
+/* saturating narrow of two s16 vectors to one u8 vector */
+static inline v_u8 v_packus_s16(v_s16 a, v_s16 b)
+{
+	return vcombine_u8(vqmovun_s16(a), vqmovun_s16(b));
+}
+
+/* saturating narrow of two u16 vectors to one u8 vector */
+static inline v_u8 v_pack_u16(v_u16 a, v_u16 b)
+{
+	return vcombine_u8(vqmovn_u16(a), vqmovn_u16(b));
+}
+
+static inline v_u8 v_min_u8(v_u8 a, v_u8 b) { return vminq_u8(a, b); }
+static inline v_u8 v_max_u8(v_u8 a, v_u8 b) { return vmaxq_u8(a, b); }
+static inline v_u8 v_adds_u8(v_u8 a, v_u8 b) { return vqaddq_u8(a, b); }
+static inline v_u8 v_subs_u8(v_u8 a, v_u8 b) { return vqsubq_u8(a, b); }
+
+/* interleave lanes 0..7 (lo) and 8..15 (hi) of a and b */
+static inline void v_zip_u8(v_u8 a, v_u8 b, v_u8 *lo, v_u8 *hi)
+{
+	uint8x16x2_t r = vzipq_u8(a, b);
+
+	*lo = r.val[0];
+	*hi = r.val[1];
+}
+static inline v_u8 v_absdiff_u8(v_u8 a, v_u8 b) { return vabdq_u8(a, b); }
+static inline v_u8 v_sub_u8(v_u8 a, v_u8 b) { return vsubq_u8(a, b); }
+static inline v_u8 v_and_u8(v_u8 a, v_u8 b) { return vandq_u8(a, b); }
+static inline v_u8 v_or_u8(v_u8 a, v_u8 b) { return vorrq_u8(a, b); }
+/* all ones lanes where a > b */
+static inline v_u8 v_cmpgt_u8(v_u8 a, v_u8 b) { return vcgtq_u8(a, b); }
+
+static inline int v_any_u8(v_u8 a)
+{
+	uint32x2_t m = vreinterpret_u32_u8(vorr_u8(vget_low_u8(a), vget_high_u8(a)));
+
+	return (vget_lane_u32(m, 0) | vget_lane_u32(m, 1)) != 0;
+}
+
+static inline v_u16 v_load_u16(const uint16_t *p) { return vld1q_u16(p); }
+static inline void v_store_u16(uint16_t *p, v_u16 a) { vst1q_u16(p, a); }
+static inline v_s16 v_load_s16(const int16_t *p) { return vld1q_s16(p); }
+static inline void v_store_s16(int16_t *p, v_s16 a) { vst1q_s16(p, a); }
+static inline v_u16 v_sub_u16(v_u16 a, v_u16 b) { return vsubq_u16(a, b); }
+static inline v_s16 v_abs_s16(v_s16 a) { return vabsq_s16(a); }
+static inline v_s16 v_min_s16(v_s16 a, v_s16 b) { return vminq_s16(a, b); }
+static inline v_s16 v_max_s16(v_s16 a, v_s16 b) { return vmaxq_s16(a, b); }
+
+/* 32-bit lanes, for sums that outgrow 16 bits */
+static inline v_s32 v_load_s32(const int32_t *p) { return vld1q_s32(p); }
+static inline void v_store_s32(int32_t *p, v_s32 a) { vst1q_s32(p, a); }
+static inline v_s32 v_setall_s32(int32_t x) { return vdupq_n_s32(x); }
+static inline v_s32 v_add_s32(v_s32 a, v_s32 b) { return vaddq_s32(a, b); }
+static inline v_s32 v_sub_s32(v_s32 a, v_s32 b) { return vsubq_s32(a, b); }
+static inline v_s32 v_expand_lo_s16(v_s16 a) { return vmovl_s16(vget_low_s16(a)); }
+static inline v_s32 v_expand_hi_s16(v_s16 a) { return vmovl_s16(vget_high_s16(a)); }
+
+/*
+ * acc plus the products a * b, two per lane. Which products share a lane
+ * differs between targets, so only the v_reduce_add_s32() of the lanes is
+ * the same everywhere.
+ */
+static inline v_s32 v_madd_s16(v_s32 acc, v_s16 a, v_s16 b)
+{
+	acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+	return vmlal_s16(acc, vget_high_s16(a), vget_high_s16(b));
+}
+
+static inline int32_t v_reduce_add_s32(v_s32 a)
+{
+	int32x2_t s = vadd_s32(vget_low_s32(a), vget_high_s32(a));
+
+	return vget_lane_s32(vpadd_s32(s, s), 0);
+}
+
+static inline v_u16 v_min_u16(v_u16 a, v_u16 b) { return vminq_u16(a, b); }
+static inline v_u16 v_adds_u16(v_u16 a, v_u16 b) { return vqaddq_u16(a, b); }
+static inline v_u16 v_subs_u16(v_u16 a, v_u16 b) { return vqsubq_u16(a, b); }
+
+/* comparisons return all ones lanes where true */
+static inline v_u16 v_cmpgt_u16(v_u16 a, v_u16 b) { return vcgtq_u16(a, b); }
+static inline v_u16 v_cmpgt_s16(v_s16 a, v_s16 b) { return vcgtq_s16(a, b); }
+static inline v_u16 v_and_u16(v_u16 a, v_u16 b) { return vandq_u16(a, b); }
+static inline v_u16 v_or_u16(v_u16 a, v_u16 b) { return vorrq_u16(a, b); }
+/* lanes of a where mask is set, else lanes of b */
+static inline v_u16 v_select_u16(v_u16 mask, v_u16 a, v_u16 b) { return vbslq_u16(mask, a, b); }
+
+static inline uint16_t v_reduce_min_u16(v_u16 a)
+{
+	uint16x4_t m = vmin_u16(vget_low_u16(a), vget_high_u16(a));
+
+	m = vpmin_u16(m, m);
+	m = vpmin_u16(m, m);
+	return vget_lane_u16(m, 0);
+}
+
+static inline int v_any_u16(v_u16 a)
+{
+	uint32x2_t m = vreinterpret_u32_u16(vorr_u16(vget_low_u16(a),
+											vget_high_u16(a)));
+
+	return (vget_lane_u32(m, 0) | vget_lane_u32(m, 1)) != 0;
+}
+
+#elif defined(VLIB_SIMD_SSE2)
+
+typedef __m128i v_u8;
+typedef __m128i v_u16;
+typedef __m128i v_s16;
+typedef __m128i v_s32;
+
+static inline v_u8 v_load_u8(const uint8_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline void v_store_u8(uint8_t *p, v_u8 a) { _mm_storeu_si128((__m128i *)p, a); }
+static inline v_u8 v_setall_u8(uint8_t x) { return _mm_set1_epi8((char)x); }
+static inline void v_store_lo_u8(uint8_t *p, v_u8 a) { _mm_storel_epi64((__m128i *)p, a); }
+static inline void v_store_hi_u8(uint8_t *p, v_u8 a) { _mm_storel_epi64((__m128i *)p, _mm_unpackhi_epi64(a, a)); }
+
+static inline void v_deinterleave2_u8(v_u8 lo, v_u8 hi, v_u8 *a, v_u8 *b)
+{
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+
+	*a = _mm_packus_epi16(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+	*b = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+static inline void v_load_deinterleave2_u8(const uint8_t *p, v_u8 *a, v_u8 *b)
+{
+	v_deinterleave2_u8(v_load_u8(p), v_load_u8(p + 16), a, b);
+}
+
+static inline void v_load_deinterleave3_u8(const uint8_t *p, v_u8 *a, v_u8 *b,
+										v_u8 *c)
+{
+	uint8_t t[3][16];
+
+	for (int i=0; i<16; i++) {
+		t[0][i] = p[3*i];
+		t[1][i] = p[3*i+1];
+		t[2][i] = p[3*i+2];
+	}
+
+	*a = v_load_u8(t[0]);
+	*b = v_load_u8(t[1]);
+	*c = v_load_u8(t[2]);
+}
+
+static inline void v_load_deinterleave4_u8(const uint8_t *p, v_u8 *a, v_u8 *b,
+										v_u8 *c, v_u8 *d)
+{
+	v_u8 ac0, bd0, ac1, bd1;
+
+	/* split even/odd bytes twice */
+	v_deinterleave2_u8(v_load_u8(p), v_load_u8(p + 16), &ac0, &bd0);
+	v_deinterleave2_u8(v_load_u8(p + 32), v_load_u8(p + 48), &ac1, &bd1);
+	v_deinterleave2_u8(ac0, ac1, a, c);
+	v_deinterleave2_u8(bd0, bd1, b, d);
+}
+
+static inline void v_store_interleave2_u8(uint8_t *p, v_u8 a, v_u8 b)
+{
+	v_store_u8(p, _mm_unpacklo_epi8(a, b));
+	v_store_u8(p + 16, _mm_unpackhi_epi8(a, b));
+}
+
+static inline void v_store_interleave3_u8(uint8_t *p, v_u8 a, v_u8 b, v_u8 c)
+{
+	uint8_t t[3][16];
+
+	v_store_u8(t[0], a);
+	v_store_u8(t[1], b);
+	v_store_u8(t[2], c);
+
+	for (int i=0; i<16; i++) {
+		p[3*i] = t[0][i];
+		p[3*i+1] = t[1][i];
+		p[3*i+2] = t[2][i];
+	}
+}
+
+static inline void v_store_interleave4_u8(uint8_t *p, v_u8 a, v_u8 b, v_u8 c,
+										v_u8 d)
+{
+	__m128i ac_lo = _mm_unpacklo_epi8(a, c), ac_hi = _mm_unpackhi_epi8(a, c);
+	__m128i bd_lo = _mm_unpacklo_epi8(b, d), bd_hi = _mm_unpackhi_epi8(b, d);
+
+	v_store_u8(p, _mm_unpacklo_epi8(ac_lo, bd_lo));
+	v_store_u8(p + 16, _mm_unpackhi_epi8(ac_lo, bd_lo));
+	v_store_u8(p + 32, _mm_unpacklo_epi8(ac_hi, bd_hi));
+	v_store_u8(p + 48, _mm_unpackhi_epi8(ac_hi, bd_hi));
+}
+
+static inline v_u8 v_avg_u8(v_u8 a, v_u8 b) { return _mm_avg_epu8(a, b); }
+
+static inline v_u16 v_pairsum_u8(v_u8 a)
+{
+	return _mm_add_epi16(_mm_and_si128(a, _mm_set1_epi16(0x00ff)),
+						_mm_srli_epi16(a, 8));
+}
+
+static inline v_s16 v_expand_lo_u8(v_u8 a) { return _mm_unpacklo_epi8(a, _mm_setzero_si128()); }
+static inline v_s16 v_expand_hi_u8(v_u8 a) { return _mm_unpackhi_epi8(a, _mm_setzero_si128()); }
+
+static inline v_s16 v_load_expand_u8(const uint8_t *p)
+{
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p),
+							_mm_setzero_si128());
+}
+
+static inline v_s16 v_setall_s16(int16_t x) { return _mm_set1_epi16(x); }
+static inline v_s16 v_add_s16(v_s16 a, v_s16 b) { return _mm_add_epi16(a, b); }
+static inline v_s16 v_sub_s16(v_s16 a, v_s16 b) { return _mm_sub_epi16(a, b); }
+static inline v_s16 v_adds_s16(v_s16 a, v_s16 b) { return _mm_adds_epi16(a, b); }
+static inline v_s16 v_mul_s16(v_s16 a, v_s16 b) { return _mm_mullo_epi16(a, b); }
+static inline v_s16 v_mulhi_s16(v_s16 a, v_s16 b) { return _mm_mulhi_epi16(a, b); }
+#define v_shr_s16(a, n)	_mm_srai_epi16(a, n)
+#define v_shl_s16(a, n)	_mm_slli_epi16(a, n)
+#define v_slide_s16(a, n)	_mm_slli_si128(a, 2 * (n))
+
+static inline v_u16 v_setall_u16(uint16_t x) { return _mm_set1_epi16((short)x); }
+static inline v_u16 v_add_u16(v_u16 a, v_u16 b) { return _mm_add_epi16(a, b); }
+static inline v_u16 v_mul_u16(v_u16 a, v_u16 b) { return _mm_mullo_epi16(a, b); }
+#define v_shr_u16(a, n)	_mm_srli_epi16(a, n)
+
+static inline v_u16 v_reinterpret_u16_s16(v_s16 a) { return a; }
+static inline v_s16 v_reinterpret_s16_u16(v_u16 a) { return a; }
+
+static inline v_s16 v_dup_lo_s16(v_s16 a) { return _mm_unpacklo_epi16(a, a); }
+static inline v_s16 v_dup_hi_s16(v_s16 a) { return _mm_unpackhi_epi16(a, a); }
+
+static inline v_u8 v_packus_s16(v_s16 a, v_s16 b) { return _mm_packus_epi16(a, b); }
+
+static inline v_u8 v_pack_u16(v_u16 a, v_u16 b)
+{
+	const __m128i max = _mm_set1_epi16(0xff);
+
+	/* min(x, 255) without SSE4.1: x - sat(x - 255) */
+	a = _mm_sub_epi16(a, _mm_subs_epu16(a, max));
+	b = _mm_sub_epi16(b, _mm_subs_epu16(b, max));
+	return _mm_packus_epi16(a, b);
+}
+
+static inline v_u8 v_min_u8(v_u8 a, v_u8 b) { return _mm_min_epu8(a, b); }
+static inline v_u8 v_max_u8(v_u8 a, v_u8 b) { return _mm_max_epu8(a, b); }
+static inline v_u8 v_adds_u8(v_u8 a, v_u8 b) { return _mm_adds_epu8(a, b); }
+static inline v_u8 v_subs_u8(v_u8 a, v_u8 b) { return _mm_subs_epu8(a, b); }
+
+static inline void v_zip_u8(v_u8 a, v_u8 b, v_u8 *lo, v_u8 *hi)
+{
+	*lo = _mm_unpacklo_epi8(a, b);
+	*hi = _mm_unpackhi_epi8(a, b);
+}
+static inline v_u8 v_absdiff_u8(v_u8 a, v_u8 b)
+{
+	return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+static inline v_u8 v_sub_u8(v_u8 a, v_u8 b) { return _mm_sub_epi8(a, b); }
+static inline v_u8 v_and_u8(v_u8 a, v_u8 b) { return _mm_and_si128(a, b); }
+static inline v_u8 v_or_u8(v_u8 a, v_u8 b) { return _mm_or_si128(a, b); }
+
+static inline v_u8 v_cmpgt_u8(v_u8 a, v_u8 b)
+{
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+
+	return _mm_cmpgt_epi8(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+}
+
+static inline int v_any_u8(v_u8 a)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128())) != 0xffff;
+}
+
+static inline v_u16 v_load_u16(const uint16_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline void v_store_u16(uint16_t *p, v_u16 a) { _mm_storeu_si128((__m128i *)p, a); }
+static inline v_s16 v_load_s16(const int16_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline void v_store_s16(int16_t *p, v_s16 a) { _mm_storeu_si128((__m128i *)p, a); }
+static inline v_u16 v_sub_u16(v_u16 a, v_u16 b) { return _mm_sub_epi16(a, b); }
+static inline v_s16 v_abs_s16(v_s16 a)
+{
+	return _mm_max_epi16(a, _mm_sub_epi16(_mm_setzero_si128(), a));
+}
+static inline v_s16 v_min_s16(v_s16 a, v_s16 b) { return _mm_min_epi16(a, b); }
+static inline v_s16 v_max_s16(v_s16 a, v_s16 b) { return _mm_max_epi16(a, b); }
+
+static inline v_s32 v_load_s32(const int32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline void v_store_s32(int32_t *p, v_s32 a) { _mm_storeu_si128((__m128i *)p, a); }
+static inline v_s32 v_setall_s32(int32_t x) { return _mm_set1_epi32(x); }
+static inline v_s32 v_add_s32(v_s32 a, v_s32 b) { return _mm_add_epi32(a, b); }
+static inline v_s32 v_sub_s32(v_s32 a, v_s32 b) { return _mm_sub_epi32(a, b); }
+static inline v_s32 v_expand_lo_s16(v_s16 a) { return _mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16); }
+static inline v_s32 v_expand_hi_s16(v_s16 a) { return _mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16); }
+static inline v_s32 v_madd_s16(v_s32 acc, v_s16 a, v_s16 b) { return _mm_add_epi32(acc, _mm_madd_epi16(a, b)); }
+
+static inline int32_t v_reduce_add_s32(v_s32 a)
+{
+	a = _mm_add_epi32(a, _mm_srli_si128(a, 8));
+	a = _mm_add_epi32(a, _mm_srli_si128(a, 4));
+	return _mm_cvtsi128_si32(a);
+}
+
+static inline v_u16 v_min_u16(v_u16 a, v_u16 b) { return _mm_sub_epi16(a, _mm_subs_epu16(a, b)); }
+static inline v_u16 v_adds_u16(v_u16 a, v_u16 b) { return _mm_adds_epu16(a, b); }
+static inline v_u16 v_subs_u16(v_u16 a, v_u16 b) { return _mm_subs_epu16(a, b); }
+
+static inline v_u16 v_cmpgt_u16(v_u16 a, v_u16 b)
+{
+	const __m128i bias = _mm_set1_epi16((short)0x8000);
+
+	return _mm_cmpgt_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+}
+static inline v_u16 v_cmpgt_s16(v_s16 a, v_s16 b) { return _mm_cmpgt_epi16(a, b); }
+static inline v_u16 v_and_u16(v_u16 a, v_u16 b) { return _mm_and_si128(a, b); }
+static inline v_u16 v_or_u16(v_u16 a, v_u16 b) { return _mm_or_si128(a, b); }
+static inline v_u16 v_select_u16(v_u16 mask, v_u16 a, v_u16 b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline uint16_t v_reduce_min_u16(v_u16 a)
+{
+	a = v_min_u16(a, _mm_srli_si128(a, 8));
+	a = v_min_u16(a, _mm_srli_si128(a, 4));
+	a = v_min_u16(a, _mm_srli_si128(a, 2));
+	return (uint16_t)_mm_cvtsi128_si32(a);
+}
+
+static inline int v_any_u16(v_u16 a)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128())) != 0xffff;
+}
+
+#else /* VLIB_SIMD_SCALAR */
+
+typedef struct { uint8_t val[16]; } v_u8;
+typedef struct { uint16_t val[8]; } v_u16;
+typedef struct { int16_t val[8]; } v_s16;
+typedef struct { int32_t val[4]; } v_s32;
+
+static inline v_u8 v_load_u8(const uint8_t *p) { v_u8 r; memcpy(r.val, p, 16); return r; }
+static inline void v_store_u8(uint8_t *p, v_u8 a) { memcpy(p, a.val, 16); }
+static inline v_u8 v_setall_u8(uint8_t x) { v_u8 r; memset(r.val, x, 16); return r; }
+static inline void v_store_lo_u8(uint8_t *p, v_u8 a) { memcpy(p, a.val, 8); }
+static inline void v_store_hi_u8(uint8_t *p, v_u8 a) { memcpy(p, a.val + 8, 8); }
+
+static inline void v_load_deinterleave2_u8(const uint8_t *p, v_u8 *a, v_u8 *b)
+{
+	for (int i=0; i<16; i++) {
+		a->val[i] = p[2*i];
+		b->val[i] = p[2*i+1];
+	}
+}
+
+static inline void v_load_deinterleave3_u8(const uint8_t *p, v_u8 *a, v_u8 *b,
+										v_u8 *c)
+{
+	for (int i=0; i<16; i++) {
+		a->val[i] = p[3*i];
+		b->val[i] = p[3*i+1];
+		c->val[i] = p[3*i+2];
+	}
+}
+
+static inline void v_load_deinterleave4_u8(const uint8_t *p, v_u8 *a, v_u8 *b,
+										v_u8 *c, v_u8 *d)
+{
+	for (int i=0; i<16; i++) {
+		a->val[i] = p[4*i];
+		b->val[i] = p[4*i+1];
+		c->val[i] = p[4*i+2];
+		d->val[i] = p[4*i+3];
+	}
+}
+
+static inline void v_store_interleave2_u8(uint8_t *p, v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++) {
+		p[2*i] = a.val[i];
+		p[2*i+1] = b.val[i];
+	}
+}
+
+static inline void v_store_interleave3_u8(uint8_t *p, v_u8 a, v_u8 b, v_u8 c)
+{
+	for (int i=0; i<16; i++) {
+		p[3*i] = a.val[i];
+		p[3*i+1] = b.val[i];
+		p[3*i+2] = c.val[i];
+	}
+}
+
+static inline void v_store_interleave4_u8(uint8_t *p, v_u8 a, v_u8 b, v_u8 c,
+										v_u8 d)
+{
+	for (int i=0; i<16; i++) {
+		p[4*i] = a.val[i];
+		p[4*i+1] = b.val[i];
+		p[4*i+2] = c.val[i];
+		p[4*i+3] = d.val[i];
+	}
+}
+
+static inline v_u8 v_avg_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] = (a.val[i] + b.val[i] + 1) >> 1;
+	return a;
+}
+
+static inline v_u16 v_pairsum_u8(v_u8 a)
+{
+	v_u16 r;
+	for (int i=0; i<8; i++)
+		r.val[i] = a.val[2*i] + a.val[2*i+1];
+	return r;
+}
+
+static inline v_s16 v_expand_lo_u8(v_u8 a)
+{
+	v_s16 r;
+	for (int i=0; i<8; i++)
+		r.val[i] = a.val[i];
+	return r;
+}
+
+static inline v_s16 v_expand_hi_u8(v_u8 a)
+{
+	v_s16 r;
+	for (int i=0; i<8; i++)
+		r.val[i] = a.val[i+8];
+	return r;
+}
+
+static inline v_s16 v_load_expand_u8(const uint8_t *p)
+{
+	v_s16 r;
+	for (int i=0; i<8; i++)
+		r.val[i] = p[i];
+	return r;
+}
+
+static inline int16_t v_sat_s16(int32_t x)
+{
+	return x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : x;
+}
+
+static inline v_s16 v_setall_s16(int16_t x)
+{
+	v_s16 r;
+	for (int i=0; i<8; i++)
+		r.val[i] = x;
+	return r;
+}
+
+static inline v_s16 v_add_s16(v_s16 a, v_s16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (int16_t)(a.val[i] + b.val[i]);
+	return a;
+}
+
+static inline v_s16 v_sub_s16(v_s16 a, v_s16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (int16_t)(a.val[i] - b.val[i]);
+	return a;
+}
+
+static inline v_s16 v_adds_s16(v_s16 a, v_s16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = v_sat_s16(a.val[i] + b.val[i]);
+	return a;
+}
+
+static inline v_s16 v_mul_s16(v_s16 a, v_s16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (int16_t)(a.val[i] * b.val[i]);
+	return a;
+}
+
+static inline v_s16 v_shr_s16_(v_s16 a, int n)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] >>= n;
+	return a;
+}
+#define v_shr_s16(a, n)	v_shr_s16_(a, n)
+
+static inline v_s16 v_mulhi_s16(v_s16 a, v_s16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (int16_t)(((int32_t)a.val[i] * b.val[i]) >> 16);
+	return a;
+}
+
+static inline v_s16 v_shl_s16_(v_s16 a, int n)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (int16_t)(a.val[i] * (1 << n));
+	return a;
+}
+#define v_shl_s16(a, n)	v_shl_s16_(a, n)
+
+static inline v_s16 v_slide_s16_(v_s16 a, int n)
+{
+	v_s16 r;
+	for (int i=0; i<8; i++)
+		r.val[i] = i < n ? 0 : a.val[i-n];
+	return r;
+}
+#define v_slide_s16(a, n)	v_slide_s16_(a, n)
+
+static inline v_u16 v_setall_u16(uint16_t x)
+{
+	v_u16 r;
+	for (int i=0; i<8; i++)
+		r.val[i] = x;
+	return r;
+}
+
+static inline v_u16 v_add_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (uint16_t)(a.val[i] + b.val[i]);
+	return a;
+}
+
+static inline v_u16 v_mul_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (uint16_t)(a.val[i] * b.val[i]);
+	return a;
+}
+
+static inline v_u16 v_shr_u16_(v_u16 a, int n)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] >>= n;
+	return a;
+}
+#define v_shr_u16(a, n)	v_shr_u16_(a, n)
+
+static inline v_u16 v_reinterpret_u16_s16(v_s16 a)
+{
+	v_u16 r;
+	memcpy(r.val, a.val, 16);
+	return r;
+}
+
+static inline v_s16 v_reinterpret_s16_u16(v_u16 a)
+{
+	v_s16 r;
+	memcpy(r.val, a.val, 16);
+	return r;
+}
+
+static inline v_s16 v_dup_lo_s16(v_s16 a)
+{
+	v_s16 r;
+	for (int i=0; i<4; i++)
+		r.val[2*i] = r.val[2*i+1] = a.val[i];
+	return r;
+}
+
+static inline v_s16 v_dup_hi_s16(v_s16 a)
+{
+	v_s16 r;
+	for (int i=0; i<4; i++)
+		r.val[2*i] = r.val[2*i+1] = a.val[i+4];
+	return r;
+}
+
+static inline v_u8 v_packus_s16(v_s16 a, v_s16 b)
+{
+	v_u8 r;
+	for (int i=0; i<8; i++) {
+		r.val[i] = a.val[i] < 0 ? 0 : a.val[i] > 255 ? 255 : a.val[i];
+		r.val[i+8] = b.val[i] < 0 ? 0 : b.val[i] > 255 ? 255 : b.val[i];
+	}
+	return r;
+}
+
+static inline v_u8 v_pack_u16(v_u16 a, v_u16 b)
+{
+	v_u8 r;
+	for (int i=0; i<8; i++) {
+		r.val[i] = a.val[i] > 255 ? 255 : a.val[i];
+		r.val[i+8] = b.val[i] > 255 ? 255 : b.val[i];
+	}
+	return r;
+}
+
+static inline v_u8 v_min_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] = a.val[i] < b.val[i] ? a.val[i] : b.val[i];
+	return a;
+}
+
+static inline v_u8 v_max_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] = a.val[i] > b.val[i] ? a.val[i] : b.val[i];
+	return a;
+}
+
+static inline v_u8 v_adds_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] = a.val[i] + b.val[i] > 255 ? 255 : a.val[i] + b.val[i];
+	return a;
+}
+
+static inline v_u8 v_subs_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] = a.val[i] > b.val[i] ? a.val[i] - b.val[i] : 0;
+	return a;
+}
+
+static inline void v_zip_u8(v_u8 a, v_u8 b, v_u8 *lo, v_u8 *hi)
+{
+	for (int i=0; i<8; i++) {
+		lo->val[2*i] = a.val[i];
+		lo->val[2*i+1] = b.val[i];
+		hi->val[2*i] = a.val[i+8];
+		hi->val[2*i+1] = b.val[i+8];
+	}
+}
+
+static inline v_u8 v_absdiff_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] = a.val[i] > b.val[i] ? a.val[i] - b.val[i] : b.val[i] - a.val[i];
+	return a;
+}
+
+static inline v_u8 v_sub_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] = (uint8_t)(a.val[i] - b.val[i]);
+	return a;
+}
+
+static inline v_u8 v_and_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] &= b.val[i];
+	return a;
+}
+
+static inline v_u8 v_or_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] |= b.val[i];
+	return a;
+}
+
+static inline v_u8 v_cmpgt_u8(v_u8 a, v_u8 b)
+{
+	for (int i=0; i<16; i++)
+		a.val[i] = a.val[i] > b.val[i] ? 0xff : 0;
+	return a;
+}
+
+static inline int v_any_u8(v_u8 a)
+{
+	for (int i=0; i<16; i++)
+		if (a.val[i])
+			return 1;
+	return 0;
+}
+
+static inline v_u16 v_load_u16(const uint16_t *p) { v_u16 r; memcpy(r.val, p, 16); return r; }
+static inline void v_store_u16(uint16_t *p, v_u16 a) { memcpy(p, a.val, 16); }
+static inline v_s16 v_load_s16(const int16_t *p) { v_s16 r; memcpy(r.val, p, 16); return r; }
+static inline void v_store_s16(int16_t *p, v_s16 a) { memcpy(p, a.val, 16); }
+
+static inline v_u16 v_sub_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (uint16_t)(a.val[i] - b.val[i]);
+	return a;
+}
+
+static inline v_s16 v_abs_s16(v_s16 a)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (int16_t)(a.val[i] < 0 ? -a.val[i] : a.val[i]);
+	return a;
+}
+
+static inline v_s16 v_min_s16(v_s16 a, v_s16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = a.val[i] < b.val[i] ? a.val[i] : b.val[i];
+	return a;
+}
+
+static inline v_s16 v_max_s16(v_s16 a, v_s16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = a.val[i] > b.val[i] ? a.val[i] : b.val[i];
+	return a;
+}
+
+static inline v_s32 v_load_s32(const int32_t *p) { v_s32 r; memcpy(r.val, p, 16); return r; }
+static inline void v_store_s32(int32_t *p, v_s32 a) { memcpy(p, a.val, 16); }
+
+static inline v_s32 v_setall_s32(int32_t x)
+{
+	v_s32 r;
+	for (int i=0; i<4; i++)
+		r.val[i] = x;
+	return r;
+}
+
+static inline v_s32 v_add_s32(v_s32 a, v_s32 b)
+{
+	for (int i=0; i<4; i++)
+		a.val[i] = (int32_t)((uint32_t)a.val[i] + (uint32_t)b.val[i]);
+	return a;
+}
+
+static inline v_s32 v_sub_s32(v_s32 a, v_s32 b)
+{
+	for (int i=0; i<4; i++)
+		a.val[i] = (int32_t)((uint32_t)a.val[i] - (uint32_t)b.val[i]);
+	return a;
+}
+
+static inline v_s32 v_expand_lo_s16(v_s16 a)
+{
+	v_s32 r;
+	for (int i=0; i<4; i++)
+		r.val[i] = a.val[i];
+	return r;
+}
+
+static inline v_s32 v_expand_hi_s16(v_s16 a)
+{
+	v_s32 r;
+	for (int i=0; i<4; i++)
+		r.val[i] = a.val[i + 4];
+	return r;
+}
+
+static inline v_s32 v_madd_s16(v_s32 acc, v_s16 a, v_s16 b)
+{
+	for (int i=0; i<4; i++)
+		acc.val[i] = (int32_t)((uint32_t)acc.val[i] +
+					(uint32_t)(a.val[2 * i] * b.val[2 * i] +
+								a.val[2 * i + 1] * b.val[2 * i + 1]));
+	return acc;
+}
+
+static inline int32_t v_reduce_add_s32(v_s32 a)
+{
+	return (int32_t)((uint32_t)a.val[0] + (uint32_t)a.val[1] +
+					(uint32_t)a.val[2] + (uint32_t)a.val[3]);
+}
+
+static inline v_u16 v_min_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = a.val[i] < b.val[i] ? a.val[i] : b.val[i];
+	return a;
+}
+
+static inline v_u16 v_adds_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++) {
+		int x = a.val[i] + b.val[i];
+		a.val[i] = x > 65535 ? 65535 : x;
+	}
+	return a;
+}
+
+static inline v_u16 v_subs_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = a.val[i] > b.val[i] ? a.val[i] - b.val[i] : 0;
+	return a;
+}
+
+static inline v_u16 v_cmpgt_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = a.val[i] > b.val[i] ? 0xffff : 0;
+	return a;
+}
+
+static inline v_u16 v_cmpgt_s16(v_s16 a, v_s16 b)
+{
+	v_u16 r;
+	for (int i=0; i<8; i++)
+		r.val[i] = a.val[i] > b.val[i] ? 0xffff : 0;
+	return r;
+}
+
+static inline v_u16 v_and_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] &= b.val[i];
+	return a;
+}
+
+static inline v_u16 v_or_u16(v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] |= b.val[i];
+	return a;
+}
+
+static inline v_u16 v_select_u16(v_u16 mask, v_u16 a, v_u16 b)
+{
+	for (int i=0; i<8; i++)
+		a.val[i] = (a.val[i] & mask.val[i]) | (b.val[i] & ~mask.val[i]);
+	return a;
+}
+
+static inline uint16_t v_reduce_min_u16(v_u16 a)
+{
+	uint16_t m = a.val[0];
+	for (int i=1; i<8; i++)
+		m = a.val[i] < m ? a.val[i] : m;
+	return m;
+}
+
+static inline int v_any_u16(v_u16 a)
+{
+	for (int i=0; i<8; i++)
+		if (a.val[i])
+			return 1;
+	return 0;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIMD_H */
@@ -0,0 +1,69 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+struct filter_s;
+
+/* Maximum number of stages in a stencil chain */
+#define VLIB_STENCIL_MAX_STAGES	8
+
+/*
+ * Line buffer kernels, the CPU counterparts of xf::GaussianBlur, xf::Sobel,
+ * xf::erode, xf::dilate and xf::medianBlur on 8-bit luma. Borders are
+ * replicated.
+ */
+enum vlib_stencil_op {
+	VLIB_STENCIL_GAUSSIAN,		/* binomial, ksize 3 or 5 */
+	VLIB_STENCIL_SOBEL,			/* |dx| + |dy| saturated, ksize 3 */
+	VLIB_STENCIL_ERODE,			/* rectangular, ksize 3 or 5 */
+	VLIB_STENCIL_DILATE,		/* rectangular, ksize 3 or 5 */
+	VLIB_STENCIL_MEDIAN,		/* ksize 3 */
+};
+
+struct vlib_stencil_stage {
+	enum vlib_stencil_op op;
+	unsigned int ksize;
+};
+
+struct vlib_stencil_chain;
+
+/*
+ * A stencil chain processes a frame in row strips across all stages. Each
+ * stage keeps only a ring of the lines its successor still needs, sized so
+ * that all rings of a strip fit into L2. A strip height equal to the frame
+ * height gives conventional stage by stage execution with full size
+ * intermediate frames.
+ *
+ * Luma is filtered for GREY, NV12, NV21, YU12, YV12, YUYV and UYVY frames,
+ * chroma is passed through unchanged.
+ */
+struct vlib_stencil_chain *vlib_stencil_chain_create(
+				const struct vlib_stencil_stage *stages, size_t num_stages,
+				size_t width, size_t height, size_t strip_lines);
+void vlib_stencil_chain_destroy(struct vlib_stencil_chain *sc);
+size_t vlib_stencil_chain_get_strip_lines(const struct vlib_stencil_chain *sc);
+size_t vlib_stencil_chain_get_halo(const struct vlib_stencil_chain *sc);
+int vlib_stencil_chain_run(struct vlib_stencil_chain *sc,
+				const struct vlib_image *src, struct vlib_image *dst);
+int vlib_stencil_chain_run_lines(struct vlib_stencil_chain *sc,
+				const struct vlib_image *src, struct vlib_image *dst,
+				size_t line_start, size_t line_end);
+
+/* Pipeline stage running a stencil chain with modes "Fused" and "Frame" */
+struct filter_s *vlib_stencil_filter_create(const char *display_text,
+				const struct vlib_stencil_stage *stages, size_t num_stages);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STENCIL_H */
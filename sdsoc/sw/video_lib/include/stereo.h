@@ -0,0 +1,70 @@
+#ifndef STEREO_H
+#define STEREO_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+#include "stereo_bm.h"
+
+struct filter_s;
+
+/* Sizes of the calibration arrays, as in the xfopencv stereo pipeline */
+#define VLIB_STEREO_CAMERA_MATRIX_SIZE	9
+#define VLIB_STEREO_DIST_COEFF_SIZE		5
+
+/*
+ * Calibration of a stereo camera. For each camera: the 3x3 camera matrix,
+ * the distortion coefficients k1, k2, p1, p2, k3 and the inverse of the
+ * rectified camera matrix times the rectification rotation, which maps
+ * rectified pixels back to camera rays (the 'ir' argument of
+ * xf::InitUndistortRectifyMapInverse).
+ */
+struct vlib_stereo_cam_params {
+	double camera_matrix[2][VLIB_STEREO_CAMERA_MATRIX_SIZE];
+	double dist_coeffs[2][VLIB_STEREO_DIST_COEFF_SIZE];
+	double ir[2][VLIB_STEREO_CAMERA_MATRIX_SIZE];
+};
+
+/* time spent in the stages of the last frame */
+struct vlib_stereo_stats {
+	float rectify_ms;			/* luma extraction and undistortion */
+	float prefilter_ms;
+	float match_ms;
+	float postfilter_ms;		/* colorization and output conversion */
+	size_t frames;
+};
+
+/*
+ * Read a camera parameter file: whitespace separated numbers in the order
+ * of the xfopencv stereo test bench, i.e. left and right camera matrix,
+ * left and right distortion coefficients, left and right ir matrix. Text
+ * from '#' to the end of a line is ignored.
+ */
+int vlib_stereo_load_cam_params(const char *file,
+				struct vlib_stereo_cam_params *params);
+
+/*
+ * Depth pipeline stage for side-by-side stereo cameras, the left view in
+ * the left half of the input frame. Both views are rectified with maps
+ * that are computed once per resolution, matched with vlib_stereo_bm and
+ * the disparity is shown with a color map. The output has the height of
+ * the input and either the width of one view (disparity only) or of the
+ * whole input (rectified left view next to the disparity).
+ *
+ * Without a camera parameter file the input is assumed to be rectified.
+ */
+struct filter_s *vlib_stereo_create(const char *cam_params_file);
+int vlib_stereo_set_bm_params(struct filter_s *fs,
+				const struct vlib_stereo_bm_params *params);
+int vlib_stereo_get_stats(const struct filter_s *fs,
+				struct vlib_stereo_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STEREO_H */
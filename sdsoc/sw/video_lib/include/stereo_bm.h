@@ -0,0 +1,60 @@
+#ifndef STEREO_BM_H
+#define STEREO_BM_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Block matching parameters, named and defaulted as in xf::xFSBMState. The
+ * prefilter is always the clipped x-Sobel of XF_STEREO_PREFILTER_SOBEL_TYPE.
+ */
+struct vlib_stereo_bm_params {
+	int pre_filter_cap;			/* prefilter output clipped to [-cap, cap], 1..63 */
+	int sad_window_size;		/* odd, 5..21 */
+	int min_disparity;
+	int num_disparities;		/* multiple of 16 */
+	int texture_threshold;		/* minimum sum of |prefiltered - cap| in the window */
+	int uniqueness_ratio;		/* percent the best SAD has to beat all others by */
+};
+
+/* time spent in the stages of the last vlib_stereo_bm_compute() call */
+struct vlib_stereo_bm_stats {
+	float prefilter_ms;
+	float match_ms;
+};
+
+struct vlib_stereo_bm;
+
+/*
+ * CPU counterpart of xf::StereoBM. Column SADs are updated incrementally
+ * from row to row and box summed along the row, so the cost per pixel does
+ * not depend on the window size. All disparities of a pixel are processed
+ * in vectors and row bands run on all cores.
+ *
+ * Disparities are written in Q4 fixed point with subpixel interpolation,
+ * rejected pixels and the borders are set to (min_disparity - 1) * 16.
+ */
+void vlib_stereo_bm_default_params(struct vlib_stereo_bm_params *params);
+struct vlib_stereo_bm *vlib_stereo_bm_create(
+				const struct vlib_stereo_bm_params *params,
+				size_t width, size_t height);
+void vlib_stereo_bm_destroy(struct vlib_stereo_bm *bm);
+int vlib_stereo_bm_set_params(struct vlib_stereo_bm *bm,
+				const struct vlib_stereo_bm_params *params);
+int vlib_stereo_bm_compute(struct vlib_stereo_bm *bm,
+				const uint8_t *left, size_t stride_left,
+				const uint8_t *right, size_t stride_right,
+				int16_t *disp, size_t stride_disp);
+void vlib_stereo_bm_get_stats(const struct vlib_stereo_bm *bm,
+				struct vlib_stereo_bm_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STEREO_BM_H */
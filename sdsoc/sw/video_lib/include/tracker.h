@@ -0,0 +1,98 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct filter_s;
+
+/* Maximum number of pyramid levels */
+#define VLIB_TRACKER_MAX_LEVELS		6
+
+enum vlib_tracker_detector {
+	VLIB_TRACKER_FAST,			/* xf::fast, vlib_fast_detect_grid() */
+	VLIB_TRACKER_HARRIS,		/* xf::cornerHarris, vlib_harris_detect() */
+};
+
+struct vlib_tracker_params {
+	int max_corners;			/* capacity of the point list */
+	int detect_interval;		/* frames from one detection to the next, >= 1 */
+	enum vlib_tracker_detector detector;
+	int fast_threshold;			/* FAST intensity threshold, 1..254 */
+	int harris_threshold;		/* Harris response threshold, >= 0 */
+	int min_distance;			/* minimum distance of new corners to all points */
+	int levels;					/* pyramid levels, 1..VLIB_TRACKER_MAX_LEVELS */
+	int window_size;			/* odd, 5..31 */
+	int iterations;				/* maximum Lucas-Kanade iterations per level */
+};
+
+/* time spent in the stages of the last vlib_tracker_process() call */
+struct vlib_tracker_stats {
+	float pyramid_ms;
+	float track_ms;
+	float detect_ms;			/* zero for frames without detection */
+	size_t tracked;				/* points followed from the previous frame */
+	size_t lost;
+	size_t detected;			/* new points */
+};
+
+/*
+ * Tracked points, one array per field. Entries are valid until the next
+ * vlib_tracker_process() call. prev_x and prev_y hold the position in the
+ * previous frame, or the position itself for points detected in this
+ * frame. age counts the frames a point has been tracked for.
+ */
+struct vlib_tracker_points {
+	size_t count;
+	const float *x;
+	const float *y;
+	const float *prev_x;
+	const float *prev_y;
+	const uint32_t *id;
+	const uint32_t *age;
+};
+
+struct vlib_tracker;
+
+/*
+ * Sparse feature tracker, xf::fast or xf::cornerHarris corners followed by
+ * pyramidal Lucas-Kanade at the corners only, in the spirit of the
+ * cornersImgToList/cornerUpdate pipeline. Every detect_interval frames the
+ * point list is topped up with the strongest corners of the detector that
+ * are at least min_distance away from the points already tracked. Candidates are
+ * taken from a grid of cells so that they cover the whole frame. In
+ * between, only the pyramid of the new frame is built and the points are
+ * tracked on all cores. Points whose window leaves the image or loses its
+ * texture are dropped.
+ */
+void vlib_tracker_default_params(struct vlib_tracker_params *params);
+struct vlib_tracker *vlib_tracker_create(
+				const struct vlib_tracker_params *params,
+				size_t width, size_t height);
+void vlib_tracker_destroy(struct vlib_tracker *tr);
+void vlib_tracker_reset(struct vlib_tracker *tr);
+int vlib_tracker_process(struct vlib_tracker *tr,
+				const uint8_t *frame, size_t stride);
+void vlib_tracker_get_points(const struct vlib_tracker *tr,
+				struct vlib_tracker_points *points);
+void vlib_tracker_get_stats(const struct vlib_tracker *tr,
+				struct vlib_tracker_stats *stats);
+
+/*
+ * Sparse tracking pipeline stage. Shows the frame in gray with the motion
+ * of every tracked point since the previous frame, new points in red and
+ * tracked ones in green. The modes select the detector, the points start
+ * over when the mode changes.
+ */
+struct filter_s *vlib_tracker_filter_create(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACKER_H */
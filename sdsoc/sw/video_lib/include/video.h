@@ -76,6 +76,7 @@ struct vlib_config_data {
 	size_t vrefresh;					/* vertical refresh rate */
 	const char *drm_background;			/* path to background image */
 	size_t buffer_cnt;					/* number of frame buffers */
+	struct vlib_crop crop;				/* capture region to display */
 };
 
 #define VLIB_CFG_FLAG_PR_ENABLE				BIT(0) /* enable partial reconfiguration */
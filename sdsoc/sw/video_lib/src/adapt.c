@@ -0,0 +1,383 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+#include "adapt.h"
+#include "filter.h"
+#include "helper.h"
+#include "video_int.h"
+
+/* frames alternating HW/SW after a reset, the first pair is discarded */
+#define ADAPT_WARMUP_FRAMES		6
+#define ADAPT_WARMUP_DISCARD	2
+/* frames between two profiling rounds */
+#define ADAPT_PROFILE_PERIOD	300
+/* split only if predicted to beat the faster implementation by 10% */
+#define ADAPT_SPLIT_GAIN		0.9f
+/* split frames before the measured split time is trusted */
+#define ADAPT_SPLIT_TRIAL		4
+/* minimum lines per band */
+#define ADAPT_BAND_MIN			16
+
+struct vlib_adapt {
+	const struct filter_s *fs;
+	struct vlib_adapt_ops ops;
+	size_t overlap;
+	/* protects st against vlib_adapt_get_status() */
+	pthread_mutex_t lock;
+	struct vlib_adapt_status st;
+	unsigned int frame;			/* frames since reset */
+	unsigned int next_profile;	/* first frame of the next profiling round */
+	unsigned int split_frames;	/* frames run split since the last decision */
+	float hw_line_ms;			/* per line cost of the bands */
+	float sw_line_ms;
+};
+
+struct adapt_band {
+	struct vlib_adapt *ad;
+	void *arg;
+	int lines;
+	float ms;
+};
+
+static GSList *adapt_list;
+static pthread_mutex_t adapt_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *adapt_impl_names[] = {
+	[VLIB_ADAPT_IMPL_HW] = "HW",
+	[VLIB_ADAPT_IMPL_SW] = "SW",
+	[VLIB_ADAPT_IMPL_SPLIT] = "HW+SW",
+};
+
+const char *vlib_adapt_impl_name(enum vlib_adapt_impl impl)
+{
+	if ((size_t)impl >= ARRAY_SIZE(adapt_impl_names)) {
+		return NULL;
+	}
+
+	return adapt_impl_names[impl];
+}
+
+static float adapt_ema(float avg, float val, float alpha)
+{
+	return avg > 0 ? avg + alpha * (val - avg) : val;
+}
+
+/* accelerator lines balancing both bands for the given per line cost */
+static size_t adapt_balance(const struct vlib_adapt *ad, float hw_line_ms,
+							float sw_line_ms)
+{
+	size_t height = ad->st.height;
+	size_t max = height - ad->overlap - ADAPT_BAND_MIN;
+	size_t lines;
+
+	lines = (size_t)(height * sw_line_ms / (hw_line_ms + sw_line_ms));
+	/* even, so that 4:2:0 chroma lines are not shared */
+	lines &= ~(size_t)1;
+	if (lines < ADAPT_BAND_MIN) {
+		lines = ADAPT_BAND_MIN;
+	}
+	if (lines > max) {
+		lines = max & ~(size_t)1;
+	}
+
+	return lines;
+}
+
+static void adapt_decide(struct vlib_adapt *ad)
+{
+	struct vlib_adapt_status *st = &ad->st;
+	enum vlib_adapt_impl best;
+	float best_ms, split_ms;
+
+	best = st->hw_ms <= st->sw_ms ? VLIB_ADAPT_IMPL_HW : VLIB_ADAPT_IMPL_SW;
+	best_ms = best == VLIB_ADAPT_IMPL_HW ? st->hw_ms : st->sw_ms;
+
+	/* both bands finish together if split by the inverse frame times */
+	split_ms = st->hw_ms * st->sw_ms / (st->hw_ms + st->sw_ms);
+
+	st->impl = best;
+	st->hw_lines = best == VLIB_ADAPT_IMPL_HW ? st->height : 0;
+	if (st->height >= 2 * ADAPT_BAND_MIN + ad->overlap + 2 &&
+			split_ms < ADAPT_SPLIT_GAIN * best_ms) {
+		ad->hw_line_ms = st->hw_ms / st->height;
+		ad->sw_line_ms = st->sw_ms / st->height;
+		st->impl = VLIB_ADAPT_IMPL_SPLIT;
+		st->hw_lines = adapt_balance(ad, ad->hw_line_ms, ad->sw_line_ms);
+		st->split_ms = 0;
+		ad->split_frames = 0;
+	}
+	st->profiling = 0;
+
+	vlib_info("%s: %zux%zu %s, %zu/%zu lines on the accelerator "
+			"(HW %.2f ms, SW %.2f ms)\n",
+			filter_type_get_display_text(ad->fs), st->width, st->height,
+			vlib_adapt_impl_name(st->impl), st->hw_lines, st->height,
+			st->hw_ms, st->sw_ms);
+}
+
+static void *adapt_hw_band(void *ptr)
+{
+	struct adapt_band *band = ptr;
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	band->ad->ops.hw(band->arg, 0, band->lines);
+	band->ms = vlib_ms_since(&start);
+
+	return NULL;
+}
+
+/* Run the accelerator band in a thread while the CPU band runs here */
+static int adapt_run_split(struct vlib_adapt *ad, void *arg, float *hw_ms,
+						float *sw_ms)
+{
+	struct adapt_band band = { .ad = ad, .arg = arg };
+	struct timespec start;
+	int height = ad->st.height;
+	int lines = ad->st.hw_lines;
+	int ov = ad->overlap;
+	pthread_t thread;
+	int ret;
+
+	band.lines = lines;
+	ret = pthread_create(&thread, NULL, adapt_hw_band, &band);
+	if (ret) {
+		VLIB_REPORT_ERR("failed to create accelerator band thread: %s",
+						strerror(ret));
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_OTHER;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ad->ops.sw(arg, lines + ov, height);
+	*sw_ms = vlib_ms_since(&start);
+	pthread_join(thread, NULL);
+	/* lines clobbered by the accelerator band */
+	ad->ops.sw(arg, lines, lines + ov);
+
+	*hw_ms = band.ms;
+
+	return VLIB_SUCCESS;
+}
+
+static void adapt_update_split(struct vlib_adapt *ad, float frame_ms,
+							float hw_ms, float sw_ms)
+{
+	struct vlib_adapt_status *st = &ad->st;
+	enum vlib_adapt_impl best;
+	float best_ms;
+
+	ad->hw_line_ms = adapt_ema(ad->hw_line_ms, hw_ms / st->hw_lines, 0.25f);
+	ad->sw_line_ms = adapt_ema(ad->sw_line_ms,
+			sw_ms / (st->height - st->hw_lines - ad->overlap), 0.25f);
+	st->split_ms = adapt_ema(st->split_ms, frame_ms, 0.25f);
+	st->hw_lines = adapt_balance(ad, ad->hw_line_ms, ad->sw_line_ms);
+
+	if (++ad->split_frames < ADAPT_SPLIT_TRIAL) {
+		return;
+	}
+
+	best = st->hw_ms <= st->sw_ms ? VLIB_ADAPT_IMPL_HW : VLIB_ADAPT_IMPL_SW;
+	best_ms = best == VLIB_ADAPT_IMPL_HW ? st->hw_ms : st->sw_ms;
+	if (st->split_ms >= best_ms) {
+		/* memory bandwidth bound, bands slow each other down */
+		st->impl = best;
+		st->hw_lines = best == VLIB_ADAPT_IMPL_HW ? st->height : 0;
+		vlib_info("%s: split %.2f ms not faster, using %s\n",
+				filter_type_get_display_text(ad->fs), st->split_ms,
+				vlib_adapt_impl_name(best));
+	}
+}
+
+struct vlib_adapt *vlib_adapt_create(const struct filter_s *fs,
+				const struct vlib_adapt_ops *ops, size_t overlap)
+{
+	struct vlib_adapt *ad;
+
+	if (!ops || !ops->sw) {
+		VLIB_REPORT_ERR("adaptive filter requires a CPU implementation");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	ad = calloc(1, sizeof(*ad));
+	if (!ad) {
+		VLIB_REPORT_ERR("failed to allocate adaptive filter");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	ad->fs = fs;
+	ad->ops = *ops;
+	ad->overlap = overlap;
+	pthread_mutex_init(&ad->lock, NULL);
+	vlib_adapt_reset(ad);
+
+	pthread_mutex_lock(&adapt_list_lock);
+	adapt_list = g_slist_prepend(adapt_list, ad);
+	pthread_mutex_unlock(&adapt_list_lock);
+
+	return ad;
+}
+
+void vlib_adapt_destroy(struct vlib_adapt *ad)
+{
+	if (!ad) {
+		return;
+	}
+
+	pthread_mutex_lock(&adapt_list_lock);
+	adapt_list = g_slist_remove(adapt_list, ad);
+	pthread_mutex_unlock(&adapt_list_lock);
+
+	pthread_mutex_destroy(&ad->lock);
+	free(ad);
+}
+
+/* Discard all measurements, e.g. when the work per frame changed */
+void vlib_adapt_reset(struct vlib_adapt *ad)
+{
+	pthread_mutex_lock(&ad->lock);
+	memset(&ad->st, 0, sizeof(ad->st));
+	ad->st.impl = ad->ops.hw ? VLIB_ADAPT_IMPL_HW : VLIB_ADAPT_IMPL_SW;
+	ad->st.profiling = !!ad->ops.hw;
+	ad->frame = 0;
+	ad->next_profile = ADAPT_PROFILE_PERIOD;
+	ad->split_frames = 0;
+	ad->hw_line_ms = 0;
+	ad->sw_line_ms = 0;
+	pthread_mutex_unlock(&ad->lock);
+}
+
+/**
+ * vlib_adapt_run - process a frame on the accelerator, the CPU or both
+ * @ad: adaptive dispatcher
+ * @arg: frame description passed to the band callbacks
+ * @width: frame width, measurements are discarded when it changes
+ * @height: frame height
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_adapt_run(struct vlib_adapt *ad, void *arg, size_t width,
+				size_t height)
+{
+	struct vlib_adapt_status *st = &ad->st;
+	enum vlib_adapt_impl impl;
+	struct timespec start;
+	float ms, hw_ms = 0, sw_ms = 0;
+	int profile = 0;
+	int ret = VLIB_SUCCESS;
+
+	if (st->width != width || st->height != height) {
+		vlib_adapt_reset(ad);
+		pthread_mutex_lock(&ad->lock);
+		st->width = width;
+		st->height = height;
+		pthread_mutex_unlock(&ad->lock);
+	}
+
+	if (!ad->ops.hw) {
+		ad->ops.sw(arg, 0, height);
+		return VLIB_SUCCESS;
+	}
+
+	/* alternate implementations while profiling */
+	if (ad->frame < ADAPT_WARMUP_FRAMES) {
+		impl = ad->frame & 1 ? VLIB_ADAPT_IMPL_SW : VLIB_ADAPT_IMPL_HW;
+		profile = ad->frame >= ADAPT_WARMUP_DISCARD;
+	} else if (ad->frame - ad->next_profile < 2) {
+		impl = ad->frame - ad->next_profile ? VLIB_ADAPT_IMPL_SW :
+					VLIB_ADAPT_IMPL_HW;
+		profile = 1;
+	} else {
+		impl = st->impl;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	switch (impl) {
+		case VLIB_ADAPT_IMPL_HW:
+			ad->ops.hw(arg, 0, height);
+			break;
+		case VLIB_ADAPT_IMPL_SW:
+			ad->ops.sw(arg, 0, height);
+			break;
+		case VLIB_ADAPT_IMPL_SPLIT:
+			ret = adapt_run_split(ad, arg, &hw_ms, &sw_ms);
+			if (ret) {
+				/* fall back to the CPU for this frame */
+				ad->ops.sw(arg, 0, height);
+			}
+			break;
+	}
+	ms = vlib_ms_since(&start);
+
+	pthread_mutex_lock(&ad->lock);
+	if (profile) {
+		float *t = impl == VLIB_ADAPT_IMPL_HW ? &st->hw_ms : &st->sw_ms;
+
+		/* best of the warm-up frames, smoothed afterwards */
+		if (ad->frame < ADAPT_WARMUP_FRAMES) {
+			*t = *t > 0 && *t < ms ? *t : ms;
+		} else {
+			*t = adapt_ema(*t, ms, 0.5f);
+		}
+	} else if (impl == VLIB_ADAPT_IMPL_SPLIT && ret == VLIB_SUCCESS) {
+		adapt_update_split(ad, ms, hw_ms, sw_ms);
+	}
+
+	if (ad->frame + 1 == ADAPT_WARMUP_FRAMES ||
+			ad->frame == ad->next_profile + 1) {
+		if (ad->frame >= ad->next_profile) {
+			ad->next_profile += ADAPT_PROFILE_PERIOD;
+		}
+		adapt_decide(ad);
+	}
+	ad->frame++;
+	pthread_mutex_unlock(&ad->lock);
+
+	return ret;
+}
+
+int vlib_adapt_get_status(const struct vlib_adapt *ad,
+				struct vlib_adapt_status *status)
+{
+	if (!ad || !status) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	pthread_mutex_lock((pthread_mutex_t *)&ad->lock);
+	*status = ad->st;
+	pthread_mutex_unlock((pthread_mutex_t *)&ad->lock);
+
+	return VLIB_SUCCESS;
+}
+
+/**
+ * vlib_filter_get_adapt_status - get the implementation chosen by a filter
+ * @fs: filter running in an adaptive mode
+ * @status: returns implementation, band split and profiled frame times
+ *
+ * Return: VLIB_SUCCESS on success, VLIB_ERROR_INVALID_PARAM if @fs has no
+ * adaptive dispatcher.
+ */
+int vlib_filter_get_adapt_status(const struct filter_s *fs,
+				struct vlib_adapt_status *status)
+{
+	int ret = VLIB_ERROR_INVALID_PARAM;
+
+	pthread_mutex_lock(&adapt_list_lock);
+	for (GSList *e = adapt_list; e; e = g_slist_next(e)) {
+		struct vlib_adapt *ad = e->data;
+
+		if (ad->fs == fs) {
+			ret = vlib_adapt_get_status(ad, status);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&adapt_list_lock);
+
+	return ret;
+}
@@ -0,0 +1,480 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analytics.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* rows per band slot */
+#define ANALYTICS_GRAIN		32
+
+/* pixels summed up in 32-bit lanes before they are added to 64 bits */
+#define ANALYTICS_BLOCK		2048
+
+/* copies of each band histogram, consecutive pixels count into different ones */
+#define ANALYTICS_BANKS		4
+
+struct analytics_cell_acc {
+	uint64_t sum;
+	int min;
+	int max;
+};
+
+/* results of a band slot, merged into slot 0 */
+struct analytics_acc {
+	int used;
+	uint64_t sum;
+	uint64_t sum_sq;
+	int min;
+	int max;
+	size_t min_x, min_y;
+	size_t max_x, max_y;
+	uint32_t *hist;
+	struct analytics_cell_acc *cells;
+};
+
+/* results of a row segment */
+struct analytics_seg {
+	uint64_t sum;
+	uint64_t sum_sq;
+	int min;
+	int max;
+};
+
+struct vlib_analytics {
+	size_t width;
+	size_t height;
+	size_t pitch;
+	unsigned int flags;
+	size_t grid_cols;
+	size_t grid_rows;
+	size_t *cell_x;				/* first column of each cell, and width */
+	size_t slots;
+	struct analytics_acc *acc;
+	uint32_t *hist;				/* histograms of the slots */
+	struct analytics_cell_acc *cells;	/* grids of the slots */
+	struct vlib_analytics_stats stats;
+	struct vlib_analytics_cell *grid;
+};
+
+struct analytics_job {
+	const struct vlib_analytics *an;
+	const uint8_t *src;
+	size_t stride;
+	size_t step;				/* tree level, distance of merged slots */
+};
+
+/**
+ * vlib_analytics_create - Set up frame statistics
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ * @pitch: Bytes between two pixels
+ * @flags: VLIB_ANALYTICS_* statistics to gather
+ * @grid_cols: Grid columns with VLIB_ANALYTICS_GRID, up to @width
+ * @grid_rows: Grid rows with VLIB_ANALYTICS_GRID, up to @height
+ *
+ * Return: Pointer to the statistics on success, NULL otherwise.
+ */
+struct vlib_analytics *vlib_analytics_create(size_t width, size_t height,
+				size_t pitch, unsigned int flags,
+				size_t grid_cols, size_t grid_rows)
+{
+	struct vlib_analytics *an;
+	size_t cells;
+
+	if (!(flags & VLIB_ANALYTICS_GRID)) {
+		grid_cols = 1;
+		grid_rows = 1;
+	}
+
+	if (!width || !height || !pitch || !flags ||
+		!grid_cols || grid_cols > width ||
+		!grid_rows || grid_rows > height) {
+		VLIB_REPORT_ERR("analytics: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	an = calloc(1, sizeof(*an));
+	if (!an) {
+		return NULL;
+	}
+
+	an->width = width;
+	an->height = height;
+	an->pitch = pitch;
+	an->flags = flags;
+	an->grid_cols = grid_cols;
+	an->grid_rows = grid_rows;
+	an->slots = (height + ANALYTICS_GRAIN - 1) / ANALYTICS_GRAIN;
+	cells = grid_cols * grid_rows;
+
+	an->cell_x = malloc((grid_cols + 1) * sizeof(*an->cell_x));
+	an->acc = calloc(an->slots, sizeof(*an->acc));
+	an->cells = malloc(an->slots * cells * sizeof(*an->cells));
+	an->grid = calloc(cells, sizeof(*an->grid));
+	if (flags & VLIB_ANALYTICS_HISTOGRAM) {
+		an->hist = malloc(an->slots * VLIB_HISTOGRAM_BINS *
+						sizeof(*an->hist));
+	}
+	if (!an->cell_x || !an->acc || !an->cells || !an->grid ||
+		((flags & VLIB_ANALYTICS_HISTOGRAM) && !an->hist)) {
+		vlib_analytics_destroy(an);
+		return NULL;
+	}
+
+	for (size_t c=0; c<=grid_cols; c++) {
+		an->cell_x[c] = c * width / grid_cols;
+	}
+	for (size_t s=0; s<an->slots; s++) {
+		an->acc[s].cells = an->cells + s * cells;
+		if (an->hist) {
+			an->acc[s].hist = an->hist + s * VLIB_HISTOGRAM_BINS;
+		}
+	}
+
+	return an;
+}
+
+void vlib_analytics_destroy(struct vlib_analytics *an)
+{
+	if (!an) {
+		return;
+	}
+
+	free(an->cell_x);
+	free(an->acc);
+	free(an->hist);
+	free(an->cells);
+	free(an->grid);
+	free(an);
+}
+
+/*
+ * Sum, sum of squares, minimum and maximum of @n pixels, 16 at a time,
+ * counted into @bank unless NULL.
+ */
+static void analytics_segment(const uint8_t *s, size_t n, size_t pitch,
+							uint32_t (*bank)[VLIB_HISTOGRAM_BINS],
+							struct analytics_seg *seg)
+{
+	/* the last pixel of YUYV rows is left out of the 32 byte loads */
+	size_t end = pitch == 1 ? n : pitch == 2 && n ? n - 1 : 0;
+	v_s16 ones = v_setall_s16(1);
+	v_u8 vmin = v_setall_u8(255);
+	v_u8 vmax = v_setall_u8(0);
+	uint8_t t[16];
+	size_t x = 0;
+
+	seg->sum = 0;
+	seg->sum_sq = 0;
+
+	while (x + 16 <= end) {
+		size_t e = x + ANALYTICS_BLOCK < end ? x + ANALYTICS_BLOCK : end;
+		v_s32 sum = v_setall_s32(0);
+		v_s32 sum_sq = v_setall_s32(0);
+
+		for (; x+16<=e; x+=16) {
+			v_u8 a, b;
+			v_s16 lo, hi;
+
+			if (pitch == 1) {
+				a = v_load_u8(s + x);
+			} else {
+				v_load_deinterleave2_u8(s + 2 * x, &a, &b);
+			}
+			lo = v_expand_lo_u8(a);
+			hi = v_expand_hi_u8(a);
+
+			sum = v_madd_s16(sum, lo, ones);
+			sum = v_madd_s16(sum, hi, ones);
+			sum_sq = v_madd_s16(sum_sq, lo, lo);
+			sum_sq = v_madd_s16(sum_sq, hi, hi);
+			vmin = v_min_u8(vmin, a);
+			vmax = v_max_u8(vmax, a);
+
+			if (bank) {
+				v_store_u8(t, a);
+				for (int i=0; i<16; i+=4) {
+					bank[0][t[i]]++;
+					bank[1][t[i + 1]]++;
+					bank[2][t[i + 2]]++;
+					bank[3][t[i + 3]]++;
+				}
+			}
+		}
+
+		seg->sum += (uint32_t)v_reduce_add_s32(sum);
+		seg->sum_sq += (uint32_t)v_reduce_add_s32(sum_sq);
+	}
+
+	seg->min = 255;
+	seg->max = 0;
+	if (x) {
+		v_store_u8(t, vmin);
+		for (int i=0; i<16; i++) {
+			seg->min = t[i] < seg->min ? t[i] : seg->min;
+		}
+		v_store_u8(t, vmax);
+		for (int i=0; i<16; i++) {
+			seg->max = t[i] > seg->max ? t[i] : seg->max;
+		}
+	}
+
+	for (; x<n; x++) {
+		uint8_t v = s[x * pitch];
+
+		seg->sum += v;
+		seg->sum_sq += v * v;
+		seg->min = v < seg->min ? v : seg->min;
+		seg->max = v > seg->max ? v : seg->max;
+		if (bank) {
+			bank[0][v]++;
+		}
+	}
+}
+
+/* first pixel of @n equal to @v */
+static size_t analytics_find(const uint8_t *s, size_t n, size_t pitch, int v)
+{
+	size_t x = 0;
+
+	while (x < n - 1 && s[x * pitch] != v) {
+		x++;
+	}
+
+	return x;
+}
+
+static void analytics_band(void *arg, size_t start, size_t end)
+{
+	struct analytics_job *job = arg;
+	const struct vlib_analytics *an = job->an;
+	struct analytics_acc *acc = an->acc + start / ANALYTICS_GRAIN;
+	uint32_t bank[ANALYTICS_BANKS][VLIB_HISTOGRAM_BINS];
+	size_t cells = an->grid_cols * an->grid_rows;
+
+	acc->used = 1;
+	acc->sum = 0;
+	acc->sum_sq = 0;
+	acc->min = 256;
+	acc->max = -1;
+	for (size_t c=0; c<cells; c++) {
+		acc->cells[c].sum = 0;
+		acc->cells[c].min = 255;
+		acc->cells[c].max = 0;
+	}
+	if (acc->hist) {
+		memset(bank, 0, sizeof(bank));
+	}
+
+	for (size_t y=start; y<end; y++) {
+		const uint8_t *row = job->src + y * job->stride;
+		struct analytics_cell_acc *cell = acc->cells +
+								y * an->grid_rows / an->height * an->grid_cols;
+
+		for (size_t c=0; c<an->grid_cols; c++, cell++) {
+			const uint8_t *s = row + an->cell_x[c] * an->pitch;
+			size_t n = an->cell_x[c + 1] - an->cell_x[c];
+			struct analytics_seg seg;
+
+			analytics_segment(s, n, an->pitch, acc->hist ? bank : NULL, &seg);
+
+			acc->sum += seg.sum;
+			acc->sum_sq += seg.sum_sq;
+			cell->sum += seg.sum;
+			cell->min = seg.min < cell->min ? seg.min : cell->min;
+			cell->max = seg.max > cell->max ? seg.max : cell->max;
+
+			if (seg.min < acc->min) {
+				acc->min = seg.min;
+				acc->min_x = an->cell_x[c] +
+							analytics_find(s, n, an->pitch, seg.min);
+				acc->min_y = y;
+			}
+			if (seg.max > acc->max) {
+				acc->max = seg.max;
+				acc->max_x = an->cell_x[c] +
+							analytics_find(s, n, an->pitch, seg.max);
+				acc->max_y = y;
+			}
+		}
+	}
+
+	if (acc->hist) {
+		for (size_t i=0; i<VLIB_HISTOGRAM_BINS; i++) {
+			acc->hist[i] = bank[0][i] + bank[1][i] + bank[2][i] + bank[3][i];
+		}
+	}
+}
+
+/* @b into @a, @b holds later rows */
+static void analytics_merge(const struct vlib_analytics *an,
+							struct analytics_acc *a,
+							const struct analytics_acc *b)
+{
+	size_t cells = an->grid_cols * an->grid_rows;
+
+	if (!b->used) {
+		return;
+	}
+
+	if (!a->used) {
+		uint32_t *hist = a->hist;
+		struct analytics_cell_acc *c = a->cells;
+
+		*a = *b;
+		a->hist = hist;
+		a->cells = c;
+		if (hist) {
+			memcpy(hist, b->hist, VLIB_HISTOGRAM_BINS * sizeof(*hist));
+		}
+		memcpy(c, b->cells, cells * sizeof(*c));
+		return;
+	}
+
+	a->sum += b->sum;
+	a->sum_sq += b->sum_sq;
+	if (b->min < a->min) {
+		a->min = b->min;
+		a->min_x = b->min_x;
+		a->min_y = b->min_y;
+	}
+	if (b->max > a->max) {
+		a->max = b->max;
+		a->max_x = b->max_x;
+		a->max_y = b->max_y;
+	}
+	if (a->hist) {
+		for (size_t i=0; i<VLIB_HISTOGRAM_BINS; i++) {
+			a->hist[i] += b->hist[i];
+		}
+	}
+	for (size_t c=0; c<cells; c++) {
+		struct analytics_cell_acc *ca = a->cells + c;
+		const struct analytics_cell_acc *cb = b->cells + c;
+
+		ca->sum += cb->sum;
+		ca->min = cb->min < ca->min ? cb->min : ca->min;
+		ca->max = cb->max > ca->max ? cb->max : ca->max;
+	}
+}
+
+/* pairs [start, end) of a tree level */
+static void analytics_merge_band(void *arg, size_t start, size_t end)
+{
+	struct analytics_job *job = arg;
+	const struct vlib_analytics *an = job->an;
+
+	for (size_t i=start; i<end; i++) {
+		size_t a = i * 2 * job->step, b = a + job->step;
+
+		if (b < an->slots) {
+			analytics_merge(an, an->acc + a, an->acc + b);
+		}
+	}
+}
+
+/**
+ * vlib_analytics_run - Gather the statistics of an image on all cores
+ * @an: Frame statistics
+ * @src: Source image of the size given at creation
+ * @stride: Line stride of @src in bytes
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_analytics_run(struct vlib_analytics *an,
+				const uint8_t *src, size_t stride)
+{
+	struct analytics_job job = {
+		.an = an,
+		.src = src,
+		.stride = stride,
+	};
+	const struct analytics_acc *acc;
+	double n, mean;
+	int ret;
+
+	if (!an || !src) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	for (size_t s=0; s<an->slots; s++) {
+		an->acc[s].used = 0;
+	}
+
+	ret = vlib_parallel_for(an->height, ANALYTICS_GRAIN, analytics_band,
+							&job);
+
+	for (job.step=1; !ret && job.step<an->slots; job.step*=2) {
+		size_t pairs = (an->slots + 2 * job.step - 1) / (2 * job.step);
+
+		ret = vlib_parallel_for(pairs, 1, analytics_merge_band, &job);
+	}
+	if (ret) {
+		return ret;
+	}
+
+	acc = an->acc;
+	n = (double)an->width * an->height;
+	mean = acc->sum / n;
+
+	if (an->flags & VLIB_ANALYTICS_MEAN_STDDEV) {
+		double var = acc->sum_sq / n - mean * mean;
+
+		an->stats.mean = mean;
+		an->stats.stddev = var > 0 ? sqrt(var) : 0;
+	}
+	if (an->flags & VLIB_ANALYTICS_MIN_MAX) {
+		an->stats.min = acc->min;
+		an->stats.max = acc->max;
+		an->stats.min_x = acc->min_x;
+		an->stats.min_y = acc->min_y;
+		an->stats.max_x = acc->max_x;
+		an->stats.max_y = acc->max_y;
+	}
+	if (an->flags & VLIB_ANALYTICS_HISTOGRAM) {
+		memcpy(an->stats.hist, acc->hist, sizeof(an->stats.hist));
+	}
+	if (an->flags & VLIB_ANALYTICS_GRID) {
+		for (size_t cy=0; cy<an->grid_rows; cy++) {
+			size_t y0 = (cy * an->height + an->grid_rows - 1) / an->grid_rows;
+			size_t y1 = ((cy + 1) * an->height + an->grid_rows - 1) /
+						an->grid_rows;
+
+			for (size_t cx=0; cx<an->grid_cols; cx++) {
+				size_t c = cy * an->grid_cols + cx;
+				size_t pixels = (y1 - y0) *
+								(an->cell_x[cx + 1] - an->cell_x[cx]);
+
+				an->grid[c].mean = pixels ?
+								(double)acc->cells[c].sum / pixels : 0;
+				an->grid[c].min = acc->cells[c].min;
+				an->grid[c].max = acc->cells[c].max;
+			}
+		}
+	}
+
+	return VLIB_SUCCESS;
+}
+
+const struct vlib_analytics_stats *vlib_analytics_get_stats(
+				const struct vlib_analytics *an)
+{
+	return &an->stats;
+}
+
+/* grid_rows x grid_cols cells, row by row */
+const struct vlib_analytics_cell *vlib_analytics_get_cells(
+				const struct vlib_analytics *an)
+{
+	return an->grid;
+}
+
+/* one cell without VLIB_ANALYTICS_GRID */
+size_t vlib_analytics_get_num_cells(const struct vlib_analytics *an)
+{
+	return an->grid_cols * an->grid_rows;
+}
@@ -0,0 +1,431 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bilateral.h"
+#include "filter.h"
+#include "helper.h"
+#include "luma_stage.h"
+#include "parallel.h"
+#include "video_int.h"
+
+/* rows per band boundary */
+#define BILATERAL_GRAIN		16
+
+/* cells around the data for the blur of two cells per side */
+#define BILATERAL_PAD		2
+
+/* grid rows kept for the vertical blur */
+#define BILATERAL_RING		5
+
+/*
+ * The grid is stored by rows of cells. A row has gw columns of gd range
+ * bins, each cell holds the sum of its pixels and their count, so that
+ * cell (x, z) of a row starts at float (x * gd + z) * 2.
+ */
+struct vlib_bilateral {
+	size_t width;
+	size_t height;
+	size_t pitch;
+	float inv_space;			/* grid cells per pixel */
+	size_t gw;					/* columns of the grid, with padding */
+	size_t gd;					/* range bins of the grid, with padding */
+	size_t row;					/* floats per grid row */
+	/* per column: offset of the nearest and of the lower cell */
+	uint32_t *x_near;
+	uint32_t *x_low;
+	float *x_frac;
+	/* the same per intensity */
+	uint32_t z_near[256];
+	uint32_t z_low[256];
+	float z_frac[256];
+};
+
+struct bilateral_job {
+	const struct vlib_bilateral *bf;
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+	int ret;
+};
+
+/* grid row a pixel row is accumulated into */
+static inline long bilateral_row_near(const struct vlib_bilateral *bf,
+									size_t y)
+{
+	return (long)(y * bf->inv_space + 0.5f);
+}
+
+/* grid row above a pixel row */
+static inline long bilateral_row_low(const struct vlib_bilateral *bf,
+									size_t y)
+{
+	return (long)(y * bf->inv_space);
+}
+
+/**
+ * vlib_bilateral_create - Set up a bilateral filter
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ * @pitch: Bytes between two pixels
+ * @sigma_space: Standard deviation of the spatial weights in pixels, >= 1
+ * @sigma_color: Standard deviation of the range weights in levels, >= 1
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct vlib_bilateral *vlib_bilateral_create(size_t width, size_t height,
+				size_t pitch, float sigma_space, float sigma_color)
+{
+	struct vlib_bilateral *bf;
+	size_t nx, nz;
+
+	if (!width || !height || !pitch || !(sigma_space >= 1) ||
+		!(sigma_color >= 1)) {
+		VLIB_REPORT_ERR("bilateral: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	bf = calloc(1, sizeof(*bf));
+	if (!bf) {
+		return NULL;
+	}
+
+	bf->width = width;
+	bf->height = height;
+	bf->pitch = pitch;
+	bf->inv_space = 1 / sigma_space;
+
+	/*
+	 * Data cells plus the padding the blur spreads into, and one more
+	 * column and bin for the upper cell of the interpolation.
+	 */
+	nx = (size_t)((width - 1) / sigma_space + 0.5f) + 1;
+	nz = (size_t)(255 / sigma_color + 0.5f) + 1;
+	bf->gw = nx + 2 * BILATERAL_PAD + 1;
+	bf->gd = nz + 2 * BILATERAL_PAD + 1;
+	bf->row = bf->gw * bf->gd * 2;
+
+	bf->x_near = malloc(width * sizeof(*bf->x_near));
+	bf->x_low = malloc(width * sizeof(*bf->x_low));
+	bf->x_frac = malloc(width * sizeof(*bf->x_frac));
+	if (!bf->x_near || !bf->x_low || !bf->x_frac) {
+		vlib_bilateral_destroy(bf);
+		return NULL;
+	}
+
+	for (size_t x=0; x<width; x++) {
+		float f = x / sigma_space;
+		size_t low = (size_t)f;
+
+		bf->x_near[x] = ((size_t)(f + 0.5f) + BILATERAL_PAD) * bf->gd * 2;
+		bf->x_low[x] = (low + BILATERAL_PAD) * bf->gd * 2;
+		bf->x_frac[x] = f - low;
+	}
+
+	for (size_t v=0; v<256; v++) {
+		float f = v / sigma_color;
+		size_t low = (size_t)f;
+
+		bf->z_near[v] = ((size_t)(f + 0.5f) + BILATERAL_PAD) * 2;
+		bf->z_low[v] = (low + BILATERAL_PAD) * 2;
+		bf->z_frac[v] = f - low;
+	}
+
+	return bf;
+}
+
+void vlib_bilateral_destroy(struct vlib_bilateral *bf)
+{
+	if (!bf) {
+		return;
+	}
+
+	free(bf->x_near);
+	free(bf->x_low);
+	free(bf->x_frac);
+	free(bf);
+}
+
+static void bilateral_splat(const struct vlib_bilateral *bf, float *row,
+							const uint8_t *src)
+{
+	for (size_t x=0; x<bf->width; x++) {
+		uint8_t v = src[x * bf->pitch];
+		float *c = row + bf->x_near[x] + bf->z_near[v];
+
+		c[0] += v;
+		c[1] += 1;
+	}
+}
+
+/*
+ * [1 4 6 4 1] along the range and then along the columns of a grid row,
+ * through @tmp. Only the cells the interpolation reads are written, the
+ * others keep zero.
+ */
+static void bilateral_blur_row(const struct vlib_bilateral *bf, float *row,
+							float *tmp)
+{
+	size_t gd2 = bf->gd * 2;
+	size_t lo = BILATERAL_PAD * 2, hi = (bf->gd - BILATERAL_PAD) * 2;
+
+	for (size_t x=0; x<bf->gw; x++) {
+		const float *s = row + x * gd2;
+		float *d = tmp + x * gd2;
+
+		for (size_t i=lo; i<hi; i++) {
+			d[i] = s[i - 4] + 4 * (s[i - 2] + s[i + 2]) + 6 * s[i] + s[i + 4];
+		}
+	}
+
+	for (size_t i=BILATERAL_PAD*gd2; i<(bf->gw-BILATERAL_PAD)*gd2; i++) {
+		row[i] = tmp[i - 2 * gd2] + 4 * (tmp[i - gd2] + tmp[i + gd2]) +
+				6 * tmp[i] + tmp[i + 2 * gd2];
+	}
+}
+
+/* [1 4 6 4 1] across five grid rows */
+static void bilateral_blur_rows(const struct vlib_bilateral *bf, float *dst,
+							float *const rows[BILATERAL_RING])
+{
+	const float *r0 = rows[0], *r1 = rows[1], *r2 = rows[2];
+	const float *r3 = rows[3], *r4 = rows[4];
+
+	for (size_t i=0; i<bf->row; i++) {
+		dst[i] = r0[i] + 4 * (r1[i] + r3[i]) + 6 * r2[i] + r4[i];
+	}
+}
+
+/* trilinear interpolation of pixel row @y between grid rows @a and @b */
+static void bilateral_slice(const struct vlib_bilateral *bf,
+							const float *a, const float *b, size_t y,
+							const uint8_t *src, uint8_t *dst)
+{
+	size_t gd2 = bf->gd * 2;
+	float fy = y * bf->inv_space - bilateral_row_low(bf, y);
+
+	for (size_t x=0; x<bf->width; x++) {
+		uint8_t v = src[x * bf->pitch];
+		size_t o = bf->x_low[x] + bf->z_low[v];
+		float fx = bf->x_frac[x], fz = bf->z_frac[v];
+		float w00 = (1 - fx) * (1 - fz), w01 = (1 - fx) * fz;
+		float w10 = fx * (1 - fz), w11 = fx * fz;
+		const float *ca = a + o, *cb = b + o;
+		float sa, sb, na, nb, s, n;
+
+		sa = w00 * ca[0] + w01 * ca[2] + w10 * ca[gd2] + w11 * ca[gd2 + 2];
+		na = w00 * ca[1] + w01 * ca[3] + w10 * ca[gd2 + 1] +
+			w11 * ca[gd2 + 3];
+		sb = w00 * cb[0] + w01 * cb[2] + w10 * cb[gd2] + w11 * cb[gd2 + 2];
+		nb = w00 * cb[1] + w01 * cb[3] + w10 * cb[gd2 + 1] +
+			w11 * cb[gd2 + 3];
+		s = sa + fy * (sb - sa);
+		n = na + fy * (nb - na);
+
+		/* the cell of the pixel itself always has a weight */
+		dst[x * bf->pitch] = n > 0 ? (uint8_t)(s / n + 0.5f) : v;
+	}
+}
+
+/*
+ * Grid rows around the band are built one after the other: pixel rows
+ * are accumulated, the row is blurred along range and columns, and once
+ * five rows are in the ring the vertical blur yields the row the pixel
+ * rows below it are interpolated from. Bands rebuild the grid rows they
+ * share with their neighbours.
+ */
+static void bilateral_band(void *arg, size_t start, size_t end)
+{
+	struct bilateral_job *job = arg;
+	const struct vlib_bilateral *bf = job->bf;
+	float *ring[BILATERAL_RING], *blurred[2], *tmp, *buf;
+	long k_lo = bilateral_row_low(bf, start);
+	long k_hi = bilateral_row_low(bf, end - 1) + 1;
+	long j0 = k_lo - BILATERAL_PAD;
+	size_t y_in, y_out = start;
+
+	buf = calloc((BILATERAL_RING + 3) * bf->row, sizeof(*buf));
+	if (!buf) {
+		job->ret = VLIB_ERROR_NO_MEM;
+		return;
+	}
+
+	for (size_t i=0; i<BILATERAL_RING; i++) {
+		ring[i] = buf + i * bf->row;
+	}
+	blurred[0] = buf + BILATERAL_RING * bf->row;
+	blurred[1] = blurred[0] + bf->row;
+	tmp = blurred[1] + bf->row;
+
+	/* first pixel row accumulated into grid row j0 */
+	y_in = j0 > 1 ? (size_t)((j0 - 1) / bf->inv_space) : 0;
+	while (y_in < bf->height && bilateral_row_near(bf, y_in) < j0) {
+		y_in++;
+	}
+
+	for (long j=j0; j<=k_hi+BILATERAL_PAD; j++) {
+		float *row = ring[(j - j0) % BILATERAL_RING];
+		float *rows[BILATERAL_RING];
+		long k = j - BILATERAL_PAD;
+
+		memset(row, 0, bf->row * sizeof(*row));
+		while (y_in < bf->height && bilateral_row_near(bf, y_in) == j) {
+			bilateral_splat(bf, row, job->src + y_in * job->stride_src);
+			y_in++;
+		}
+		bilateral_blur_row(bf, row, tmp);
+
+		if (k < k_lo) {
+			continue;
+		}
+
+		for (size_t i=0; i<BILATERAL_RING; i++) {
+			rows[i] = ring[(k - BILATERAL_PAD + i - j0) % BILATERAL_RING];
+		}
+		bilateral_blur_rows(bf, blurred[k & 1], rows);
+
+		/* pixel rows between grid rows k - 1 and k */
+		if (k == k_lo) {
+			continue;
+		}
+		while (y_out < end && bilateral_row_low(bf, y_out) == k - 1) {
+			bilateral_slice(bf, blurred[(k - 1) & 1], blurred[k & 1], y_out,
+							job->src + y_out * job->stride_src,
+							job->dst + y_out * job->stride_dst);
+			y_out++;
+		}
+	}
+
+	free(buf);
+}
+
+/**
+ * vlib_bilateral - Bilateral filter an image on all cores
+ * @bf: Bilateral filter
+ * @src: Source image of the size given at creation
+ * @stride_src: Line stride of @src in bytes
+ * @dst: Output image of the same size, must not overlap @src
+ * @stride_dst: Line stride of @dst in bytes
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_bilateral(const struct vlib_bilateral *bf,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst)
+{
+	struct bilateral_job job = {
+		.bf = bf,
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.ret = VLIB_SUCCESS,
+	};
+	int ret;
+
+	if (!bf || !src || !dst) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	ret = vlib_parallel_for(bf->height, BILATERAL_GRAIN, bilateral_band,
+							&job);
+
+	return ret ? ret : job.ret;
+}
+
+/* Pipeline stage */
+
+/* sigma_space and sigma_color of the filter modes */
+static const struct {
+	float space;
+	float color;
+} bilateral_sigmas[] = {
+	{ 4, 16 },
+	{ 8, 24 },
+	{ 16, 32 },
+};
+
+struct bilateral_data {
+	struct vlib_bilateral *bf[ARRAY_SIZE(bilateral_sigmas)];
+};
+
+static void bilateral_release(void *arg)
+{
+	struct bilateral_data *data = arg;
+
+	for (size_t m=0; m<ARRAY_SIZE(bilateral_sigmas); m++) {
+		vlib_bilateral_destroy(data->bf[m]);
+		data->bf[m] = NULL;
+	}
+}
+
+static int bilateral_setup(void *arg, const struct luma_stage_format *fmt,
+						size_t width, size_t height)
+{
+	struct bilateral_data *data = arg;
+
+	for (size_t m=0; m<ARRAY_SIZE(bilateral_sigmas); m++) {
+		data->bf[m] = vlib_bilateral_create(width, height, fmt->pitch,
+						bilateral_sigmas[m].space, bilateral_sigmas[m].color);
+		if (!data->bf[m]) {
+			bilateral_release(data);
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	return VLIB_SUCCESS;
+}
+
+static int bilateral_run(void *arg, size_t mode,
+						const struct luma_stage_frame *frame)
+{
+	struct bilateral_data *data = arg;
+
+	return vlib_bilateral(data->bf[mode], frame->src, frame->stride_src,
+						frame->dst, frame->stride_dst);
+}
+
+static const struct luma_stage_ops bilateral_ops = {
+	.setup = bilateral_setup,
+	.release = bilateral_release,
+	.run = bilateral_run,
+};
+
+static const char *bilateral_modes[] = {
+	"4/16",
+	"8/24",
+	"16/32",
+};
+
+static const struct luma_stage bilateral_stage = {
+	.display_text = "Bilateral",
+	.name = "bilateral",
+	.modes = bilateral_modes,
+	.num_modes = ARRAY_SIZE(bilateral_modes),
+	.grey_chroma = 0,
+	.ops = &bilateral_ops,
+};
+
+/**
+ * vlib_bilateral_filter_create - Create an edge preserving smoothing stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_bilateral_filter_create(void)
+{
+	struct filter_s *fs;
+	struct bilateral_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	fs = luma_stage_create(&bilateral_stage, data);
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	return fs;
+}
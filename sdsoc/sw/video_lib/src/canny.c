@@ -0,0 +1,678 @@
+#include <drm/drm_fourcc.h>
+#include <linux/videodev2.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "canny.h"
+#include "cvt_color.h"
+#include "filter.h"
+#include "helper.h"
+#include "image.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* rows per tile, hysteresis is followed within a tile first */
+#define CANNY_TILE			32
+
+/* rows per band boundary of the output passes */
+#define CANNY_GRAIN			8
+
+/* tan(22.5 deg) in Q15, as xFAngle */
+#define CANNY_TG22			13573
+
+/* pixel classes, kept in the output frame until the final pass */
+enum {
+	CANNY_NONE,
+	CANNY_WEAK,
+	CANNY_EDGE,
+};
+
+/* quantized gradient directions, in the order of the suppression tests */
+enum {
+	CANNY_DIR_0,
+	CANNY_DIR_90,
+	CANNY_DIR_45,
+	CANNY_DIR_135,
+};
+
+struct vlib_canny {
+	size_t width;
+	size_t height;
+	size_t tiles;
+	/* 2 * width pixels per tile to follow next, offsets in the tile */
+	uint32_t *seeds;
+	size_t *num_seeds;
+	struct vlib_canny_stats stats;
+};
+
+struct canny_job {
+	struct vlib_canny *cn;
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+	int low;
+	int high;
+};
+
+static inline size_t canny_tile_rows(const struct vlib_canny *cn, size_t t)
+{
+	size_t y0 = t * CANNY_TILE;
+
+	return cn->height - y0 < CANNY_TILE ? cn->height - y0 : CANNY_TILE;
+}
+
+/*
+ * Sobel gradients of row @y, their L1 magnitude and direction. The
+ * direction is quantized as xFAngle: horizontal if
+ * |Gy| * 2^15 < |Gx| * tg22, which holds exactly when |Gx| > 0 and
+ * |Gy| <= (|Gx| * tg22) >> 15 because tg22 is odd, vertical if
+ * |Gy| > (|Gx| * tg22) >> 15 + 2 |Gx|, else diagonal by the signs.
+ */
+static void canny_gradient_row(const struct canny_job *job, long y,
+							int16_t *mag, uint16_t *dir)
+{
+	const size_t w = job->cn->width, n = w - 2;
+	const v_s16 zero = v_setall_s16(0), tg22 = v_setall_s16(CANNY_TG22);
+	const v_u16 none = v_setall_u16(0);
+	const uint8_t *up, *cur, *dn;
+
+	if (y < 1 || y >= (long)job->cn->height - 1) {
+		memset(mag, 0, w * sizeof(*mag));
+		return;
+	}
+
+	cur = job->src + y * job->stride_src;
+	up = cur - job->stride_src;
+	dn = cur + job->stride_src;
+
+	mag[0] = 0;
+	mag[w - 1] = 0;
+
+	for (size_t i=0; i<n; i+=8) {
+		size_t x;
+		v_s16 gx, gy, ax, ay, f;
+		v_u16 d0, d90, sx, sy, neg;
+
+		if (i + 8 > n) {
+			i = n - 8;
+		}
+		x = i + 1;
+
+		gx = v_add_s16(v_sub_s16(v_load_expand_u8(up + x + 1),
+								v_load_expand_u8(up + x - 1)),
+						v_sub_s16(v_load_expand_u8(dn + x + 1),
+								v_load_expand_u8(dn + x - 1)));
+		gx = v_add_s16(gx, v_shl_s16(v_sub_s16(v_load_expand_u8(cur + x + 1),
+											v_load_expand_u8(cur + x - 1)), 1));
+		gy = v_add_s16(v_sub_s16(v_load_expand_u8(dn + x - 1),
+								v_load_expand_u8(up + x - 1)),
+						v_sub_s16(v_load_expand_u8(dn + x + 1),
+								v_load_expand_u8(up + x + 1)));
+		gy = v_add_s16(gy, v_shl_s16(v_sub_s16(v_load_expand_u8(dn + x),
+											v_load_expand_u8(up + x)), 1));
+
+		ax = v_abs_s16(gx);
+		ay = v_abs_s16(gy);
+		v_store_s16(mag + x, v_add_s16(ax, ay));
+
+		f = v_mulhi_s16(v_shl_s16(ax, 1), tg22);
+		d0 = v_select_u16(v_cmpgt_s16(ay, f), none, v_cmpgt_s16(ax, zero));
+		d90 = v_cmpgt_s16(ay, v_add_s16(f, v_shl_s16(ax, 1)));
+		sx = v_cmpgt_s16(zero, gx);
+		sy = v_cmpgt_s16(zero, gy);
+		neg = v_select_u16(v_and_u16(sx, sy), none, v_or_u16(sx, sy));
+
+		v_store_u16(dir + x,
+					v_select_u16(d0, v_setall_u16(CANNY_DIR_0),
+					v_select_u16(d90, v_setall_u16(CANNY_DIR_90),
+					v_select_u16(neg, v_setall_u16(CANNY_DIR_45),
+								v_setall_u16(CANNY_DIR_135)))));
+	}
+}
+
+/*
+ * Non-maximum suppression of a row as xFFindmax3x3, the magnitude must be
+ * larger than the neighbour before it along the gradient and, for the
+ * horizontal and vertical directions, at least the one after it. @up,
+ * @cur and @dn have a zero column on both sides.
+ */
+static void canny_nms_row(const struct canny_job *job, const int16_t *up,
+						const int16_t *cur, const int16_t *dn,
+						const uint16_t *dir, uint8_t *out)
+{
+	const size_t w = job->cn->width;
+	const v_s16 one = v_setall_s16(1);
+	const v_s16 low = v_setall_s16(job->low), high = v_setall_s16(job->high);
+	const v_u16 weak = v_setall_u16(CANNY_WEAK), edge = v_setall_u16(CANNY_EDGE);
+	const v_u16 dir0 = v_setall_u16(CANNY_DIR_0);
+	const v_u16 dir90 = v_setall_u16(CANNY_DIR_90);
+	const v_u16 dir45 = v_setall_u16(CANNY_DIR_45);
+
+	for (size_t x=0; x<w; x+=8) {
+		v_s16 m, m1;
+		v_u16 d, c0, c90, c45, c135, max, lab;
+
+		if (x + 8 > w) {
+			x = w - 8;
+		}
+
+		m = v_load_s16(cur + x);
+		m1 = v_add_s16(m, one);
+		d = v_load_u16(dir + x);
+
+		c0 = v_and_u16(v_cmpgt_s16(m, v_load_s16(cur + x - 1)),
+						v_cmpgt_s16(m1, v_load_s16(cur + x + 1)));
+		c90 = v_and_u16(v_cmpgt_s16(m, v_load_s16(up + x)),
+						v_cmpgt_s16(m1, v_load_s16(dn + x)));
+		c45 = v_and_u16(v_cmpgt_s16(m, v_load_s16(up + x + 1)),
+						v_cmpgt_s16(m, v_load_s16(dn + x - 1)));
+		c135 = v_and_u16(v_cmpgt_s16(m, v_load_s16(up + x - 1)),
+						v_cmpgt_s16(m, v_load_s16(dn + x + 1)));
+
+		max = v_select_u16(v_cmpgt_u16(d, dir90),
+						v_select_u16(v_cmpgt_u16(d, dir45), c135, c45),
+						v_select_u16(v_cmpgt_u16(d, dir0), c90, c0));
+
+		lab = v_select_u16(v_cmpgt_s16(m, high), edge, weak);
+		lab = v_and_u16(lab, v_and_u16(max, v_cmpgt_s16(m, low)));
+		v_store_lo_u8(out + x, v_pack_u16(lab, lab));
+	}
+}
+
+/*
+ * Follow the weak pixels from the @n pixels on @stack within @rows rows
+ * from @y0. Offsets are relative to the first pixel of row @y0.
+ */
+static void canny_follow(const struct canny_job *job, size_t y0, long rows,
+						uint32_t *stack, size_t n)
+{
+	const long w = job->cn->width;
+	uint8_t *base = job->dst + y0 * job->stride_dst;
+
+	while (n) {
+		uint32_t p = stack[--n];
+		long y = p / w, x = p % w;
+
+		for (long j=y-1; j<=y+1; j++) {
+			uint8_t *row = base + j * job->stride_dst;
+
+			if (j < 0 || j >= rows) {
+				continue;
+			}
+
+			for (long i=x-1; i<=x+1; i++) {
+				if (i >= 0 && i < w && row[i] == CANNY_WEAK) {
+					row[i] = CANNY_EDGE;
+					stack[n++] = j * w + i;
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Gradients, suppression and the hysteresis within each tile of the band,
+ * as soon as the last row of a tile is classified.
+ */
+static void canny_tiles_band(void *arg, size_t start, size_t end)
+{
+	struct canny_job *job = arg;
+	const size_t w = job->cn->width;
+	int16_t *mag[3], *mbuf;
+	uint16_t *dir[3], *dbuf;
+	uint32_t *stack;
+
+	mbuf = calloc(3 * (w + 2), sizeof(*mbuf));
+	dbuf = calloc(3 * w, sizeof(*dbuf));
+	stack = malloc(CANNY_TILE * w * sizeof(*stack));
+	if (!mbuf || !dbuf || !stack) {
+		vlib_warn("canny: out of memory\n");
+		goto out;
+	}
+
+	for (int k=0; k<3; k++) {
+		mag[k] = mbuf + k * (w + 2) + 1;
+		dir[k] = dbuf + k * w;
+	}
+
+	canny_gradient_row(job, (long)start - 1, mag[0], dir[0]);
+	canny_gradient_row(job, start, mag[1], dir[1]);
+
+	for (size_t y=start; y<end; y++) {
+		int16_t *mt = mag[0];
+		uint16_t *dt = dir[0];
+
+		canny_gradient_row(job, y + 1, mag[2], dir[2]);
+		canny_nms_row(job, mag[0], mag[1], mag[2], dir[1],
+					job->dst + y * job->stride_dst);
+
+		mag[0] = mag[1];
+		mag[1] = mag[2];
+		mag[2] = mt;
+		dir[0] = dir[1];
+		dir[1] = dir[2];
+		dir[2] = dt;
+
+		if ((y + 1) % CANNY_TILE == 0 || y + 1 == end) {
+			size_t t = y / CANNY_TILE, y0 = t * CANNY_TILE, n = 0;
+
+			for (size_t j=y0; j<=y; j++) {
+				const uint8_t *row = job->dst + j * job->stride_dst;
+
+				for (size_t x=0; x<w; x++) {
+					if (row[x] == CANNY_EDGE) {
+						stack[n++] = (j - y0) * w + x;
+					}
+				}
+			}
+			canny_follow(job, y0, y + 1 - y0, stack, n);
+		}
+	}
+
+out:
+	free(mbuf);
+	free(dbuf);
+	free(stack);
+}
+
+/* weak pixels of row @y next to an edge pixel of row @y_nb */
+static size_t canny_find_seeds(const struct canny_job *job, size_t y,
+							size_t y_nb, uint32_t ofs, uint32_t *seeds,
+							size_t n)
+{
+	const size_t w = job->cn->width;
+	const uint8_t *row = job->dst + y * job->stride_dst;
+	const uint8_t *nb = job->dst + y_nb * job->stride_dst;
+
+	for (size_t x=0; x<w; x++) {
+		if (row[x] == CANNY_WEAK &&
+			((x > 0 && nb[x - 1] == CANNY_EDGE) || nb[x] == CANNY_EDGE ||
+			 (x + 1 < w && nb[x + 1] == CANNY_EDGE))) {
+			seeds[n++] = ofs + x;
+		}
+	}
+
+	return n;
+}
+
+/* only reads the neighbour tiles, the following is a separate pass */
+static void canny_seed_band(void *arg, size_t start, size_t end)
+{
+	struct canny_job *job = arg;
+	struct vlib_canny *cn = job->cn;
+
+	for (size_t t=start; t<end; t++) {
+		size_t y0 = t * CANNY_TILE, rows = canny_tile_rows(cn, t);
+		uint32_t *seeds = cn->seeds + t * 2 * cn->width;
+		size_t n = 0;
+
+		if (t > 0) {
+			n = canny_find_seeds(job, y0, y0 - 1, 0, seeds, n);
+		}
+		if (y0 + rows < cn->height) {
+			n = canny_find_seeds(job, y0 + rows - 1, y0 + rows,
+								(rows - 1) * cn->width, seeds, n);
+		}
+		cn->num_seeds[t] = n;
+	}
+}
+
+/*
+ * The tiles of a band belong to one thread, so edges are followed across
+ * the tile boundaries within the band right away.
+ */
+static void canny_follow_band(void *arg, size_t start, size_t end)
+{
+	struct canny_job *job = arg;
+	struct vlib_canny *cn = job->cn;
+	const size_t y0 = start * CANNY_TILE;
+	const size_t rows = end * CANNY_TILE < cn->height ?
+						end * CANNY_TILE - y0 : cn->height - y0;
+	uint32_t *stack = malloc(rows * cn->width * sizeof(*stack));
+	size_t n = 0;
+
+	if (!stack) {
+		vlib_warn("canny: out of memory\n");
+		return;
+	}
+
+	for (size_t t=start; t<end; t++) {
+		const uint32_t *seeds = cn->seeds + t * 2 * cn->width;
+		uint32_t ofs = (t - start) * CANNY_TILE * cn->width;
+
+		for (size_t i=0; i<cn->num_seeds[t]; i++) {
+			uint32_t s = ofs + seeds[i];
+			uint8_t *p = job->dst + (y0 + s / cn->width) * job->stride_dst +
+						s % cn->width;
+
+			if (*p == CANNY_WEAK) {
+				*p = CANNY_EDGE;
+				stack[n++] = s;
+			}
+		}
+	}
+	canny_follow(job, y0, rows, stack, n);
+
+	free(stack);
+}
+
+/* edges to 255, everything else to 0 */
+static void canny_out_band(void *arg, size_t start, size_t end)
+{
+	struct canny_job *job = arg;
+	const size_t w = job->cn->width;
+	const v_u8 weak = v_setall_u8(CANNY_WEAK);
+
+	for (size_t y=start; y<end; y++) {
+		uint8_t *row = job->dst + y * job->stride_dst;
+		size_t x = 0;
+
+		for (; x+16<=w; x+=16) {
+			v_store_u8(row + x, v_cmpgt_u8(v_load_u8(row + x), weak));
+		}
+		for (; x<w; x++) {
+			row[x] = row[x] == CANNY_EDGE ? 255 : 0;
+		}
+	}
+}
+
+struct vlib_canny *vlib_canny_create(size_t width, size_t height)
+{
+	struct vlib_canny *cn;
+
+	if (width < 10 || height < 3 || width > UINT16_MAX ||
+		height > UINT16_MAX) {
+		VLIB_REPORT_ERR("canny: %zux%zu not supported", width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	cn = calloc(1, sizeof(*cn));
+	if (!cn) {
+		return NULL;
+	}
+
+	cn->width = width;
+	cn->height = height;
+	cn->tiles = (height + CANNY_TILE - 1) / CANNY_TILE;
+	cn->seeds = malloc(cn->tiles * 2 * width * sizeof(*cn->seeds));
+	cn->num_seeds = calloc(cn->tiles, sizeof(*cn->num_seeds));
+	if (!cn->seeds || !cn->num_seeds) {
+		vlib_canny_destroy(cn);
+		return NULL;
+	}
+
+	return cn;
+}
+
+void vlib_canny_destroy(struct vlib_canny *cn)
+{
+	if (!cn) {
+		return;
+	}
+
+	free(cn->seeds);
+	free(cn->num_seeds);
+	free(cn);
+}
+
+/**
+ * vlib_canny_compute - detect the edges of a frame
+ * @cn: edge detector
+ * @src: 8-bit frame of the size @cn was created for
+ * @stride_src: line stride of @src in bytes
+ * @dst: 8-bit edge image
+ * @stride_dst: line stride of @dst in bytes
+ * @low: magnitude above which pixels continue edges
+ * @high: magnitude above which pixels start edges, >= @low
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_canny_compute(struct vlib_canny *cn,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst, int low, int high)
+{
+	struct canny_job job = {
+		.cn = cn,
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.low = low,
+		.high = high,
+	};
+	struct timespec t;
+	int ret;
+
+	if (!src || !dst || low < 0 || high < low ||
+		high > VLIB_CANNY_MAX_MAGNITUDE) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	cn->stats.rounds = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(cn->height, CANNY_TILE, canny_tiles_band, &job);
+	cn->stats.tiles_ms = vlib_ms_since(&t);
+	if (ret) {
+		return ret;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	for (;;) {
+		size_t pending = 0;
+
+		ret = vlib_parallel_for(cn->tiles, 1, canny_seed_band, &job);
+		if (ret) {
+			return ret;
+		}
+
+		for (size_t i=0; i<cn->tiles; i++) {
+			pending += cn->num_seeds[i];
+		}
+		if (!pending) {
+			break;
+		}
+
+		cn->stats.rounds++;
+		ret = vlib_parallel_for(cn->tiles, 1, canny_follow_band, &job);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	ret = vlib_parallel_for(cn->height, CANNY_GRAIN, canny_out_band, &job);
+	cn->stats.propagate_ms = vlib_ms_since(&t);
+
+	return ret;
+}
+
+void vlib_canny_get_stats(const struct vlib_canny *cn,
+				struct vlib_canny_stats *stats)
+{
+	*stats = cn->stats;
+}
+
+/* Pipeline stage */
+
+/* thresholds of the filter modes */
+static const struct {
+	int low;
+	int high;
+} canny_thresholds[] = {
+	{ 30, 60 },
+	{ 60, 120 },
+	{ 120, 240 },
+};
+
+struct canny_data {
+	struct vlib_canny *cn;
+	uint32_t in_fourcc;
+	uint32_t out_fourcc;
+	size_t width;
+	size_t height;
+	uint8_t *luma;
+	uint8_t *edges;
+};
+
+struct canny_post_job {
+	struct vlib_image edges;
+	struct vlib_image out;
+	int ret;
+};
+
+static void canny_post_band(void *arg, size_t start, size_t end)
+{
+	struct canny_post_job *job = arg;
+
+	if (vlib_cvt_color_lines(&job->edges, &job->out, start, end)) {
+		job->ret = VLIB_ERROR_OTHER;
+	}
+}
+
+static void canny_free_buffers(struct canny_data *data)
+{
+	vlib_canny_destroy(data->cn);
+	free(data->luma);
+	free(data->edges);
+	data->cn = NULL;
+	data->luma = NULL;
+	data->edges = NULL;
+	data->width = 0;
+	data->height = 0;
+}
+
+static int canny_init(struct filter_s *fs, const struct filter_init_data *fid)
+{
+	struct canny_data *data = fs->data;
+	size_t w = fid->in_width, h = fid->in_height;
+
+	if (fid->out_width != w || fid->out_height != h) {
+		return -1;
+	}
+
+	if ((fid->in_fourcc != V4L2_PIX_FMT_GREY &&
+		 !vlib_cvt_color_supported(fid->in_fourcc, V4L2_PIX_FMT_GREY)) ||
+		!vlib_cvt_color_supported(V4L2_PIX_FMT_GREY, fid->out_fourcc)) {
+		return -1;
+	}
+
+	data->in_fourcc = fid->in_fourcc;
+	data->out_fourcc = fid->out_fourcc;
+
+	if (data->width == w && data->height == h) {
+		return 0;
+	}
+
+	canny_free_buffers(data);
+	data->cn = vlib_canny_create(w, h);
+	data->luma = malloc(w * h);
+	data->edges = malloc(w * h);
+	if (!data->cn || !data->luma || !data->edges) {
+		vlib_warn("canny: failed to set up %zux%zu\n", w, h);
+		canny_free_buffers(data);
+		return -1;
+	}
+
+	data->width = w;
+	data->height = h;
+
+	return 0;
+}
+
+static void canny_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	struct canny_data *data = fs->data;
+	struct canny_post_job job = { .ret = 0 };
+	const uint8_t *luma = frm_data_in;
+	size_t luma_stride = stride_in;
+
+	if (!data->cn || (size_t)width_in != data->width ||
+		(size_t)height_in != data->height) {
+		return;
+	}
+
+	if (data->in_fourcc != V4L2_PIX_FMT_GREY) {
+		struct vlib_image in, out;
+
+		if (vlib_image_init(&in, data->in_fourcc, data->width, data->height,
+							stride_in, frm_data_in) ||
+			vlib_image_init(&out, V4L2_PIX_FMT_GREY, data->width,
+							data->height, data->width, data->luma) ||
+			vlib_cvt_color(&in, &out)) {
+			return;
+		}
+		luma = data->luma;
+		luma_stride = data->width;
+	}
+
+	if (vlib_canny_compute(data->cn, luma, luma_stride, data->edges,
+						data->width, canny_thresholds[fs->mode].low,
+						canny_thresholds[fs->mode].high)) {
+		return;
+	}
+
+	vlib_image_init(&job.edges, V4L2_PIX_FMT_GREY, data->width, data->height,
+					data->width, data->edges);
+	if (vlib_image_init(&job.out, data->out_fourcc, width_out, height_out,
+						stride_out, frm_data_out)) {
+		return;
+	}
+
+	vlib_parallel_for(data->height, CANNY_GRAIN, canny_post_band, &job);
+}
+
+static struct filter_ops canny_ops = {
+	.init = canny_init,
+	.func = canny_func,
+};
+
+static const char *canny_modes[] = {
+	"30/60",
+	"60/120",
+	"120/240",
+};
+
+static const struct filter_s canny_fs = {
+	.display_text = "Canny Edges",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = 0,
+	.ops = &canny_ops,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(canny_modes),
+	.modes = canny_modes,
+};
+
+/**
+ * vlib_canny_filter_create - Create an edge detection stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_canny_filter_create(void)
+{
+	struct filter_s *fs;
+	struct canny_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	*fs = canny_fs;
+	fs->data = data;
+
+	return fs;
+}
@@ -0,0 +1,38 @@
+#include <stdlib.h>
+
+#include "corners.h"
+#include "video_int.h"
+
+/**
+ * vlib_corners_init - allocate an empty corner list
+ * @corners: list to initialize
+ * @capacity: maximum number of corners
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_corners_init(struct vlib_corners *corners, size_t capacity)
+{
+	corners->count = 0;
+	corners->capacity = capacity;
+	corners->x = malloc(capacity * sizeof(*corners->x));
+	corners->y = malloc(capacity * sizeof(*corners->y));
+	corners->score = malloc(capacity * sizeof(*corners->score));
+	if (!corners->x || !corners->y || !corners->score) {
+		vlib_corners_free(corners);
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	return VLIB_SUCCESS;
+}
+
+void vlib_corners_free(struct vlib_corners *corners)
+{
+	free(corners->x);
+	free(corners->y);
+	free(corners->score);
+	corners->x = NULL;
+	corners->y = NULL;
+	corners->score = NULL;
+	corners->count = 0;
+	corners->capacity = 0;
+}
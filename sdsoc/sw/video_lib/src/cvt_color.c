@@ -0,0 +1,836 @@
+#include <drm/drm_fourcc.h>
+#include <linux/videodev2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cvt_color.h"
+#include "filter.h"
+#include "helper.h"
+#include "simd.h"
+#include "video_int.h"
+
+/*
+ * BT.601 limited range coefficients. YUV to RGB uses Q6 so that all
+ * intermediate values fit into 16 bit lanes, RGB to YUV uses Q8.
+ */
+#define Y2RGB	74
+#define V2R		102
+#define U2G		25
+#define V2G		52
+#define U2B		129
+
+#define R2Y		66
+#define G2Y		129
+#define B2Y		25
+#define R2U		38
+#define G2U		74
+#define B2U		112
+#define R2V		112
+#define G2V		94
+#define B2V		18
+
+/*
+ * Every conversion goes through a pair of lines in YUV 4:2:2 (the pivot).
+ * Unpackers either point the pivot at source lines directly or fill the
+ * scratch lines, packers read the pivot and write the destination. Pivot
+ * lines are small enough to stay in L1 between unpack and pack.
+ */
+struct cvt_pivot {
+	const uint8_t *y[2];
+	const uint8_t *u[2];
+	const uint8_t *v[2];
+	uint8_t *scratch_y[2];
+	uint8_t *scratch_u[2];
+	uint8_t *scratch_v[2];
+};
+
+enum cvt_class {
+	CVT_CLASS_YUV,
+	CVT_CLASS_RGB,
+};
+
+struct cvt_format {
+	uint32_t fourcc;
+	enum cvt_class cls;
+	/*
+	 * Meaning of idx depends on the layout:
+	 *  packed RGB: byte offsets of R, G, B, A
+	 *  packed YUV: byte offsets of Y0, U, Y1, V within a macro pixel
+	 *  semi-planar: byte offset of U, V within a chroma pair
+	 *  planar: plane index of U, V
+	 */
+	unsigned int idx[4];
+	unsigned int bpp;			/* bytes per pixel of packed RGB */
+	void (*unpack)(const struct cvt_format *f, const struct vlib_image *img,
+				size_t line, struct cvt_pivot *p);
+	void (*pack)(const struct cvt_format *f, struct vlib_image *img,
+				size_t line, const struct cvt_pivot *p);
+};
+
+static inline uint8_t clamp_u8(int x)
+{
+	return x < 0 ? 0 : x > 255 ? 255 : x;
+}
+
+/* scalar reference, bit-exact with the vector paths */
+static inline void yuv2rgb_px(int y, int u, int v, uint8_t *rgb)
+{
+	int yy = Y2RGB * (y - 16) + 32;
+
+	u -= 128;
+	v -= 128;
+	rgb[0] = clamp_u8((yy + V2R * v) >> 6);
+	rgb[1] = clamp_u8((yy - U2G * u - V2G * v) >> 6);
+	rgb[2] = clamp_u8((yy + U2B * u) >> 6);
+}
+
+static inline uint8_t rgb2y_px(int r, int g, int b)
+{
+	return ((R2Y * r + G2Y * g + B2Y * b + 128) >> 8) + 16;
+}
+
+static inline uint8_t rgb2u_px(int r, int g, int b)
+{
+	return clamp_u8(((B2U * b - R2U * r - G2U * g + 128) >> 8) + 128);
+}
+
+static inline uint8_t rgb2v_px(int r, int g, int b)
+{
+	return clamp_u8(((R2V * r - G2V * g - B2V * b + 128) >> 8) + 128);
+}
+
+/**
+ * vlib_cvt_color_rgb2yuv - Convert one RGB pixel to YUV
+ * @r: Red
+ * @g: Green
+ * @b: Blue
+ * @yuv: Y, U and V of the pixel
+ *
+ * Same coefficients and rounding as vlib_cvt_color(), for color tables of
+ * overlays drawn in YUV.
+ */
+void vlib_cvt_color_rgb2yuv(uint8_t r, uint8_t g, uint8_t b, uint8_t *yuv)
+{
+	yuv[0] = rgb2y_px(r, g, b);
+	yuv[1] = rgb2u_px(r, g, b);
+	yuv[2] = rgb2v_px(r, g, b);
+}
+
+/* 16 pixels of Y and 8 samples of U/V to R, G, B */
+static inline void yuv2rgb_16(v_u8 y, const uint8_t *u, const uint8_t *v,
+							v_u8 *r, v_u8 *g, v_u8 *b)
+{
+	const v_s16 c128 = v_setall_s16(128);
+	v_s16 du = v_sub_s16(v_load_expand_u8(u), c128);
+	v_s16 dv = v_sub_s16(v_load_expand_u8(v), c128);
+	v_s16 rc = v_mul_s16(dv, v_setall_s16(V2R));
+	v_s16 gc = v_add_s16(v_mul_s16(du, v_setall_s16(-U2G)),
+						v_mul_s16(dv, v_setall_s16(-V2G)));
+	v_s16 bc = v_mul_s16(du, v_setall_s16(U2B));
+
+	const v_s16 c16 = v_setall_s16(16);
+	const v_s16 cy = v_setall_s16(Y2RGB);
+	const v_s16 c32 = v_setall_s16(32);
+	v_s16 yl = v_add_s16(v_mul_s16(v_sub_s16(v_expand_lo_u8(y), c16), cy), c32);
+	v_s16 yh = v_add_s16(v_mul_s16(v_sub_s16(v_expand_hi_u8(y), c16), cy), c32);
+
+	*r = v_packus_s16(v_shr_s16(v_adds_s16(yl, v_dup_lo_s16(rc)), 6),
+					v_shr_s16(v_adds_s16(yh, v_dup_hi_s16(rc)), 6));
+	*g = v_packus_s16(v_shr_s16(v_adds_s16(yl, v_dup_lo_s16(gc)), 6),
+					v_shr_s16(v_adds_s16(yh, v_dup_hi_s16(gc)), 6));
+	*b = v_packus_s16(v_shr_s16(v_adds_s16(yl, v_dup_lo_s16(bc)), 6),
+					v_shr_s16(v_adds_s16(yh, v_dup_hi_s16(bc)), 6));
+}
+
+/* 16 pixels of R, G, B to 16 Y and 8 U/V (chroma of averaged pairs) */
+static inline void rgb2yuv_16(v_u8 r, v_u8 g, v_u8 b,
+							uint8_t *y, uint8_t *u, uint8_t *v)
+{
+	const v_u16 cr = v_setall_u16(R2Y);
+	const v_u16 cg = v_setall_u16(G2Y);
+	const v_u16 cb = v_setall_u16(B2Y);
+	const v_u16 c128 = v_setall_u16(128);
+	const v_u16 c16 = v_setall_u16(16);
+	v_u16 yl, yh;
+
+	yl = v_add_u16(v_add_u16(v_mul_u16(v_reinterpret_u16_s16(v_expand_lo_u8(r)), cr),
+							v_mul_u16(v_reinterpret_u16_s16(v_expand_lo_u8(g)), cg)),
+					v_add_u16(v_mul_u16(v_reinterpret_u16_s16(v_expand_lo_u8(b)), cb),
+							c128));
+	yh = v_add_u16(v_add_u16(v_mul_u16(v_reinterpret_u16_s16(v_expand_hi_u8(r)), cr),
+							v_mul_u16(v_reinterpret_u16_s16(v_expand_hi_u8(g)), cg)),
+					v_add_u16(v_mul_u16(v_reinterpret_u16_s16(v_expand_hi_u8(b)), cb),
+							c128));
+	yl = v_add_u16(v_shr_u16(yl, 8), c16);
+	yh = v_add_u16(v_shr_u16(yh, 8), c16);
+	v_store_u8(y, v_pack_u16(yl, yh));
+
+	const v_u16 one = v_setall_u16(1);
+	v_s16 ra = v_reinterpret_s16_u16(v_shr_u16(v_add_u16(v_pairsum_u8(r), one), 1));
+	v_s16 ga = v_reinterpret_s16_u16(v_shr_u16(v_add_u16(v_pairsum_u8(g), one), 1));
+	v_s16 ba = v_reinterpret_s16_u16(v_shr_u16(v_add_u16(v_pairsum_u8(b), one), 1));
+	const v_s16 s128 = v_setall_s16(128);
+	v_s16 cu, cv;
+
+	cu = v_sub_s16(v_mul_s16(ba, v_setall_s16(B2U)),
+				v_add_s16(v_mul_s16(ra, v_setall_s16(R2U)),
+						v_mul_s16(ga, v_setall_s16(G2U))));
+	cv = v_sub_s16(v_mul_s16(ra, v_setall_s16(R2V)),
+				v_add_s16(v_mul_s16(ga, v_setall_s16(G2V)),
+						v_mul_s16(ba, v_setall_s16(B2V))));
+	cu = v_add_s16(v_shr_s16(v_add_s16(cu, s128), 8), s128);
+	cv = v_add_s16(v_shr_s16(v_add_s16(cv, s128), 8), s128);
+
+	v_u8 uv = v_packus_s16(cu, cv);
+	v_store_lo_u8(u, uv);
+	v_store_hi_u8(v, uv);
+}
+
+/* d[x] = average of s[2x], s[2x+1] */
+static void halve_line(const uint8_t *s, uint8_t *d, size_t n)
+{
+	const v_u16 one = v_setall_u16(1);
+	size_t x = 0;
+
+	for (; x + 16 <= n; x += 16) {
+		v_u16 lo = v_add_u16(v_pairsum_u8(v_load_u8(s + 2*x)), one);
+		v_u16 hi = v_add_u16(v_pairsum_u8(v_load_u8(s + 2*x + 16)), one);
+		v_store_u8(d + x, v_pack_u16(v_shr_u16(lo, 1), v_shr_u16(hi, 1)));
+	}
+
+	for (; x < n; x++) {
+		d[x] = (s[2*x] + s[2*x+1] + 1) >> 1;
+	}
+}
+
+/* d[x] = 2x2 box average of lines a and b */
+static void down2_line(const uint8_t *a, const uint8_t *b, uint8_t *d, size_t n)
+{
+	const v_u16 two = v_setall_u16(2);
+	size_t x = 0;
+
+	for (; x + 16 <= n; x += 16) {
+		v_u16 lo = v_add_u16(v_pairsum_u8(v_load_u8(a + 2*x)),
+							v_pairsum_u8(v_load_u8(b + 2*x)));
+		v_u16 hi = v_add_u16(v_pairsum_u8(v_load_u8(a + 2*x + 16)),
+							v_pairsum_u8(v_load_u8(b + 2*x + 16)));
+		lo = v_shr_u16(v_add_u16(lo, two), 2);
+		hi = v_shr_u16(v_add_u16(hi, two), 2);
+		v_store_u8(d + x, v_pack_u16(lo, hi));
+	}
+
+	for (; x < n; x++) {
+		d[x] = (a[2*x] + a[2*x+1] + b[2*x] + b[2*x+1] + 2) >> 2;
+	}
+}
+
+/* d[x] = rounded average of a[x] and b[x] */
+static void avg_line(const uint8_t *a, const uint8_t *b, uint8_t *d, size_t n)
+{
+	size_t x = 0;
+
+	if (a == b) {
+		memcpy(d, a, n);
+		return;
+	}
+
+	for (; x + 16 <= n; x += 16) {
+		v_store_u8(d + x, v_avg_u8(v_load_u8(a + x), v_load_u8(b + x)));
+	}
+
+	for (; x < n; x++) {
+		d[x] = (a[x] + b[x] + 1) >> 1;
+	}
+}
+
+static inline void copy_line(uint8_t *d, const uint8_t *s, size_t n)
+{
+	if (d != s) {
+		memcpy(d, s, n);
+	}
+}
+
+static void unpack_422(const struct cvt_format *f, const struct vlib_image *img,
+					size_t line, struct cvt_pivot *p)
+{
+	const unsigned int *idx = f->idx;
+	size_t w = img->width;
+
+	for (int i=0; i<2; i++) {
+		const uint8_t *s = vlib_image_line(img, 0, line + i);
+		uint8_t *y = p->scratch_y[i];
+		uint8_t *u = p->scratch_u[i];
+		uint8_t *v = p->scratch_v[i];
+		size_t x = 0;
+
+		for (; x + 32 <= w; x += 32) {
+			v_u8 c[4];
+
+			v_load_deinterleave4_u8(s + 2*x, &c[0], &c[1], &c[2], &c[3]);
+			v_store_interleave2_u8(y + x, c[idx[0]], c[idx[2]]);
+			v_store_u8(u + x/2, c[idx[1]]);
+			v_store_u8(v + x/2, c[idx[3]]);
+		}
+
+		for (; x < w; x += 2) {
+			const uint8_t *m = s + 2*x;
+
+			y[x] = m[idx[0]];
+			y[x+1] = m[idx[2]];
+			u[x/2] = m[idx[1]];
+			v[x/2] = m[idx[3]];
+		}
+
+		p->y[i] = y;
+		p->u[i] = u;
+		p->v[i] = v;
+	}
+}
+
+static void pack_422(const struct cvt_format *f, struct vlib_image *img,
+					size_t line, const struct cvt_pivot *p)
+{
+	const unsigned int *idx = f->idx;
+	size_t w = img->width;
+
+	for (int i=0; i<2; i++) {
+		uint8_t *d = vlib_image_line(img, 0, line + i);
+		const uint8_t *y = p->y[i];
+		const uint8_t *u = p->u[i];
+		const uint8_t *v = p->v[i];
+		size_t x = 0;
+
+		for (; x + 32 <= w; x += 32) {
+			v_u8 c[4];
+
+			v_load_deinterleave2_u8(y + x, &c[idx[0]], &c[idx[2]]);
+			c[idx[1]] = v_load_u8(u + x/2);
+			c[idx[3]] = v_load_u8(v + x/2);
+			v_store_interleave4_u8(d + 2*x, c[0], c[1], c[2], c[3]);
+		}
+
+		for (; x < w; x += 2) {
+			uint8_t *m = d + 2*x;
+
+			m[idx[0]] = y[x];
+			m[idx[2]] = y[x+1];
+			m[idx[1]] = u[x/2];
+			m[idx[3]] = v[x/2];
+		}
+	}
+}
+
+static void unpack_nv(const struct cvt_format *f, const struct vlib_image *img,
+					size_t line, struct cvt_pivot *p)
+{
+	const uint8_t *s = vlib_image_line(img, 1, line / 2);
+	uint8_t *u = p->scratch_u[0];
+	uint8_t *v = p->scratch_v[0];
+	size_t n = img->width / 2;
+	size_t x = 0;
+
+	for (; x + 16 <= n; x += 16) {
+		v_u8 c[2];
+
+		v_load_deinterleave2_u8(s + 2*x, &c[0], &c[1]);
+		v_store_u8(u + x, c[f->idx[0]]);
+		v_store_u8(v + x, c[f->idx[1]]);
+	}
+
+	for (; x < n; x++) {
+		u[x] = s[2*x + f->idx[0]];
+		v[x] = s[2*x + f->idx[1]];
+	}
+
+	p->y[0] = vlib_image_line(img, 0, line);
+	p->y[1] = vlib_image_line(img, 0, line + 1);
+	p->u[0] = p->u[1] = u;
+	p->v[0] = p->v[1] = v;
+}
+
+static void pack_nv(const struct cvt_format *f, struct vlib_image *img,
+					size_t line, const struct cvt_pivot *p)
+{
+	uint8_t *d = vlib_image_line(img, 1, line / 2);
+	size_t n = img->width / 2;
+	size_t x = 0;
+
+	copy_line(vlib_image_line(img, 0, line), p->y[0], img->width);
+	copy_line(vlib_image_line(img, 0, line + 1), p->y[1], img->width);
+
+	for (; x + 16 <= n; x += 16) {
+		v_u8 c[2];
+
+		c[f->idx[0]] = v_avg_u8(v_load_u8(p->u[0] + x), v_load_u8(p->u[1] + x));
+		c[f->idx[1]] = v_avg_u8(v_load_u8(p->v[0] + x), v_load_u8(p->v[1] + x));
+		v_store_interleave2_u8(d + 2*x, c[0], c[1]);
+	}
+
+	for (; x < n; x++) {
+		d[2*x + f->idx[0]] = (p->u[0][x] + p->u[1][x] + 1) >> 1;
+		d[2*x + f->idx[1]] = (p->v[0][x] + p->v[1][x] + 1) >> 1;
+	}
+}
+
+static void unpack_420(const struct cvt_format *f, const struct vlib_image *img,
+					size_t line, struct cvt_pivot *p)
+{
+	p->y[0] = vlib_image_line(img, 0, line);
+	p->y[1] = vlib_image_line(img, 0, line + 1);
+	p->u[0] = p->u[1] = vlib_image_line(img, f->idx[0], line / 2);
+	p->v[0] = p->v[1] = vlib_image_line(img, f->idx[1], line / 2);
+}
+
+static void pack_420(const struct cvt_format *f, struct vlib_image *img,
+					size_t line, const struct cvt_pivot *p)
+{
+	(void)f;
+
+	copy_line(vlib_image_line(img, 0, line), p->y[0], img->width);
+	copy_line(vlib_image_line(img, 0, line + 1), p->y[1], img->width);
+	avg_line(p->u[0], p->u[1], vlib_image_line(img, f->idx[0], line / 2),
+			img->width / 2);
+	avg_line(p->v[0], p->v[1], vlib_image_line(img, f->idx[1], line / 2),
+			img->width / 2);
+}
+
+static void unpack_444(const struct cvt_format *f, const struct vlib_image *img,
+					size_t line, struct cvt_pivot *p)
+{
+	for (int i=0; i<2; i++) {
+		halve_line(vlib_image_line(img, f->idx[0], line + i),
+					p->scratch_u[i], img->width / 2);
+		halve_line(vlib_image_line(img, f->idx[1], line + i),
+					p->scratch_v[i], img->width / 2);
+		p->y[i] = vlib_image_line(img, 0, line + i);
+		p->u[i] = p->scratch_u[i];
+		p->v[i] = p->scratch_v[i];
+	}
+}
+
+static void dup_line(const uint8_t *s, uint8_t *d, size_t n)
+{
+	size_t x = 0;
+
+	for (; x + 16 <= n; x += 16) {
+		v_u8 c = v_load_u8(s + x);
+		v_store_interleave2_u8(d + 2*x, c, c);
+	}
+
+	for (; x < n; x++) {
+		d[2*x] = d[2*x+1] = s[x];
+	}
+}
+
+static void pack_444(const struct cvt_format *f, struct vlib_image *img,
+					size_t line, const struct cvt_pivot *p)
+{
+	for (int i=0; i<2; i++) {
+		copy_line(vlib_image_line(img, 0, line + i), p->y[i], img->width);
+		dup_line(p->u[i], vlib_image_line(img, f->idx[0], line + i),
+				img->width / 2);
+		dup_line(p->v[i], vlib_image_line(img, f->idx[1], line + i),
+				img->width / 2);
+	}
+}
+
+static void unpack_grey(const struct cvt_format *f, const struct vlib_image *img,
+					size_t line, struct cvt_pivot *p)
+{
+	(void)f;
+
+	memset(p->scratch_u[0], 128, img->width / 2);
+
+	p->y[0] = vlib_image_line(img, 0, line);
+	p->y[1] = vlib_image_line(img, 0, line + 1);
+	p->u[0] = p->u[1] = p->v[0] = p->v[1] = p->scratch_u[0];
+}
+
+static void pack_grey(const struct cvt_format *f, struct vlib_image *img,
+					size_t line, const struct cvt_pivot *p)
+{
+	(void)f;
+
+	copy_line(vlib_image_line(img, 0, line), p->y[0], img->width);
+	copy_line(vlib_image_line(img, 0, line + 1), p->y[1], img->width);
+}
+
+static void unpack_rgb(const struct cvt_format *f, const struct vlib_image *img,
+					size_t line, struct cvt_pivot *p)
+{
+	const unsigned int *idx = f->idx;
+	size_t w = img->width;
+
+	for (int i=0; i<2; i++) {
+		const uint8_t *s = vlib_image_line(img, 0, line + i);
+		uint8_t *y = p->scratch_y[i];
+		uint8_t *u = p->scratch_u[i];
+		uint8_t *v = p->scratch_v[i];
+		size_t x = 0;
+
+		for (; x + 16 <= w; x += 16) {
+			v_u8 c[4];
+
+			if (f->bpp == 3) {
+				v_load_deinterleave3_u8(s + 3*x, &c[0], &c[1], &c[2]);
+			} else {
+				v_load_deinterleave4_u8(s + 4*x, &c[0], &c[1], &c[2], &c[3]);
+			}
+			rgb2yuv_16(c[idx[0]], c[idx[1]], c[idx[2]], y + x, u + x/2, v + x/2);
+		}
+
+		for (; x < w; x += 2) {
+			const uint8_t *m0 = s + f->bpp * x;
+			const uint8_t *m1 = m0 + f->bpp;
+			int r = (m0[idx[0]] + m1[idx[0]] + 1) >> 1;
+			int g = (m0[idx[1]] + m1[idx[1]] + 1) >> 1;
+			int b = (m0[idx[2]] + m1[idx[2]] + 1) >> 1;
+
+			y[x] = rgb2y_px(m0[idx[0]], m0[idx[1]], m0[idx[2]]);
+			y[x+1] = rgb2y_px(m1[idx[0]], m1[idx[1]], m1[idx[2]]);
+			u[x/2] = rgb2u_px(r, g, b);
+			v[x/2] = rgb2v_px(r, g, b);
+		}
+
+		p->y[i] = y;
+		p->u[i] = u;
+		p->v[i] = v;
+	}
+}
+
+static void pack_rgb(const struct cvt_format *f, struct vlib_image *img,
+					size_t line, const struct cvt_pivot *p)
+{
+	const unsigned int *idx = f->idx;
+	size_t w = img->width;
+
+	for (int i=0; i<2; i++) {
+		uint8_t *d = vlib_image_line(img, 0, line + i);
+		const uint8_t *y = p->y[i];
+		const uint8_t *u = p->u[i];
+		const uint8_t *v = p->v[i];
+		size_t x = 0;
+
+		for (; x + 16 <= w; x += 16) {
+			v_u8 c[4];
+
+			yuv2rgb_16(v_load_u8(y + x), u + x/2, v + x/2,
+						&c[idx[0]], &c[idx[1]], &c[idx[2]]);
+			if (f->bpp == 3) {
+				v_store_interleave3_u8(d + 3*x, c[0], c[1], c[2]);
+			} else {
+				c[idx[3]] = v_setall_u8(0xff);
+				v_store_interleave4_u8(d + 4*x, c[0], c[1], c[2], c[3]);
+			}
+		}
+
+		for (; x < w; x++) {
+			uint8_t rgb[3];
+			uint8_t *m = d + f->bpp * x;
+
+			yuv2rgb_px(y[x], u[x/2], v[x/2], rgb);
+			m[idx[0]] = rgb[0];
+			m[idx[1]] = rgb[1];
+			m[idx[2]] = rgb[2];
+			if (f->bpp == 4) {
+				m[idx[3]] = 0xff;
+			}
+		}
+	}
+}
+
+static const struct cvt_format cvt_formats[] = {
+	{ V4L2_PIX_FMT_YUYV, CVT_CLASS_YUV, { 0, 1, 2, 3 }, 0, unpack_422, pack_422 },
+	{ V4L2_PIX_FMT_UYVY, CVT_CLASS_YUV, { 1, 0, 3, 2 }, 0, unpack_422, pack_422 },
+	{ V4L2_PIX_FMT_NV12, CVT_CLASS_YUV, { 0, 1 }, 0, unpack_nv, pack_nv },
+	{ V4L2_PIX_FMT_NV21, CVT_CLASS_YUV, { 1, 0 }, 0, unpack_nv, pack_nv },
+	{ V4L2_PIX_FMT_YUV420, CVT_CLASS_YUV, { 1, 2 }, 0, unpack_420, pack_420 },
+	{ V4L2_PIX_FMT_YVU420, CVT_CLASS_YUV, { 2, 1 }, 0, unpack_420, pack_420 },
+	{ DRM_FORMAT_YUV444, CVT_CLASS_YUV, { 1, 2 }, 0, unpack_444, pack_444 },
+	{ V4L2_PIX_FMT_YUV444M, CVT_CLASS_YUV, { 1, 2 }, 0, unpack_444, pack_444 },
+	{ V4L2_PIX_FMT_GREY, CVT_CLASS_YUV, { 0 }, 0, unpack_grey, pack_grey },
+	/* byte order in memory is given by idx */
+	{ V4L2_PIX_FMT_RGB24, CVT_CLASS_RGB, { 0, 1, 2 }, 3, unpack_rgb, pack_rgb },
+	{ V4L2_PIX_FMT_BGR24, CVT_CLASS_RGB, { 2, 1, 0 }, 3, unpack_rgb, pack_rgb },
+	{ DRM_FORMAT_RGB888, CVT_CLASS_RGB, { 2, 1, 0 }, 3, unpack_rgb, pack_rgb },
+	{ DRM_FORMAT_BGR888, CVT_CLASS_RGB, { 0, 1, 2 }, 3, unpack_rgb, pack_rgb },
+	{ DRM_FORMAT_ABGR8888, CVT_CLASS_RGB, { 0, 1, 2, 3 }, 4, unpack_rgb, pack_rgb },
+	{ DRM_FORMAT_XBGR8888, CVT_CLASS_RGB, { 0, 1, 2, 3 }, 4, unpack_rgb, pack_rgb },
+	{ DRM_FORMAT_ARGB8888, CVT_CLASS_RGB, { 2, 1, 0, 3 }, 4, unpack_rgb, pack_rgb },
+	{ DRM_FORMAT_XRGB8888, CVT_CLASS_RGB, { 2, 1, 0, 3 }, 4, unpack_rgb, pack_rgb },
+};
+
+static const struct cvt_format *cvt_get_format(uint32_t fourcc)
+{
+	for (size_t i=0; i<ARRAY_SIZE(cvt_formats); i++) {
+		if (cvt_formats[i].fourcc == fourcc)
+			return &cvt_formats[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * vlib_cvt_color_supported - Check if a conversion is available
+ * @src_fourcc: Source pixel format
+ * @dst_fourcc: Destination pixel format
+ *
+ * Return: 1 if @src_fourcc can be converted to @dst_fourcc, 0 otherwise.
+ */
+int vlib_cvt_color_supported(uint32_t src_fourcc, uint32_t dst_fourcc)
+{
+	const struct cvt_format *fs = cvt_get_format(src_fourcc);
+	const struct cvt_format *fd = cvt_get_format(dst_fourcc);
+
+	if (!fs || !fd) {
+		return 0;
+	}
+
+	return !(fs->cls == CVT_CLASS_RGB && fd->cls == CVT_CLASS_RGB);
+}
+
+static int cvt_color_check(const struct vlib_image *src,
+						const struct vlib_image *dst)
+{
+	if (!vlib_cvt_color_supported(src->fourcc, dst->fourcc)) {
+		VLIB_REPORT_ERR("unsupported conversion '%.4s' -> '%.4s'",
+						(const char *)&src->fourcc,
+						(const char *)&dst->fourcc);
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_NOT_SUPPORTED;
+	}
+
+	if ((src->width & 1) || (src->height & 1) || (dst->height & 1)) {
+		VLIB_REPORT_ERR("color conversion requires even resolutions");
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (dst->width == src->width && dst->height == src->height) {
+		return 1;
+	}
+
+	if (dst->width * 2 == src->width && dst->height * 2 == src->height &&
+			!(dst->width & 1)) {
+		return 2;
+	}
+
+	VLIB_REPORT_ERR("unsupported scaling %zux%zu -> %zux%zu",
+					src->width, src->height, dst->width, dst->height);
+	vlib_dbg("%s\n", vlib_errstr);
+	return VLIB_ERROR_NOT_SUPPORTED;
+}
+
+static void cvt_pivot_setup(struct cvt_pivot *p, uint8_t *buf, size_t width)
+{
+	for (int i=0; i<2; i++) {
+		p->scratch_y[i] = buf;
+		p->scratch_u[i] = buf + width;
+		p->scratch_v[i] = buf + width + width / 2;
+		buf += 2 * width;
+	}
+}
+
+/**
+ * vlib_cvt_color_lines - Convert a range of destination lines
+ * @src: Source image
+ * @dst: Destination image
+ * @start: First destination line, must be even
+ * @end: Last destination line (exclusive), must be even
+ *
+ * Allows callers to split a frame into bands or tiles, e.g. to run the
+ * conversion on several cores or interleaved with a downstream filter.
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_cvt_color_lines(const struct vlib_image *src, struct vlib_image *dst,
+						size_t start, size_t end)
+{
+	const struct cvt_format *fs, *fd;
+	struct cvt_pivot p[3];
+	uint8_t *buf;
+	int scale;
+
+	if (!src || !dst) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	scale = cvt_color_check(src, dst);
+	if (scale < 0) {
+		return scale;
+	}
+
+	if ((start & 1) || (end & 1) || end > dst->height) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	fs = cvt_get_format(src->fourcc);
+	fd = cvt_get_format(dst->fourcc);
+
+	/* each pivot holds two lines of Y plus two half lines of U and V */
+	buf = malloc(3 * 4 * src->width);
+	if (!buf) {
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	for (int i=0; i<3; i++) {
+		cvt_pivot_setup(&p[i], buf + i * 4 * src->width, src->width);
+	}
+
+	for (size_t line=start; line<end; line+=2) {
+		if (scale == 1) {
+			fs->unpack(fs, src, line, &p[0]);
+			fd->pack(fd, dst, line, &p[0]);
+			continue;
+		}
+
+		/* fused 2x2 box downscale, four source lines per line pair */
+		fs->unpack(fs, src, 2 * line, &p[0]);
+		fs->unpack(fs, src, 2 * line + 2, &p[1]);
+		for (int i=0; i<2; i++) {
+			down2_line(p[i].y[0], p[i].y[1], p[2].scratch_y[i], dst->width);
+			down2_line(p[i].u[0], p[i].u[1], p[2].scratch_u[i], dst->width / 2);
+			down2_line(p[i].v[0], p[i].v[1], p[2].scratch_v[i], dst->width / 2);
+			p[2].y[i] = p[2].scratch_y[i];
+			p[2].u[i] = p[2].scratch_u[i];
+			p[2].v[i] = p[2].scratch_v[i];
+		}
+		fd->pack(fd, dst, line, &p[2]);
+	}
+
+	free(buf);
+
+	return VLIB_SUCCESS;
+}
+
+/**
+ * vlib_cvt_color - Convert a frame to a different pixel format
+ * @src: Source image
+ * @dst: Destination image, same size as @src or half width and height
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_cvt_color(const struct vlib_image *src, struct vlib_image *dst)
+{
+	if (!dst) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return vlib_cvt_color_lines(src, dst, 0, dst->height);
+}
+
+struct cvt_color_data {
+	uint32_t in_fourcc;
+	uint32_t out_fourcc;
+};
+
+static int cvt_color_init(struct filter_s *fs, const struct filter_init_data *fid)
+{
+	struct cvt_color_data *data;
+
+	if (!vlib_cvt_color_supported(fid->in_fourcc, fid->out_fourcc)) {
+		return -1;
+	}
+
+	/* 1:1 or fused 2:1 downscale only */
+	if (!(fid->in_width == fid->out_width && fid->in_height == fid->out_height) &&
+		!(fid->in_width == 2 * fid->out_width &&
+		  fid->in_height == 2 * fid->out_height)) {
+		return -1;
+	}
+
+	data = fs->data ? fs->data : malloc(sizeof(*data));
+	if (!data) {
+		return -1;
+	}
+
+	data->in_fourcc = fid->in_fourcc;
+	data->out_fourcc = fid->out_fourcc;
+	fs->data = data;
+
+	return 0;
+}
+
+static void cvt_color_func_lines(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out,
+						int line_start, int line_end)
+{
+	struct cvt_color_data *data = fs->data;
+	struct vlib_image src, dst;
+
+	if (vlib_image_init(&src, data->in_fourcc, width_in, height_in,
+						stride_in, frm_data_in) ||
+		vlib_image_init(&dst, data->out_fourcc, width_out, height_out,
+						stride_out, frm_data_out)) {
+		return;
+	}
+
+	if (vlib_cvt_color_lines(&src, &dst, line_start, line_end)) {
+		vlib_warn("%s\n", vlib_errstr);
+	}
+}
+
+static void cvt_color_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	cvt_color_func_lines(fs, frm_data_in, frm_data_out, height_in, width_in,
+						stride_in, height_out, width_out, stride_out,
+						0, height_out);
+}
+
+static int cvt_color_lines_required(struct filter_s *fs, int line_end,
+								int height_in, int height_out)
+{
+	(void)fs;
+
+	return height_in == height_out ? line_end : 2 * line_end;
+}
+
+static struct filter_ops cvt_color_ops = {
+	.init = cvt_color_init,
+	.func = cvt_color_func,
+	.func_lines = cvt_color_func_lines,
+	.lines_required = cvt_color_lines_required,
+};
+
+static const char *cvt_color_modes[] = {
+	"SW",
+};
+
+static const struct filter_s cvt_color_fs = {
+	.display_text = "Color Convert",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = 0,
+	.ops = &cvt_color_ops,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(cvt_color_modes),
+	.modes = cvt_color_modes,
+};
+
+/**
+ * vlib_cvt_color_create - Create a color conversion pipeline stage
+ *
+ * The stage converts frames from the capture format into the display
+ * format, optionally halving the resolution. Register it with
+ * filter_type_register() like any other filter.
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_cvt_color_create(void)
+{
+	struct filter_s *fs = malloc(sizeof(*fs));
+	if (!fs) {
+		return NULL;
+	}
+
+	*fs = cvt_color_fs;
+
+	return fs;
+}
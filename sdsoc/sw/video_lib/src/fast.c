@@ -0,0 +1,499 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fast.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* Bresenham circle of radius 3, clockwise from the top, as xf_fast */
+static const int fast_circle[16][2] = {
+	{ 0, -3 }, { 1, -3 }, { 2, -2 }, { 3, -1 },
+	{ 3, 0 }, { 3, 1 }, { 2, 2 }, { 1, 3 },
+	{ 0, 3 }, { -1, 3 }, { -2, 2 }, { -3, 1 },
+	{ -3, 0 }, { -3, -1 }, { -2, -2 }, { -1, -3 },
+};
+
+static inline int fast_min(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+static inline int fast_max(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+/*
+ * Largest threshold for which the pixel is still a corner, minus one, as
+ * xFCoreScore. @d holds center minus circle, wrapped to 25 entries. The
+ * result is below @threshold for pixels that are not corners.
+ */
+static int fast_score(const int *d, int threshold)
+{
+	int a0 = threshold, b0 = -threshold;
+
+	for (int k=0; k<16; k+=2) {
+		int a = d[k + 1], b = d[k + 1];
+
+		for (int j=k+2; j<=k+8; j++) {
+			a = fast_min(a, d[j]);
+			b = fast_max(b, d[j]);
+		}
+
+		a0 = fast_max(a0, fast_min(a, d[k]));
+		a0 = fast_max(a0, fast_min(a, d[k + 9]));
+		b0 = fast_min(b0, fast_max(b, d[k]));
+		b0 = fast_min(b0, fast_max(b, d[k + 9]));
+	}
+
+	return fast_max(a0, -b0) - 1;
+}
+
+static void fast_offsets(size_t stride, long *ofs)
+{
+	for (int k=0; k<16; k++) {
+		ofs[k] = fast_circle[k][1] * (long)stride + fast_circle[k][0];
+	}
+}
+
+/* score of the pixel at @p, below @threshold if it is not a corner */
+static int fast_score_px(const uint8_t *p, int threshold, const long *ofs)
+{
+	int d[25];
+
+	for (int k=0; k<16; k++) {
+		d[k] = p[0] - p[ofs[k]];
+	}
+	for (int k=16; k<25; k++) {
+		d[k] = d[k - 16];
+	}
+
+	return fast_score(d, threshold);
+}
+
+/*
+ * Corner test of the 16 pixels at @p. A 9 pixel arc always covers two
+ * neighbouring compass points of the circle, which rejects most pixels
+ * with four loads. The others count the longest run of brighter and of
+ * darker pixels around the circle.
+ */
+static v_u8 fast_test16(const uint8_t *p, v_u8 vt, const long *ofs)
+{
+	v_u8 c = v_load_u8(p);
+	v_u8 hi = v_adds_u8(c, vt), lo = v_subs_u8(c, vt);
+	v_u8 b[4], d[4], m, rb, rd, run;
+
+	for (int k=0; k<4; k++) {
+		v_u8 q = v_load_u8(p + ofs[4 * k]);
+
+		b[k] = v_cmpgt_u8(q, hi);
+		d[k] = v_cmpgt_u8(lo, q);
+	}
+
+	m = v_or_u8(v_or_u8(v_and_u8(b[0], b[1]), v_and_u8(b[1], b[2])),
+				v_or_u8(v_and_u8(b[2], b[3]), v_and_u8(b[3], b[0])));
+	m = v_or_u8(m, v_or_u8(v_or_u8(v_and_u8(d[0], d[1]), v_and_u8(d[1], d[2])),
+						v_or_u8(v_and_u8(d[2], d[3]), v_and_u8(d[3], d[0]))));
+	if (!v_any_u8(m)) {
+		return m;
+	}
+
+	rb = rd = run = v_setall_u8(0);
+	for (int k=0; k<25; k++) {
+		v_u8 q = v_load_u8(p + ofs[k & 15]);
+		v_u8 bk = v_cmpgt_u8(q, hi), dk = v_cmpgt_u8(lo, q);
+
+		/* runs count up in lanes that continue and restart at zero */
+		rb = v_and_u8(v_sub_u8(rb, bk), bk);
+		rd = v_and_u8(v_sub_u8(rd, dk), dk);
+		run = v_max_u8(run, v_max_u8(rb, rd));
+	}
+
+	return v_and_u8(m, v_cmpgt_u8(run, v_setall_u8(8)));
+}
+
+/* scores of one row, zero for pixels that are not corners */
+static void fast_score_row(const uint8_t *img, size_t stride, size_t width,
+						size_t y, int threshold, const long *ofs,
+						uint8_t *score)
+{
+	const uint8_t *row = img + y * stride;
+	const v_u8 vt = v_setall_u8(threshold);
+	size_t n = width - 6;
+
+	memset(score, 0, width);
+
+	if (n < 16) {
+		for (size_t x=3; x+3<width; x++) {
+			int s = fast_score_px(row + x, threshold, ofs);
+
+			score[x] = s >= threshold ? s : 0;
+		}
+		return;
+	}
+
+	for (size_t i=0; i<n; i+=16) {
+		uint8_t flag[16];
+		v_u8 m;
+
+		if (i + 16 > n) {
+			i = n - 16;
+		}
+
+		m = fast_test16(row + 3 + i, vt, ofs);
+		if (!v_any_u8(m)) {
+			continue;
+		}
+
+		v_store_u8(flag, m);
+		for (int k=0; k<16; k++) {
+			if (flag[k]) {
+				score[3 + i + k] = fast_score_px(row + 3 + i + k, threshold, ofs);
+			}
+		}
+	}
+}
+
+static int fast_is_max(const uint8_t *up, const uint8_t *cur,
+					const uint8_t *dn, size_t x)
+{
+	int s = cur[x];
+
+	return s > up[x - 1] && s > up[x] && s > up[x + 1] &&
+			s > cur[x - 1] && s > cur[x + 1] &&
+			s > dn[x - 1] && s > dn[x] && s > dn[x + 1];
+}
+
+static void fast_emit_row(struct vlib_corners *corners, const uint8_t *up,
+						const uint8_t *cur, const uint8_t *dn,
+						size_t width, size_t y)
+{
+	for (size_t x=3; x+3<width; x++) {
+		if (!cur[x] || (up && !fast_is_max(up, cur, dn, x))) {
+			continue;
+		}
+
+		if (corners->count == corners->capacity) {
+			return;
+		}
+
+		corners->x[corners->count] = x;
+		corners->y[corners->count] = y;
+		corners->score[corners->count] = cur[x];
+		corners->count++;
+	}
+}
+
+/**
+ * vlib_fast_detect - detect FAST-9 corners
+ * @img: 8-bit image
+ * @stride: line stride of @img in bytes
+ * @width: image width
+ * @height: image height
+ * @threshold: intensity difference threshold, 1..254
+ * @nms: non-maximum suppression on the score in 3x3 neighbourhoods
+ * @corners: list the corners are written to
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_fast_detect(const uint8_t *img, size_t stride,
+				size_t width, size_t height, int threshold, int nms,
+				struct vlib_corners *corners)
+{
+	long ofs[16];
+	uint8_t *buf, *row[3];
+
+	corners->count = 0;
+
+	if (!img || threshold < 1 || threshold > 254 ||
+		width > UINT16_MAX || height > UINT16_MAX) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (width < 7 || height < 7) {
+		return VLIB_SUCCESS;
+	}
+
+	buf = calloc(3, width);
+	if (!buf) {
+		return VLIB_ERROR_NO_MEM;
+	}
+	for (int k=0; k<3; k++) {
+		row[k] = buf + k * width;
+	}
+
+	fast_offsets(stride, ofs);
+
+	/* rolling scores of rows y - 2, y - 1 and y, row 2 has no corners */
+	for (size_t y=3; y+3<height; y++) {
+		uint8_t *t = row[0];
+
+		row[0] = row[1];
+		row[1] = row[2];
+		row[2] = t;
+		fast_score_row(img, stride, width, y, threshold, ofs, row[2]);
+
+		if (!nms) {
+			fast_emit_row(corners, NULL, row[2], NULL, width, y);
+		} else if (y > 3) {
+			fast_emit_row(corners, row[0], row[1], row[2], width, y - 1);
+		}
+	}
+
+	/* the last row with corners, the row below has none */
+	if (nms) {
+		memset(row[0], 0, width);
+		fast_emit_row(corners, row[1], row[2], row[0], width, height - 4);
+	}
+
+	free(buf);
+
+	return VLIB_SUCCESS;
+}
+
+/* Grid detection */
+
+/* rows of cells per band boundary */
+#define FAST_GRAIN		1
+
+struct vlib_fast {
+	struct vlib_fast_params p;
+	size_t width;
+	size_t height;
+	size_t cols;
+	size_t rows;
+	/* max_per_cell slots per cell, strongest first */
+	uint16_t *bx;
+	uint16_t *by;
+	uint8_t *bs;
+	uint16_t *bn;				/* corners per cell */
+	size_t *start;				/* cols * rows + 1 list offsets */
+};
+
+struct fast_job {
+	struct vlib_fast *fd;
+	const uint8_t *img;
+	size_t stride;
+	long ofs[16];
+};
+
+/* keep the max_per_cell strongest, earlier corners win ties */
+static void fast_cell_insert(struct vlib_fast *fd, size_t x, size_t y, int s)
+{
+	size_t cell = (y / fd->p.cell_size) * fd->cols + x / fd->p.cell_size;
+	size_t k = fd->p.max_per_cell;
+	uint16_t *bx = fd->bx + cell * k, *by = fd->by + cell * k;
+	uint8_t *bs = fd->bs + cell * k;
+	size_t n = fd->bn[cell], i;
+
+	if (n == k) {
+		if (s <= bs[k - 1]) {
+			return;
+		}
+		n--;
+	} else {
+		fd->bn[cell]++;
+	}
+
+	for (i=n; i>0 && bs[i - 1]<s; i--) {
+		bx[i] = bx[i - 1];
+		by[i] = by[i - 1];
+		bs[i] = bs[i - 1];
+	}
+
+	bx[i] = x;
+	by[i] = y;
+	bs[i] = s;
+}
+
+static void fast_grid_band(void *arg, size_t start, size_t end)
+{
+	struct fast_job *job = arg;
+	struct vlib_fast *fd = job->fd;
+	const size_t w = fd->width, h = fd->height;
+	size_t y0 = start * fd->p.cell_size;
+	size_t y1 = end * fd->p.cell_size < h ? end * fd->p.cell_size : h;
+	uint8_t *buf, *row[3];
+
+	memset(fd->bn + start * fd->cols, 0,
+			(end - start) * fd->cols * sizeof(*fd->bn));
+
+	/* corners are found on rows 3 .. h - 4 */
+	y0 = y0 > 3 ? y0 : 3;
+	y1 = y1 < h - 3 ? y1 : h - 3;
+	if (y0 >= y1) {
+		return;
+	}
+
+	buf = calloc(3, w);
+	if (!buf) {
+		vlib_warn("fast: out of memory\n");
+		return;
+	}
+	for (int k=0; k<3; k++) {
+		row[k] = buf + k * w;
+	}
+
+	/* rows y - 1, y and y + 1, the neighbour rows of the band included */
+	if (y0 > 3) {
+		fast_score_row(job->img, job->stride, w, y0 - 1, fd->p.threshold,
+					job->ofs, row[1]);
+	}
+	fast_score_row(job->img, job->stride, w, y0, fd->p.threshold, job->ofs,
+				row[2]);
+
+	for (size_t y=y0; y<y1; y++) {
+		uint8_t *t = row[0];
+
+		row[0] = row[1];
+		row[1] = row[2];
+		row[2] = t;
+		if (y + 1 < h - 3) {
+			fast_score_row(job->img, job->stride, w, y + 1, fd->p.threshold,
+						job->ofs, row[2]);
+		} else {
+			memset(row[2], 0, w);
+		}
+
+		for (size_t x=3; x+3<w; x++) {
+			if (row[1][x] &&
+				(!fd->p.nms || fast_is_max(row[0], row[1], row[2], x))) {
+				fast_cell_insert(fd, x, y, row[1][x]);
+			}
+		}
+	}
+
+	free(buf);
+}
+
+void vlib_fast_default_params(struct vlib_fast_params *params)
+{
+	params->threshold = 20;
+	params->nms = 1;
+	params->cell_size = 32;
+	params->max_per_cell = 8;
+}
+
+struct vlib_fast *vlib_fast_create(const struct vlib_fast_params *params,
+				size_t width, size_t height)
+{
+	struct vlib_fast *fd;
+	size_t cells;
+
+	if (params->threshold < 1 || params->threshold > 254 ||
+		params->cell_size < 8 || params->max_per_cell < 1 ||
+		params->max_per_cell > UINT16_MAX) {
+		VLIB_REPORT_ERR("fast: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	if (width < 7 || height < 7 || width > UINT16_MAX || height > UINT16_MAX) {
+		VLIB_REPORT_ERR("fast: %zux%zu not supported", width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	fd = calloc(1, sizeof(*fd));
+	if (!fd) {
+		return NULL;
+	}
+
+	fd->p = *params;
+	fd->width = width;
+	fd->height = height;
+	fd->cols = (width + params->cell_size - 1) / params->cell_size;
+	fd->rows = (height + params->cell_size - 1) / params->cell_size;
+
+	cells = fd->cols * fd->rows;
+	fd->bx = malloc(cells * params->max_per_cell * sizeof(*fd->bx));
+	fd->by = malloc(cells * params->max_per_cell * sizeof(*fd->by));
+	fd->bs = malloc(cells * params->max_per_cell * sizeof(*fd->bs));
+	fd->bn = malloc(cells * sizeof(*fd->bn));
+	fd->start = malloc((cells + 1) * sizeof(*fd->start));
+	if (!fd->bx || !fd->by || !fd->bs || !fd->bn || !fd->start) {
+		vlib_fast_destroy(fd);
+		return NULL;
+	}
+
+	return fd;
+}
+
+void vlib_fast_destroy(struct vlib_fast *fd)
+{
+	if (!fd) {
+		return;
+	}
+
+	free(fd->bx);
+	free(fd->by);
+	free(fd->bs);
+	free(fd->bn);
+	free(fd->start);
+	free(fd);
+}
+
+/* list capacity that holds every corner the grid can keep */
+size_t vlib_fast_capacity(const struct vlib_fast *fd)
+{
+	return fd->cols * fd->rows * fd->p.max_per_cell;
+}
+
+/**
+ * vlib_fast_detect_grid - detect the strongest FAST-9 corners of each cell
+ * @fd: grid detector
+ * @img: 8-bit image of the size @fd was created for
+ * @stride: line stride of @img in bytes
+ * @corners: list the corners are written to
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_fast_detect_grid(struct vlib_fast *fd,
+				const uint8_t *img, size_t stride,
+				struct vlib_corners *corners)
+{
+	struct fast_job job = {
+		.fd = fd,
+		.img = img,
+		.stride = stride,
+	};
+	size_t cells = fd->cols * fd->rows, n = 0;
+	int ret;
+
+	corners->count = 0;
+
+	if (!img) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	fast_offsets(stride, job.ofs);
+	ret = vlib_parallel_for(fd->rows, FAST_GRAIN, fast_grid_band, &job);
+	if (ret) {
+		return ret;
+	}
+
+	for (size_t c=0; c<cells; c++) {
+		size_t k = fd->p.max_per_cell;
+
+		fd->start[c] = n;
+		for (size_t i=0; i<fd->bn[c] && n<corners->capacity; i++) {
+			corners->x[n] = fd->bx[c * k + i];
+			corners->y[n] = fd->by[c * k + i];
+			corners->score[n] = fd->bs[c * k + i];
+			n++;
+		}
+	}
+	fd->start[cells] = n;
+	corners->count = n;
+
+	return VLIB_SUCCESS;
+}
+
+void vlib_fast_get_cells(const struct vlib_fast *fd, size_t *cols,
+				size_t *rows, const size_t **start)
+{
+	*cols = fd->cols;
+	*rows = fd->rows;
+	*start = fd->start;
+}
@@ -0,0 +1,488 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "filter_graph.h"
+#include "helper.h"
+#include "image.h"
+#include "video_int.h"
+
+/* L2 budget for the lines of all buffers touched by one strip */
+#define FILTER_GRAPH_STRIP_BYTES	(256 * 1024)
+#define FILTER_GRAPH_STRIP_MIN		16
+
+/* frame geometry between two stages */
+struct filter_graph_buf {
+	unsigned char *data;
+	size_t size;
+	int width;
+	int height;
+	int stride;
+	uint32_t fourcc;
+};
+
+struct filter_graph_stage {
+	struct filter_s *fs;
+	/* requested output format, 0 to inherit from the stage input */
+	uint32_t fourcc;
+	size_t width;
+	size_t height;
+};
+
+struct filter_graph {
+	struct filter_ops ops;
+	struct filter_graph_stage stages[FILTER_GRAPH_MAX_STAGES];
+	size_t num_stages;
+	/* buffers between stages, buf[0] and buf[num_stages] are the frames
+	 * passed in by the pipeline */
+	struct filter_graph_buf buf[FILTER_GRAPH_MAX_STAGES + 1];
+	size_t strip_lines;
+	size_t strip_lines_user;
+};
+
+static const char *filter_graph_modes[] = {
+	"Fused",
+	"Frame",
+};
+
+static void filter_graph_free_bufs(struct filter_graph *fg)
+{
+	for (size_t i=1; i<fg->num_stages; i++) {
+		free(fg->buf[i].data);
+		fg->buf[i].data = NULL;
+		fg->buf[i].size = 0;
+	}
+}
+
+static size_t filter_graph_calc_strip(const struct filter_graph *fg)
+{
+	size_t h_out = fg->buf[fg->num_stages].height;
+	size_t bytes = 0;
+	size_t lines;
+
+	if (fg->strip_lines_user) {
+		lines = fg->strip_lines_user;
+	} else {
+		/* bytes of all buffers per output line */
+		for (size_t i=0; i<=fg->num_stages; i++) {
+			bytes += vlib_image_size(fg->buf[i].fourcc, fg->buf[i].height,
+									fg->buf[i].stride) / h_out;
+		}
+
+		lines = bytes ? FILTER_GRAPH_STRIP_BYTES / bytes : h_out;
+		if (lines < FILTER_GRAPH_STRIP_MIN) {
+			lines = FILTER_GRAPH_STRIP_MIN;
+		}
+	}
+
+	lines = (lines + 1) & ~1;
+
+	return lines < h_out ? lines : h_out;
+}
+
+static int filter_graph_init(struct filter_s *fs,
+							const struct filter_init_data *fid)
+{
+	struct filter_graph *fg = fs->data;
+	struct filter_init_data sfid;
+
+	if (!fg->num_stages) {
+		return -1;
+	}
+
+	filter_graph_free_bufs(fg);
+
+	fg->buf[0].width = fid->in_width;
+	fg->buf[0].height = fid->in_height;
+	fg->buf[0].fourcc = fid->in_fourcc;
+	fg->buf[0].stride = vlib_image_stride(fid->in_fourcc, fid->in_width);
+	fg->buf[fg->num_stages].width = fid->out_width;
+	fg->buf[fg->num_stages].height = fid->out_height;
+	fg->buf[fg->num_stages].fourcc = fid->out_fourcc;
+	fg->buf[fg->num_stages].stride = vlib_image_stride(fid->out_fourcc,
+													fid->out_width);
+
+	for (size_t i=0; i<fg->num_stages; i++) {
+		struct filter_graph_stage *st = &fg->stages[i];
+		struct filter_graph_buf *in = &fg->buf[i];
+		struct filter_graph_buf *out = &fg->buf[i + 1];
+
+		/* the last stage writes the pipeline output */
+		if (i + 1 < fg->num_stages) {
+			out->width = st->width ? st->width : (size_t)in->width;
+			out->height = st->height ? st->height : (size_t)in->height;
+			out->fourcc = st->fourcc ? st->fourcc : in->fourcc;
+			out->stride = vlib_image_stride(out->fourcc, out->width);
+			out->size = vlib_image_size(out->fourcc, out->height,
+										out->stride);
+			if (!out->stride || !out->size) {
+				VLIB_REPORT_ERR("stage '%s': unsupported format '%.4s'",
+								filter_type_get_display_text(st->fs),
+								(const char *)&out->fourcc);
+				vlib_dbg("%s\n", vlib_errstr);
+				goto err;
+			}
+
+			out->data = malloc(out->size);
+			if (!out->data) {
+				goto err;
+			}
+		}
+
+		sfid.in_width = in->width;
+		sfid.in_height = in->height;
+		sfid.in_fourcc = in->fourcc;
+		sfid.out_width = out->width;
+		sfid.out_height = out->height;
+		sfid.out_fourcc = out->fourcc;
+
+		if (st->fs->ops->init(st->fs, &sfid)) {
+			VLIB_REPORT_ERR("stage '%s': %zux%zu '%.4s' -> %zux%zu '%.4s' not supported",
+							filter_type_get_display_text(st->fs),
+							sfid.in_width, sfid.in_height,
+							(const char *)&sfid.in_fourcc,
+							sfid.out_width, sfid.out_height,
+							(const char *)&sfid.out_fourcc);
+			vlib_dbg("%s\n", vlib_errstr);
+			goto err;
+		}
+	}
+
+	fg->strip_lines = filter_graph_calc_strip(fg);
+
+	return 0;
+
+err:
+	filter_graph_free_bufs(fg);
+	return -1;
+}
+
+static void filter_graph_run_stage(struct filter_graph *fg, size_t i,
+								int line_start, int line_end)
+{
+	struct filter_s *sfs = fg->stages[i].fs;
+	struct filter_graph_buf *in = &fg->buf[i];
+	struct filter_graph_buf *out = &fg->buf[i + 1];
+
+	if (sfs->ops->func_lines &&
+		(line_start != 0 || line_end != out->height)) {
+		sfs->ops->func_lines(sfs, in->data, out->data,
+							in->height, in->width, in->stride,
+							out->height, out->width, out->stride,
+							line_start, line_end);
+	} else {
+		sfs->ops->func(sfs, in->data, out->data,
+					in->height, in->width, in->stride,
+					out->height, out->width, out->stride);
+	}
+}
+
+static int filter_graph_lines_required(const struct filter_graph *fg, size_t i,
+									int line_end)
+{
+	struct filter_s *sfs = fg->stages[i].fs;
+	int h_in = fg->buf[i].height;
+	int h_out = fg->buf[i + 1].height;
+	int lines;
+
+	if (sfs->ops->lines_required) {
+		lines = sfs->ops->lines_required(sfs, line_end, h_in, h_out);
+	} else {
+		lines = (line_end * h_in + h_out - 1) / h_out;
+	}
+
+	/* keep strips aligned for 4:2:0 chroma */
+	lines = (lines + 1) & ~1;
+
+	return lines < h_in ? lines : h_in;
+}
+
+/*
+ * Pull strips through the graph: for every strip of the output compute the
+ * lines each stage has to provide, then run the stages front to back on
+ * the lines not produced yet.
+ */
+static void filter_graph_run_fused(struct filter_graph *fg, size_t first)
+{
+	int done[FILTER_GRAPH_MAX_STAGES] = { 0 };
+	int need[FILTER_GRAPH_MAX_STAGES];
+	size_t n = fg->num_stages;
+	int h_out = fg->buf[n].height;
+
+	for (size_t i=0; i<first; i++) {
+		done[i] = fg->buf[i + 1].height;
+	}
+
+	for (int end=fg->strip_lines; ; end+=fg->strip_lines) {
+		if (end > h_out) {
+			end = h_out;
+		}
+
+		need[n - 1] = end;
+		for (size_t i=n-1; i>first; i--) {
+			if (need[i] <= done[i]) {
+				need[i - 1] = done[i - 1];
+				continue;
+			}
+
+			/* stages without line support are barriers */
+			if (!fg->stages[i].fs->ops->func_lines) {
+				need[i] = fg->buf[i + 1].height;
+			}
+
+			need[i - 1] = filter_graph_lines_required(fg, i, need[i]);
+			if (!fg->stages[i].fs->ops->func_lines) {
+				need[i - 1] = fg->buf[i].height;
+			}
+			if (need[i - 1] < done[i - 1]) {
+				need[i - 1] = done[i - 1];
+			}
+		}
+
+		if (!fg->stages[first].fs->ops->func_lines) {
+			need[first] = fg->buf[first + 1].height;
+		}
+
+		for (size_t i=first; i<n; i++) {
+			if (need[i] > done[i]) {
+				filter_graph_run_stage(fg, i, done[i], need[i]);
+				done[i] = need[i];
+			}
+		}
+
+		if (end == h_out) {
+			break;
+		}
+	}
+}
+
+static void filter_graph_run(struct filter_s *fs, size_t first)
+{
+	struct filter_graph *fg = fs->data;
+
+	if (fs->mode == FILTER_GRAPH_MODE_FUSED && first < fg->num_stages) {
+		filter_graph_run_fused(fg, first);
+		return;
+	}
+
+	for (size_t i=first; i<fg->num_stages; i++) {
+		filter_graph_run_stage(fg, i, 0, fg->buf[i + 1].height);
+	}
+}
+
+static void filter_graph_set_frames(struct filter_graph *fg,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	fg->buf[0].data = frm_data_in;
+	fg->buf[0].height = height_in;
+	fg->buf[0].width = width_in;
+	fg->buf[0].stride = stride_in;
+	fg->buf[fg->num_stages].data = frm_data_out;
+	fg->buf[fg->num_stages].height = height_out;
+	fg->buf[fg->num_stages].width = width_out;
+	fg->buf[fg->num_stages].stride = stride_out;
+}
+
+static void filter_graph_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	struct filter_graph *fg = fs->data;
+
+	filter_graph_set_frames(fg, frm_data_in, frm_data_out, height_in,
+						width_in, stride_in, height_out, width_out,
+						stride_out);
+	filter_graph_run(fs, 0);
+}
+
+/* the first stage takes two input frames, the rest of the graph one */
+static void filter_graph_func2(struct filter_s *fs,
+						unsigned char *frame_prev, unsigned char *frame_curr,
+						unsigned char *frame_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	struct filter_graph *fg = fs->data;
+	struct filter_s *sfs = fg->stages[0].fs;
+	struct filter_graph_buf *out;
+
+	filter_graph_set_frames(fg, frame_curr, frame_out, height_in,
+						width_in, stride_in, height_out, width_out,
+						stride_out);
+
+	out = &fg->buf[1];
+	sfs->ops->func2(sfs, frame_prev, frame_curr, out->data,
+					height_in, width_in, stride_in,
+					out->height, out->width, out->stride);
+
+	filter_graph_run(fs, 1);
+}
+
+static const struct filter_s filter_graph_fs = {
+	.display_text = "Filter Graph",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = FILTER_GRAPH_MODE_FUSED,
+	.ops = NULL,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(filter_graph_modes),
+	.modes = filter_graph_modes,
+};
+
+/**
+ * filter_graph_create - Create an empty filter graph
+ * @display_text: Name of the graph shown in the filter list
+ *
+ * Return: Pointer to the graph filter on success, NULL otherwise.
+ */
+struct filter_s *filter_graph_create(const char *display_text)
+{
+	struct filter_s *fs;
+	struct filter_graph *fg;
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		return NULL;
+	}
+
+	fg = calloc(1, sizeof(*fg));
+	if (!fg) {
+		free(fs);
+		return NULL;
+	}
+
+	fg->ops.init = filter_graph_init;
+	fg->ops.func = filter_graph_func;
+
+	*fs = filter_graph_fs;
+	if (display_text) {
+		fs->display_text = display_text;
+	}
+	fs->ops = &fg->ops;
+	fs->data = fg;
+
+	return fs;
+}
+
+/**
+ * filter_graph_destroy - Free a filter graph
+ * @graph: Graph created by filter_graph_create()
+ *
+ * The stages are owned by the caller and not freed.
+ */
+void filter_graph_destroy(struct filter_s *graph)
+{
+	if (!graph) {
+		return;
+	}
+
+	filter_graph_free_bufs(graph->data);
+	free(graph->data);
+	free(graph);
+}
+
+/**
+ * filter_graph_add_stage - Append a filter to the graph
+ * @graph: Filter graph
+ * @stage: Filter to append
+ * @fourcc: Output format of the stage, 0 to keep the input format
+ * @width: Output width of the stage, 0 to keep the input width
+ * @height: Output height of the stage, 0 to keep the input height
+ *
+ * The output format of the last stage is always the pipeline output, its
+ * @fourcc, @width and @height are ignored. Only the first stage may use a
+ * two input func2.
+ *
+ * The graph initializes @stage for the geometry inside the graph, so
+ * @stage must not run on its own while the graph is in use. A registered
+ * filter may be a stage if the graph runs in its place, as the scaler
+ * does; its mode then applies to the graph.
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int filter_graph_add_stage(struct filter_s *graph, struct filter_s *stage,
+						uint32_t fourcc, size_t width, size_t height)
+{
+	struct filter_graph *fg;
+	struct filter_graph_stage *st;
+
+	if (!graph || !stage || !stage->ops) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	fg = graph->data;
+	if (fg->num_stages == FILTER_GRAPH_MAX_STAGES) {
+		VLIB_REPORT_ERR("filter graph supports at most %d stages",
+						FILTER_GRAPH_MAX_STAGES);
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_NOT_SUPPORTED;
+	}
+
+	if (stage->ops->func2 && fg->num_stages) {
+		VLIB_REPORT_ERR("'%s': two input filters must be the first stage",
+						filter_type_get_display_text(stage));
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_NOT_SUPPORTED;
+	}
+
+	if (!stage->ops->func && !stage->ops->func2) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	st = &fg->stages[fg->num_stages++];
+	st->fs = stage;
+	st->fourcc = fourcc;
+	st->width = width;
+	st->height = height;
+
+	fg->ops.func2 = fg->stages[0].fs->ops->func2 ? filter_graph_func2 : NULL;
+
+	return VLIB_SUCCESS;
+}
+
+size_t filter_graph_get_num_stages(const struct filter_s *graph)
+{
+	const struct filter_graph *fg = graph->data;
+
+	return fg->num_stages;
+}
+
+struct filter_s *filter_graph_get_stage(const struct filter_s *graph, size_t i)
+{
+	const struct filter_graph *fg = graph->data;
+
+	if (i >= fg->num_stages) {
+		return NULL;
+	}
+
+	return fg->stages[i].fs;
+}
+
+/**
+ * filter_graph_set_strip_lines - Override the strip height of fused mode
+ * @graph: Filter graph
+ * @lines: Output lines per strip, 0 to derive from the L2 budget
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int filter_graph_set_strip_lines(struct filter_s *graph, size_t lines)
+{
+	struct filter_graph *fg;
+
+	if (!graph) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	fg = graph->data;
+	fg->strip_lines_user = lines;
+	if (fg->buf[fg->num_stages].height) {
+		fg->strip_lines = filter_graph_calc_strip(fg);
+	}
+
+	return VLIB_SUCCESS;
+}
@@ -0,0 +1,485 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "harris.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* rows of cells per band boundary */
+#define HARRIS_GRAIN		1
+
+/* response outside the image, below every threshold */
+#define HARRIS_NONE			INT32_MIN
+
+/* products, in the order of the column sums */
+enum {
+	HARRIS_XX,
+	HARRIS_YY,
+	HARRIS_XY,
+	HARRIS_NUM_PRODUCTS,
+};
+
+struct vlib_harris {
+	struct vlib_harris_params p;
+	size_t width;
+	size_t height;
+	/* product line stride in elements, a multiple of 8 */
+	size_t stride;
+	/* 1 / block_size^2 in Q15, as the xf box filter */
+	int32_t div;
+	size_t cols;
+	size_t rows;
+	/* max_per_cell slots per cell, strongest first */
+	uint16_t *bx;
+	uint16_t *by;
+	int32_t *bs;
+	uint16_t *bn;				/* corners per cell */
+	size_t *start;				/* cols * rows + 1 list offsets */
+};
+
+struct harris_job {
+	struct vlib_harris *hd;
+	const uint8_t *img;
+	size_t stride;
+};
+
+/* line buffers of one band */
+struct harris_lines {
+	/* block_size + 1 product rows, row y in slot y % (block_size + 1) */
+	int16_t *prod[HARRIS_NUM_PRODUCTS];
+	/* column sums of the last block_size rows, block_size / 2 zero columns
+	 * on both sides */
+	int32_t *cs[HARRIS_NUM_PRODUCTS];
+	/* box sums of the current row */
+	int32_t *sum[HARRIS_NUM_PRODUCTS];
+	/* 2 * nms_radius + 1 response rows, nms_radius columns on both sides */
+	int32_t *score;
+	size_t score_stride;
+	int16_t *buf16;
+	int32_t *buf32;
+};
+
+static inline long harris_slot(long y, long n)
+{
+	return ((y % n) + n) % n;
+}
+
+/*
+ * Sobel gradients of row @y and their products (g * g) >> 6 as xFSquare
+ * and xFMultiply. |g| <= 1020, so g * 32 fits 16 bits and the high half of
+ * its product is the shifted product.
+ */
+static void harris_products_row(const struct vlib_harris *hd,
+								const struct harris_job *job, long y,
+								int16_t **p)
+{
+	const size_t w = hd->width, n = w - 2;
+	const uint8_t *up, *cur, *dn;
+
+	if (y < 1 || y >= (long)hd->height - 1) {
+		for (int k=0; k<HARRIS_NUM_PRODUCTS; k++) {
+			memset(p[k], 0, w * sizeof(int16_t));
+		}
+		return;
+	}
+
+	cur = job->img + y * job->stride;
+	up = cur - job->stride;
+	dn = cur + job->stride;
+
+	for (int k=0; k<HARRIS_NUM_PRODUCTS; k++) {
+		p[k][0] = 0;
+		p[k][w - 1] = 0;
+	}
+
+	for (size_t i=0; i<n; i+=8) {
+		size_t x;
+		v_s16 gx, gy;
+
+		if (i + 8 > n) {
+			i = n - 8;
+		}
+		x = i + 1;
+
+		gx = v_add_s16(v_sub_s16(v_load_expand_u8(up + x + 1),
+								v_load_expand_u8(up + x - 1)),
+						v_sub_s16(v_load_expand_u8(dn + x + 1),
+								v_load_expand_u8(dn + x - 1)));
+		gx = v_add_s16(gx, v_shl_s16(v_sub_s16(v_load_expand_u8(cur + x + 1),
+											v_load_expand_u8(cur + x - 1)), 1));
+		gy = v_add_s16(v_sub_s16(v_load_expand_u8(dn + x - 1),
+								v_load_expand_u8(up + x - 1)),
+						v_sub_s16(v_load_expand_u8(dn + x + 1),
+								v_load_expand_u8(up + x + 1)));
+		gy = v_add_s16(gy, v_shl_s16(v_sub_s16(v_load_expand_u8(dn + x),
+											v_load_expand_u8(up + x)), 1));
+
+		gx = v_shl_s16(gx, 5);
+		gy = v_shl_s16(gy, 5);
+		v_store_s16(p[HARRIS_XX] + x, v_mulhi_s16(gx, gx));
+		v_store_s16(p[HARRIS_YY] + x, v_mulhi_s16(gy, gy));
+		v_store_s16(p[HARRIS_XY] + x, v_mulhi_s16(gx, gy));
+	}
+}
+
+/*
+ * Move the ring down by one row: the products of row @y replace those of
+ * row y - block_size, in the column sums as well.
+ */
+static void harris_advance(const struct vlib_harris *hd,
+						const struct harris_job *job,
+						struct harris_lines *l, long y)
+{
+	const long n = hd->p.block_size + 1;
+	const size_t add = harris_slot(y, n) * hd->stride;
+	const size_t sub = harris_slot(y - hd->p.block_size, n) * hd->stride;
+	int16_t *p[HARRIS_NUM_PRODUCTS];
+
+	for (int k=0; k<HARRIS_NUM_PRODUCTS; k++) {
+		p[k] = l->prod[k] + add;
+	}
+	harris_products_row(hd, job, y, p);
+
+	for (int k=0; k<HARRIS_NUM_PRODUCTS; k++) {
+		const int16_t *pa = l->prod[k] + add, *ps = l->prod[k] + sub;
+		int32_t *c = l->cs[k];
+
+		for (size_t x=0; x<hd->stride; x+=8) {
+			v_s16 a = v_load_s16(pa + x), s = v_load_s16(ps + x);
+			v_s32 lo = v_load_s32(c + x), hi = v_load_s32(c + x + 4);
+
+			lo = v_sub_s32(v_add_s32(lo, v_expand_lo_s16(a)), v_expand_lo_s16(s));
+			hi = v_sub_s32(v_add_s32(hi, v_expand_hi_s16(a)), v_expand_hi_s16(s));
+			v_store_s32(c + x, lo);
+			v_store_s32(c + x + 4, hi);
+		}
+	}
+}
+
+/*
+ * det - k * trace^2 of the box means, as xFComputeScore. The means are
+ * those of the xf box filter, sum * div >> 15, shifted right by 2 more.
+ */
+static inline int32_t harris_response(const struct vlib_harris *hd,
+									int32_t sxx, int32_t syy, int32_t sxy)
+{
+	int32_t a = (sxx * hd->div) >> 17;
+	int32_t b = (syy * hd->div) >> 17;
+	int32_t c = (sxy * hd->div) >> 17;
+	int32_t t = a + b;
+
+	return a * b - c * c - (int32_t)(((int64_t)t * t * hd->p.k) >> 16);
+}
+
+/* box sums along the row of the column sums, then the response */
+static void harris_score_row(const struct vlib_harris *hd,
+							struct harris_lines *l, int32_t *score)
+{
+	const long r = hd->p.block_size / 2;
+
+	for (int k=0; k<HARRIS_NUM_PRODUCTS; k++) {
+		const int32_t *c = l->cs[k];
+		int32_t *s = l->sum[k];
+
+		for (size_t x=0; x<hd->width; x+=4) {
+			v_s32 v = v_load_s32(c + x - r);
+
+			for (long j=1-r; j<=r; j++) {
+				v = v_add_s32(v, v_load_s32(c + x + j));
+			}
+			v_store_s32(s + x, v);
+		}
+	}
+
+	for (size_t x=0; x<hd->width; x++) {
+		score[x] = harris_response(hd, l->sum[HARRIS_XX][x],
+								l->sum[HARRIS_YY][x], l->sum[HARRIS_XY][x]);
+	}
+}
+
+/* keep the max_per_cell strongest, earlier corners win ties */
+static void harris_cell_insert(struct vlib_harris *hd, size_t x, size_t y,
+							int32_t s)
+{
+	size_t cell = (y / hd->p.cell_size) * hd->cols + x / hd->p.cell_size;
+	size_t k = hd->p.max_per_cell;
+	uint16_t *bx = hd->bx + cell * k, *by = hd->by + cell * k;
+	int32_t *bs = hd->bs + cell * k;
+	size_t n = hd->bn[cell], i;
+
+	if (n == k) {
+		if (s <= bs[k - 1]) {
+			return;
+		}
+		n--;
+	} else {
+		hd->bn[cell]++;
+	}
+
+	for (i=n; i>0 && bs[i - 1]<s; i--) {
+		bx[i] = bx[i - 1];
+		by[i] = by[i - 1];
+		bs[i] = bs[i - 1];
+	}
+
+	bx[i] = x;
+	by[i] = y;
+	bs[i] = s;
+}
+
+/* corners of row @y, whose window rows are all in the response ring */
+static void harris_nms_row(struct vlib_harris *hd,
+						const struct harris_lines *l, long y)
+{
+	const long nr = hd->p.nms_radius, n = 2 * nr + 1;
+	const int32_t *row[5];
+
+	for (long j=0; j<n; j++) {
+		row[j] = l->score + harris_slot(y - nr + j, n) * l->score_stride + nr;
+	}
+
+	for (long x=0; x<(long)hd->width; x++) {
+		int32_t s = row[nr][x];
+		int max = 1;
+
+		if (s <= hd->p.threshold) {
+			continue;
+		}
+
+		for (long j=0; j<n && max; j++) {
+			for (long i=-nr; i<=nr; i++) {
+				if ((j != nr || i) && row[j][x + i] >= s) {
+					max = 0;
+					break;
+				}
+			}
+		}
+
+		if (max) {
+			harris_cell_insert(hd, x, y, s);
+		}
+	}
+}
+
+static int harris_lines_alloc(const struct vlib_harris *hd,
+							struct harris_lines *l)
+{
+	const size_t r = hd->p.block_size / 2, n = 2 * hd->p.nms_radius + 1;
+	const size_t ncs = hd->stride + 2 * r;
+	const size_t nprod = (hd->p.block_size + 1) * hd->stride;
+	int32_t *p;
+
+	l->score_stride = hd->width + 2 * hd->p.nms_radius;
+	l->buf16 = calloc(HARRIS_NUM_PRODUCTS * nprod, sizeof(*l->buf16));
+	l->buf32 = calloc(HARRIS_NUM_PRODUCTS * (ncs + hd->stride) +
+					n * l->score_stride, sizeof(*l->buf32));
+	if (!l->buf16 || !l->buf32) {
+		free(l->buf16);
+		free(l->buf32);
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	p = l->buf32;
+	for (int k=0; k<HARRIS_NUM_PRODUCTS; k++) {
+		l->prod[k] = l->buf16 + k * nprod;
+		l->cs[k] = p + r;
+		p += ncs;
+		l->sum[k] = p;
+		p += hd->stride;
+	}
+
+	l->score = p;
+	for (size_t i=0; i<n*l->score_stride; i++) {
+		l->score[i] = HARRIS_NONE;
+	}
+
+	return VLIB_SUCCESS;
+}
+
+static void harris_band(void *arg, size_t start, size_t end)
+{
+	struct harris_job *job = arg;
+	struct vlib_harris *hd = job->hd;
+	const long h = hd->height;
+	const long rb = hd->p.block_size / 2, nr = hd->p.nms_radius;
+	const long y0 = start * hd->p.cell_size;
+	const long y1 = (long)end * hd->p.cell_size < h ?
+					(long)end * hd->p.cell_size : h;
+	/* the response rows above the band are needed for the suppression */
+	const long ys = y0 - nr > 0 ? y0 - nr : 0;
+	struct harris_lines l;
+
+	memset(hd->bn + start * hd->cols, 0,
+			(end - start) * hd->cols * sizeof(*hd->bn));
+
+	if (harris_lines_alloc(hd, &l)) {
+		vlib_warn("harris: out of memory\n");
+		return;
+	}
+
+	/* fill the ring with the rows around ys - 1 */
+	for (long t=ys-hd->p.block_size; t<ys; t++) {
+		harris_advance(hd, job, &l, t + rb);
+	}
+
+	for (long t=ys; t<y1+nr; t++) {
+		int32_t *score = l.score + harris_slot(t, 2 * nr + 1) * l.score_stride + nr;
+
+		if (t < h) {
+			harris_advance(hd, job, &l, t + rb);
+			harris_score_row(hd, &l, score);
+		} else {
+			for (size_t x=0; x<hd->width; x++) {
+				score[x] = HARRIS_NONE;
+			}
+		}
+
+		if (t - nr >= y0) {
+			harris_nms_row(hd, &l, t - nr);
+		}
+	}
+
+	free(l.buf16);
+	free(l.buf32);
+}
+
+void vlib_harris_default_params(struct vlib_harris_params *params)
+{
+	params->block_size = 3;
+	params->nms_radius = 1;
+	params->threshold = 1000;
+	params->k = 2621;
+	params->cell_size = 32;
+	params->max_per_cell = 8;
+}
+
+struct vlib_harris *vlib_harris_create(
+				const struct vlib_harris_params *params,
+				size_t width, size_t height)
+{
+	static const int32_t div[] = { 3641, 1311, 669 };
+	struct vlib_harris *hd;
+	size_t cells;
+
+	if ((params->block_size != 3 && params->block_size != 5 &&
+		params->block_size != 7) ||
+		params->nms_radius < 1 || params->nms_radius > 2 ||
+		params->threshold < 0 || params->k < 0 || params->k > UINT16_MAX ||
+		params->cell_size < 8 || params->max_per_cell < 1 ||
+		params->max_per_cell > UINT16_MAX) {
+		VLIB_REPORT_ERR("harris: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	if (width < 10 || height < 3 || width > UINT16_MAX ||
+		height > UINT16_MAX) {
+		VLIB_REPORT_ERR("harris: %zux%zu not supported", width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	hd = calloc(1, sizeof(*hd));
+	if (!hd) {
+		return NULL;
+	}
+
+	hd->p = *params;
+	hd->width = width;
+	hd->height = height;
+	hd->stride = (width + 7) & ~7;
+	hd->div = div[params->block_size / 2 - 1];
+	hd->cols = (width + params->cell_size - 1) / params->cell_size;
+	hd->rows = (height + params->cell_size - 1) / params->cell_size;
+
+	cells = hd->cols * hd->rows;
+	hd->bx = malloc(cells * params->max_per_cell * sizeof(*hd->bx));
+	hd->by = malloc(cells * params->max_per_cell * sizeof(*hd->by));
+	hd->bs = malloc(cells * params->max_per_cell * sizeof(*hd->bs));
+	hd->bn = malloc(cells * sizeof(*hd->bn));
+	hd->start = malloc((cells + 1) * sizeof(*hd->start));
+	if (!hd->bx || !hd->by || !hd->bs || !hd->bn || !hd->start) {
+		vlib_harris_destroy(hd);
+		return NULL;
+	}
+
+	return hd;
+}
+
+void vlib_harris_destroy(struct vlib_harris *hd)
+{
+	if (!hd) {
+		return;
+	}
+
+	free(hd->bx);
+	free(hd->by);
+	free(hd->bs);
+	free(hd->bn);
+	free(hd->start);
+	free(hd);
+}
+
+/* list capacity that holds every corner the grid can keep */
+size_t vlib_harris_capacity(const struct vlib_harris *hd)
+{
+	return hd->cols * hd->rows * hd->p.max_per_cell;
+}
+
+/**
+ * vlib_harris_detect - detect the strongest Harris corners of each cell
+ * @hd: Harris detector
+ * @img: 8-bit image of the size @hd was created for
+ * @stride: line stride of @img in bytes
+ * @corners: list the corners are written to
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_harris_detect(struct vlib_harris *hd,
+				const uint8_t *img, size_t stride,
+				struct vlib_corners *corners)
+{
+	struct harris_job job = {
+		.hd = hd,
+		.img = img,
+		.stride = stride,
+	};
+	size_t cells = hd->cols * hd->rows, n = 0;
+	int ret;
+
+	corners->count = 0;
+
+	if (!img) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	ret = vlib_parallel_for(hd->rows, HARRIS_GRAIN, harris_band, &job);
+	if (ret) {
+		return ret;
+	}
+
+	for (size_t c=0; c<cells; c++) {
+		size_t k = hd->p.max_per_cell;
+
+		hd->start[c] = n;
+		for (size_t i=0; i<hd->bn[c] && n<corners->capacity; i++) {
+			corners->x[n] = hd->bx[c * k + i];
+			corners->y[n] = hd->by[c * k + i];
+			corners->score[n] = hd->bs[c * k + i];
+			n++;
+		}
+	}
+	hd->start[cells] = n;
+	corners->count = n;
+
+	return VLIB_SUCCESS;
+}
+
+void vlib_harris_get_cells(const struct vlib_harris *hd, size_t *cols,
+				size_t *rows, const size_t **start)
+{
+	*cols = hd->cols;
+	*rows = hd->rows;
+	*start = hd->start;
+}
@@ -0,0 +1,19 @@
+#include <time.h>
+
+#include "helper.h"
+
+/**
+ * vlib_ms_since - Time elapsed since a point in time
+ * @start: Start time taken with clock_gettime(CLOCK_MONOTONIC)
+ *
+ * Return: Milliseconds elapsed since @start.
+ */
+float vlib_ms_since(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000.0f +
+			(now.tv_nsec - start->tv_nsec) / 1000000.0f;
+}
@@ -0,0 +1,393 @@
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "helper.h"
+#include "histogram.h"
+#include "luma_stage.h"
+#include "parallel.h"
+#include "video_int.h"
+
+/* rows per band slot */
+#define HISTOGRAM_GRAIN		32
+
+/* copies of each band histogram, consecutive pixels count into different ones */
+#define HISTOGRAM_BANKS		4
+
+struct histogram_job {
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+	size_t width;
+	size_t pitch;
+	const uint8_t *lut;
+	uint32_t *bands;			/* histogram per band, NULL to only map */
+};
+
+static void histogram_count_row(const uint8_t *s, size_t n, size_t pitch,
+							uint32_t (*bank)[VLIB_HISTOGRAM_BINS])
+{
+	size_t x = 0;
+
+	for (; x+4<=n; x+=4, s+=4*pitch) {
+		bank[0][s[0]]++;
+		bank[1][s[pitch]]++;
+		bank[2][s[2 * pitch]]++;
+		bank[3][s[3 * pitch]]++;
+	}
+	for (; x<n; x++, s+=pitch) {
+		bank[0][s[0]]++;
+	}
+}
+
+static void histogram_map_row(const uint8_t *s, uint8_t *d, size_t n,
+							size_t pitch, const uint8_t *lut)
+{
+	for (size_t x=0; x<n; x++) {
+		d[x * pitch] = lut[s[x * pitch]];
+	}
+}
+
+static void histogram_map_count_row(const uint8_t *s, uint8_t *d, size_t n,
+							size_t pitch, const uint8_t *lut,
+							uint32_t (*bank)[VLIB_HISTOGRAM_BINS])
+{
+	size_t x = 0;
+
+	for (; x+4<=n; x+=4, s+=4*pitch, d+=4*pitch) {
+		uint8_t v0 = s[0], v1 = s[pitch], v2 = s[2 * pitch], v3 = s[3 * pitch];
+
+		bank[0][v0]++;
+		bank[1][v1]++;
+		bank[2][v2]++;
+		bank[3][v3]++;
+		d[0] = lut[v0];
+		d[pitch] = lut[v1];
+		d[2 * pitch] = lut[v2];
+		d[3 * pitch] = lut[v3];
+	}
+	for (; x<n; x++, s+=pitch, d+=pitch) {
+		bank[0][s[0]]++;
+		d[0] = lut[s[0]];
+	}
+}
+
+static void histogram_band(void *arg, size_t start, size_t end)
+{
+	struct histogram_job *job = arg;
+	uint32_t bank[HISTOGRAM_BANKS][VLIB_HISTOGRAM_BINS];
+
+	if (job->bands) {
+		memset(bank, 0, sizeof(bank));
+	}
+
+	for (size_t y=start; y<end; y++) {
+		const uint8_t *s = job->src + y * job->stride_src;
+		uint8_t *d = job->dst ? job->dst + y * job->stride_dst : NULL;
+
+		if (!job->bands) {
+			histogram_map_row(s, d, job->width, job->pitch, job->lut);
+		} else if (d) {
+			histogram_map_count_row(s, d, job->width, job->pitch, job->lut,
+									bank);
+		} else {
+			histogram_count_row(s, job->width, job->pitch, bank);
+		}
+	}
+
+	if (job->bands) {
+		uint32_t *hist = job->bands + start / HISTOGRAM_GRAIN *
+						VLIB_HISTOGRAM_BINS;
+
+		for (size_t i=0; i<VLIB_HISTOGRAM_BINS; i++) {
+			hist[i] = bank[0][i] + bank[1][i] + bank[2][i] + bank[3][i];
+		}
+	}
+}
+
+/* runs @job on all cores, sums the band histograms up into @hist */
+static int histogram_run(struct histogram_job *job, size_t height,
+						uint32_t *hist)
+{
+	size_t slots = (height + HISTOGRAM_GRAIN - 1) / HISTOGRAM_GRAIN;
+	int ret;
+
+	if (hist) {
+		job->bands = calloc(slots, VLIB_HISTOGRAM_BINS * sizeof(*job->bands));
+		if (!job->bands) {
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	ret = vlib_parallel_for(height, HISTOGRAM_GRAIN, histogram_band, job);
+
+	if (hist) {
+		memset(hist, 0, VLIB_HISTOGRAM_BINS * sizeof(*hist));
+		for (size_t s=0; s<slots; s++) {
+			const uint32_t *b = job->bands + s * VLIB_HISTOGRAM_BINS;
+
+			for (size_t i=0; i<VLIB_HISTOGRAM_BINS; i++) {
+				hist[i] += b[i];
+			}
+		}
+		free(job->bands);
+	}
+
+	return ret;
+}
+
+/**
+ * vlib_histogram - Histogram of an 8-bit image on all cores
+ * @src: Source image
+ * @stride: Line stride of @src in bytes
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ * @pitch: Bytes between two pixels
+ * @hist: VLIB_HISTOGRAM_BINS counts
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_histogram(const uint8_t *src, size_t stride, size_t width,
+				size_t height, size_t pitch, uint32_t *hist)
+{
+	struct histogram_job job = {
+		.src = src,
+		.stride_src = stride,
+		.width = width,
+		.pitch = pitch,
+	};
+
+	if (!src || !hist || !pitch) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return histogram_run(&job, height, hist);
+}
+
+/**
+ * vlib_histogram_lut - Map an 8-bit image through a table on all cores
+ * @src: Source image
+ * @stride_src: Line stride of @src in bytes
+ * @dst: Output image of the same size, may be @src
+ * @stride_dst: Line stride of @dst in bytes
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ * @pitch: Bytes between two pixels
+ * @lut: VLIB_HISTOGRAM_BINS output values
+ * @hist: Histogram of @src counted on the way, may be NULL
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_histogram_lut(const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t width, size_t height, size_t pitch,
+				const uint8_t *lut, uint32_t *hist)
+{
+	struct histogram_job job = {
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.width = width,
+		.pitch = pitch,
+		.lut = lut,
+	};
+
+	if (!src || !dst || !lut || !pitch) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return histogram_run(&job, height, hist);
+}
+
+/**
+ * vlib_histogram_equalize_lut - Equalization table of a histogram
+ * @hist: VLIB_HISTOGRAM_BINS counts
+ * @lut: VLIB_HISTOGRAM_BINS output values
+ *
+ * The cumulative histogram is stretched to 0..255 from the lowest level
+ * present, as cv::equalizeHist.
+ */
+void vlib_histogram_equalize_lut(const uint32_t *hist, uint8_t *lut)
+{
+	uint64_t total = 0, sum = 0;
+	size_t i = 0;
+	float scale;
+
+	for (size_t j=0; j<VLIB_HISTOGRAM_BINS; j++) {
+		total += hist[j];
+	}
+
+	memset(lut, 0, VLIB_HISTOGRAM_BINS);
+	if (!total) {
+		return;
+	}
+
+	while (!hist[i]) {
+		i++;
+	}
+
+	if (hist[i] == total) {
+		memset(lut, i, VLIB_HISTOGRAM_BINS);
+		return;
+	}
+
+	scale = 255.0f / (total - hist[i]);
+	for (i++; i<VLIB_HISTOGRAM_BINS; i++) {
+		float v;
+
+		sum += hist[i];
+		v = sum * scale + 0.5f;
+		lut[i] = v > 255 ? 255 : v;
+	}
+}
+
+/**
+ * vlib_histogram_otsu - Otsu threshold of a histogram
+ * @hist: VLIB_HISTOGRAM_BINS counts
+ *
+ * Return: The level maximizing the variance between the pixels up to it
+ * and the pixels above it.
+ */
+uint8_t vlib_histogram_otsu(const uint32_t *hist)
+{
+	double total = 0, mu = 0, mu1 = 0, q1 = 0, best = 0;
+	uint8_t thresh = 0;
+
+	for (size_t i=0; i<VLIB_HISTOGRAM_BINS; i++) {
+		total += hist[i];
+		mu += (double)i * hist[i];
+	}
+
+	if (!total) {
+		return 0;
+	}
+	mu /= total;
+
+	for (size_t i=0; i<VLIB_HISTOGRAM_BINS; i++) {
+		double p = hist[i] / total;
+		double q2, mu2, sigma;
+
+		mu1 *= q1;
+		q1 += p;
+		q2 = 1 - q1;
+
+		if (q1 < FLT_EPSILON || q2 < FLT_EPSILON) {
+			continue;
+		}
+
+		mu1 = (mu1 + i * p) / q1;
+		mu2 = (mu - q1 * mu1) / q2;
+		sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+		if (sigma > best) {
+			best = sigma;
+			thresh = i;
+		}
+	}
+
+	return thresh;
+}
+
+/* Pipeline stage */
+
+enum histogram_mode {
+	HISTOGRAM_MODE_EQUALIZE,
+	HISTOGRAM_MODE_STREAM,
+	HISTOGRAM_MODE_OTSU,
+};
+
+struct histogram_data {
+	int lut_valid;				/* @lut is the table of the previous frame */
+	uint8_t lut[VLIB_HISTOGRAM_BINS];
+	uint32_t hist[VLIB_HISTOGRAM_BINS];
+};
+
+static void histogram_stage_reset(void *arg)
+{
+	struct histogram_data *data = arg;
+
+	data->lut_valid = 0;
+}
+
+static int histogram_stage_run(void *arg, size_t mode,
+						const struct luma_stage_frame *frame)
+{
+	struct histogram_data *data = arg;
+	int ret;
+
+	if (mode == HISTOGRAM_MODE_STREAM && data->lut_valid) {
+		/* table of the previous frame, the histogram for the next one */
+		ret = vlib_histogram_lut(frame->src, frame->stride_src, frame->dst,
+								frame->stride_dst, frame->width,
+								frame->height, frame->pitch, data->lut,
+								data->hist);
+		if (!ret) {
+			vlib_histogram_equalize_lut(data->hist, data->lut);
+		}
+	} else {
+		ret = vlib_histogram(frame->src, frame->stride_src, frame->width,
+							frame->height, frame->pitch, data->hist);
+		if (!ret) {
+			if (mode == HISTOGRAM_MODE_OTSU) {
+				uint8_t t = vlib_histogram_otsu(data->hist);
+
+				memset(data->lut, 0, t + 1);
+				memset(data->lut + t + 1, 255, VLIB_HISTOGRAM_BINS - t - 1);
+			} else {
+				vlib_histogram_equalize_lut(data->hist, data->lut);
+			}
+			ret = vlib_histogram_lut(frame->src, frame->stride_src,
+									frame->dst, frame->stride_dst,
+									frame->width, frame->height,
+									frame->pitch, data->lut, NULL);
+		}
+	}
+
+	data->lut_valid = !ret && mode != HISTOGRAM_MODE_OTSU;
+
+	return ret;
+}
+
+static const struct luma_stage_ops histogram_ops = {
+	.reset = histogram_stage_reset,
+	.run = histogram_stage_run,
+};
+
+static const char *histogram_modes[] = {
+	"Equalize",
+	"Equalize stream",
+	"Otsu",
+};
+
+static const struct luma_stage histogram_stage = {
+	.display_text = "Histogram",
+	.name = "histogram",
+	.modes = histogram_modes,
+	.num_modes = ARRAY_SIZE(histogram_modes),
+	.grey_chroma = 0,
+	.ops = &histogram_ops,
+};
+
+/**
+ * vlib_histogram_filter_create - Create a histogram stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_histogram_filter_create(void)
+{
+	struct filter_s *fs;
+	struct histogram_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	fs = luma_stage_create(&histogram_stage, data);
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	return fs;
+}
@@ -0,0 +1,604 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "helper.h"
+#include "hog.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* rows of cells, blocks or windows per band boundary */
+#define HOG_GRAIN			1
+
+/* fractional bits of the pixel votes */
+#define HOG_MAG_FRAC		4
+
+/* bins per cell accumulator, the last one wraps around to the first */
+#define HOG_ACC_BINS		(VLIB_HOG_BINS + 1)
+
+/* sum of |value| of a normalized block: L2 norm 1 plus the rounding */
+#define HOG_BLOCK_L1		25000
+
+/* largest fractional bits of the SVM weights */
+#define HOG_MAX_WEIGHT_FRAC	24
+
+/* orientation table entry: lower bin, its vote and the vote of the next */
+#define HOG_LUT_BIN(e)		((e) & 0xf)
+#define HOG_LUT_LO(e)		(((e) >> 4) & 0x3fff)
+#define HOG_LUT_HI(e)		((e) >> 18)
+
+struct vlib_hog {
+	struct vlib_hog_params p;
+	size_t width;
+	size_t height;
+	size_t cells_x;
+	size_t cells_y;
+	size_t blocks_x;
+	size_t blocks_y;
+	/* window size in cells and in blocks, window step in cells */
+	size_t win_cx;
+	size_t win_cy;
+	size_t win_bx;
+	size_t win_by;
+	size_t step;
+	size_t windows_x;
+	size_t windows_y;
+	/* votes by |gx| + 256 * |gy| */
+	uint32_t *lut;
+	uint32_t *hist;				/* VLIB_HOG_BINS per cell */
+	int16_t *blocks;			/* VLIB_HOG_BLOCK_SIZE per block */
+	/* in descriptor order, NULL until vlib_hog_set_svm() */
+	int16_t *weights;
+	int weights_frac;
+	float bias;
+	struct vlib_hog_stats stats;
+};
+
+struct hog_job {
+	struct vlib_hog *hog;
+	const uint8_t *img;
+	size_t stride;
+	float *scores;
+	size_t stride_scores;
+};
+
+/*
+ * Votes of a gradient in the first quadrant. The bins are centered on 10,
+ * 30, ..., 170 degrees and a pixel votes its magnitude into the two bins
+ * around its angle, weighted by the distance to their centers as
+ * xFDHOGbilinearNO. The bin after the last one is the first.
+ */
+static void hog_lut_init(uint32_t *lut)
+{
+	for (int ay=0; ay<256; ay++) {
+		for (int ax=0; ax<256; ax++) {
+			double m = sqrt(ax * ax + ay * ay) * (1 << HOG_MAG_FRAC);
+			double p = atan2(ay, ax) * 180 / M_PI - 10, f;
+			int k;
+
+			if (p < 0) {
+				p += 180;
+			}
+			k = p / 20;
+			if (k > VLIB_HOG_BINS - 1) {
+				k = VLIB_HOG_BINS - 1;
+			}
+			f = p / 20 - k;
+
+			lut[ay * 256 + ax] = k | (uint32_t)lrint(m * (1 - f)) << 4 |
+								(uint32_t)lrint(m * f) << 18;
+		}
+	}
+}
+
+/*
+ * Table index |gx| + 256 * |gy| of the centered differences of pixels
+ * [@x0, @x1) of row @y, and whether gx and gy differ in sign. Gradients
+ * are zero on the outermost rows and columns.
+ */
+static void hog_gradient_row(const struct vlib_hog *hog, const uint8_t *img,
+							size_t stride, size_t y, size_t x0, size_t x1,
+							uint16_t *idx, uint16_t *neg)
+{
+	const size_t end = x1 < hog->width ? x1 : hog->width - 1;
+	const v_s16 zero = v_setall_s16(0);
+	const v_u16 none = v_setall_u16(0), row = v_setall_u16(256);
+	const uint8_t *cur = img + y * stride, *up, *dn;
+	size_t x = x0 ? x0 : 1;
+
+	if (y == 0 || y == hog->height - 1) {
+		memset(idx, 0, (x1 - x0) * sizeof(*idx));
+		memset(neg, 0, (x1 - x0) * sizeof(*neg));
+		return;
+	}
+
+	up = cur - stride;
+	dn = cur + stride;
+
+	if (x0 == 0) {
+		idx[0] = neg[0] = 0;
+	}
+	if (x1 == hog->width) {
+		idx[x1 - 1 - x0] = neg[x1 - 1 - x0] = 0;
+	}
+
+	for (; x+8<=end; x+=8) {
+		v_s16 gx = v_sub_s16(v_load_expand_u8(cur + x + 1),
+							v_load_expand_u8(cur + x - 1));
+		v_s16 gy = v_sub_s16(v_load_expand_u8(dn + x),
+							v_load_expand_u8(up + x));
+		v_u16 ax = v_reinterpret_u16_s16(v_abs_s16(gx));
+		v_u16 ay = v_reinterpret_u16_s16(v_abs_s16(gy));
+		v_u16 sx = v_cmpgt_s16(zero, gx), sy = v_cmpgt_s16(zero, gy);
+
+		v_store_u16(idx + x - x0, v_or_u16(ax, v_mul_u16(ay, row)));
+		v_store_u16(neg + x - x0,
+					v_select_u16(v_and_u16(sx, sy), none, v_or_u16(sx, sy)));
+	}
+
+	for (; x<end; x++) {
+		int gx = cur[x + 1] - cur[x - 1], gy = dn[x] - up[x];
+
+		idx[x - x0] = abs(gx) + 256 * abs(gy);
+		neg[x - x0] = (gx < 0) != (gy < 0);
+	}
+}
+
+/*
+ * Histograms of the @n cells of cell row @cy from cell column @cx0. @idx
+ * and @neg hold n * cell_size pixels, @acc HOG_ACC_BINS per cell.
+ */
+static void hog_cell_row(const struct vlib_hog *hog, const uint8_t *img,
+						size_t stride, size_t cy, size_t cx0, size_t n,
+						uint16_t *idx, uint16_t *neg, uint32_t *acc,
+						uint32_t *hist)
+{
+	const size_t cs = hog->p.cell_size;
+
+	memset(acc, 0, n * HOG_ACC_BINS * sizeof(*acc));
+
+	for (size_t y=cy*cs; y<(cy+1)*cs; y++) {
+		hog_gradient_row(hog, img, stride, y, cx0 * cs, (cx0 + n) * cs,
+						idx, neg);
+
+		for (size_t c=0; c<n; c++) {
+			uint32_t *a = acc + c * HOG_ACC_BINS;
+
+			for (size_t i=c*cs; i<(c+1)*cs; i++) {
+				uint32_t e = hog->lut[idx[i]], k = HOG_LUT_BIN(e);
+
+				if (neg[i]) {
+					/* 180 degrees minus the angle, mirrored bins */
+					k = k == VLIB_HOG_BINS - 1 ? k : VLIB_HOG_BINS - 2 - k;
+					a[k] += HOG_LUT_HI(e);
+					a[k + 1] += HOG_LUT_LO(e);
+				} else {
+					a[k] += HOG_LUT_LO(e);
+					a[k + 1] += HOG_LUT_HI(e);
+				}
+			}
+		}
+	}
+
+	for (size_t c=0; c<n; c++) {
+		const uint32_t *a = acc + c * HOG_ACC_BINS;
+		uint32_t *h = hist + c * VLIB_HOG_BINS;
+
+		h[0] = a[0] + a[VLIB_HOG_BINS];
+		for (int i=1; i<VLIB_HOG_BINS; i++) {
+			h[i] = a[i];
+		}
+	}
+}
+
+/*
+ * L2-Hys normalization of the block of two cells from @top and the two
+ * below them from @bottom, with the epsilons of cv::HOGDescriptor.
+ */
+static void hog_block(const uint32_t *top, const uint32_t *bottom,
+					int16_t *out)
+{
+	float v[VLIB_HOG_BLOCK_SIZE], ss = 0, r;
+
+	for (int i=0; i<2*VLIB_HOG_BINS; i++) {
+		v[i] = top[i];
+		v[2 * VLIB_HOG_BINS + i] = bottom[i];
+	}
+
+	for (int i=0; i<VLIB_HOG_BLOCK_SIZE; i++) {
+		ss += v[i] * v[i];
+	}
+	r = 1 / (sqrtf(ss) +
+			0.1f * VLIB_HOG_BLOCK_SIZE * (1 << HOG_MAG_FRAC));
+
+	ss = 0;
+	for (int i=0; i<VLIB_HOG_BLOCK_SIZE; i++) {
+		v[i] = v[i] * r < 0.2f ? v[i] * r : 0.2f;
+		ss += v[i] * v[i];
+	}
+	r = (1 << VLIB_HOG_DESC_FRAC) / (sqrtf(ss) + 1e-3f);
+
+	for (int i=0; i<VLIB_HOG_BLOCK_SIZE; i++) {
+		out[i] = v[i] * r + 0.5f;
+	}
+}
+
+/* sum of a[i] * b[i], @n a multiple of 4 */
+static int32_t hog_dot(const int16_t *a, const int16_t *b, size_t n)
+{
+	v_s32 acc = v_setall_s32(0);
+	int32_t sum;
+	size_t i = 0;
+
+	for (; i+8<=n; i+=8) {
+		acc = v_madd_s16(acc, v_load_s16(a + i), v_load_s16(b + i));
+	}
+
+	sum = v_reduce_add_s32(acc);
+	for (; i<n; i++) {
+		sum += a[i] * b[i];
+	}
+
+	return sum;
+}
+
+/*
+ * SVM score of the window whose first block is @blocks, the blocks of a
+ * row of the window being @stride values apart. A row of blocks fits the
+ * 32-bit dot product for the weights of vlib_hog_set_svm().
+ */
+static float hog_score(const struct vlib_hog *hog, const int16_t *blocks,
+					size_t stride)
+{
+	const size_t n = hog->win_bx * VLIB_HOG_BLOCK_SIZE;
+	int64_t acc = 0;
+
+	for (size_t r=0; r<hog->win_by; r++) {
+		acc += hog_dot(hog->weights + r * n, blocks + r * stride, n);
+	}
+
+	return (float)ldexp(acc, -(VLIB_HOG_DESC_FRAC + hog->weights_frac)) +
+			hog->bias;
+}
+
+static void hog_cells_band(void *arg, size_t start, size_t end)
+{
+	struct hog_job *job = arg;
+	struct vlib_hog *hog = job->hog;
+	const size_t n = hog->cells_x, w = n * hog->p.cell_size;
+	uint16_t *idx = malloc(2 * w * sizeof(*idx));
+	uint32_t *acc = malloc(n * HOG_ACC_BINS * sizeof(*acc));
+
+	if (!idx || !acc) {
+		vlib_warn("hog: out of memory\n");
+		goto out;
+	}
+
+	for (size_t cy=start; cy<end; cy++) {
+		hog_cell_row(hog, job->img, job->stride, cy, 0, n, idx, idx + w,
+					acc, hog->hist + cy * n * VLIB_HOG_BINS);
+	}
+
+out:
+	free(idx);
+	free(acc);
+}
+
+static void hog_blocks_band(void *arg, size_t start, size_t end)
+{
+	struct hog_job *job = arg;
+	struct vlib_hog *hog = job->hog;
+
+	for (size_t by=start; by<end; by++) {
+		const uint32_t *h = hog->hist + by * hog->cells_x * VLIB_HOG_BINS;
+		int16_t *b = hog->blocks + by * hog->blocks_x * VLIB_HOG_BLOCK_SIZE;
+
+		for (size_t bx=0; bx<hog->blocks_x; bx++) {
+			hog_block(h + bx * VLIB_HOG_BINS,
+					h + (hog->cells_x + bx) * VLIB_HOG_BINS,
+					b + bx * VLIB_HOG_BLOCK_SIZE);
+		}
+	}
+}
+
+/* the blocks of a window are read in place from the blocks of the frame */
+static void hog_svm_band(void *arg, size_t start, size_t end)
+{
+	struct hog_job *job = arg;
+	struct vlib_hog *hog = job->hog;
+	const size_t stride = hog->blocks_x * VLIB_HOG_BLOCK_SIZE;
+
+	for (size_t wy=start; wy<end; wy++) {
+		const int16_t *b = hog->blocks + wy * hog->step * stride;
+		float *row = (float *)((uint8_t *)job->scores +
+								wy * job->stride_scores);
+
+		for (size_t wx=0; wx<hog->windows_x; wx++) {
+			row[wx] = hog_score(hog, b + wx * hog->step * VLIB_HOG_BLOCK_SIZE,
+								stride);
+		}
+	}
+}
+
+void vlib_hog_default_params(struct vlib_hog_params *params)
+{
+	params->win_width = 64;
+	params->win_height = 128;
+	params->cell_size = 8;
+	params->win_stride = 8;
+}
+
+struct vlib_hog *vlib_hog_create(const struct vlib_hog_params *params,
+				size_t width, size_t height)
+{
+	const int cs = params->cell_size;
+	struct vlib_hog *hog;
+
+	if (cs < 4 || cs > 16 || params->win_width < 2 * cs ||
+		params->win_height < 2 * cs || params->win_width % cs ||
+		params->win_height % cs || params->win_stride < cs ||
+		params->win_stride % cs) {
+		VLIB_REPORT_ERR("hog: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	if (width < (size_t)params->win_width ||
+		height < (size_t)params->win_height || width > UINT16_MAX ||
+		height > UINT16_MAX) {
+		VLIB_REPORT_ERR("hog: %zux%zu not supported", width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	hog = calloc(1, sizeof(*hog));
+	if (!hog) {
+		return NULL;
+	}
+
+	hog->p = *params;
+	hog->width = width;
+	hog->height = height;
+	hog->cells_x = width / cs;
+	hog->cells_y = height / cs;
+	hog->blocks_x = hog->cells_x - 1;
+	hog->blocks_y = hog->cells_y - 1;
+	hog->win_cx = params->win_width / cs;
+	hog->win_cy = params->win_height / cs;
+	hog->win_bx = hog->win_cx - 1;
+	hog->win_by = hog->win_cy - 1;
+	hog->step = params->win_stride / cs;
+	hog->windows_x = (hog->cells_x - hog->win_cx) / hog->step + 1;
+	hog->windows_y = (hog->cells_y - hog->win_cy) / hog->step + 1;
+
+	hog->lut = malloc(256 * 256 * sizeof(*hog->lut));
+	hog->hist = malloc(hog->cells_x * hog->cells_y * VLIB_HOG_BINS *
+						sizeof(*hog->hist));
+	hog->blocks = malloc(hog->blocks_x * hog->blocks_y * VLIB_HOG_BLOCK_SIZE *
+						sizeof(*hog->blocks));
+	if (!hog->lut || !hog->hist || !hog->blocks) {
+		vlib_hog_destroy(hog);
+		return NULL;
+	}
+
+	hog_lut_init(hog->lut);
+
+	return hog;
+}
+
+void vlib_hog_destroy(struct vlib_hog *hog)
+{
+	if (!hog) {
+		return;
+	}
+
+	free(hog->lut);
+	free(hog->hist);
+	free(hog->blocks);
+	free(hog->weights);
+	free(hog);
+}
+
+/* values per window descriptor */
+size_t vlib_hog_descriptor_size(const struct vlib_hog *hog)
+{
+	return hog->win_bx * hog->win_by * VLIB_HOG_BLOCK_SIZE;
+}
+
+/* window positions vlib_hog_detect() scores, win_stride apart */
+void vlib_hog_get_windows(const struct vlib_hog *hog, size_t *cols,
+				size_t *rows)
+{
+	*cols = hog->windows_x;
+	*rows = hog->windows_y;
+}
+
+/**
+ * vlib_hog_set_svm - set the linear SVM the windows are scored with
+ * @hog: HOG engine
+ * @weights: vlib_hog_descriptor_size() weights in descriptor order
+ * @bias: added to the dot product of the weights and the descriptor
+ *
+ * The weights are converted to 16-bit fixed point with as many fractional
+ * bits as a row of blocks allows without overflowing the 32-bit dot
+ * product, as the operands of xf::SVM.
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_hog_set_svm(struct vlib_hog *hog, const float *weights, float bias)
+{
+	const size_t n = vlib_hog_descriptor_size(hog);
+	double limit = INT32_MAX / ((double)hog->win_bx * HOG_BLOCK_L1), max = 0;
+	int frac = HOG_MAX_WEIGHT_FRAC;
+
+	if (!weights) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (limit > INT16_MAX) {
+		limit = INT16_MAX;
+	}
+
+	for (size_t i=0; i<n; i++) {
+		if (!isfinite(weights[i])) {
+			VLIB_REPORT_ERR("hog: invalid SVM weight %zu", i);
+			vlib_dbg("%s\n", vlib_errstr);
+			return VLIB_ERROR_INVALID_PARAM;
+		}
+		if (fabs(weights[i]) > max) {
+			max = fabs(weights[i]);
+		}
+	}
+
+	while (frac > 0 && ldexp(max, frac) > limit) {
+		frac--;
+	}
+	if (ldexp(max, frac) > limit) {
+		VLIB_REPORT_ERR("hog: SVM weights out of range");
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (!hog->weights) {
+		hog->weights = malloc(n * sizeof(*hog->weights));
+		if (!hog->weights) {
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	for (size_t i=0; i<n; i++) {
+		hog->weights[i] = lrint(ldexp(weights[i], frac));
+	}
+	hog->weights_frac = frac;
+	hog->bias = bias;
+
+	return VLIB_SUCCESS;
+}
+
+/**
+ * vlib_hog_describe - compute the descriptor of one window
+ * @hog: HOG engine
+ * @img: 8-bit image of the size @hog was created for
+ * @stride: line stride of @img in bytes
+ * @x: left edge of the window, a multiple of cell_size
+ * @y: top edge of the window, a multiple of cell_size
+ * @desc: vlib_hog_descriptor_size() values
+ *
+ * Computes the cells and blocks of the window only, as xf::HOGDescriptor
+ * does for its input window. The result is the same as the descriptor
+ * vlib_hog_detect() scores for this window, for instance to train the SVM.
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_hog_describe(const struct vlib_hog *hog,
+				const uint8_t *img, size_t stride, size_t x, size_t y,
+				int16_t *desc)
+{
+	const size_t cs = hog->p.cell_size, n = hog->win_cx;
+	const size_t cx = x / cs, cy = y / cs;
+	uint16_t *idx;
+	uint32_t *acc, *hist;
+	int ret = VLIB_SUCCESS;
+
+	if (!img || !desc || x % cs || y % cs || cx + n > hog->cells_x ||
+		cy + hog->win_cy > hog->cells_y) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	idx = malloc(2 * n * cs * sizeof(*idx));
+	acc = malloc(n * HOG_ACC_BINS * sizeof(*acc));
+	hist = malloc(n * hog->win_cy * VLIB_HOG_BINS * sizeof(*hist));
+	if (!idx || !acc || !hist) {
+		ret = VLIB_ERROR_NO_MEM;
+		goto out;
+	}
+
+	for (size_t j=0; j<hog->win_cy; j++) {
+		hog_cell_row(hog, img, stride, cy + j, cx, n, idx, idx + n * cs, acc,
+					hist + j * n * VLIB_HOG_BINS);
+	}
+
+	for (size_t r=0; r<hog->win_by; r++) {
+		for (size_t c=0; c<hog->win_bx; c++) {
+			hog_block(hist + (r * n + c) * VLIB_HOG_BINS,
+					hist + ((r + 1) * n + c) * VLIB_HOG_BINS,
+					desc + (r * hog->win_bx + c) * VLIB_HOG_BLOCK_SIZE);
+		}
+	}
+
+out:
+	free(idx);
+	free(acc);
+	free(hist);
+
+	return ret;
+}
+
+/* SVM score of a descriptor, as xf::SVM on the weights of vlib_hog_set_svm() */
+float vlib_hog_svm_score(const struct vlib_hog *hog, const int16_t *desc)
+{
+	return hog_score(hog, desc, hog->win_bx * VLIB_HOG_BLOCK_SIZE);
+}
+
+/**
+ * vlib_hog_detect - score every window of a frame
+ * @hog: HOG engine with an SVM set
+ * @img: 8-bit image of the size @hog was created for
+ * @stride: line stride of @img in bytes
+ * @scores: vlib_hog_get_windows() columns and rows of window scores
+ * @stride_scores: line stride of @scores in bytes
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_hog_detect(struct vlib_hog *hog,
+				const uint8_t *img, size_t stride,
+				float *scores, size_t stride_scores)
+{
+	struct hog_job job = {
+		.hog = hog,
+		.img = img,
+		.stride = stride,
+		.scores = scores,
+		.stride_scores = stride_scores,
+	};
+	struct timespec t;
+	int ret;
+
+	if (!img || !scores) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (!hog->weights) {
+		VLIB_REPORT_ERR("hog: no SVM set");
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(hog->cells_y, HOG_GRAIN, hog_cells_band, &job);
+	hog->stats.cells_ms = vlib_ms_since(&t);
+	if (ret) {
+		return ret;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(hog->blocks_y, HOG_GRAIN, hog_blocks_band, &job);
+	hog->stats.blocks_ms = vlib_ms_since(&t);
+	if (ret) {
+		return ret;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(hog->windows_y, HOG_GRAIN, hog_svm_band, &job);
+	hog->stats.svm_ms = vlib_ms_since(&t);
+
+	return ret;
+}
+
+void vlib_hog_get_stats(const struct vlib_hog *hog,
+				struct vlib_hog_stats *stats)
+{
+	*stats = hog->stats;
+}
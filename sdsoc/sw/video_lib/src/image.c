@@ -0,0 +1,118 @@
+#include <drm/drm_fourcc.h>
+#include <linux/videodev2.h>
+#include <string.h>
+
+#include "image.h"
+#include "video_int.h"
+
+/**
+ * vlib_image_init - Describe a frame stored in a single contiguous buffer
+ * @img: Image descriptor to populate
+ * @fourcc: Pixel format
+ * @width: Width in pixels
+ * @height: Height in lines
+ * @stride: Bytes per line of the first plane
+ * @buf: Start of the frame buffer
+ *
+ * Chroma planes of planar and semi-planar formats are expected to follow
+ * the luma plane directly, as produced by single-plane V4L2 and DRM dumb
+ * buffers.
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_image_init(struct vlib_image *img, uint32_t fourcc, size_t width,
+					size_t height, size_t stride, unsigned char *buf)
+{
+	if (!img || !width || !height) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	memset(img, 0, sizeof(*img));
+	img->fourcc = fourcc;
+	img->width = width;
+	img->height = height;
+	img->plane[0] = buf;
+	img->stride[0] = stride;
+	img->num_planes = 1;
+
+	switch (fourcc) {
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+			img->plane[1] = buf + stride * height;
+			img->stride[1] = stride;
+			img->num_planes = 2;
+			break;
+		case V4L2_PIX_FMT_YUV420:
+		case V4L2_PIX_FMT_YVU420:
+			img->plane[1] = buf + stride * height;
+			img->stride[1] = stride / 2;
+			img->plane[2] = img->plane[1] + img->stride[1] * (height / 2);
+			img->stride[2] = stride / 2;
+			img->num_planes = 3;
+			break;
+		case DRM_FORMAT_YUV444:
+		case V4L2_PIX_FMT_YUV444M:
+			img->plane[1] = buf + stride * height;
+			img->stride[1] = stride;
+			img->plane[2] = img->plane[1] + stride * height;
+			img->stride[2] = stride;
+			img->num_planes = 3;
+			break;
+		default:
+			if (!vlib_fourcc2bpp(fourcc)) {
+				VLIB_REPORT_ERR("unsupported pixel format '%.4s'",
+								(const char *)&fourcc);
+				vlib_dbg("%s\n", vlib_errstr);
+				return VLIB_ERROR_INVALID_PARAM;
+			}
+			break;
+	}
+
+	return VLIB_SUCCESS;
+}
+
+/**
+ * vlib_image_size - Get the buffer size of a contiguous frame
+ * @fourcc: Pixel format
+ * @height: Height in lines
+ * @stride: Bytes per line of the first plane
+ *
+ * Return: Number of bytes required to hold the frame.
+ */
+size_t vlib_image_size(uint32_t fourcc, size_t height, size_t stride)
+{
+	switch (fourcc) {
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+		case V4L2_PIX_FMT_YUV420:
+		case V4L2_PIX_FMT_YVU420:
+			return stride * height * 3 / 2;
+		case DRM_FORMAT_YUV444:
+		case V4L2_PIX_FMT_YUV444M:
+			return stride * height * 3;
+		default:
+			return stride * height;
+	}
+}
+
+/**
+ * vlib_image_stride - Get the minimum stride of the first plane
+ * @fourcc: Pixel format
+ * @width: Width in pixels
+ *
+ * Return: Bytes per line of the first plane or 0 for unknown formats.
+ */
+size_t vlib_image_stride(uint32_t fourcc, size_t width)
+{
+	switch (fourcc) {
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+		case V4L2_PIX_FMT_YUV420:
+		case V4L2_PIX_FMT_YVU420:
+		case DRM_FORMAT_YUV444:
+		case V4L2_PIX_FMT_YUV444M:
+			return width;
+		default:
+			return width * vlib_fourcc2bpp(fourcc);
+	}
+}
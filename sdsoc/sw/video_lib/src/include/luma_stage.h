@@ -0,0 +1,79 @@
+#ifndef LUMA_STAGE_H
+#define LUMA_STAGE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "filter.h"
+#include "image.h"
+
+/* luma of a supported format */
+struct luma_stage_format {
+	uint32_t fourcc;
+	size_t pitch;				/* bytes from one luma value to the next */
+	size_t offset;				/* byte of the first luma value */
+};
+
+/* frame handed to the kernel of a luma stage */
+struct luma_stage_frame {
+	const struct vlib_image *in;
+	const struct vlib_image *out;
+	const uint8_t *src;			/* first luma value of @in */
+	size_t stride_src;
+	uint8_t *dst;				/* first luma value of @out */
+	size_t stride_dst;
+	size_t width;
+	size_t height;
+	size_t pitch;				/* bytes from one luma value to the next */
+};
+
+/*
+ * Callbacks of a luma stage, @data is the pointer given to
+ * luma_stage_create(). All but run are optional.
+ *
+ * setup: prepare for frames of @fmt, @width x @height. Only called when
+ *        one of them changes, after release. VLIB_ERROR_NOT_SUPPORTED
+ *        rejects the geometry quietly, other errors are reported.
+ * release: free what setup allocated.
+ * reset: called on every init, e.g. to drop state of the last stream.
+ * run: write the luma of @frame->out for mode @mode.
+ */
+struct luma_stage_ops {
+	int (*setup)(void *data, const struct luma_stage_format *fmt,
+				size_t width, size_t height);
+	void (*release)(void *data);
+	void (*reset)(void *data);
+	int (*run)(void *data, size_t mode, const struct luma_stage_frame *frame);
+};
+
+struct luma_stage {
+	const char *display_text;
+	const char *name;			/* prefix of warnings */
+	const char **modes;
+	size_t num_modes;
+	int grey_chroma;			/* chroma set to 128 instead of copied */
+	const struct luma_stage_ops *ops;
+};
+
+/*
+ * Pipeline stage that runs a kernel on the luma of GREY, NV12, NV21,
+ * YUV420, YVU420, YUYV and UYVY frames of the same size and format in and
+ * out. The stage checks the formats, calls setup when the geometry
+ * changes, and copies the chroma, or sets it to grey, in row bands on all
+ * cores. The kernel only handles the luma.
+ */
+struct filter_s *luma_stage_create(const struct luma_stage *ls, void *data);
+
+/* luma layout of @fourcc, NULL if it is none of the formats above */
+const struct luma_stage_format *luma_stage_find_format(uint32_t fourcc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LUMA_STAGE_H */
@@ -0,0 +1,40 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "common.h"
+#include "filter.h"
+
+struct vlib_scaler;
+
+/*
+ * Scaling between capture and display for pipelines whose resolutions
+ * differ, or that show a crop region of the capture. Filters that only
+ * process at a single size are wrapped into a fused filter graph with a
+ * resize stage, placed in front of the filter when the display has fewer
+ * pixels than the crop region and behind it otherwise, so filters always
+ * run at the smaller of both sizes. The resize stage crops its input, so
+ * a filter behind it sees the region only, one in front of it the whole
+ * capture. Pass through crops, resizes and converts the capture format in
+ * one stage.
+ *
+ * The graphs run in place of the registered filters, which are their
+ * stages. They are never run on their own, and mode changes of the
+ * registered filters apply to the graphs.
+ */
+struct vlib_scaler *vlib_scaler_create(const struct filter_init_data *fid,
+										const struct vlib_crop *crop);
+void vlib_scaler_destroy(struct vlib_scaler *sc);
+int vlib_scaler_add_filter(struct vlib_scaler *sc, struct filter_s *fs);
+struct filter_s *vlib_scaler_get_filter(const struct vlib_scaler *sc,
+										struct filter_s *fs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCALER_H */
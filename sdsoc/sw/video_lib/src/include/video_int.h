@@ -110,10 +110,12 @@ typedef enum {
 	MODE_EXIT
 } app_state;
 
+#include "analytics.h"
 #include "drm_helper.h"
 #include <linux/videodev2.h>
 
 struct levents_counter;
+struct vlib_scaler;
 
 /* global setup for all modes */
 struct video_pipeline {
@@ -140,6 +142,16 @@ struct video_pipeline {
 	struct levents_counter *events[NUM_EVENTS];
 	int enable_log_event;
 	struct filter_tbl *ft;
+	struct vlib_scaler *scaler; /* capture to display scaling, NULL if same size */
+	struct vlib_crop crop; /* capture region scaled to the display */
+	struct vlib_analytics *analytics; /* statistics of the captured luma, NULL if off */
+	size_t analytics_offset; /* offset of the luma in a pixel */
+	size_t analytics_frames; /* frames published since enabled */
+	struct vlib_analytics_stats analytics_stats; /* last published frame */
+	struct vlib_analytics_cell *analytics_cells; /* grid of the last published frame */
+	size_t analytics_num_cells;
+	pthread_mutex_t analytics_run_lock; /* held by a pass and while analytics changes */
+	pthread_mutex_t analytics_lock; /* published statistics */
 	size_t buffer_cnt; /* number of frame buffers */
 	int fps_thread_quit;
 	int process_thread_quit;
@@ -151,6 +163,8 @@ struct media_device *vlib_vdev_get_mdev(const struct vlib_vdev *vdev);
 int vlib_video_src_get_vnode(const struct vlib_vdev *vsrc);
 int vlib_pipeline_v4l2_init(struct stream_handle *sh, struct video_pipeline *s);
 size_t vlib_fourcc2bpp(uint32_t fourcc);
+void vlib_analytics_frame(struct video_pipeline *vp, const uint8_t *frame,
+				size_t stride);
 
 void vlib_log(vlib_log_level level, const char *format, ...)
 		__attribute__((__format__(__printf__, 2, 3)));
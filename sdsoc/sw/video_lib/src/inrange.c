@@ -0,0 +1,457 @@
+#include <linux/videodev2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cvt_color.h"
+#include "filter.h"
+#include "helper.h"
+#include "image.h"
+#include "inrange.h"
+#include "luma_stage.h"
+#include "parallel.h"
+#include "stencil.h"
+#include "video_int.h"
+
+/* rows per band, even for the 4:2:0 conversions */
+#define INRANGE_GRAIN		16
+
+/* fixed point shift of the HSV reciprocals, exact for 17-bit numerators */
+#define INRANGE_HSV_SHIFT	32
+
+struct vlib_inrange {
+	uint32_t lut[3][256];		/* colors whose range holds the value */
+	uint32_t rcp[256];			/* (1 << shift) / (2 * i), rounded up */
+};
+
+struct inrange_job {
+	const struct vlib_inrange *ir;
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+	size_t width;
+};
+
+/**
+ * vlib_inrange_create - Compile color ranges into lookup tables
+ * @low: Lower bounds of each range on the three channels
+ * @high: Upper bounds of each range on the three channels
+ * @num_colors: Number of ranges, up to VLIB_INRANGE_MAX_COLORS
+ *
+ * Return: Pointer to the thresholds on success, NULL otherwise.
+ */
+struct vlib_inrange *vlib_inrange_create(const uint8_t low[][3],
+				const uint8_t high[][3], size_t num_colors)
+{
+	struct vlib_inrange *ir;
+
+	if (!low || !high || !num_colors ||
+		num_colors > VLIB_INRANGE_MAX_COLORS) {
+		VLIB_REPORT_ERR("inrange: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	ir = calloc(1, sizeof(*ir));
+	if (!ir) {
+		return NULL;
+	}
+
+	for (size_t i=0; i<num_colors; i++) {
+		for (int c=0; c<3; c++) {
+			for (int v=low[i][c]; v<=high[i][c]; v++) {
+				ir->lut[c][v] |= 1u << i;
+			}
+		}
+	}
+
+	for (uint64_t i=1; i<256; i++) {
+		ir->rcp[i] = ((1ull << INRANGE_HSV_SHIFT) + 2 * i - 1) / (2 * i);
+	}
+
+	return ir;
+}
+
+void vlib_inrange_destroy(struct vlib_inrange *ir)
+{
+	free(ir);
+}
+
+static void inrange_row(const struct vlib_inrange *ir, const uint8_t *s,
+						uint8_t *d, size_t width)
+{
+	for (size_t x=0; x<width; x++, s+=3) {
+		d[x] = ir->lut[0][s[0]] & ir->lut[1][s[1]] & ir->lut[2][s[2]] ?
+				255 : 0;
+	}
+}
+
+/*
+ * RGB to HSV with hue in 0..179, classified on the way. Hue and saturation
+ * are the quotients of the float conversion rounded to nearest, ties up:
+ * (2 * n + d) / (2 * d) through the reciprocal of 2 * d, which is exact
+ * as the numerators stay below 1 << 17 and 2 * d below 1 << 9.
+ * cv::cvtColor rounds through 12-bit tables instead and differs by one on
+ * some pixels.
+ */
+static void inrange_rgb_row(const struct vlib_inrange *ir, const uint8_t *s,
+						uint8_t *d, size_t width)
+{
+	for (size_t x=0; x<width; x++, s+=3) {
+		int r = s[0], g = s[1], b = s[2];
+		int v = r > g ? r : g;
+		int vmin = r < g ? r : g;
+		int diff, h, sat;
+
+		v = b > v ? b : v;
+		vmin = b < vmin ? b : vmin;
+		diff = v - vmin;
+
+		sat = ((uint64_t)(510 * diff + v) * ir->rcp[v]) >> INRANGE_HSV_SHIFT;
+		h = v == r ? 30 * (g - b) : v == g ? 30 * (b - r) + 60 * diff :
+			30 * (r - g) + 120 * diff;
+		h += h < 0 ? 180 * diff : 0;
+		h = ((uint64_t)(2 * h + diff) * ir->rcp[diff]) >> INRANGE_HSV_SHIFT;
+
+		d[x] = ir->lut[0][h] & ir->lut[1][sat] & ir->lut[2][v] ? 255 : 0;
+	}
+}
+
+static void inrange_band(void *arg, size_t start, size_t end)
+{
+	struct inrange_job *job = arg;
+
+	for (size_t y=start; y<end; y++) {
+		inrange_row(job->ir, job->src + y * job->stride_src,
+					job->dst + y * job->stride_dst, job->width);
+	}
+}
+
+static void inrange_rgb_band(void *arg, size_t start, size_t end)
+{
+	struct inrange_job *job = arg;
+
+	for (size_t y=start; y<end; y++) {
+		inrange_rgb_row(job->ir, job->src + y * job->stride_src,
+						job->dst + y * job->stride_dst, job->width);
+	}
+}
+
+/**
+ * vlib_inrange - Mask of the pixels inside any range on all cores
+ * @ir: Compiled ranges
+ * @src: Source image, 3 bytes per pixel
+ * @stride_src: Line stride of @src in bytes
+ * @dst: Mask of the same size, 1 byte per pixel
+ * @stride_dst: Line stride of @dst in bytes
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_inrange(const struct vlib_inrange *ir,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t width, size_t height)
+{
+	struct inrange_job job = {
+		.ir = ir,
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.width = width,
+	};
+
+	if (!ir || !src || !dst) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return vlib_parallel_for(height, INRANGE_GRAIN, inrange_band, &job);
+}
+
+/**
+ * vlib_inrange_rgb - Mask of the RGB pixels inside any HSV range on all cores
+ * @ir: Compiled ranges, in HSV with hue in 0..179
+ * @src: Source image, RGB24
+ * @stride_src: Line stride of @src in bytes
+ * @dst: Mask of the same size, 1 byte per pixel
+ * @stride_dst: Line stride of @dst in bytes
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_inrange_rgb(const struct vlib_inrange *ir,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t width, size_t height)
+{
+	struct inrange_job job = {
+		.ir = ir,
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.width = width,
+	};
+
+	if (!ir || !src || !dst) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return vlib_parallel_for(height, INRANGE_GRAIN, inrange_rgb_band, &job);
+}
+
+/* Pipeline stage */
+
+/* HSV ranges of the xf color detection example, red on both ends of hue */
+static const uint8_t inrange_low[][3] = {
+	{ 0, 150, 60 },				/* red */
+	{ 160, 150, 60 },			/* red */
+	{ 38, 150, 60 },			/* green */
+	{ 100, 150, 60 },			/* blue */
+	{ 22, 150, 60 },			/* yellow */
+};
+
+static const uint8_t inrange_high[][3] = {
+	{ 10, 255, 255 },
+	{ 179, 255, 255 },
+	{ 75, 255, 255 },
+	{ 130, 255, 255 },
+	{ 38, 255, 255 },
+};
+
+/* ranges of each mode */
+static const struct inrange_set {
+	size_t first;
+	size_t num;
+	int clean;
+} inrange_sets[] = {
+	{ 0, 2, 0 },
+	{ 2, 1, 0 },
+	{ 3, 1, 0 },
+	{ 4, 1, 0 },
+	{ 0, 5, 0 },
+	{ 0, 5, 1 },
+};
+
+/* clean-up of the xf color detection example */
+static const struct vlib_stencil_stage inrange_clean[] = {
+	{ VLIB_STENCIL_ERODE, 3 },
+	{ VLIB_STENCIL_DILATE, 3 },
+	{ VLIB_STENCIL_DILATE, 3 },
+	{ VLIB_STENCIL_ERODE, 3 },
+};
+
+struct inrange_data {
+	struct vlib_inrange *ir[ARRAY_SIZE(inrange_sets)];
+	struct vlib_stencil_chain *chain;
+	uint8_t *mask;
+	uint8_t *clean;
+	uint8_t *rgb;				/* RGB strip of each band */
+};
+
+struct inrange_filter_job {
+	const struct vlib_inrange *ir;
+	const struct luma_stage_frame *frame;
+	uint8_t *mask;
+	uint8_t *rgb;
+	size_t bands;				/* strips taken */
+	int ret;
+};
+
+static void inrange_release(void *arg)
+{
+	struct inrange_data *data = arg;
+
+	for (size_t m=0; m<ARRAY_SIZE(inrange_sets); m++) {
+		vlib_inrange_destroy(data->ir[m]);
+		data->ir[m] = NULL;
+	}
+	vlib_stencil_chain_destroy(data->chain);
+	free(data->mask);
+	free(data->clean);
+	free(data->rgb);
+
+	data->chain = NULL;
+	data->mask = NULL;
+	data->clean = NULL;
+	data->rgb = NULL;
+}
+
+/* colors of GREY frames are lost, the others have to convert to RGB */
+static int inrange_setup(void *arg, const struct luma_stage_format *fmt,
+						size_t w, size_t h)
+{
+	struct inrange_data *data = arg;
+
+	if (fmt->fourcc == V4L2_PIX_FMT_GREY ||
+		!vlib_cvt_color_supported(fmt->fourcc, V4L2_PIX_FMT_RGB24) ||
+		(w & 1) || (h & 1)) {
+		return VLIB_ERROR_NOT_SUPPORTED;
+	}
+
+	for (size_t m=0; m<ARRAY_SIZE(inrange_sets); m++) {
+		const struct inrange_set *set = &inrange_sets[m];
+
+		data->ir[m] = vlib_inrange_create(inrange_low + set->first,
+										inrange_high + set->first,
+										set->num);
+		if (!data->ir[m]) {
+			inrange_release(data);
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	data->chain = vlib_stencil_chain_create(inrange_clean,
+											ARRAY_SIZE(inrange_clean), w, h, 0);
+	data->mask = malloc(w * h);
+	data->clean = malloc(w * h);
+	/* a loop calls the band function at most once per thread */
+	data->rgb = malloc(VLIB_PARALLEL_MAX_THREADS * INRANGE_GRAIN * 3 * w);
+	if (!data->chain || !data->mask || !data->clean || !data->rgb) {
+		inrange_release(data);
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	return VLIB_SUCCESS;
+}
+
+/* lines [start, end) of @img */
+static void inrange_image_lines(const struct vlib_image *img, size_t start,
+							size_t end, struct vlib_image *lines)
+{
+	*lines = *img;
+	lines->height = end - start;
+	for (size_t p=0; p<img->num_planes; p++) {
+		lines->plane[p] += (p ? start / 2 : start) * img->stride[p];
+	}
+}
+
+/* converts strips of the band to RGB while they are in the cache */
+static void inrange_filter_band(void *arg, size_t start, size_t end)
+{
+	struct inrange_filter_job *job = arg;
+	size_t w = job->frame->width;
+	size_t band = __atomic_fetch_add(&job->bands, 1, __ATOMIC_RELAXED);
+	uint8_t *buf = job->rgb + band * INRANGE_GRAIN * 3 * w;
+
+	for (size_t s=start; s<end; s+=INRANGE_GRAIN) {
+		size_t e = end - s < INRANGE_GRAIN ? end : s + INRANGE_GRAIN;
+		struct vlib_image lines, rgb;
+
+		inrange_image_lines(job->frame->in, s, e, &lines);
+		vlib_image_init(&rgb, V4L2_PIX_FMT_RGB24, w, e - s, 3 * w, buf);
+		if (vlib_cvt_color_lines(&lines, &rgb, 0, e - s)) {
+			job->ret = VLIB_ERROR_NO_MEM;
+			break;
+		}
+
+		for (size_t y=s; y<e; y++) {
+			inrange_rgb_row(job->ir, buf + (y - s) * 3 * w,
+							job->mask + y * w, w);
+		}
+	}
+}
+
+/* mask to luma */
+static void inrange_out_band(void *arg, size_t start, size_t end)
+{
+	struct inrange_filter_job *job = arg;
+	const struct luma_stage_frame *frame = job->frame;
+	size_t w = frame->width;
+
+	for (size_t y=start; y<end; y++) {
+		const uint8_t *m = job->mask + y * w;
+		uint8_t *d = frame->dst + y * frame->stride_dst;
+
+		if (frame->pitch == 1) {
+			memcpy(d, m, w);
+			continue;
+		}
+		for (size_t x=0; x<w; x++) {
+			d[x * frame->pitch] = m[x];
+		}
+	}
+}
+
+static int inrange_run(void *arg, size_t mode,
+					const struct luma_stage_frame *frame)
+{
+	struct inrange_data *data = arg;
+	struct inrange_filter_job job = {
+		.ir = data->ir[mode],
+		.frame = frame,
+		.mask = data->mask,
+		.rgb = data->rgb,
+		.bands = 0,
+		.ret = 0,
+	};
+	int ret;
+
+	ret = vlib_parallel_for(frame->height, INRANGE_GRAIN, inrange_filter_band,
+							&job);
+	if (!ret && !job.ret && inrange_sets[mode].clean) {
+		struct vlib_image mask, clean;
+
+		vlib_image_init(&mask, V4L2_PIX_FMT_GREY, frame->width,
+						frame->height, frame->width, data->mask);
+		vlib_image_init(&clean, V4L2_PIX_FMT_GREY, frame->width,
+						frame->height, frame->width, data->clean);
+		ret = vlib_stencil_chain_run(data->chain, &mask, &clean);
+		job.mask = data->clean;
+	}
+	if (!ret && !job.ret) {
+		ret = vlib_parallel_for(frame->height, INRANGE_GRAIN,
+								inrange_out_band, &job);
+	}
+
+	return ret ? ret : job.ret;
+}
+
+static const struct luma_stage_ops inrange_ops = {
+	.setup = inrange_setup,
+	.release = inrange_release,
+	.run = inrange_run,
+};
+
+static const char *inrange_modes[] = {
+	"Red",
+	"Green",
+	"Blue",
+	"Yellow",
+	"All",
+	"All clean",
+};
+
+static const struct luma_stage inrange_stage = {
+	.display_text = "Color Detect",
+	.name = "inrange",
+	.modes = inrange_modes,
+	.num_modes = ARRAY_SIZE(inrange_modes),
+	.grey_chroma = 1,
+	.ops = &inrange_ops,
+};
+
+/**
+ * vlib_inrange_filter_create - Create a color detection stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_inrange_filter_create(void)
+{
+	struct filter_s *fs;
+	struct inrange_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	fs = luma_stage_create(&inrange_stage, data);
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	return fs;
+}
@@ -0,0 +1,327 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "integral.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* rows per band, the column sums of a band fit 16 bits */
+#define INTEGRAL_CHUNK		64
+
+struct vlib_integral_rows {
+	size_t width;
+	size_t rows;
+	long next;					/* next row pushed */
+	uint32_t *ring;				/* @rows integral rows */
+	uint32_t *zero;				/* integral row -1 */
+	int32_t *prefix;
+};
+
+struct integral_job {
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+	size_t width;
+	size_t height;
+	enum vlib_integral_depth depth;
+	uint16_t *sums;				/* column sums per band */
+	int ret;
+};
+
+/* prefix sums of a row, 16 pixels at a time with a scan in the registers */
+static void integral_row_prefix(const uint8_t *src, int32_t *dst, size_t n)
+{
+	int32_t carry = 0;
+	size_t x = 0;
+
+	for (; x+16<=n; x+=16) {
+		v_u8 a = v_load_u8(src + x);
+		v_s16 lo = v_expand_lo_u8(a);
+		v_s16 hi = v_expand_hi_u8(a);
+
+		lo = v_add_s16(lo, v_slide_s16(lo, 1));
+		hi = v_add_s16(hi, v_slide_s16(hi, 1));
+		lo = v_add_s16(lo, v_slide_s16(lo, 2));
+		hi = v_add_s16(hi, v_slide_s16(hi, 2));
+		lo = v_add_s16(lo, v_slide_s16(lo, 4));
+		hi = v_add_s16(hi, v_slide_s16(hi, 4));
+
+		v_store_s32(dst + x, v_add_s32(v_expand_lo_s16(lo),
+						v_setall_s32(carry)));
+		v_store_s32(dst + x + 4, v_add_s32(v_expand_hi_s16(lo),
+						v_setall_s32(carry)));
+		carry = dst[x + 7];
+		v_store_s32(dst + x + 8, v_add_s32(v_expand_lo_s16(hi),
+						v_setall_s32(carry)));
+		v_store_s32(dst + x + 12, v_add_s32(v_expand_hi_s16(hi),
+						v_setall_s32(carry)));
+		carry = dst[x + 15];
+	}
+	for (; x<n; x++) {
+		carry += src[x];
+		dst[x] = carry;
+	}
+}
+
+/**
+ * vlib_integral_depth - Narrowest exact output of an integral image
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ *
+ * Return: VLIB_INTEGRAL_32 if the sum of all pixels fits 32 bits,
+ * VLIB_INTEGRAL_64 otherwise.
+ */
+enum vlib_integral_depth vlib_integral_depth(size_t width, size_t height)
+{
+	if (width && height > VLIB_INTEGRAL_MAX_PIXELS_32 / width) {
+		return VLIB_INTEGRAL_64;
+	}
+
+	return VLIB_INTEGRAL_32;
+}
+
+static void integral_sums_band(void *arg, size_t start, size_t end)
+{
+	struct integral_job *job = arg;
+	size_t w = job->width;
+
+	for (size_t c=start; c<end; c++) {
+		size_t y1 = (c + 1) * INTEGRAL_CHUNK < job->height ?
+					(c + 1) * INTEGRAL_CHUNK : job->height;
+		uint16_t *s = job->sums + c * w;
+
+		memset(s, 0, w * sizeof(*s));
+		for (size_t y=c*INTEGRAL_CHUNK; y<y1; y++) {
+			const uint8_t *p = job->src + y * job->stride_src;
+
+			for (size_t x=0; x<w; x++) {
+				s[x] += p[x];
+			}
+		}
+	}
+}
+
+/*
+ * Rows of bands [start, end). The integral row above the first band is
+ * put together from the column sums of the bands above, every other row
+ * adds its prefix sums to the row above it.
+ */
+static void integral_band(void *arg, size_t start, size_t end)
+{
+	struct integral_job *job = arg;
+	size_t w = job->width;
+	size_t y0 = start * INTEGRAL_CHUNK;
+	size_t y1 = end * INTEGRAL_CHUNK < job->height ?
+				end * INTEGRAL_CHUNK : job->height;
+	int32_t *prefix = malloc(w * sizeof(*prefix));
+	uint64_t *carry = calloc(w, sizeof(*carry));
+	uint32_t *cols = calloc(w, sizeof(*cols));
+
+	if (!prefix || !carry || !cols) {
+		job->ret = VLIB_ERROR_NO_MEM;
+		goto out;
+	}
+
+	for (size_t c=0; c<start; c++) {
+		const uint16_t *s = job->sums + c * w;
+
+		for (size_t x=0; x<w; x++) {
+			cols[x] += s[x];
+		}
+	}
+	for (size_t x=0; x<w; x++) {
+		carry[x] = (x ? carry[x - 1] : 0) + cols[x];
+	}
+
+	for (size_t y=y0; y<y1; y++) {
+		uint8_t *d = job->dst + y * job->stride_dst;
+
+		integral_row_prefix(job->src + y * job->stride_src, prefix, w);
+
+		if (job->depth == VLIB_INTEGRAL_32) {
+			uint32_t *o = (uint32_t *)d;
+
+			if (y == y0) {
+				for (size_t x=0; x<w; x++) {
+					o[x] = (uint32_t)carry[x] + (uint32_t)prefix[x];
+				}
+			} else {
+				const uint32_t *a = (const uint32_t *)(d - job->stride_dst);
+
+				for (size_t x=0; x<w; x++) {
+					o[x] = a[x] + (uint32_t)prefix[x];
+				}
+			}
+		} else {
+			uint64_t *o = (uint64_t *)d;
+			const uint64_t *a = y == y0 ? carry :
+						(const uint64_t *)(d - job->stride_dst);
+
+			for (size_t x=0; x<w; x++) {
+				o[x] = a[x] + (uint32_t)prefix[x];
+			}
+		}
+	}
+
+out:
+	free(prefix);
+	free(carry);
+	free(cols);
+}
+
+/**
+ * vlib_integral - Integral image of an 8-bit image on all cores
+ * @src: Source image
+ * @stride_src: Line stride of @src in bytes
+ * @dst: Integral image of the same size, elements of @depth bytes
+ * @stride_dst: Line stride of @dst in bytes
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ * @depth: Output width, 32-bit only up to VLIB_INTEGRAL_MAX_PIXELS_32
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_integral(const uint8_t *src, size_t stride_src,
+				void *dst, size_t stride_dst,
+				size_t width, size_t height,
+				enum vlib_integral_depth depth)
+{
+	size_t chunks = (height + INTEGRAL_CHUNK - 1) / INTEGRAL_CHUNK;
+	struct integral_job job = {
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.width = width,
+		.height = height,
+		.depth = depth,
+		.ret = VLIB_SUCCESS,
+	};
+	int ret;
+
+	if (!src || !dst || !width || !height ||
+		(depth != VLIB_INTEGRAL_32 && depth != VLIB_INTEGRAL_64) ||
+		depth < vlib_integral_depth(width, height) ||
+		stride_dst < width * depth) {
+		VLIB_REPORT_ERR("integral: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	job.sums = malloc(chunks * width * sizeof(*job.sums));
+	if (!job.sums) {
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	ret = vlib_parallel_for(chunks, 1, integral_sums_band, &job);
+	if (!ret) {
+		ret = vlib_parallel_for(chunks, 1, integral_band, &job);
+	}
+
+	free(job.sums);
+
+	return ret ? ret : job.ret;
+}
+
+/**
+ * vlib_integral_rows_create - Set up a rolling integral image
+ * @width: Image width in pixels
+ * @rows: Integral rows kept, at least 1
+ *
+ * Return: Pointer to the rolling integral on success, NULL otherwise.
+ */
+struct vlib_integral_rows *vlib_integral_rows_create(size_t width,
+				size_t rows)
+{
+	struct vlib_integral_rows *ir;
+
+	if (!width || !rows) {
+		VLIB_REPORT_ERR("integral: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	ir = calloc(1, sizeof(*ir));
+	if (!ir) {
+		return NULL;
+	}
+
+	ir->width = width;
+	ir->rows = rows;
+	ir->ring = malloc(rows * width * sizeof(*ir->ring));
+	ir->zero = calloc(width, sizeof(*ir->zero));
+	ir->prefix = malloc(width * sizeof(*ir->prefix));
+	if (!ir->ring || !ir->zero || !ir->prefix) {
+		vlib_integral_rows_destroy(ir);
+		return NULL;
+	}
+
+	return ir;
+}
+
+void vlib_integral_rows_destroy(struct vlib_integral_rows *ir)
+{
+	if (!ir) {
+		return;
+	}
+
+	free(ir->ring);
+	free(ir->zero);
+	free(ir->prefix);
+	free(ir);
+}
+
+/**
+ * vlib_integral_rows_reset - Start over at the top of a frame
+ * @ir: Rolling integral
+ */
+void vlib_integral_rows_reset(struct vlib_integral_rows *ir)
+{
+	ir->next = 0;
+}
+
+/**
+ * vlib_integral_rows_push - Add the next source row
+ * @ir: Rolling integral
+ * @src: Source row of the width given at creation
+ *
+ * The oldest row is dropped once @rows are kept.
+ *
+ * Return: The integral row of @src.
+ */
+const uint32_t *vlib_integral_rows_push(struct vlib_integral_rows *ir,
+				const uint8_t *src)
+{
+	const uint32_t *a = vlib_integral_rows_get(ir, ir->next - 1);
+	uint32_t *o = ir->ring + (ir->next % ir->rows) * ir->width;
+
+	integral_row_prefix(src, ir->prefix, ir->width);
+	for (size_t x=0; x<ir->width; x++) {
+		o[x] = a[x] + (uint32_t)ir->prefix[x];
+	}
+	ir->next++;
+
+	return o;
+}
+
+/**
+ * vlib_integral_rows_get - Integral row of a source row pushed before
+ * @ir: Rolling integral
+ * @y: Source row, rows above the frame are zero
+ *
+ * Return: The integral row, NULL if it was not pushed yet or is dropped.
+ */
+const uint32_t *vlib_integral_rows_get(const struct vlib_integral_rows *ir,
+				long y)
+{
+	if (y < 0) {
+		return ir->zero;
+	}
+	if (y >= ir->next || ir->next - y > (long)ir->rows) {
+		return NULL;
+	}
+
+	return ir->ring + (y % ir->rows) * ir->width;
+}
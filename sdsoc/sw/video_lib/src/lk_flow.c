@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "helper.h"
+#include "lk_flow.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* rows per band boundary of the parallel passes */
+#define LK_FLOW_GRAIN		16
+
+/* product images, in the order of the window sums */
+enum {
+	LK_FLOW_IXIX,
+	LK_FLOW_IXIY,
+	LK_FLOW_IYIY,
+	LK_FLOW_DIX,
+	LK_FLOW_DIY,
+	LK_FLOW_NUM_PRODUCTS,
+};
+
+struct vlib_lk_flow {
+	size_t width;
+	size_t height;
+	/* product line stride in elements, a multiple of 8 */
+	size_t stride;
+	int window_size;
+	/* zero padded beyond width */
+	int16_t *prod[LK_FLOW_NUM_PRODUCTS];
+	struct vlib_lk_flow_stats stats;
+};
+
+struct lk_flow_job {
+	struct vlib_lk_flow *lk;
+	const uint8_t *src[2];
+	size_t stride[2];
+	float *flow[2];
+	size_t stride_flow;
+};
+
+/* a / 2 rounded towards zero, as the integer division of the xf kernel */
+static inline v_s16 lk_flow_half(v_s16 a)
+{
+	v_s16 sign = v_reinterpret_s16_u16(v_shr_u16(v_reinterpret_u16_s16(a), 15));
+
+	return v_shr_s16(v_add_s16(a, sign), 1);
+}
+
+/*
+ * Central difference gradients of @cur and the difference to @next, and
+ * their products. The products fit 16 bits: |Ix|, |Iy| <= 127 and
+ * |It| <= 255.
+ */
+static void lk_flow_products_row(const struct vlib_lk_flow *lk,
+								const uint8_t *up, const uint8_t *cur,
+								const uint8_t *dn, const uint8_t *next,
+								size_t y)
+{
+	int16_t *p[LK_FLOW_NUM_PRODUCTS];
+	size_t n = lk->width - 2;
+
+	for (int k=0; k<LK_FLOW_NUM_PRODUCTS; k++) {
+		p[k] = lk->prod[k] + y * lk->stride;
+		p[k][0] = 0;
+		p[k][lk->width - 1] = 0;
+	}
+
+	for (size_t i=0; i<n; i+=8) {
+		size_t x;
+		v_s16 ix, iy, dt;
+
+		if (i + 8 > n) {
+			i = n - 8;
+		}
+		x = i + 1;
+
+		ix = lk_flow_half(v_sub_s16(v_load_expand_u8(cur + x + 1),
+									v_load_expand_u8(cur + x - 1)));
+		iy = lk_flow_half(v_sub_s16(v_load_expand_u8(dn + x),
+									v_load_expand_u8(up + x)));
+		dt = v_sub_s16(v_load_expand_u8(cur + x), v_load_expand_u8(next + x));
+
+		v_store_s16(p[LK_FLOW_IXIX] + x, v_mul_s16(ix, ix));
+		v_store_s16(p[LK_FLOW_IXIY] + x, v_mul_s16(ix, iy));
+		v_store_s16(p[LK_FLOW_IYIY] + x, v_mul_s16(iy, iy));
+		v_store_s16(p[LK_FLOW_DIX] + x, v_mul_s16(dt, ix));
+		v_store_s16(p[LK_FLOW_DIY] + x, v_mul_s16(dt, iy));
+	}
+}
+
+static void lk_flow_products_band(void *arg, size_t start, size_t end)
+{
+	struct lk_flow_job *job = arg;
+	const struct vlib_lk_flow *lk = job->lk;
+
+	for (size_t y=start; y<end; y++) {
+		const uint8_t *cur = job->src[0] + y * job->stride[0];
+
+		if (y == 0 || y == lk->height - 1) {
+			for (int k=0; k<LK_FLOW_NUM_PRODUCTS; k++) {
+				memset(lk->prod[k] + y * lk->stride, 0,
+						lk->width * sizeof(int16_t));
+			}
+			continue;
+		}
+
+		lk_flow_products_row(lk, cur - job->stride[0], cur,
+							cur + job->stride[0],
+							job->src[1] + y * job->stride[1], y);
+	}
+}
+
+/* add row @add and remove row @sub of the products from the column sums */
+static void lk_flow_update_cols(const struct vlib_lk_flow *lk, int32_t **cs,
+								long add, long sub)
+{
+	for (int k=0; k<LK_FLOW_NUM_PRODUCTS; k++) {
+		const int16_t *pa = add >= 0 ? lk->prod[k] + add * lk->stride : NULL;
+		const int16_t *ps = sub >= 0 ? lk->prod[k] + sub * lk->stride : NULL;
+		int32_t *c = cs[k];
+
+		for (size_t x=0; x<lk->stride; x+=8) {
+			v_s32 lo = v_load_s32(c + x), hi = v_load_s32(c + x + 4);
+
+			if (pa) {
+				v_s16 a = v_load_s16(pa + x);
+
+				lo = v_add_s32(lo, v_expand_lo_s16(a));
+				hi = v_add_s32(hi, v_expand_hi_s16(a));
+			}
+			if (ps) {
+				v_s16 s = v_load_s16(ps + x);
+
+				lo = v_sub_s32(lo, v_expand_lo_s16(s));
+				hi = v_sub_s32(hi, v_expand_hi_s16(s));
+			}
+			v_store_s32(c + x, lo);
+			v_store_s32(c + x + 4, hi);
+		}
+	}
+}
+
+/* solve the 2x2 system of a window as computeFlow16 */
+static inline void lk_flow_solve(const int32_t *s, float *fx, float *fy)
+{
+	float det = (float)s[LK_FLOW_IXIX] * s[LK_FLOW_IYIY] -
+				(float)s[LK_FLOW_IXIY] * s[LK_FLOW_IXIY];
+
+	if (det <= 1.0f) {
+		*fx = 0;
+		*fy = 0;
+	} else {
+		float i00 = (float)s[LK_FLOW_IYIY] / det;
+		float i01 = (float)-s[LK_FLOW_IXIY] / det;
+		float i11 = (float)s[LK_FLOW_IXIX] / det;
+
+		*fx = i00 * s[LK_FLOW_DIX] + i01 * s[LK_FLOW_DIY];
+		*fy = i01 * s[LK_FLOW_DIX] + i11 * s[LK_FLOW_DIY];
+	}
+}
+
+static void lk_flow_band(void *arg, size_t start, size_t end)
+{
+	struct lk_flow_job *job = arg;
+	const struct vlib_lk_flow *lk = job->lk;
+	const long r = lk->window_size / 2;
+	const long w = lk->width, h = lk->height;
+	/* column sums, r zero columns on the left, r + 1 on the right */
+	const size_t ncs = lk->stride + 2 * r + 1;
+	int32_t *buf, *cs[LK_FLOW_NUM_PRODUCTS];
+
+	buf = calloc(ncs * LK_FLOW_NUM_PRODUCTS, sizeof(*buf));
+	if (!buf) {
+		vlib_warn("lk optical flow: out of memory\n");
+		return;
+	}
+	for (int k=0; k<LK_FLOW_NUM_PRODUCTS; k++) {
+		cs[k] = buf + k * ncs + r;
+	}
+
+	/* the first update of the loop removes row start - r - 1 again */
+	for (long y=(long)start-r-1; y<(long)start+r; y++) {
+		if (y >= 0 && y < h) {
+			lk_flow_update_cols(lk, cs, y, -1);
+		}
+	}
+
+	for (long y=start; y<(long)end; y++) {
+		float *fx = (float *)((uint8_t *)job->flow[0] + y * job->stride_flow);
+		float *fy = (float *)((uint8_t *)job->flow[1] + y * job->stride_flow);
+		int32_t s[LK_FLOW_NUM_PRODUCTS];
+
+		lk_flow_update_cols(lk, cs, y + r < h ? y + r : -1,
+							y - r - 1 >= 0 ? y - r - 1 : -1);
+
+		/* box sum of the first window, then slide along the row */
+		for (int k=0; k<LK_FLOW_NUM_PRODUCTS; k++) {
+			s[k] = 0;
+			for (long j=-r; j<=r; j++) {
+				s[k] += cs[k][j];
+			}
+		}
+
+		for (long x=0; x<w; x++) {
+			lk_flow_solve(s, fx + x, fy + x);
+
+			for (int k=0; k<LK_FLOW_NUM_PRODUCTS; k++) {
+				s[k] += cs[k][x + r + 1] - cs[k][x - r];
+			}
+		}
+	}
+
+	free(buf);
+}
+
+struct vlib_lk_flow *vlib_lk_flow_create(size_t width, size_t height,
+				int window_size)
+{
+	struct vlib_lk_flow *lk;
+
+	if (width < 10 || height < 3) {
+		VLIB_REPORT_ERR("lk optical flow: %zux%zu too small", width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	if (window_size < 3 || window_size > VLIB_LK_FLOW_MAX_WINDOW ||
+		!(window_size & 1)) {
+		VLIB_REPORT_ERR("lk optical flow: window size %d not odd in 3..%d",
+						window_size, VLIB_LK_FLOW_MAX_WINDOW);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	lk = calloc(1, sizeof(*lk));
+	if (!lk) {
+		return NULL;
+	}
+
+	lk->width = width;
+	lk->height = height;
+	lk->stride = (width + 7) & ~7;
+	lk->window_size = window_size;
+
+	for (int k=0; k<LK_FLOW_NUM_PRODUCTS; k++) {
+		lk->prod[k] = calloc(lk->stride * height, sizeof(int16_t));
+		if (!lk->prod[k]) {
+			vlib_lk_flow_destroy(lk);
+			return NULL;
+		}
+	}
+
+	return lk;
+}
+
+void vlib_lk_flow_destroy(struct vlib_lk_flow *lk)
+{
+	if (!lk) {
+		return;
+	}
+
+	for (int k=0; k<LK_FLOW_NUM_PRODUCTS; k++) {
+		free(lk->prod[k]);
+	}
+	free(lk);
+}
+
+/**
+ * vlib_lk_flow_compute - compute the dense optical flow between two frames
+ * @lk: flow context
+ * @prev: previous 8-bit frame
+ * @stride_prev: line stride of @prev in bytes
+ * @next: next 8-bit frame
+ * @stride_next: line stride of @next in bytes
+ * @flowx: horizontal flow output in pixels
+ * @flowy: vertical flow output in pixels
+ * @stride_flow: line stride of @flowx and @flowy in bytes
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_lk_flow_compute(struct vlib_lk_flow *lk,
+				const uint8_t *prev, size_t stride_prev,
+				const uint8_t *next, size_t stride_next,
+				float *flowx, float *flowy, size_t stride_flow)
+{
+	struct lk_flow_job job = {
+		.lk = lk,
+		.src = { prev, next },
+		.stride = { stride_prev, stride_next },
+		.flow = { flowx, flowy },
+		.stride_flow = stride_flow,
+	};
+	struct timespec t;
+	int ret;
+
+	if (!prev || !next || !flowx || !flowy) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(lk->height, LK_FLOW_GRAIN,
+							lk_flow_products_band, &job);
+	lk->stats.products_ms = vlib_ms_since(&t);
+	if (ret) {
+		return ret;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(lk->height, LK_FLOW_GRAIN, lk_flow_band, &job);
+	lk->stats.flow_ms = vlib_ms_since(&t);
+
+	return ret;
+}
+
+void vlib_lk_flow_get_stats(const struct vlib_lk_flow *lk,
+				struct vlib_lk_flow_stats *stats)
+{
+	*stats = lk->stats;
+}
@@ -0,0 +1,247 @@
+#include <linux/videodev2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "helper.h"
+#include "image.h"
+#include "luma_stage.h"
+#include "parallel.h"
+#include "video_int.h"
+
+/* rows per band boundary of the chroma pass, even for 4:2:0 formats */
+#define LUMA_STAGE_GRAIN	16
+
+/* luma of the supported formats */
+static const struct luma_stage_format luma_stage_formats[] = {
+	{ V4L2_PIX_FMT_GREY, 1, 0 },
+	{ V4L2_PIX_FMT_NV12, 1, 0 },
+	{ V4L2_PIX_FMT_NV21, 1, 0 },
+	{ V4L2_PIX_FMT_YUV420, 1, 0 },
+	{ V4L2_PIX_FMT_YVU420, 1, 0 },
+	{ V4L2_PIX_FMT_YUYV, 2, 0 },
+	{ V4L2_PIX_FMT_UYVY, 2, 1 },
+};
+
+struct luma_stage_data {
+	const struct luma_stage *ls;
+	void *data;
+	const struct luma_stage_format *fmt;
+	size_t width;
+	size_t height;
+};
+
+struct luma_stage_job {
+	const struct luma_stage_data *sd;
+	const struct vlib_image *in;
+	const struct vlib_image *out;
+};
+
+/**
+ * luma_stage_find_format - Look up the luma layout of a format
+ * @fourcc: V4L2 fourcc of the frames
+ *
+ * Return: The layout, or NULL if @fourcc has no single luma channel.
+ */
+const struct luma_stage_format *luma_stage_find_format(uint32_t fourcc)
+{
+	for (size_t i=0; i<ARRAY_SIZE(luma_stage_formats); i++) {
+		if (luma_stage_formats[i].fourcc == fourcc) {
+			return &luma_stage_formats[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void luma_stage_release(struct luma_stage_data *sd)
+{
+	if (sd->fmt && sd->ls->ops->release) {
+		sd->ls->ops->release(sd->data);
+	}
+
+	sd->fmt = NULL;
+	sd->width = 0;
+	sd->height = 0;
+}
+
+static int luma_stage_init(struct filter_s *fs,
+						const struct filter_init_data *fid)
+{
+	struct luma_stage_data *sd = fs->data;
+	const struct luma_stage_ops *ops = sd->ls->ops;
+	const struct luma_stage_format *fmt;
+	int ret;
+
+	fmt = luma_stage_find_format(fid->in_fourcc);
+	if (!fmt || fid->out_fourcc != fid->in_fourcc ||
+		fid->out_width != fid->in_width ||
+		fid->out_height != fid->in_height) {
+		return -1;
+	}
+
+	if (ops->reset) {
+		ops->reset(sd->data);
+	}
+
+	if (sd->fmt == fmt && sd->width == fid->in_width &&
+		sd->height == fid->in_height) {
+		return 0;
+	}
+
+	luma_stage_release(sd);
+
+	ret = ops->setup ? ops->setup(sd->data, fmt, fid->in_width,
+								fid->in_height) : 0;
+	if (ret) {
+		if (ret != VLIB_ERROR_NOT_SUPPORTED) {
+			vlib_warn("%s: failed to set up %zux%zu\n", sd->ls->name,
+					fid->in_width, fid->in_height);
+		}
+		return -1;
+	}
+
+	sd->fmt = fmt;
+	sd->width = fid->in_width;
+	sd->height = fid->in_height;
+
+	return 0;
+}
+
+/* chroma of rows [start, end), interleaved with the luma of packed formats */
+static void luma_stage_chroma_band(void *arg, size_t start, size_t end)
+{
+	struct luma_stage_job *job = arg;
+	const struct luma_stage_format *fmt = job->sd->fmt;
+	const struct vlib_image *in = job->in, *out = job->out;
+	int grey = job->sd->ls->grey_chroma;
+
+	if (fmt->pitch > 1) {
+		size_t bytes = in->stride[0] < out->stride[0] ?
+						in->stride[0] : out->stride[0];
+
+		for (size_t y=start; y<end; y++) {
+			uint8_t *d = vlib_image_line(out, 0, y);
+
+			if (!grey) {
+				memcpy(d, vlib_image_line(in, 0, y), bytes);
+				continue;
+			}
+			for (size_t x=0; x<in->width; x++) {
+				d[2 * x + 1 - fmt->offset] = 128;
+			}
+		}
+		return;
+	}
+
+	for (size_t p=1; p<in->num_planes; p++) {
+		size_t bytes = in->stride[p] < out->stride[p] ?
+						in->stride[p] : out->stride[p];
+
+		for (size_t y=start/2; y<(end+1)/2; y++) {
+			if (grey) {
+				memset(vlib_image_line(out, p, y), 128, bytes);
+			} else {
+				memcpy(vlib_image_line(out, p, y),
+						vlib_image_line(in, p, y), bytes);
+			}
+		}
+	}
+}
+
+static void luma_stage_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	struct luma_stage_data *sd = fs->data;
+	const struct luma_stage_format *fmt = sd->fmt;
+	struct vlib_image in, out;
+	struct luma_stage_job job = {
+		.sd = sd,
+		.in = &in,
+		.out = &out,
+	};
+	struct luma_stage_frame frame;
+
+	if (!fmt || (size_t)width_in != sd->width ||
+		(size_t)height_in != sd->height ||
+		vlib_image_init(&in, fmt->fourcc, width_in, height_in, stride_in,
+						frm_data_in) ||
+		vlib_image_init(&out, fmt->fourcc, width_out, height_out,
+						stride_out, frm_data_out)) {
+		return;
+	}
+
+	if (in.num_planes > 1 || fmt->pitch > 1) {
+		vlib_parallel_for(in.height, LUMA_STAGE_GRAIN, luma_stage_chroma_band,
+						&job);
+	}
+
+	frame.in = &in;
+	frame.out = &out;
+	frame.src = in.plane[0] + fmt->offset;
+	frame.stride_src = in.stride[0];
+	frame.dst = out.plane[0] + fmt->offset;
+	frame.stride_dst = out.stride[0];
+	frame.width = in.width;
+	frame.height = in.height;
+	frame.pitch = fmt->pitch;
+
+	if (sd->ls->ops->run(sd->data, fs->mode, &frame)) {
+		vlib_warn("%s: out of memory\n", sd->ls->name);
+	}
+}
+
+static struct filter_ops luma_stage_ops = {
+	.init = luma_stage_init,
+	.func = luma_stage_func,
+};
+
+static const struct filter_s luma_stage_fs = {
+	.display_text = "",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = 0,
+	.ops = &luma_stage_ops,
+	.data = NULL,
+	.num_modes = 0,
+	.modes = NULL,
+};
+
+/**
+ * luma_stage_create - Create a pipeline stage around a luma kernel
+ * @ls: Description of the stage, must stay valid
+ * @data: Private data handed to the callbacks of @ls
+ *
+ * @data is owned by the caller and must outlive the stage.
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *luma_stage_create(const struct luma_stage *ls, void *data)
+{
+	struct filter_s *fs;
+	struct luma_stage_data *sd = calloc(1, sizeof(*sd));
+	if (!sd) {
+		return NULL;
+	}
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		free(sd);
+		return NULL;
+	}
+
+	sd->ls = ls;
+	sd->data = data;
+
+	*fs = luma_stage_fs;
+	fs->display_text = ls->display_text;
+	fs->num_modes = ls->num_modes;
+	fs->modes = ls->modes;
+	fs->data = sd;
+
+	return fs;
+}
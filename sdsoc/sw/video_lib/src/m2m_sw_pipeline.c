@@ -170,6 +170,9 @@ static void m2m_sw_v4l2_process_loop(struct stream_handle *sh)
 			unsigned char *out_ptr = (unsigned char *)b_out->drm_buff;
 			unsigned char *in_ptr0 = (unsigned char *)b->v4l2_buff;
 
+			vlib_analytics_frame(v_pipe, in_ptr0,
+					sh->video_in.format.bytesperline);
+
 			if (filter_has_func2) {
 				/*processing function takes two input frames */
 				struct buffer *b2 = g_queue_peek_tail(sh->buffer_q_src2filter);
@@ -246,6 +249,7 @@ static void m2m_sw_file_process_loop(struct video_pipeline *v_pipe,
 		levents_capture_event(v_pipe->events[PROCESS_IN]);
 		unsigned char *out_ptr = (unsigned char*)v_pipe->drm.d_buff[cur_drm_buf].drm_buff;
 		unsigned char *in_ptr0 = (unsigned char*)in_buf;
+		vlib_analytics_frame(v_pipe, in_ptr0, v_pipe->stride);
 		sh->fs->ops->func(sh->fs, in_ptr0, out_ptr,
 				v_pipe->h, v_pipe->w, v_pipe->stride,
 				sh->video_out.height,
@@ -0,0 +1,784 @@
+#include <linux/videodev2.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cvt_color.h"
+#include "filter.h"
+#include "helper.h"
+#include "image.h"
+#include "meanshift.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* rows per band boundary of the image passes, even for 4:2:0 formats */
+#define MEANSHIFT_GRAIN		8
+
+/* kernel weight of the window center, Q8 as xf */
+#define MEANSHIFT_K_ONE		256
+
+/* smallest object window edge */
+#define MEANSHIFT_MIN_SIZE	4
+
+struct meanshift_obj {
+	int active;
+	int lost;
+	int x;
+	int y;
+	int width;
+	int height;
+	int iterations;
+	float similarity;
+	/* search window of the current frame, end exclusive */
+	int sx0;
+	int sy0;
+	int sx1;
+	int sy1;
+	uint16_t *kernel;			/* width * height Epanechnikov weights */
+	uint32_t qu[VLIB_MEANSHIFT_BINS];	/* target histogram */
+	uint32_t qn;
+	uint32_t pu[VLIB_MEANSHIFT_BINS];	/* candidate histogram */
+	float weight[VLIB_MEANSHIFT_BINS];
+};
+
+struct vlib_meanshift {
+	struct vlib_meanshift_params p;
+	size_t width;
+	size_t height;
+	struct meanshift_obj *objs;
+	/* bin image, valid inside the search windows of the current frame */
+	uint16_t *bins;
+	/* objects tracked in the current frame, by left edge of the search */
+	int *order;
+	size_t num_order;
+	struct vlib_meanshift_stats stats;
+};
+
+struct meanshift_job {
+	struct vlib_meanshift *ms;
+	const uint8_t *rgb;
+	size_t stride;
+	size_t y0;
+};
+
+static inline int meanshift_clamp(int v, int lo, int hi)
+{
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+/* bins of pixels [@x0, @x1) of an RGB24 row, as xFTrackmulFindbin */
+static void meanshift_bin_row(const uint8_t *rgb, uint16_t *bins, size_t x0,
+							size_t x1)
+{
+	const v_u16 top = v_setall_u16(0xe0), two = v_setall_u16(2);
+	size_t x = x0;
+
+	for (; x+16<=x1; x+=16) {
+		v_u8 r, g, b;
+
+		v_load_deinterleave3_u8(rgb + 3 * x, &r, &g, &b);
+
+		for (int k=0; k<2; k++) {
+			v_u16 r16 = v_reinterpret_u16_s16(k ? v_expand_hi_u8(r) : v_expand_lo_u8(r));
+			v_u16 g16 = v_reinterpret_u16_s16(k ? v_expand_hi_u8(g) : v_expand_lo_u8(g));
+			v_u16 b16 = v_reinterpret_u16_s16(k ? v_expand_hi_u8(b) : v_expand_lo_u8(b));
+
+			v_store_u16(bins + x + 8 * k,
+						v_add_u16(v_add_u16(v_shr_u16(r16, 5),
+											v_shr_u16(v_and_u16(g16, top), 2)),
+								v_mul_u16(v_and_u16(b16, top), two)));
+		}
+	}
+
+	for (; x<x1; x++) {
+		const uint8_t *p = rgb + 3 * x;
+
+		bins[x] = (p[0] >> 5) + ((p[1] >> 5) << 3) + ((p[2] >> 5) << 6);
+	}
+}
+
+/*
+ * Bins of the union of the search windows, one run of merged intervals
+ * per row. The objects are sorted by the left edge of their search.
+ */
+static void meanshift_bins_band(void *arg, size_t start, size_t end)
+{
+	struct meanshift_job *job = arg;
+	struct vlib_meanshift *ms = job->ms;
+
+	for (size_t y=job->y0+start; y<job->y0+end; y++) {
+		const uint8_t *rgb = job->rgb + y * job->stride;
+		uint16_t *bins = ms->bins + y * ms->width;
+		int x0 = 0, x1 = 0;
+
+		for (size_t k=0; k<ms->num_order; k++) {
+			const struct meanshift_obj *o = &ms->objs[ms->order[k]];
+
+			if ((int)y < o->sy0 || (int)y >= o->sy1) {
+				continue;
+			}
+			if (o->sx0 > x1) {
+				meanshift_bin_row(rgb, bins, x0, x1);
+				x0 = o->sx0;
+				x1 = o->sx1;
+			} else if (o->sx1 > x1) {
+				x1 = o->sx1;
+			}
+		}
+		meanshift_bin_row(rgb, bins, x0, x1);
+	}
+}
+
+/* kernel weighted histogram of the window at @x, @y, returns its sum */
+static uint32_t meanshift_hist(const struct vlib_meanshift *ms,
+							const struct meanshift_obj *o, int x, int y,
+							uint32_t *hist)
+{
+	uint32_t n = 0;
+
+	memset(hist, 0, VLIB_MEANSHIFT_BINS * sizeof(*hist));
+
+	for (int j=0; j<o->height; j++) {
+		const uint16_t *b = ms->bins + (y + j) * ms->width + x;
+		const uint16_t *k = o->kernel + j * o->width;
+
+		for (int i=0; i<o->width; i++) {
+			hist[b[i]] += k[i];
+			n += k[i];
+		}
+	}
+
+	return n;
+}
+
+/* Bhattacharyya coefficient of the target and the candidate histogram */
+static float meanshift_similarity(const struct meanshift_obj *o, uint32_t pn)
+{
+	float s = 0;
+
+	if (!pn || !o->qn) {
+		return 0;
+	}
+
+	for (int b=0; b<VLIB_MEANSHIFT_BINS; b++) {
+		s += sqrtf((float)o->qu[b] * o->pu[b]);
+	}
+
+	return s / sqrtf((float)o->qn * pn);
+}
+
+/*
+ * Mean shift steps of one object, as xFTrackmulKernelFunc: the candidate
+ * histogram at the window, the weight of every bin and the weighted mean
+ * of the pixel offsets from the window center.
+ */
+static void meanshift_track_obj(const struct vlib_meanshift *ms,
+								struct meanshift_obj *o)
+{
+	const float cx = (o->width - 1) / 2.0f, cy = (o->height - 1) / 2.0f;
+	uint32_t pn = 0;
+	int moved = 1;
+
+	o->iterations = 0;
+
+	for (int it=0; it<ms->p.max_iterations; it++) {
+		float sw = 0, sx = 0, sy = 0;
+		int x, y;
+
+		pn = meanshift_hist(ms, o, o->x, o->y, o->pu);
+		for (int b=0; b<VLIB_MEANSHIFT_BINS; b++) {
+			o->weight[b] = o->pu[b] && o->qu[b] ?
+						sqrtf((float)o->qu[b] * pn / ((float)o->pu[b] * o->qn)) : 0;
+		}
+
+		for (int j=0; j<o->height; j++) {
+			const uint16_t *b = ms->bins + (o->y + j) * ms->width + o->x;
+			const uint16_t *k = o->kernel + j * o->width;
+			float rw = 0, rx = 0;
+
+			for (int i=0; i<o->width; i++) {
+				if (k[i]) {
+					float w = o->weight[b[i]];
+
+					rw += w;
+					rx += w * i;
+				}
+			}
+			sw += rw;
+			sx += rx;
+			sy += rw * j;
+		}
+
+		o->iterations++;
+		if (sw <= 0) {
+			moved = 0;
+			break;
+		}
+
+		x = meanshift_clamp(o->x + lroundf(sx / sw - cx), o->sx0,
+							o->sx1 - o->width);
+		y = meanshift_clamp(o->y + lroundf(sy / sw - cy), o->sy0,
+							o->sy1 - o->height);
+		if (x == o->x && y == o->y) {
+			moved = 0;
+			break;
+		}
+		o->x = x;
+		o->y = y;
+	}
+
+	if (moved) {
+		pn = meanshift_hist(ms, o, o->x, o->y, o->pu);
+	}
+
+	o->similarity = meanshift_similarity(o, pn);
+	o->lost = o->similarity < ms->p.min_similarity;
+}
+
+static void meanshift_track_band(void *arg, size_t start, size_t end)
+{
+	struct meanshift_job *job = arg;
+	struct vlib_meanshift *ms = job->ms;
+
+	for (size_t k=start; k<end; k++) {
+		meanshift_track_obj(ms, &ms->objs[ms->order[k]]);
+	}
+}
+
+void vlib_meanshift_default_params(struct vlib_meanshift_params *params)
+{
+	params->max_objects = 16;
+	params->max_iterations = 4;
+	params->search_radius = 16;
+	params->min_similarity = 0.5f;
+}
+
+struct vlib_meanshift *vlib_meanshift_create(
+				const struct vlib_meanshift_params *params,
+				size_t width, size_t height)
+{
+	struct vlib_meanshift *ms;
+
+	if (params->max_objects < 1 || params->max_iterations < 1 ||
+		params->search_radius < 1 || !(params->min_similarity >= 0) ||
+		params->min_similarity > 1) {
+		VLIB_REPORT_ERR("meanshift: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	if (width < MEANSHIFT_MIN_SIZE || height < MEANSHIFT_MIN_SIZE ||
+		width > UINT16_MAX || height > UINT16_MAX) {
+		VLIB_REPORT_ERR("meanshift: %zux%zu not supported", width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	ms = calloc(1, sizeof(*ms));
+	if (!ms) {
+		return NULL;
+	}
+
+	ms->p = *params;
+	ms->width = width;
+	ms->height = height;
+	ms->objs = calloc(params->max_objects, sizeof(*ms->objs));
+	ms->order = malloc(params->max_objects * sizeof(*ms->order));
+	ms->bins = malloc(width * height * sizeof(*ms->bins));
+	if (!ms->objs || !ms->order || !ms->bins) {
+		vlib_meanshift_destroy(ms);
+		return NULL;
+	}
+
+	return ms;
+}
+
+void vlib_meanshift_destroy(struct vlib_meanshift *ms)
+{
+	if (!ms) {
+		return;
+	}
+
+	if (ms->objs) {
+		for (int i=0; i<ms->p.max_objects; i++) {
+			free(ms->objs[i].kernel);
+		}
+	}
+	free(ms->objs);
+	free(ms->order);
+	free(ms->bins);
+	free(ms);
+}
+
+/**
+ * vlib_meanshift_add - start tracking an object
+ * @ms: mean shift tracker
+ * @rgb: RGB24 frame the object is taken from
+ * @stride: line stride of @rgb in bytes
+ * @x: left edge of the object window
+ * @y: top edge of the object window
+ * @width: width of the object window, >= 4
+ * @height: height of the object window, >= 4
+ *
+ * The target histogram is taken from the window in @rgb and kept until
+ * the object is removed.
+ *
+ * Return: the object id on success, or an error code.
+ */
+int vlib_meanshift_add(struct vlib_meanshift *ms,
+				const uint8_t *rgb, size_t stride,
+				int x, int y, int width, int height)
+{
+	struct meanshift_obj *o = NULL;
+	float hx = width / 2.0f, hy = height / 2.0f;
+	int id;
+
+	if (!rgb || width < MEANSHIFT_MIN_SIZE || height < MEANSHIFT_MIN_SIZE ||
+		x < 0 || y < 0 || (size_t)x + width > ms->width ||
+		(size_t)y + height > ms->height) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	for (id=0; id<ms->p.max_objects; id++) {
+		if (!ms->objs[id].active) {
+			o = &ms->objs[id];
+			break;
+		}
+	}
+	if (!o) {
+		VLIB_REPORT_ERR("meanshift: all %d objects in use", ms->p.max_objects);
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	free(o->kernel);
+	memset(o, 0, sizeof(*o));
+	o->kernel = malloc(width * height * sizeof(*o->kernel));
+	if (!o->kernel) {
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	/* 1 - r^2 over the ellipse of the window, as xFTrackmulFindbinIncrement */
+	for (int j=0; j<height; j++) {
+		for (int i=0; i<width; i++) {
+			float dx = (i - (width - 1) / 2.0f) / hx;
+			float dy = (j - (height - 1) / 2.0f) / hy;
+			float k = 1 - (dx * dx + dy * dy);
+
+			o->kernel[j * width + i] = k > 0 ? lroundf(k * MEANSHIFT_K_ONE) : 0;
+		}
+	}
+
+	o->active = 1;
+	o->x = x;
+	o->y = y;
+	o->width = width;
+	o->height = height;
+	o->similarity = 1;
+
+	for (int j=0; j<height; j++) {
+		meanshift_bin_row(rgb + (y + j) * stride, ms->bins + (y + j) * ms->width,
+						x, x + width);
+	}
+	o->qn = meanshift_hist(ms, o, x, y, o->qu);
+
+	return id;
+}
+
+void vlib_meanshift_remove(struct vlib_meanshift *ms, int id)
+{
+	if (id < 0 || id >= ms->p.max_objects) {
+		return;
+	}
+
+	ms->objs[id].active = 0;
+}
+
+/**
+ * vlib_meanshift_track - follow all objects into a new frame
+ * @ms: mean shift tracker
+ * @rgb: RGB24 frame of the size @ms was created for
+ * @stride: line stride of @rgb in bytes
+ *
+ * Objects that are lost are left where they were lost.
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_meanshift_track(struct vlib_meanshift *ms,
+				const uint8_t *rgb, size_t stride)
+{
+	struct meanshift_job job = {
+		.ms = ms,
+		.rgb = rgb,
+		.stride = stride,
+	};
+	const int r = ms->p.search_radius;
+	size_t y1 = 0, lost = 0;
+	struct timespec t;
+	int ret;
+
+	if (!rgb) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	job.y0 = ms->height;
+	ms->num_order = 0;
+
+	for (int id=0; id<ms->p.max_objects; id++) {
+		struct meanshift_obj *o = &ms->objs[id];
+		size_t k;
+
+		if (!o->active || o->lost) {
+			continue;
+		}
+
+		o->sx0 = o->x > r ? o->x - r : 0;
+		o->sy0 = o->y > r ? o->y - r : 0;
+		o->sx1 = meanshift_clamp(o->x + o->width + r, 0, ms->width);
+		o->sy1 = meanshift_clamp(o->y + o->height + r, 0, ms->height);
+
+		for (k=ms->num_order; k>0 && ms->objs[ms->order[k - 1]].sx0>o->sx0; k--) {
+			ms->order[k] = ms->order[k - 1];
+		}
+		ms->order[k] = id;
+		ms->num_order++;
+
+		job.y0 = (size_t)o->sy0 < job.y0 ? (size_t)o->sy0 : job.y0;
+		y1 = (size_t)o->sy1 > y1 ? (size_t)o->sy1 : y1;
+	}
+
+	ms->stats.tracked = ms->num_order;
+	ms->stats.lost = 0;
+	ms->stats.bins_ms = 0;
+	ms->stats.track_ms = 0;
+	if (!ms->num_order) {
+		return VLIB_SUCCESS;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(y1 - job.y0, MEANSHIFT_GRAIN, meanshift_bins_band,
+							&job);
+	ms->stats.bins_ms = vlib_ms_since(&t);
+	if (ret) {
+		return ret;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(ms->num_order, 1, meanshift_track_band, &job);
+	ms->stats.track_ms = vlib_ms_since(&t);
+
+	for (size_t k=0; k<ms->num_order; k++) {
+		lost += ms->objs[ms->order[k]].lost;
+	}
+	ms->stats.lost = lost;
+
+	return ret;
+}
+
+int vlib_meanshift_get_object(const struct vlib_meanshift *ms, int id,
+				struct vlib_meanshift_object *obj)
+{
+	const struct meanshift_obj *o;
+
+	if (id < 0 || id >= ms->p.max_objects || !ms->objs[id].active) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	o = &ms->objs[id];
+	obj->x = o->x;
+	obj->y = o->y;
+	obj->width = o->width;
+	obj->height = o->height;
+	obj->similarity = o->similarity;
+	obj->iterations = o->iterations;
+	obj->lost = o->lost;
+
+	return VLIB_SUCCESS;
+}
+
+void vlib_meanshift_get_stats(const struct vlib_meanshift *ms,
+				struct vlib_meanshift_stats *stats)
+{
+	*stats = ms->stats;
+}
+
+/* Pipeline stage */
+
+/* objects per grid row of the filter modes */
+static const int meanshift_grid[] = { 1, 2, 3 };
+
+struct meanshift_data {
+	struct vlib_meanshift_params params;
+	struct vlib_meanshift *ms;
+	uint32_t in_fourcc;
+	uint32_t out_fourcc;
+	size_t width;
+	size_t height;
+	uint8_t *rgb;
+	/* mode the objects were placed for, -1 if none */
+	int grid_mode;
+	int ids[9];
+};
+
+struct meanshift_post_job {
+	struct meanshift_data *data;
+	struct vlib_image staging;
+	struct vlib_image out;
+	int ret;
+};
+
+static void meanshift_out_band(void *arg, size_t start, size_t end)
+{
+	struct meanshift_post_job *job = arg;
+
+	if (job->out.fourcc == V4L2_PIX_FMT_RGB24) {
+		for (size_t y=start; y<end; y++) {
+			memcpy(vlib_image_line(&job->out, 0, y),
+				vlib_image_line(&job->staging, 0, y), 3 * job->staging.width);
+		}
+		return;
+	}
+
+	if (vlib_cvt_color_lines(&job->staging, &job->out, start, end)) {
+		job->ret = VLIB_ERROR_OTHER;
+	}
+}
+
+/* window of object @i of an @n x @n grid over the center of the frame */
+static void meanshift_grid_window(const struct meanshift_data *data, int n,
+								int i, int *x, int *y, int *w, int *h)
+{
+	int cw = data->width / 2 / n, ch = data->height / 2 / n;
+
+	*w = cw / 2 & ~1;
+	*h = ch / 2 & ~1;
+	*x = data->width / 4 + (i % n) * cw + (cw - *w) / 2;
+	*y = data->height / 4 + (i / n) * ch + (ch - *h) / 2;
+}
+
+/* objects of the current mode, lost ones start over at their place */
+static void meanshift_place(struct meanshift_data *data, int mode)
+{
+	int n = meanshift_grid[mode];
+
+	if (data->grid_mode != mode) {
+		for (int i=0; i<(int)ARRAY_SIZE(data->ids); i++) {
+			vlib_meanshift_remove(data->ms, data->ids[i]);
+			data->ids[i] = -1;
+		}
+		data->grid_mode = mode;
+	}
+
+	for (int i=0; i<n*n; i++) {
+		struct vlib_meanshift_object obj;
+		int x, y, w, h;
+
+		if (data->ids[i] >= 0 &&
+			!vlib_meanshift_get_object(data->ms, data->ids[i], &obj) &&
+			!obj.lost) {
+			continue;
+		}
+
+		vlib_meanshift_remove(data->ms, data->ids[i]);
+		meanshift_grid_window(data, n, i, &x, &y, &w, &h);
+		data->ids[i] = vlib_meanshift_add(data->ms, data->rgb, 3 * data->width,
+										x, y, w, h);
+	}
+}
+
+static void meanshift_draw_rect(struct meanshift_data *data,
+								const struct vlib_meanshift_object *obj,
+								const uint8_t *color)
+{
+	for (int j=0; j<obj->height; j++) {
+		for (int i=0; i<obj->width; i++) {
+			uint8_t *p;
+
+			if (j > 1 && j < obj->height - 2 && i > 1 && i < obj->width - 2) {
+				i = obj->width - 3;
+				continue;
+			}
+
+			p = data->rgb + 3 * ((obj->y + j) * data->width + obj->x + i);
+			memcpy(p, color, 3);
+		}
+	}
+}
+
+static void meanshift_draw(struct meanshift_data *data)
+{
+	static const uint8_t green[3] = { 0, 255, 0 }, red[3] = { 255, 0, 0 };
+
+	for (int i=0; i<(int)ARRAY_SIZE(data->ids); i++) {
+		struct vlib_meanshift_object obj;
+
+		if (data->ids[i] < 0 ||
+			vlib_meanshift_get_object(data->ms, data->ids[i], &obj)) {
+			continue;
+		}
+		meanshift_draw_rect(data, &obj, obj.lost ? red : green);
+	}
+}
+
+static void meanshift_free_buffers(struct meanshift_data *data)
+{
+	vlib_meanshift_destroy(data->ms);
+	free(data->rgb);
+	data->ms = NULL;
+	data->rgb = NULL;
+	data->width = 0;
+	data->height = 0;
+}
+
+static int meanshift_init(struct filter_s *fs,
+						const struct filter_init_data *fid)
+{
+	struct meanshift_data *data = fs->data;
+	size_t w = fid->in_width, h = fid->in_height;
+
+	if (fid->out_width != w || fid->out_height != h || (w & 1) || (h & 1)) {
+		return -1;
+	}
+
+	if ((fid->in_fourcc != V4L2_PIX_FMT_RGB24 &&
+		 !vlib_cvt_color_supported(fid->in_fourcc, V4L2_PIX_FMT_RGB24)) ||
+		(fid->out_fourcc != V4L2_PIX_FMT_RGB24 &&
+		 !vlib_cvt_color_supported(V4L2_PIX_FMT_RGB24, fid->out_fourcc))) {
+		return -1;
+	}
+
+	data->in_fourcc = fid->in_fourcc;
+	data->out_fourcc = fid->out_fourcc;
+
+	for (int i=0; i<(int)ARRAY_SIZE(data->ids); i++) {
+		data->ids[i] = -1;
+	}
+	data->grid_mode = -1;
+
+	if (data->width == w && data->height == h) {
+		for (int i=0; i<data->params.max_objects; i++) {
+			vlib_meanshift_remove(data->ms, i);
+		}
+		return 0;
+	}
+
+	meanshift_free_buffers(data);
+	data->ms = vlib_meanshift_create(&data->params, w, h);
+	data->rgb = malloc(3 * w * h);
+	if (!data->ms || !data->rgb) {
+		vlib_warn("meanshift: failed to set up %zux%zu\n", w, h);
+		meanshift_free_buffers(data);
+		return -1;
+	}
+
+	data->width = w;
+	data->height = h;
+
+	return 0;
+}
+
+static void meanshift_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	struct meanshift_data *data = fs->data;
+	struct meanshift_post_job job = {
+		.data = data,
+		.ret = 0,
+	};
+
+	if (!data->ms || (size_t)width_in != data->width ||
+		(size_t)height_in != data->height) {
+		return;
+	}
+
+	if (data->in_fourcc == V4L2_PIX_FMT_RGB24) {
+		for (size_t y=0; y<data->height; y++) {
+			memcpy(data->rgb + 3 * y * data->width, frm_data_in + y * stride_in,
+				3 * data->width);
+		}
+	} else {
+		struct vlib_image in, out;
+
+		if (vlib_image_init(&in, data->in_fourcc, data->width, data->height,
+							stride_in, frm_data_in) ||
+			vlib_image_init(&out, V4L2_PIX_FMT_RGB24, data->width,
+							data->height, 3 * data->width, data->rgb) ||
+			vlib_cvt_color(&in, &out)) {
+			return;
+		}
+	}
+
+	meanshift_place(data, fs->mode);
+	if (vlib_meanshift_track(data->ms, data->rgb, 3 * data->width)) {
+		return;
+	}
+
+	vlib_image_init(&job.staging, V4L2_PIX_FMT_RGB24, data->width,
+					data->height, 3 * data->width, data->rgb);
+	if (vlib_image_init(&job.out, data->out_fourcc, width_out, height_out,
+						stride_out, frm_data_out)) {
+		return;
+	}
+
+	meanshift_draw(data);
+	vlib_parallel_for(data->height, MEANSHIFT_GRAIN, meanshift_out_band, &job);
+}
+
+static struct filter_ops meanshift_ops = {
+	.init = meanshift_init,
+	.func = meanshift_func,
+};
+
+static const char *meanshift_modes[] = {
+	"1 Object",
+	"4 Objects",
+	"9 Objects",
+};
+
+static const struct filter_s meanshift_fs = {
+	.display_text = "Mean Shift",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = 0,
+	.ops = &meanshift_ops,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(meanshift_modes),
+	.modes = meanshift_modes,
+};
+
+/**
+ * vlib_meanshift_filter_create - Create a mean shift tracking stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_meanshift_filter_create(void)
+{
+	struct filter_s *fs;
+	struct meanshift_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	vlib_meanshift_default_params(&data->params);
+	data->grid_mode = -1;
+	for (int i=0; i<(int)ARRAY_SIZE(data->ids); i++) {
+		data->ids[i] = -1;
+	}
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	*fs = meanshift_fs;
+	fs->data = data;
+
+	return fs;
+}
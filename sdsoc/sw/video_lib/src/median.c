@@ -0,0 +1,344 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "helper.h"
+#include "luma_stage.h"
+#include "median.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* output columns per strip, the histograms of a strip stay in L2 */
+#define MEDIAN_STRIP		128
+
+/* histogram of 16 coarse bins, each over 16 fine bins */
+struct median_hist {
+	uint16_t fine[256];			/* fine bins of coarse bin c at c * 16 */
+	uint16_t coarse[16];
+};
+
+struct vlib_median {
+	size_t width;
+	size_t height;
+	size_t pitch;
+	size_t radius;
+	size_t strips;
+};
+
+struct median_job {
+	const struct vlib_median *md;
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+	int ret;
+};
+
+static inline size_t median_clamp(long v, size_t n)
+{
+	return v < 0 ? 0 : v >= (long)n ? n - 1 : (size_t)v;
+}
+
+/* @d += @a, 16 bins */
+static inline void median_add(uint16_t *d, const uint16_t *a)
+{
+	v_store_u16(d, v_add_u16(v_load_u16(d), v_load_u16(a)));
+	v_store_u16(d + 8, v_add_u16(v_load_u16(d + 8), v_load_u16(a + 8)));
+}
+
+/* @d += @a - @s, 16 bins */
+static inline void median_add_sub(uint16_t *d, const uint16_t *a,
+								const uint16_t *s)
+{
+	v_store_u16(d, v_sub_u16(v_add_u16(v_load_u16(d), v_load_u16(a)),
+							v_load_u16(s)));
+	v_store_u16(d + 8, v_sub_u16(v_add_u16(v_load_u16(d + 8),
+							v_load_u16(a + 8)), v_load_u16(s + 8)));
+}
+
+/**
+ * vlib_median_create - Set up a median filter
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ * @pitch: Bytes between two pixels
+ * @window: Odd window size, up to VLIB_MEDIAN_MAX_WINDOW
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct vlib_median *vlib_median_create(size_t width, size_t height,
+				size_t pitch, size_t window)
+{
+	struct vlib_median *md;
+
+	if (!width || !height || !pitch || !(window & 1) ||
+		window > VLIB_MEDIAN_MAX_WINDOW) {
+		VLIB_REPORT_ERR("median: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	md = calloc(1, sizeof(*md));
+	if (!md) {
+		return NULL;
+	}
+
+	md->width = width;
+	md->height = height;
+	md->pitch = pitch;
+	md->radius = window / 2;
+	md->strips = (width + MEDIAN_STRIP - 1) / MEDIAN_STRIP;
+
+	return md;
+}
+
+void vlib_median_destroy(struct vlib_median *md)
+{
+	free(md);
+}
+
+/*
+ * Output columns [x0, x1) of all rows. @cols holds the histograms of the
+ * x1 - x0 + 2 * radius columns the windows cover, @offs their byte
+ * offsets in a row.
+ */
+static void median_strip(const struct median_job *job,
+						struct median_hist *cols, size_t *offs,
+						size_t x0, size_t x1)
+{
+	const struct vlib_median *md = job->md;
+	long r = md->radius, k = 2 * r + 1;
+	size_t n = x1 - x0 + 2 * r;
+	size_t rank = k * k / 2;
+	struct median_hist h;
+	long luc[16];
+
+	for (size_t i=0; i<n; i++) {
+		offs[i] = median_clamp((long)(x0 + i) - r, md->width) * md->pitch;
+	}
+
+	/* column histograms of the rows around row 0 */
+	memset(cols, 0, n * sizeof(*cols));
+	for (long j=-r; j<=r; j++) {
+		const uint8_t *s = job->src +
+						median_clamp(j, md->height) * job->stride_src;
+
+		for (size_t i=0; i<n; i++) {
+			uint8_t v = s[offs[i]];
+
+			cols[i].fine[v]++;
+			cols[i].coarse[v >> 4]++;
+		}
+	}
+
+	for (size_t y=0; y<md->height; y++) {
+		const uint8_t *sa = job->src +
+						median_clamp(y + r, md->height) * job->stride_src;
+		const uint8_t *ss = job->src +
+						median_clamp((long)y - r - 1, md->height) *
+						job->stride_src;
+		uint8_t *d = job->dst + y * job->stride_dst + x0 * md->pitch;
+
+		/* one row in and one out, unless both are the replicated border */
+		if (y && sa != ss) {
+			for (size_t i=0; i<n; i++) {
+				uint8_t a = sa[offs[i]], s = ss[offs[i]];
+
+				cols[i].fine[a]++;
+				cols[i].coarse[a >> 4]++;
+				cols[i].fine[s]--;
+				cols[i].coarse[s >> 4]--;
+			}
+		}
+
+		memset(h.coarse, 0, sizeof(h.coarse));
+		for (long i=0; i<k; i++) {
+			median_add(h.coarse, cols[i].coarse);
+		}
+		for (size_t c=0; c<16; c++) {
+			luc[c] = -k;
+		}
+
+		for (long i=0; i<(long)(x1-x0); i++) {
+			size_t sum = 0, c, b;
+			uint16_t *fine;
+
+			if (i) {
+				median_add_sub(h.coarse, cols[i + k - 1].coarse,
+							cols[i - 1].coarse);
+			}
+
+			for (c=0; sum + h.coarse[c] <= rank; c++) {
+				sum += h.coarse[c];
+			}
+
+			/* bring the fine bins of coarse bin c up to column i */
+			fine = h.fine + c * 16;
+			if (2 * (i - luc[c]) > k) {
+				memset(fine, 0, 16 * sizeof(*fine));
+				for (long j=i; j<i+k; j++) {
+					median_add(fine, cols[j].fine + c * 16);
+				}
+			} else {
+				for (long j=luc[c]; j<i; j++) {
+					median_add_sub(fine, cols[j + k].fine + c * 16,
+								cols[j].fine + c * 16);
+				}
+			}
+			luc[c] = i;
+
+			for (b=0; sum + fine[b] <= rank; b++) {
+				sum += fine[b];
+			}
+
+			d[i * md->pitch] = c * 16 + b;
+		}
+	}
+}
+
+static void median_band(void *arg, size_t start, size_t end)
+{
+	struct median_job *job = arg;
+	const struct vlib_median *md = job->md;
+	size_t n = MEDIAN_STRIP + 2 * md->radius;
+	struct median_hist *cols = malloc(n * sizeof(*cols));
+	size_t *offs = malloc(n * sizeof(*offs));
+
+	if (!cols || !offs) {
+		job->ret = VLIB_ERROR_NO_MEM;
+		goto out;
+	}
+
+	for (size_t s=start; s<end; s++) {
+		size_t x0 = s * MEDIAN_STRIP;
+		size_t x1 = x0 + MEDIAN_STRIP < md->width ?
+					x0 + MEDIAN_STRIP : md->width;
+
+		median_strip(job, cols, offs, x0, x1);
+	}
+
+out:
+	free(cols);
+	free(offs);
+}
+
+/**
+ * vlib_median - Median filter an image on all cores
+ * @md: Median filter
+ * @src: Source image of the size given at creation
+ * @stride_src: Line stride of @src in bytes
+ * @dst: Output image of the same size, must not overlap @src
+ * @stride_dst: Line stride of @dst in bytes
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_median(const struct vlib_median *md,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst)
+{
+	struct median_job job = {
+		.md = md,
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.ret = VLIB_SUCCESS,
+	};
+	int ret;
+
+	if (!md || !src || !dst) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	ret = vlib_parallel_for(md->strips, 1, median_band, &job);
+
+	return ret ? ret : job.ret;
+}
+
+/* Pipeline stage */
+
+/* windows of the filter modes */
+static const size_t median_windows[] = { 7, 15, 31 };
+
+struct median_data {
+	struct vlib_median *md[ARRAY_SIZE(median_windows)];
+};
+
+static void median_release(void *arg)
+{
+	struct median_data *data = arg;
+
+	for (size_t m=0; m<ARRAY_SIZE(median_windows); m++) {
+		vlib_median_destroy(data->md[m]);
+		data->md[m] = NULL;
+	}
+}
+
+static int median_setup(void *arg, const struct luma_stage_format *fmt,
+						size_t width, size_t height)
+{
+	struct median_data *data = arg;
+
+	for (size_t m=0; m<ARRAY_SIZE(median_windows); m++) {
+		data->md[m] = vlib_median_create(width, height, fmt->pitch,
+										median_windows[m]);
+		if (!data->md[m]) {
+			median_release(data);
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	return VLIB_SUCCESS;
+}
+
+static int median_run(void *arg, size_t mode,
+					const struct luma_stage_frame *frame)
+{
+	struct median_data *data = arg;
+
+	return vlib_median(data->md[mode], frame->src, frame->stride_src,
+					frame->dst, frame->stride_dst);
+}
+
+static const struct luma_stage_ops median_ops = {
+	.setup = median_setup,
+	.release = median_release,
+	.run = median_run,
+};
+
+static const char *median_modes[] = {
+	"7x7",
+	"15x15",
+	"31x31",
+};
+
+static const struct luma_stage median_stage = {
+	.display_text = "Median",
+	.name = "median",
+	.modes = median_modes,
+	.num_modes = ARRAY_SIZE(median_modes),
+	.grey_chroma = 0,
+	.ops = &median_ops,
+};
+
+/**
+ * vlib_median_filter_create - Create a median stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_median_filter_create(void)
+{
+	struct filter_s *fs;
+	struct median_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	fs = luma_stage_create(&median_stage, data);
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	return fs;
+}
@@ -0,0 +1,562 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "helper.h"
+#include "luma_stage.h"
+#include "morph.h"
+#include "parallel.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* least output lines per strip, raised to the kernel height */
+#define MORPH_STRIP			32
+
+struct vlib_morph {
+	size_t width;
+	size_t height;
+	size_t pitch;
+	size_t kw;
+	size_t kh;
+	size_t strip;				/* output lines per strip */
+	size_t lines;				/* lines of a first pass, in tiles of 16 */
+	size_t strips;
+};
+
+/* lines [lo, hi) of an image, @base points to line lo */
+struct morph_lines {
+	const uint8_t *base;
+	size_t stride;
+	long lo;
+	long hi;
+};
+
+struct morph_scratch {
+	uint8_t *pack;				/* source lines of pitch > 1 */
+	uint8_t *inter;				/* first pass of open and close */
+	uint8_t *col;				/* column pass */
+	uint8_t *res;				/* results of the strip */
+	uint8_t *res2;
+	uint8_t *tile_in;			/* row pass, a line of 16 per column */
+	uint8_t *tile_out;
+	uint8_t *acc;
+};
+
+struct morph_job {
+	const struct vlib_morph *mp;
+	enum vlib_morph_op op;
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+	int ret;
+};
+
+static inline long morph_clamp(long v, long lo, long hi)
+{
+	return v < lo ? lo : v >= hi ? hi - 1 : v;
+}
+
+/* @d = min or max of @a and @b, 16 pixels at a time */
+static inline void morph_minmax(uint8_t *d, const uint8_t *a,
+								const uint8_t *b, size_t n, int max)
+{
+	size_t x = 0;
+
+	if (max) {
+		for (; x+16<=n; x+=16) {
+			v_store_u8(d + x, v_max_u8(v_load_u8(a + x), v_load_u8(b + x)));
+		}
+		for (; x<n; x++) {
+			d[x] = a[x] > b[x] ? a[x] : b[x];
+		}
+	} else {
+		for (; x+16<=n; x+=16) {
+			v_store_u8(d + x, v_min_u8(v_load_u8(a + x), v_load_u8(b + x)));
+		}
+		for (; x<n; x++) {
+			d[x] = a[x] < b[x] ? a[x] : b[x];
+		}
+	}
+}
+
+/* @d = @a - @b saturated, lines of @n pixels */
+static void morph_sub(uint8_t *d, size_t stride_d, const uint8_t *a,
+					size_t stride_a, const uint8_t *b, size_t stride_b,
+					size_t lines, size_t n)
+{
+	for (size_t y=0; y<lines; y++, d+=stride_d, a+=stride_a, b+=stride_b) {
+		size_t x = 0;
+
+		for (; x+16<=n; x+=16) {
+			v_store_u8(d + x, v_subs_u8(v_load_u8(a + x), v_load_u8(b + x)));
+		}
+		for (; x<n; x++) {
+			d[x] = a[x] > b[x] ? a[x] - b[x] : 0;
+		}
+	}
+}
+
+/* 16x16 pixel tile from @src to @dst, rows to columns */
+static void morph_transpose(const uint8_t *src, size_t stride_src,
+							uint8_t *dst, size_t stride_dst)
+{
+	v_u8 r[16], t[16];
+
+	for (int i=0; i<16; i++) {
+		r[i] = v_load_u8(src + i * stride_src);
+	}
+
+	/* each round rotates the 4 row and 4 column bits of a pixel index */
+	for (int k=0; k<4; k++) {
+		for (int i=0; i<8; i++) {
+			v_zip_u8(r[i], r[i + 8], &t[2 * i], &t[2 * i + 1]);
+		}
+		for (int i=0; i<16; i++) {
+			r[i] = t[i];
+		}
+	}
+
+	for (int i=0; i<16; i++) {
+		v_store_u8(dst + i * stride_dst, r[i]);
+	}
+}
+
+/*
+ * van Herk/Gil-Werman: line i of @dst is the minimum or maximum of lines
+ * first + i to first + i + k - 1 of @src, clamped to [lo, hi), for i < n.
+ * With the lines cut into blocks of k from @first, a window is the suffix
+ * of one block and the prefix of the next. The suffixes are scanned
+ * backwards into @dst, the prefixes forwards into @acc and merged.
+ */
+static void morph_vhgw(const uint8_t *src, size_t stride, long first,
+					long lo, long hi, size_t len, size_t k, size_t n,
+					uint8_t *dst, size_t stride_dst, uint8_t *acc, int max)
+{
+	long p = n + k - 1;
+	const uint8_t *h = NULL, *g = NULL;
+
+	if (k == 1) {
+		for (size_t i=0; i<n; i++) {
+			memcpy(dst + i * stride_dst,
+					src + (morph_clamp(first + i, lo, hi) - lo) * stride, len);
+		}
+		return;
+	}
+
+	for (long j=p-1; j>=0; j--) {
+		const uint8_t *s = src + (morph_clamp(first + j, lo, hi) - lo) * stride;
+		uint8_t *d = j < (long)n ? dst + j * stride_dst : acc;
+
+		if (j == p - 1 || j % (long)k == (long)k - 1) {
+			if (j < (long)n) {
+				memcpy(d, s, len);
+				s = d;
+			}
+			h = s;
+		} else {
+			morph_minmax(d, h, s, len, max);
+			h = d;
+		}
+	}
+
+	for (long j=0; j<p; j++) {
+		const uint8_t *s = src + (morph_clamp(first + j, lo, hi) - lo) * stride;
+
+		if (j % (long)k == 0) {
+			g = s;
+		} else {
+			morph_minmax(acc, g, s, len, max);
+			g = acc;
+		}
+
+		if (j >= (long)k - 1) {
+			uint8_t *d = dst + (j - k + 1) * stride_dst;
+
+			morph_minmax(d, d, g, len, max);
+		}
+	}
+}
+
+/* row pass of @rows <= 16 lines of the column pass at @src */
+static void morph_rows(const struct vlib_morph *mp, struct morph_scratch *sc,
+					int max, const uint8_t *src, size_t rows,
+					uint8_t *out, size_t stride_out)
+{
+	size_t w = mp->width, x;
+
+	if (mp->kw == 1) {
+		for (size_t y=0; y<rows; y++) {
+			memcpy(out + y * stride_out, src + y * w, w);
+		}
+		return;
+	}
+
+	for (x=0; x+16<=w; x+=16) {
+		morph_transpose(src + x, w, sc->tile_in + x * 16, 16);
+	}
+	for (; x<w; x++) {
+		for (size_t y=0; y<16; y++) {
+			sc->tile_in[x * 16 + y] = src[y * w + x];
+		}
+	}
+
+	morph_vhgw(sc->tile_in, 16, -(long)(mp->kw / 2), 0, w, 16, mp->kw, w,
+			sc->tile_out, 16, sc->acc, max);
+
+	for (x=0; x+16<=w; x+=16) {
+		uint8_t tile[16 * 16];
+
+		if (rows == 16) {
+			morph_transpose(sc->tile_out + x * 16, 16, out + x, stride_out);
+			continue;
+		}
+
+		morph_transpose(sc->tile_out + x * 16, 16, tile, 16);
+		for (size_t y=0; y<rows; y++) {
+			memcpy(out + y * stride_out + x, tile + y * 16, 16);
+		}
+	}
+	for (; x<w; x++) {
+		for (size_t y=0; y<rows; y++) {
+			out[y * stride_out + x] = sc->tile_out[x * 16 + y];
+		}
+	}
+}
+
+/* lines [y0, y1) of the erosion or dilation of @in */
+static void morph_pass(const struct vlib_morph *mp, struct morph_scratch *sc,
+					int max, const struct morph_lines *in, long y0, long y1,
+					uint8_t *out, size_t stride_out)
+{
+	size_t w = mp->width, n = y1 - y0;
+
+	morph_vhgw(in->base, in->stride, y0 - (long)(mp->kh / 2), in->lo, in->hi,
+			w, mp->kh, n, sc->col, w, sc->acc, max);
+
+	for (size_t y=0; y<n; y+=16) {
+		morph_rows(mp, sc, max, sc->col + y * w, n - y < 16 ? n - y : 16,
+				out + y * stride_out, stride_out);
+	}
+}
+
+/* lines [y0, y1) of the opening or closing of @in */
+static void morph_pass2(const struct vlib_morph *mp, struct morph_scratch *sc,
+					int close, const struct morph_lines *in, long y0, long y1,
+					uint8_t *out, size_t stride_out)
+{
+	long r = mp->kh / 2;
+	long a = y0 - r > 0 ? y0 - r : 0;
+	long b = y1 + r < (long)mp->height ? y1 + r : (long)mp->height;
+	struct morph_lines mid = { sc->inter, mp->width, a, b };
+
+	morph_pass(mp, sc, close, in, a, b, sc->inter, mp->width);
+	morph_pass(mp, sc, !close, &mid, y0, y1, out, stride_out);
+}
+
+static void morph_strip(const struct morph_job *job, struct morph_scratch *sc,
+						long y0, long y1)
+{
+	const struct vlib_morph *mp = job->mp;
+	size_t w = mp->width, n = y1 - y0;
+	long r = mp->kh / 2;
+	long halo = job->op == VLIB_MORPH_ERODE || job->op == VLIB_MORPH_DILATE ||
+				job->op == VLIB_MORPH_GRADIENT ? r : 2 * r;
+	struct morph_lines in = { job->src, job->stride_src, 0, mp->height };
+	const uint8_t *s;
+	uint8_t *out = job->dst + y0 * job->stride_dst;
+	size_t stride_out = job->stride_dst;
+
+	/* luma of packed formats into lines of their own */
+	if (mp->pitch > 1) {
+		in.lo = y0 - halo > 0 ? y0 - halo : 0;
+		in.hi = y1 + halo < (long)mp->height ? y1 + halo : (long)mp->height;
+		in.base = sc->pack;
+		in.stride = w;
+
+		for (long y=in.lo; y<in.hi; y++) {
+			const uint8_t *p = job->src + y * job->stride_src;
+			uint8_t *d = sc->pack + (y - in.lo) * w;
+
+			for (size_t x=0; x<w; x++) {
+				d[x] = p[x * mp->pitch];
+			}
+		}
+
+		out = sc->res;
+		stride_out = w;
+	}
+	s = in.base + (y0 - in.lo) * in.stride;
+
+	switch (job->op) {
+	case VLIB_MORPH_ERODE:
+	case VLIB_MORPH_DILATE:
+		morph_pass(mp, sc, job->op == VLIB_MORPH_DILATE, &in, y0, y1, out,
+				stride_out);
+		break;
+	case VLIB_MORPH_OPEN:
+	case VLIB_MORPH_CLOSE:
+		morph_pass2(mp, sc, job->op == VLIB_MORPH_CLOSE, &in, y0, y1, out,
+					stride_out);
+		break;
+	case VLIB_MORPH_GRADIENT:
+		morph_pass(mp, sc, 1, &in, y0, y1, sc->res, w);
+		morph_pass(mp, sc, 0, &in, y0, y1, sc->res2, w);
+		morph_sub(out, stride_out, sc->res, w, sc->res2, w, n, w);
+		break;
+	case VLIB_MORPH_TOPHAT:
+		morph_pass2(mp, sc, 0, &in, y0, y1, sc->res2, w);
+		morph_sub(out, stride_out, s, in.stride, sc->res2, w, n, w);
+		break;
+	case VLIB_MORPH_BLACKHAT:
+		morph_pass2(mp, sc, 1, &in, y0, y1, sc->res2, w);
+		morph_sub(out, stride_out, sc->res2, w, s, in.stride, n, w);
+		break;
+	}
+
+	if (mp->pitch > 1) {
+		for (long y=y0; y<y1; y++) {
+			const uint8_t *p = sc->res + (y - y0) * w;
+			uint8_t *d = job->dst + y * job->stride_dst;
+
+			for (size_t x=0; x<w; x++) {
+				d[x * mp->pitch] = p[x];
+			}
+		}
+	}
+}
+
+static void morph_band(void *arg, size_t start, size_t end)
+{
+	struct morph_job *job = arg;
+	const struct vlib_morph *mp = job->mp;
+	size_t w = mp->width;
+	struct morph_scratch sc = {
+		.pack = mp->pitch > 1 ?
+				malloc((mp->strip + 2 * (mp->kh - 1)) * w) : NULL,
+		.inter = malloc(mp->lines * w),
+		.col = calloc(mp->lines, w),
+		.res = malloc(mp->strip * w),
+		.res2 = malloc(mp->strip * w),
+		.tile_in = malloc(w * 16),
+		.tile_out = malloc(w * 16),
+		.acc = malloc(w > 16 ? w : 16),
+	};
+
+	if ((mp->pitch > 1 && !sc.pack) || !sc.inter || !sc.col || !sc.res ||
+		!sc.res2 || !sc.tile_in || !sc.tile_out || !sc.acc) {
+		job->ret = VLIB_ERROR_NO_MEM;
+		goto out;
+	}
+
+	for (size_t s=start; s<end; s++) {
+		size_t y0 = s * mp->strip;
+		size_t y1 = y0 + mp->strip < mp->height ? y0 + mp->strip : mp->height;
+
+		morph_strip(job, &sc, y0, y1);
+	}
+
+out:
+	free(sc.pack);
+	free(sc.inter);
+	free(sc.col);
+	free(sc.res);
+	free(sc.res2);
+	free(sc.tile_in);
+	free(sc.tile_out);
+	free(sc.acc);
+}
+
+/**
+ * vlib_morph_create - Set up a morphology filter
+ * @width: Image width in pixels
+ * @height: Image height in lines
+ * @pitch: Bytes between two pixels
+ * @kernel_width: Odd kernel width, up to VLIB_MORPH_MAX_KSIZE
+ * @kernel_height: Odd kernel height, up to VLIB_MORPH_MAX_KSIZE
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct vlib_morph *vlib_morph_create(size_t width, size_t height,
+				size_t pitch, size_t kernel_width, size_t kernel_height)
+{
+	struct vlib_morph *mp;
+
+	if (!width || !height || !pitch || !(kernel_width & 1) ||
+		!(kernel_height & 1) || kernel_width > VLIB_MORPH_MAX_KSIZE ||
+		kernel_height > VLIB_MORPH_MAX_KSIZE) {
+		VLIB_REPORT_ERR("morph: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	mp = calloc(1, sizeof(*mp));
+	if (!mp) {
+		return NULL;
+	}
+
+	mp->width = width;
+	mp->height = height;
+	mp->pitch = pitch;
+	mp->kw = kernel_width;
+	mp->kh = kernel_height;
+
+	/* at least a kernel height of lines keeps the column pass O(1) */
+	mp->strip = kernel_height > MORPH_STRIP ? kernel_height : MORPH_STRIP;
+	mp->strip = (mp->strip + 15) & ~(size_t)15;
+	mp->lines = (mp->strip + kernel_height - 1 + 15) & ~(size_t)15;
+	mp->strips = (height + mp->strip - 1) / mp->strip;
+
+	return mp;
+}
+
+void vlib_morph_destroy(struct vlib_morph *mp)
+{
+	free(mp);
+}
+
+/**
+ * vlib_morph - Apply a morphological operation on all cores
+ * @mp: Morphology filter
+ * @op: Operation
+ * @src: Source image of the size given at creation
+ * @stride_src: Line stride of @src in bytes
+ * @dst: Output image of the same size, must not overlap @src
+ * @stride_dst: Line stride of @dst in bytes
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_morph(const struct vlib_morph *mp, enum vlib_morph_op op,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst)
+{
+	struct morph_job job = {
+		.mp = mp,
+		.op = op,
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.ret = VLIB_SUCCESS,
+	};
+	int ret;
+
+	if (!mp || !src || !dst || op < VLIB_MORPH_ERODE ||
+		op > VLIB_MORPH_BLACKHAT) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	ret = vlib_parallel_for(mp->strips, 1, morph_band, &job);
+
+	return ret ? ret : job.ret;
+}
+
+/* Pipeline stage */
+
+/* square kernels of the filter modes */
+static const size_t morph_ksizes[] = { 3, 7, 15, 31 };
+
+static const char *morph_names[] = {
+	[VLIB_MORPH_ERODE] = "Erode",
+	[VLIB_MORPH_DILATE] = "Dilate",
+	[VLIB_MORPH_OPEN] = "Open",
+	[VLIB_MORPH_CLOSE] = "Close",
+	[VLIB_MORPH_GRADIENT] = "Morph Gradient",
+	[VLIB_MORPH_TOPHAT] = "Top-hat",
+	[VLIB_MORPH_BLACKHAT] = "Black-hat",
+};
+
+struct morph_data {
+	enum vlib_morph_op op;
+	struct vlib_morph *mp[ARRAY_SIZE(morph_ksizes)];
+};
+
+static void morph_release(void *arg)
+{
+	struct morph_data *data = arg;
+
+	for (size_t m=0; m<ARRAY_SIZE(morph_ksizes); m++) {
+		vlib_morph_destroy(data->mp[m]);
+		data->mp[m] = NULL;
+	}
+}
+
+static int morph_setup(void *arg, const struct luma_stage_format *fmt,
+						size_t width, size_t height)
+{
+	struct morph_data *data = arg;
+
+	for (size_t m=0; m<ARRAY_SIZE(morph_ksizes); m++) {
+		data->mp[m] = vlib_morph_create(width, height, fmt->pitch,
+										morph_ksizes[m], morph_ksizes[m]);
+		if (!data->mp[m]) {
+			morph_release(data);
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	return VLIB_SUCCESS;
+}
+
+static int morph_run(void *arg, size_t mode,
+					const struct luma_stage_frame *frame)
+{
+	struct morph_data *data = arg;
+
+	return vlib_morph(data->mp[mode], data->op, frame->src, frame->stride_src,
+					frame->dst, frame->stride_dst);
+}
+
+static const struct luma_stage_ops morph_ops = {
+	.setup = morph_setup,
+	.release = morph_release,
+	.run = morph_run,
+};
+
+static const char *morph_modes[] = {
+	"3x3",
+	"7x7",
+	"15x15",
+	"31x31",
+};
+
+static const struct luma_stage morph_stage = {
+	.display_text = "",
+	.name = "morph",
+	.modes = morph_modes,
+	.num_modes = ARRAY_SIZE(morph_modes),
+	.grey_chroma = 0,
+	.ops = &morph_ops,
+};
+
+/**
+ * vlib_morph_filter_create - Create a morphology stage
+ * @op: Operation of the stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_morph_filter_create(enum vlib_morph_op op)
+{
+	struct filter_s *fs;
+	struct morph_data *data;
+
+	if (op < VLIB_MORPH_ERODE || op > VLIB_MORPH_BLACKHAT) {
+		return NULL;
+	}
+
+	data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	fs = luma_stage_create(&morph_stage, data);
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	fs->display_text = morph_names[op];
+	data->op = op;
+
+	return fs;
+}
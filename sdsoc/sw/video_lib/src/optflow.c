@@ -0,0 +1,787 @@
+#include <drm/drm_fourcc.h>
+#include <linux/videodev2.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cvt_color.h"
+#include "filter.h"
+#include "helper.h"
+#include "image.h"
+#include "optflow.h"
+#include "parallel.h"
+#include "pyramid.h"
+#include "video_int.h"
+
+/* rows per band boundary of the parallel passes, even for 4:2:0 formats */
+#define OPTFLOW_GRAIN		8
+
+/* levels are not reduced below this width or height */
+#define OPTFLOW_MIN_SIZE	16
+
+/* visualization: flow clipped to +-OPTFLOW_VIS_RANGE in 1/OPTFLOW_VIS_STEP */
+#define OPTFLOW_VIS_RANGE	8
+#define OPTFLOW_VIS_STEP	4
+#define OPTFLOW_VIS_SIZE	(2 * OPTFLOW_VIS_RANGE * OPTFLOW_VIS_STEP + 1)
+
+struct optflow_level {
+	size_t width;				/* also the stride */
+	size_t height;
+	uint8_t *img;
+	int16_t *ix;				/* central differences, twice the gradient */
+	int16_t *iy;
+};
+
+struct optflow_pyramid {
+	struct optflow_level lv[VLIB_OPTFLOW_MAX_LEVELS];
+};
+
+struct vlib_optflow {
+	struct vlib_optflow_params p;
+	size_t width;
+	size_t height;
+	int levels;
+	struct optflow_pyramid pyr[2];
+	int cur;					/* pyramid of the last frame */
+	int valid;					/* pyr[cur] holds a frame */
+	float *flow[VLIB_OPTFLOW_MAX_LEVELS];	/* dx, dy per pixel */
+	float *g;					/* window sums of Ix^2, IxIy, Iy^2 */
+	float *b;					/* IxIt, IyIt */
+	struct vlib_optflow_stats stats;
+};
+
+struct optflow_job {
+	struct vlib_optflow *of;
+	int level;
+	const struct optflow_level *prev;
+	const struct optflow_level *next;
+	const uint8_t *frame;
+	size_t stride;
+};
+
+/* level 0 is a copy of the frame, which may be requeued after the call */
+static void optflow_copy_band(void *arg, size_t start, size_t end)
+{
+	struct optflow_job *job = arg;
+	const struct optflow_level *lv = job->next;
+
+	for (size_t y=start; y<end; y++) {
+		memcpy(lv->img + y * lv->width, job->frame + y * job->stride,
+				lv->width);
+	}
+}
+
+static void optflow_grad_band(void *arg, size_t start, size_t end)
+{
+	struct optflow_job *job = arg;
+	const struct optflow_level *lv = job->next;
+	size_t w = lv->width, h = lv->height;
+
+	for (size_t y=start; y<end; y++) {
+		const uint8_t *up = lv->img + (y ? y - 1 : 0) * w;
+		const uint8_t *cur = lv->img + y * w;
+		const uint8_t *dn = lv->img + (y + 1 < h ? y + 1 : y) * w;
+		int16_t *ix = lv->ix + y * w;
+		int16_t *iy = lv->iy + y * w;
+
+		ix[0] = cur[1] - cur[0];
+		for (size_t x=1; x<w-1; x++) {
+			ix[x] = cur[x + 1] - cur[x - 1];
+		}
+		ix[w - 1] = cur[w - 1] - cur[w - 2];
+
+		for (size_t x=0; x<w; x++) {
+			iy[x] = dn[x] - up[x];
+		}
+	}
+}
+
+/* sliding window sum along a row of column sums, clipped at the borders */
+static void optflow_hsum(const float *col, float *dst, size_t w, int nch,
+						int r)
+{
+	float s[3] = { 0, 0, 0 };
+
+	for (long x=0; x<=r && x<(long)w; x++) {
+		for (int c=0; c<nch; c++) {
+			s[c] += col[x * nch + c];
+		}
+	}
+
+	for (long x=0; x<(long)w; x++) {
+		for (int c=0; c<nch; c++) {
+			dst[x * nch + c] = s[c];
+		}
+		if (x + r + 1 < (long)w) {
+			for (int c=0; c<nch; c++) {
+				s[c] += col[(x + r + 1) * nch + c];
+			}
+		}
+		if (x >= r) {
+			for (int c=0; c<nch; c++) {
+				s[c] -= col[(x - r) * nch + c];
+			}
+		}
+	}
+}
+
+static void optflow_g_row(const struct optflow_level *lv, size_t y,
+						float sign, float *col)
+{
+	const int16_t *ix = lv->ix + y * lv->width;
+	const int16_t *iy = lv->iy + y * lv->width;
+
+	for (size_t x=0; x<lv->width; x++) {
+		col[3 * x] += sign * (ix[x] * ix[x]);
+		col[3 * x + 1] += sign * (ix[x] * iy[x]);
+		col[3 * x + 2] += sign * (iy[x] * iy[x]);
+	}
+}
+
+/* structure tensor of the previous frame, fixed for all iterations */
+static void optflow_g_band(void *arg, size_t start, size_t end)
+{
+	struct optflow_job *job = arg;
+	const struct optflow_level *lv = job->prev;
+	const long r = job->of->p.window_size / 2;
+	const long h = lv->height;
+	float *col = calloc(3 * lv->width, sizeof(*col));
+
+	if (!col) {
+		vlib_warn("optical flow: out of memory\n");
+		return;
+	}
+
+	for (long y=(long)start-r; y<=(long)start+r; y++) {
+		if (y >= 0 && y < h) {
+			optflow_g_row(lv, y, 1, col);
+		}
+	}
+
+	for (long y=start; y<(long)end; y++) {
+		if (y > (long)start) {
+			if (y + r < h) {
+				optflow_g_row(lv, y + r, 1, col);
+			}
+			if (y - r - 1 >= 0) {
+				optflow_g_row(lv, y - r - 1, -1, col);
+			}
+		}
+		optflow_hsum(col, job->of->g + 3 * y * lv->width, lv->width, 3, r);
+	}
+
+	free(col);
+}
+
+/* coarser flow scaled to this level, the initial estimate */
+static void optflow_upsample_band(void *arg, size_t start, size_t end)
+{
+	struct optflow_job *job = arg;
+	const struct optflow_level *lv = job->prev;
+	const struct optflow_level *up = &job->prev[1];
+	const float *src = job->of->flow[job->level + 1];
+	float *dst = job->of->flow[job->level];
+
+	for (size_t y=start; y<end; y++) {
+		size_t sy = y / 2 < up->height ? y / 2 : up->height - 1;
+
+		for (size_t x=0; x<lv->width; x++) {
+			size_t sx = x / 2 < up->width ? x / 2 : up->width - 1;
+			const float *s = src + 2 * (sy * up->width + sx);
+
+			dst[2 * (y * lv->width + x)] = 2 * s[0];
+			dst[2 * (y * lv->width + x) + 1] = 2 * s[1];
+		}
+	}
+}
+
+/* temporal difference at the current estimate times the gradients */
+static void optflow_it_band(void *arg, size_t start, size_t end)
+{
+	struct optflow_job *job = arg;
+	const struct optflow_level *p = job->prev;
+	const struct optflow_level *n = job->next;
+	const float *flow = job->of->flow[job->level];
+	float *b = job->of->b;
+	const size_t w = p->width, h = p->height;
+
+	for (size_t y=start; y<end; y++) {
+		for (size_t x=0; x<w; x++) {
+			size_t i = y * w + x;
+			float fx = x + flow[2 * i];
+			float fy = y + flow[2 * i + 1];
+			size_t x0, y0, x1, y1;
+			float ax, ay, t0, t1, it;
+
+			if (!(fx >= 0 && fy >= 0 && fx <= w - 1 && fy <= h - 1)) {
+				b[2 * i] = 0;
+				b[2 * i + 1] = 0;
+				continue;
+			}
+
+			x0 = fx;
+			y0 = fy;
+			x1 = x0 + 1 < w ? x0 + 1 : x0;
+			y1 = y0 + 1 < h ? y0 + 1 : y0;
+			ax = fx - x0;
+			ay = fy - y0;
+			t0 = n->img[y0 * w + x0] + ax * (n->img[y0 * w + x1] - n->img[y0 * w + x0]);
+			t1 = n->img[y1 * w + x0] + ax * (n->img[y1 * w + x1] - n->img[y1 * w + x0]);
+			it = t0 + ay * (t1 - t0) - p->img[i];
+
+			b[2 * i] = p->ix[i] * it;
+			b[2 * i + 1] = p->iy[i] * it;
+		}
+	}
+}
+
+static void optflow_b_row(const float *b, size_t w, size_t y, float sign,
+						float *col)
+{
+	const float *s = b + 2 * y * w;
+
+	for (size_t x=0; x<2*w; x++) {
+		col[x] += sign * s[x];
+	}
+}
+
+/* window sums of the mismatch and the Lucas-Kanade update */
+static void optflow_update_band(void *arg, size_t start, size_t end)
+{
+	struct optflow_job *job = arg;
+	struct vlib_optflow *of = job->of;
+	const size_t w = job->prev->width;
+	const long h = job->prev->height;
+	const long r = of->p.window_size / 2;
+	/* gradients are doubled, the tensor holds 4 * n^2 * mean gradient^2 */
+	const float min_eig = 0.01f * 4 * (2 * r + 1) * (2 * r + 1);
+	float *flow = of->flow[job->level];
+	float *col = calloc(4 * w, sizeof(*col));
+	float *sum = col + 2 * w;
+
+	if (!col) {
+		vlib_warn("optical flow: out of memory\n");
+		return;
+	}
+
+	for (long y=(long)start-r; y<=(long)start+r; y++) {
+		if (y >= 0 && y < h) {
+			optflow_b_row(of->b, w, y, 1, col);
+		}
+	}
+
+	for (long y=start; y<(long)end; y++) {
+		if (y > (long)start) {
+			if (y + r < h) {
+				optflow_b_row(of->b, w, y + r, 1, col);
+			}
+			if (y - r - 1 >= 0) {
+				optflow_b_row(of->b, w, y - r - 1, -1, col);
+			}
+		}
+		optflow_hsum(col, sum, w, 2, r);
+
+		for (size_t x=0; x<w; x++) {
+			const float *g = of->g + 3 * (y * w + x);
+			float gxx = g[0], gxy = g[1], gyy = g[2];
+			float bx = sum[2 * x], by = sum[2 * x + 1];
+			float det = gxx * gyy - gxy * gxy;
+			float d = gxx - gyy;
+			float eig = 0.5f * (gxx + gyy - sqrtf(d * d + 4 * gxy * gxy));
+
+			if (eig < min_eig) {
+				continue;
+			}
+
+			/* doubled gradients: (2G)^-1 (2b) scaled back by 2 */
+			flow[2 * (y * w + x)] -= 2 * (gyy * bx - gxy * by) / det;
+			flow[2 * (y * w + x) + 1] -= 2 * (gxx * by - gxy * bx) / det;
+		}
+	}
+
+	free(col);
+}
+
+static void optflow_build_pyramid(struct vlib_optflow *of,
+								struct optflow_pyramid *pyr,
+								const uint8_t *frame, size_t stride)
+{
+	struct optflow_job job = {
+		.of = of,
+		.frame = frame,
+		.stride = stride,
+	};
+
+	for (int l=0; l<of->levels; l++) {
+		const struct optflow_level *lv = &pyr->lv[l];
+
+		job.next = lv;
+		if (l) {
+			vlib_pyr_down(lv[-1].img, lv[-1].width, lv[-1].width,
+						lv[-1].height, lv->img, lv->width);
+		} else {
+			vlib_parallel_for(lv->height, OPTFLOW_GRAIN, optflow_copy_band,
+							&job);
+		}
+		vlib_parallel_for(lv->height, OPTFLOW_GRAIN, optflow_grad_band, &job);
+	}
+}
+
+static void optflow_compute_flow(struct vlib_optflow *of,
+								const struct optflow_pyramid *prev,
+								const struct optflow_pyramid *next)
+{
+	struct optflow_job job = { .of = of };
+
+	for (int l=of->levels-1; l>=0; l--) {
+		const struct optflow_level *lv = &prev->lv[l];
+
+		job.level = l;
+		job.prev = lv;
+		job.next = &next->lv[l];
+
+		if (l == of->levels - 1) {
+			memset(of->flow[l], 0, 2 * lv->width * lv->height * sizeof(float));
+		} else {
+			vlib_parallel_for(lv->height, OPTFLOW_GRAIN,
+							optflow_upsample_band, &job);
+		}
+
+		vlib_parallel_for(lv->height, OPTFLOW_GRAIN, optflow_g_band, &job);
+		for (int i=0; i<of->p.iterations; i++) {
+			vlib_parallel_for(lv->height, OPTFLOW_GRAIN, optflow_it_band, &job);
+			vlib_parallel_for(lv->height, OPTFLOW_GRAIN, optflow_update_band,
+							&job);
+		}
+	}
+}
+
+void vlib_optflow_default_params(struct vlib_optflow_params *params)
+{
+	params->levels = 4;
+	params->window_size = 11;
+	params->iterations = 3;
+}
+
+static int optflow_check_params(const struct vlib_optflow_params *p)
+{
+	if (p->levels < 1 || p->levels > VLIB_OPTFLOW_MAX_LEVELS ||
+		p->window_size < 3 || p->window_size > 31 || !(p->window_size & 1) ||
+		p->iterations < 1) {
+		VLIB_REPORT_ERR("optical flow: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return VLIB_SUCCESS;
+}
+
+struct vlib_optflow *vlib_optflow_create(
+				const struct vlib_optflow_params *params,
+				size_t width, size_t height)
+{
+	struct vlib_optflow *of;
+	size_t w = width, h = height;
+
+	if (optflow_check_params(params)) {
+		return NULL;
+	}
+
+	if (width < OPTFLOW_MIN_SIZE || height < OPTFLOW_MIN_SIZE) {
+		VLIB_REPORT_ERR("optical flow: %zux%zu too small", width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	of = calloc(1, sizeof(*of));
+	if (!of) {
+		return NULL;
+	}
+
+	of->p = *params;
+	of->width = width;
+	of->height = height;
+
+	for (int l=0; l<params->levels; l++) {
+		if (w < OPTFLOW_MIN_SIZE || h < OPTFLOW_MIN_SIZE) {
+			break;
+		}
+
+		for (int i=0; i<2; i++) {
+			struct optflow_level *lv = &of->pyr[i].lv[l];
+
+			lv->width = w;
+			lv->height = h;
+			lv->img = malloc(w * h);
+			lv->ix = malloc(w * h * sizeof(*lv->ix));
+			lv->iy = malloc(w * h * sizeof(*lv->iy));
+			if (!lv->img || !lv->ix || !lv->iy) {
+				vlib_optflow_destroy(of);
+				return NULL;
+			}
+		}
+
+		of->flow[l] = malloc(2 * w * h * sizeof(*of->flow[l]));
+		if (!of->flow[l]) {
+			vlib_optflow_destroy(of);
+			return NULL;
+		}
+
+		of->levels++;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+
+	of->g = malloc(3 * width * height * sizeof(*of->g));
+	of->b = malloc(2 * width * height * sizeof(*of->b));
+	if (!of->g || !of->b) {
+		vlib_optflow_destroy(of);
+		return NULL;
+	}
+
+	return of;
+}
+
+void vlib_optflow_destroy(struct vlib_optflow *of)
+{
+	if (!of) {
+		return;
+	}
+
+	for (int l=0; l<VLIB_OPTFLOW_MAX_LEVELS; l++) {
+		for (int i=0; i<2; i++) {
+			free(of->pyr[i].lv[l].img);
+			free(of->pyr[i].lv[l].ix);
+			free(of->pyr[i].lv[l].iy);
+		}
+		free(of->flow[l]);
+	}
+
+	free(of->g);
+	free(of->b);
+	free(of);
+}
+
+/* forget the last frame, e.g. after a scene cut */
+void vlib_optflow_reset(struct vlib_optflow *of)
+{
+	of->valid = 0;
+}
+
+/**
+ * vlib_optflow_compute - push a frame and compute the flow to it
+ * @of: optical flow state
+ * @frame: 8-bit image
+ * @stride: line stride of @frame in bytes
+ * @flow: (dx, dy) float pairs from the previous frame to @frame
+ * @stride_flow: line stride of @flow in bytes
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_optflow_compute(struct vlib_optflow *of,
+				const uint8_t *frame, size_t stride,
+				float *flow, size_t stride_flow)
+{
+	int next = of->valid ? !of->cur : of->cur;
+	struct timespec t;
+
+	if (!frame || !flow) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	optflow_build_pyramid(of, &of->pyr[next], frame, stride);
+	of->stats.pyramid_ms = vlib_ms_since(&t);
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	if (of->valid) {
+		optflow_compute_flow(of, &of->pyr[of->cur], &of->pyr[next]);
+	} else {
+		memset(of->flow[0], 0, 2 * of->width * of->height * sizeof(float));
+	}
+
+	for (size_t y=0; y<of->height; y++) {
+		memcpy((uint8_t *)flow + y * stride_flow, of->flow[0] + 2 * y * of->width,
+				2 * of->width * sizeof(float));
+	}
+	of->stats.flow_ms = vlib_ms_since(&t);
+
+	of->cur = next;
+	of->valid = 1;
+
+	return VLIB_SUCCESS;
+}
+
+void vlib_optflow_get_stats(const struct vlib_optflow *of,
+				struct vlib_optflow_stats *stats)
+{
+	*stats = of->stats;
+}
+
+/* Pipeline stage */
+
+struct optflow_data {
+	struct vlib_optflow_params params;
+	struct vlib_optflow *of;
+	uint32_t in_fourcc;
+	uint32_t out_fourcc;
+	size_t width;
+	size_t height;
+	const unsigned char *pushed;	/* frame whose pyramid is kept */
+	uint8_t *luma;
+	float *flow;
+	uint8_t *yuv;				/* YUV 4:4:4 output staging */
+	uint8_t lut[3][OPTFLOW_VIS_SIZE * OPTFLOW_VIS_SIZE];
+};
+
+struct optflow_post_job {
+	struct optflow_data *data;
+	struct vlib_image staging;
+	struct vlib_image out;
+	int ret;
+};
+
+/* HSV color wheel, hue for the direction and value for the magnitude */
+static void optflow_init_lut(struct optflow_data *data)
+{
+	for (int j=0; j<OPTFLOW_VIS_SIZE; j++) {
+		for (int i=0; i<OPTFLOW_VIS_SIZE; i++) {
+			float dx = (i - OPTFLOW_VIS_SIZE / 2) / (float)OPTFLOW_VIS_STEP;
+			float dy = (j - OPTFLOW_VIS_SIZE / 2) / (float)OPTFLOW_VIS_STEP;
+			float hue = (atan2f(dy, dx) + (float)M_PI) * 3 / (float)M_PI;
+			float val = hypotf(dx, dy) / OPTFLOW_VIS_RANGE;
+			float f = hue - floorf(hue);
+			float c[3];
+			uint8_t rgb[3], yuv[3];
+			int k = (int)hue % 6;
+
+			if (val > 1) {
+				val = 1;
+			}
+
+			switch (k) {
+				case 0: c[0] = 1; c[1] = f; c[2] = 0; break;
+				case 1: c[0] = 1 - f; c[1] = 1; c[2] = 0; break;
+				case 2: c[0] = 0; c[1] = 1; c[2] = f; break;
+				case 3: c[0] = 0; c[1] = 1 - f; c[2] = 1; break;
+				case 4: c[0] = f; c[1] = 0; c[2] = 1; break;
+				default: c[0] = 1; c[1] = 0; c[2] = 1 - f; break;
+			}
+
+			for (int n=0; n<3; n++) {
+				rgb[n] = lroundf(c[n] * val * 255);
+			}
+
+			vlib_cvt_color_rgb2yuv(rgb[0], rgb[1], rgb[2], yuv);
+			for (int n=0; n<3; n++) {
+				data->lut[n][j * OPTFLOW_VIS_SIZE + i] = yuv[n];
+			}
+		}
+	}
+}
+
+static inline int optflow_vis_index(float d)
+{
+	int i = lroundf(d * OPTFLOW_VIS_STEP);
+
+	if (i < -OPTFLOW_VIS_RANGE * OPTFLOW_VIS_STEP) {
+		i = -OPTFLOW_VIS_RANGE * OPTFLOW_VIS_STEP;
+	} else if (i > OPTFLOW_VIS_RANGE * OPTFLOW_VIS_STEP) {
+		i = OPTFLOW_VIS_RANGE * OPTFLOW_VIS_STEP;
+	}
+
+	return i + OPTFLOW_VIS_SIZE / 2;
+}
+
+static void optflow_post_band(void *arg, size_t start, size_t end)
+{
+	struct optflow_post_job *job = arg;
+	struct optflow_data *data = job->data;
+	size_t w = data->width, plane = w * data->height;
+
+	for (size_t y=start; y<end; y++) {
+		const float *f = data->flow + 2 * y * w;
+		uint8_t *py = data->yuv + y * w;
+
+		for (size_t x=0; x<w; x++) {
+			int k = optflow_vis_index(f[2 * x + 1]) * OPTFLOW_VIS_SIZE +
+					optflow_vis_index(f[2 * x]);
+
+			py[x] = data->lut[0][k];
+			py[plane + x] = data->lut[1][k];
+			py[2 * plane + x] = data->lut[2][k];
+		}
+	}
+
+	if (vlib_cvt_color_lines(&job->staging, &job->out, start, end)) {
+		job->ret = VLIB_ERROR_OTHER;
+	}
+}
+
+static void optflow_free_buffers(struct optflow_data *data)
+{
+	vlib_optflow_destroy(data->of);
+	free(data->luma);
+	free(data->flow);
+	free(data->yuv);
+	data->of = NULL;
+	data->luma = NULL;
+	data->flow = NULL;
+	data->yuv = NULL;
+	data->width = 0;
+	data->height = 0;
+}
+
+static int optflow_init(struct filter_s *fs, const struct filter_init_data *fid)
+{
+	struct optflow_data *data = fs->data;
+	size_t w = fid->in_width, h = fid->in_height;
+
+	if (fid->out_width != w || fid->out_height != h || (w & 1) || (h & 1)) {
+		return -1;
+	}
+
+	if ((fid->in_fourcc != V4L2_PIX_FMT_GREY &&
+		 !vlib_cvt_color_supported(fid->in_fourcc, V4L2_PIX_FMT_GREY)) ||
+		!vlib_cvt_color_supported(DRM_FORMAT_YUV444, fid->out_fourcc)) {
+		return -1;
+	}
+
+	data->in_fourcc = fid->in_fourcc;
+	data->out_fourcc = fid->out_fourcc;
+	data->pushed = NULL;
+
+	if (data->width == w && data->height == h) {
+		vlib_optflow_reset(data->of);
+		return 0;
+	}
+
+	optflow_free_buffers(data);
+	data->of = vlib_optflow_create(&data->params, w, h);
+	data->luma = malloc(w * h);
+	data->flow = malloc(2 * w * h * sizeof(*data->flow));
+	data->yuv = malloc(vlib_image_size(DRM_FORMAT_YUV444, h, w));
+	if (!data->of || !data->luma || !data->flow || !data->yuv) {
+		vlib_warn("optical flow: failed to set up %zux%zu\n", w, h);
+		optflow_free_buffers(data);
+		return -1;
+	}
+
+	data->width = w;
+	data->height = h;
+
+	return 0;
+}
+
+static int optflow_push(struct optflow_data *data, const unsigned char *frame,
+						int stride)
+{
+	const uint8_t *luma = frame;
+	size_t luma_stride = stride;
+
+	if (data->in_fourcc != V4L2_PIX_FMT_GREY) {
+		struct vlib_image in, out;
+
+		if (vlib_image_init(&in, data->in_fourcc, data->width, data->height,
+							stride, (unsigned char *)frame) ||
+			vlib_image_init(&out, V4L2_PIX_FMT_GREY, data->width,
+							data->height, data->width, data->luma) ||
+			vlib_cvt_color(&in, &out)) {
+			return VLIB_ERROR_OTHER;
+		}
+		luma = data->luma;
+		luma_stride = data->width;
+	}
+
+	data->pushed = frame;
+
+	return vlib_optflow_compute(data->of, luma, luma_stride, data->flow,
+								2 * data->width * sizeof(*data->flow));
+}
+
+static void optflow_func2(struct filter_s *fs,
+						unsigned char *frame_prev, unsigned char *frame_curr,
+						unsigned char *frame_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	struct optflow_data *data = fs->data;
+	struct optflow_post_job job = { .data = data };
+	/* m2m order, the newer frame comes first */
+	const unsigned char *newer = frame_prev, *older = frame_curr;
+
+	if (!data->of || (size_t)width_in != data->width ||
+		(size_t)height_in != data->height) {
+		return;
+	}
+
+	/* the pyramid of the older frame is kept from the last call */
+	if (data->pushed != older) {
+		vlib_optflow_reset(data->of);
+		if (optflow_push(data, older, stride_in)) {
+			return;
+		}
+	}
+	if (optflow_push(data, newer, stride_in)) {
+		return;
+	}
+
+	vlib_image_init(&job.staging, DRM_FORMAT_YUV444, data->width, data->height,
+					data->width, data->yuv);
+	if (vlib_image_init(&job.out, data->out_fourcc, width_out, height_out,
+						stride_out, frame_out)) {
+		return;
+	}
+	vlib_parallel_for(data->height, OPTFLOW_GRAIN, optflow_post_band, &job);
+}
+
+static struct filter_ops optflow_ops = {
+	.init = optflow_init,
+	.func2 = optflow_func2,
+};
+
+static const char *optflow_modes[] = {
+	"SW",
+};
+
+static const struct filter_s optflow_fs = {
+	.display_text = "Optical Flow",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = 0,
+	.ops = &optflow_ops,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(optflow_modes),
+	.modes = optflow_modes,
+};
+
+/**
+ * vlib_optflow_filter_create - Create a dense optical flow pipeline stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_optflow_filter_create(void)
+{
+	struct filter_s *fs;
+	struct optflow_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	vlib_optflow_default_params(&data->params);
+	optflow_init_lut(data);
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	*fs = optflow_fs;
+	fs->data = data;
+
+	return fs;
+}
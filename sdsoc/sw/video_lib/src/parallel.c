@@ -0,0 +1,235 @@
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parallel.h"
+#include "video_int.h"
+
+struct parallel_pool {
+	/* held by the thread running a parallel loop */
+	pthread_mutex_t busy;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	pthread_t workers[VLIB_PARALLEL_MAX_THREADS - 1];
+	size_t num_workers;
+	size_t num_threads;			/* requested, 0 for one per core */
+	unsigned long generation;	/* incremented for each loop */
+	size_t pending;				/* workers not done with the current loop */
+	int quit;
+	/* current loop */
+	vlib_parallel_func func;
+	void *arg;
+	size_t n;
+	size_t chunk;
+};
+
+struct parallel_worker {
+	struct parallel_pool *pool;
+	size_t id;
+	unsigned long generation;	/* last loop seen */
+};
+
+static struct parallel_pool pool = {
+	.busy = PTHREAD_MUTEX_INITIALIZER,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.start = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+static struct parallel_worker parallel_workers[VLIB_PARALLEL_MAX_THREADS - 1];
+static int parallel_started;
+
+static void parallel_run_chunk(struct parallel_pool *p, size_t i)
+{
+	size_t start = i * p->chunk;
+	size_t end = start + p->chunk;
+
+	if (start >= p->n) {
+		return;
+	}
+
+	p->func(p->arg, start, end < p->n ? end : p->n);
+}
+
+static void *parallel_worker_thread(void *ptr)
+{
+	struct parallel_worker *w = ptr;
+	struct parallel_pool *p = w->pool;
+	unsigned long seen = w->generation;
+
+	while (1) {
+		pthread_mutex_lock(&p->lock);
+		while (p->generation == seen && !p->quit) {
+			pthread_cond_wait(&p->start, &p->lock);
+		}
+		if (p->quit) {
+			pthread_mutex_unlock(&p->lock);
+			break;
+		}
+		seen = p->generation;
+		pthread_mutex_unlock(&p->lock);
+
+		parallel_run_chunk(p, w->id);
+
+		pthread_mutex_lock(&p->lock);
+		if (!--p->pending) {
+			pthread_cond_signal(&p->done);
+		}
+		pthread_mutex_unlock(&p->lock);
+	}
+
+	return NULL;
+}
+
+static size_t parallel_default_threads(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (n < 1) {
+		return 1;
+	}
+
+	return n < VLIB_PARALLEL_MAX_THREADS ? n : VLIB_PARALLEL_MAX_THREADS;
+}
+
+/* called with pool.busy held */
+static void parallel_start(struct parallel_pool *p)
+{
+	size_t n = p->num_threads ? p->num_threads : parallel_default_threads();
+
+	p->quit = 0;
+	p->num_workers = 0;
+	for (size_t i=0; i<n-1; i++) {
+		parallel_workers[i].pool = p;
+		parallel_workers[i].id = i + 1;
+		parallel_workers[i].generation = p->generation;
+		int ret = pthread_create(&p->workers[i], NULL,
+								parallel_worker_thread, &parallel_workers[i]);
+		if (ret) {
+			vlib_warn("failed to create worker thread: %s\n", strerror(ret));
+			break;
+		}
+		p->num_workers++;
+	}
+
+	parallel_started = 1;
+}
+
+/* called with pool.busy held */
+static void parallel_stop(struct parallel_pool *p)
+{
+	pthread_mutex_lock(&p->lock);
+	p->quit = 1;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+
+	for (size_t i=0; i<p->num_workers; i++) {
+		pthread_join(p->workers[i], NULL);
+	}
+
+	p->num_workers = 0;
+	parallel_started = 0;
+}
+
+/**
+ * vlib_parallel_for - run a band callback on all cores
+ * @n: number of items, typically rows
+ * @grain: band boundaries are multiples of grain, at least 1
+ * @func: callback processing items [start, end)
+ * @arg: argument passed to func
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_parallel_for(size_t n, size_t grain, vlib_parallel_func func,
+				void *arg)
+{
+	struct parallel_pool *p = &pool;
+	size_t blocks, bands;
+
+	if (!func || !grain) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (!n) {
+		return VLIB_SUCCESS;
+	}
+
+	/* nested or concurrent loop */
+	if (pthread_mutex_trylock(&p->busy)) {
+		func(arg, 0, n);
+		return VLIB_SUCCESS;
+	}
+
+	if (!parallel_started) {
+		parallel_start(p);
+	}
+
+	blocks = (n + grain - 1) / grain;
+	bands = p->num_workers + 1;
+	if (bands > blocks) {
+		bands = blocks;
+	}
+
+	if (bands == 1) {
+		func(arg, 0, n);
+		pthread_mutex_unlock(&p->busy);
+		return VLIB_SUCCESS;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	p->func = func;
+	p->arg = arg;
+	p->n = n;
+	p->chunk = (blocks + bands - 1) / bands * grain;
+	p->pending = p->num_workers;
+	p->generation++;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+
+	parallel_run_chunk(p, 0);
+
+	pthread_mutex_lock(&p->lock);
+	while (p->pending) {
+		pthread_cond_wait(&p->done, &p->lock);
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	pthread_mutex_unlock(&p->busy);
+
+	return VLIB_SUCCESS;
+}
+
+/* may be called from a band callback, so does not take the pool lock */
+size_t vlib_parallel_get_num_threads(void)
+{
+	if (parallel_started) {
+		return pool.num_workers + 1;
+	}
+
+	return pool.num_threads ? pool.num_threads : parallel_default_threads();
+}
+
+/**
+ * vlib_parallel_set_num_threads - set the size of the worker pool
+ * @num_threads: threads including the caller, 0 for one per online core
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_parallel_set_num_threads(size_t num_threads)
+{
+	if (num_threads > VLIB_PARALLEL_MAX_THREADS) {
+		VLIB_REPORT_ERR("at most %d threads supported",
+						VLIB_PARALLEL_MAX_THREADS);
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	pthread_mutex_lock(&pool.busy);
+	if (parallel_started) {
+		parallel_stop(&pool);
+	}
+	pool.num_threads = num_threads;
+	pthread_mutex_unlock(&pool.busy);
+
+	return VLIB_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+
+#include "parallel.h"
+#include "pyramid.h"
+#include "video_int.h"
+
+/* rows per band boundary */
+#define PYRAMID_GRAIN		8
+
+struct pyramid_job {
+	const uint8_t *src;
+	size_t stride_src;
+	size_t width;
+	size_t height;
+	uint8_t *dst;
+	size_t stride_dst;
+};
+
+static inline size_t pyramid_reflect(long i, size_t n)
+{
+	if (i < 0) {
+		return -i;
+	}
+
+	return i < (long)n ? (size_t)i : 2 * n - 2 - i;
+}
+
+static void pyramid_down_band(void *arg, size_t start, size_t end)
+{
+	struct pyramid_job *job = arg;
+	size_t sw = job->width, sh = job->height, dw = (sw + 1) / 2;
+	uint16_t *tmp = malloc(sw * sizeof(*tmp));
+
+	if (!tmp) {
+		vlib_warn("pyramid: out of memory\n");
+		return;
+	}
+
+	for (size_t y=start; y<end; y++) {
+		const uint8_t *r[5];
+		uint8_t *dst = job->dst + y * job->stride_dst;
+
+		for (int k=0; k<5; k++) {
+			r[k] = job->src + pyramid_reflect(2 * y + k - 2, sh) * job->stride_src;
+		}
+
+		for (size_t x=0; x<sw; x++) {
+			tmp[x] = r[0][x] + 4 * (r[1][x] + r[3][x]) + 6 * r[2][x] + r[4][x];
+		}
+
+		for (size_t x=0; x<dw; x++) {
+			long c = 2 * x;
+			unsigned int sum = tmp[pyramid_reflect(c - 2, sw)] +
+					4 * (tmp[pyramid_reflect(c - 1, sw)] +
+						 tmp[pyramid_reflect(c + 1, sw)]) +
+					6 * tmp[c] + tmp[pyramid_reflect(c + 2, sw)];
+
+			dst[x] = (sum + 128) >> 8;
+		}
+	}
+
+	free(tmp);
+}
+
+/**
+ * vlib_pyr_down - blur and halve an 8-bit image
+ * @src: source image
+ * @stride_src: line stride of @src in bytes
+ * @width: source width
+ * @height: source height
+ * @dst: destination image of (@width + 1) / 2 x (@height + 1) / 2 pixels
+ * @stride_dst: line stride of @dst in bytes
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_pyr_down(const uint8_t *src, size_t stride_src,
+				size_t width, size_t height,
+				uint8_t *dst, size_t stride_dst)
+{
+	struct pyramid_job job = {
+		.src = src,
+		.stride_src = stride_src,
+		.width = width,
+		.height = height,
+		.dst = dst,
+		.stride_dst = stride_dst,
+	};
+
+	if (!src || !dst || width < 3 || height < 3) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return vlib_parallel_for((height + 1) / 2, PYRAMID_GRAIN,
+							pyramid_down_band, &job);
+}
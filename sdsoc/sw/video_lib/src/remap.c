@@ -0,0 +1,368 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parallel.h"
+#include "remap.h"
+#include "simd.h"
+#include "video_int.h"
+
+#define REMAP_TILE_WIDTH	64
+#define REMAP_TILE_HEIGHT	16
+
+/*
+ * Coordinates are stored as (c + 1) in Q11.5, so that -1, the column or
+ * line left of or above the source, is still representable.
+ */
+#define REMAP_BITS			5
+#define REMAP_ONE			(1 << REMAP_BITS)
+#define REMAP_MASK			(REMAP_ONE - 1)
+
+struct vlib_remap {
+	size_t width;				/* output size */
+	size_t height;
+	size_t src_width;
+	size_t src_height;
+	size_t tiles_x;
+	size_t tiles_y;
+	/*
+	 * Tiles are stored one after the other, row by row, and the entries
+	 * of a tile line by line.
+	 */
+	uint16_t *x;
+	uint16_t *y;
+	uint8_t *inside;			/* per tile, all reads inside the source */
+};
+
+struct remap_job {
+	const struct vlib_remap *rm;
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+};
+
+static uint16_t remap_quantize(float c, size_t size)
+{
+	long max = (long)((size + 1) << REMAP_BITS);
+	long q;
+
+	/* also catches NaN */
+	if (!(c > -1.0f)) {
+		return 0;
+	}
+
+	if (c >= size) {
+		return max;
+	}
+
+	q = lroundf(c * REMAP_ONE) + REMAP_ONE;
+
+	return q > max ? max : q;
+}
+
+/*
+ * The interpolation is done in two rounded steps so that all intermediate
+ * values fit 16 bit lanes: horizontal to 11 bits, then vertical.
+ */
+static inline uint8_t remap_lerp(int p00, int p01, int p10, int p11,
+								int fx, int fy)
+{
+	int h0 = (p00 * (REMAP_ONE - fx) + p01 * fx + 2) >> 2;
+	int h1 = (p10 * (REMAP_ONE - fx) + p11 * fx + 2) >> 2;
+
+	return (h0 * (REMAP_ONE - fy) + h1 * fy + 128) >> 8;
+}
+
+static inline int remap_pixel(const uint8_t *src, size_t stride, long w,
+							long h, long x, long y)
+{
+	if (x < 0 || y < 0 || x >= w || y >= h) {
+		return 0;
+	}
+
+	return src[y * stride + x];
+}
+
+static uint8_t remap_px_border(const struct vlib_remap *rm,
+							const uint8_t *src, size_t stride,
+							uint16_t qx, uint16_t qy)
+{
+	long w = rm->src_width, h = rm->src_height;
+	long x = (qx >> REMAP_BITS) - 1, y = (qy >> REMAP_BITS) - 1;
+
+	return remap_lerp(remap_pixel(src, stride, w, h, x, y),
+					remap_pixel(src, stride, w, h, x + 1, y),
+					remap_pixel(src, stride, w, h, x, y + 1),
+					remap_pixel(src, stride, w, h, x + 1, y + 1),
+					qx & REMAP_MASK, qy & REMAP_MASK);
+}
+
+static inline const uint8_t *remap_src(const uint8_t *src, size_t stride,
+									uint16_t qx, uint16_t qy)
+{
+	return src + ((qy >> REMAP_BITS) - 1) * stride + (qx >> REMAP_BITS) - 1;
+}
+
+static inline uint8_t remap_px(const uint8_t *src, size_t stride,
+							uint16_t qx, uint16_t qy)
+{
+	const uint8_t *p = remap_src(src, stride, qx, qy);
+
+	return remap_lerp(p[0], p[1], p[stride], p[stride + 1],
+					qx & REMAP_MASK, qy & REMAP_MASK);
+}
+
+/*
+ * Interpolate 8 pixels. There is no gather instruction, so the left and
+ * right neighbour of each pixel are fetched together with one 16 bit load
+ * per line (little endian: left neighbour in the low byte) and the
+ * weights are computed in vectors.
+ */
+static inline v_u16 remap_8(const uint8_t *src, size_t stride,
+							const uint16_t *x, const uint16_t *y)
+{
+	const v_u16 one = v_setall_u16(REMAP_ONE);
+	const v_u16 mask = v_setall_u16(REMAP_MASK);
+	const v_u16 lo = v_setall_u16(0xff);
+	uint16_t t0[8], t1[8];
+	v_u16 vx = v_load_u16(x), vy = v_load_u16(y);
+	v_u16 fx, fy, gx, gy, a, b, h0, h1;
+
+	for (int i=0; i<8; i++) {
+		const uint8_t *p = remap_src(src, stride, x[i], y[i]);
+
+		memcpy(&t0[i], p, 2);
+		memcpy(&t1[i], p + stride, 2);
+	}
+
+	fx = v_and_u16(vx, mask);
+	fy = v_and_u16(vy, mask);
+	gx = v_sub_u16(one, fx);
+	gy = v_sub_u16(one, fy);
+
+	a = v_load_u16(t0);
+	b = v_load_u16(t1);
+	h0 = v_add_u16(v_mul_u16(v_and_u16(a, lo), gx), v_mul_u16(v_shr_u16(a, 8), fx));
+	h1 = v_add_u16(v_mul_u16(v_and_u16(b, lo), gx), v_mul_u16(v_shr_u16(b, 8), fx));
+	h0 = v_shr_u16(v_add_u16(h0, v_setall_u16(2)), 2);
+	h1 = v_shr_u16(v_add_u16(h1, v_setall_u16(2)), 2);
+
+	return v_shr_u16(v_add_u16(v_add_u16(v_mul_u16(h0, gy), v_mul_u16(h1, fy)),
+								v_setall_u16(128)), 8);
+}
+
+static void remap_tile(const struct vlib_remap *rm, size_t tx, size_t ty,
+					size_t start, size_t end, const uint8_t *src,
+					size_t stride_src, uint8_t *dst, size_t stride_dst)
+{
+	size_t x0 = tx * REMAP_TILE_WIDTH, y0 = ty * REMAP_TILE_HEIGHT;
+	size_t tw = rm->width - x0 < REMAP_TILE_WIDTH ? rm->width - x0 : REMAP_TILE_WIDTH;
+	size_t th = rm->height - y0 < REMAP_TILE_HEIGHT ? rm->height - y0 : REMAP_TILE_HEIGHT;
+	size_t base = y0 * rm->width + x0 * th;
+	int inside = rm->inside[ty * rm->tiles_x + tx];
+
+	for (size_t l=start-y0; l<end-y0; l++) {
+		const uint16_t *x = rm->x + base + l * tw;
+		const uint16_t *y = rm->y + base + l * tw;
+		uint8_t *d = dst + (y0 + l) * stride_dst + x0;
+		size_t i = 0;
+
+		if (!inside) {
+			for (; i<tw; i++) {
+				d[i] = remap_px_border(rm, src, stride_src, x[i], y[i]);
+			}
+			continue;
+		}
+
+		for (; i+16<=tw; i+=16) {
+			v_u16 r0 = remap_8(src, stride_src, x + i, y + i);
+			v_u16 r1 = remap_8(src, stride_src, x + i + 8, y + i + 8);
+
+			v_store_u8(d + i, v_pack_u16(r0, r1));
+		}
+
+		for (; i<tw; i++) {
+			d[i] = remap_px(src, stride_src, x[i], y[i]);
+		}
+	}
+}
+
+/**
+ * vlib_remap_lines - remap a range of output lines
+ * @rm: compiled map
+ * @src: source image
+ * @stride_src: line stride of @src in bytes
+ * @dst: output image
+ * @stride_dst: line stride of @dst in bytes
+ * @start: first output line
+ * @end: last output line (exclusive)
+ *
+ * Bands aligned to 16 lines are processed tile by tile.
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_remap_lines(const struct vlib_remap *rm,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t start, size_t end)
+{
+	if (!rm || !src || !dst || end > rm->height || start > end) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	for (size_t ty=start/REMAP_TILE_HEIGHT; ty*REMAP_TILE_HEIGHT<end; ty++) {
+		size_t y0 = ty * REMAP_TILE_HEIGHT;
+		size_t s = start > y0 ? start : y0;
+		size_t e = end < y0 + REMAP_TILE_HEIGHT ? end : y0 + REMAP_TILE_HEIGHT;
+
+		for (size_t tx=0; tx<rm->tiles_x; tx++) {
+			remap_tile(rm, tx, ty, s, e, src, stride_src, dst, stride_dst);
+		}
+	}
+
+	return VLIB_SUCCESS;
+}
+
+static void remap_band(void *arg, size_t start, size_t end)
+{
+	struct remap_job *job = arg;
+
+	vlib_remap_lines(job->rm, job->src, job->stride_src, job->dst,
+					job->stride_dst, start, end);
+}
+
+/**
+ * vlib_remap - remap an image on all cores
+ * @rm: compiled map
+ * @src: source image of the size given at creation
+ * @stride_src: line stride of @src in bytes
+ * @dst: output image
+ * @stride_dst: line stride of @dst in bytes
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_remap(const struct vlib_remap *rm,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst)
+{
+	struct remap_job job = {
+		.rm = rm,
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+	};
+
+	if (!rm || !src || !dst) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return vlib_parallel_for(rm->height, REMAP_TILE_HEIGHT, remap_band, &job);
+}
+
+/**
+ * vlib_remap_create - compile a pair of float maps
+ * @mapx: source column of each output pixel
+ * @mapy: source line of each output pixel
+ * @map_stride: line stride of @mapx and @mapy in bytes
+ * @width: output width
+ * @height: output height
+ * @src_width: source width, at most VLIB_REMAP_MAX_SRC_SIZE
+ * @src_height: source height, at most VLIB_REMAP_MAX_SRC_SIZE
+ *
+ * The float maps are not referenced after this call.
+ *
+ * Return: Pointer to the compiled map on success, NULL otherwise.
+ */
+struct vlib_remap *vlib_remap_create(const float *mapx, const float *mapy,
+				size_t map_stride, size_t width, size_t height,
+				size_t src_width, size_t src_height)
+{
+	struct vlib_remap *rm;
+
+	if (!mapx || !mapy || !width || !height || src_width < 2 || src_height < 2) {
+		return NULL;
+	}
+
+	if (src_width > VLIB_REMAP_MAX_SRC_SIZE || src_height > VLIB_REMAP_MAX_SRC_SIZE) {
+		VLIB_REPORT_ERR("remap: source %zux%zu exceeds %d", src_width,
+						src_height, VLIB_REMAP_MAX_SRC_SIZE);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	rm = calloc(1, sizeof(*rm));
+	if (!rm) {
+		return NULL;
+	}
+
+	rm->width = width;
+	rm->height = height;
+	rm->src_width = src_width;
+	rm->src_height = src_height;
+	rm->tiles_x = (width + REMAP_TILE_WIDTH - 1) / REMAP_TILE_WIDTH;
+	rm->tiles_y = (height + REMAP_TILE_HEIGHT - 1) / REMAP_TILE_HEIGHT;
+	rm->x = malloc(width * height * sizeof(*rm->x));
+	rm->y = malloc(width * height * sizeof(*rm->y));
+	rm->inside = malloc(rm->tiles_x * rm->tiles_y);
+	if (!rm->x || !rm->y || !rm->inside) {
+		vlib_remap_destroy(rm);
+		return NULL;
+	}
+
+	for (size_t ty=0; ty<rm->tiles_y; ty++) {
+		size_t y0 = ty * REMAP_TILE_HEIGHT;
+		size_t th = height - y0 < REMAP_TILE_HEIGHT ? height - y0 : REMAP_TILE_HEIGHT;
+
+		for (size_t tx=0; tx<rm->tiles_x; tx++) {
+			size_t x0 = tx * REMAP_TILE_WIDTH;
+			size_t tw = width - x0 < REMAP_TILE_WIDTH ? width - x0 : REMAP_TILE_WIDTH;
+			uint16_t *x = rm->x + y0 * width + x0 * th;
+			uint16_t *y = rm->y + y0 * width + x0 * th;
+			int inside = 1;
+
+			for (size_t l=0; l<th; l++) {
+				const float *mx = (const float *)((const uint8_t *)mapx +
+												(y0 + l) * map_stride) + x0;
+				const float *my = (const float *)((const uint8_t *)mapy +
+												(y0 + l) * map_stride) + x0;
+
+				for (size_t i=0; i<tw; i++) {
+					uint16_t qx = remap_quantize(mx[i], src_width);
+					uint16_t qy = remap_quantize(my[i], src_height);
+					size_t sx = qx >> REMAP_BITS, sy = qy >> REMAP_BITS;
+
+					/* 2x2 neighbourhood (sx - 1, sy - 1) inside */
+					inside &= sx >= 1 && sy >= 1 && sx < src_width &&
+							sy < src_height;
+					x[l * tw + i] = qx;
+					y[l * tw + i] = qy;
+				}
+			}
+
+			rm->inside[ty * rm->tiles_x + tx] = inside;
+		}
+	}
+
+	return rm;
+}
+
+void vlib_remap_destroy(struct vlib_remap *rm)
+{
+	if (!rm) {
+		return;
+	}
+
+	free(rm->x);
+	free(rm->y);
+	free(rm->inside);
+	free(rm);
+}
+
+/* bytes of compiled map data */
+size_t vlib_remap_size(const struct vlib_remap *rm)
+{
+	return rm->width * rm->height * (sizeof(*rm->x) + sizeof(*rm->y)) +
+			rm->tiles_x * rm->tiles_y;
+}
@@ -0,0 +1,1027 @@
+#include <drm/drm_fourcc.h>
+#include <linux/videodev2.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cvt_color.h"
+#include "filter.h"
+#include "helper.h"
+#include "image.h"
+#include "parallel.h"
+#include "resize.h"
+#include "simd.h"
+#include "video_int.h"
+
+/* output lines per band boundary, even for 4:2:0 chroma */
+#define RESIZE_GRAIN		8
+
+/* output lines resized at once before a format conversion */
+#define RESIZE_STRIP		16
+
+/* fractional bits of the horizontal and the vertical weights */
+#define RESIZE_H_BITS		14
+#define RESIZE_V_BITS		15
+
+/*
+ * Horizontal sums are rounded to Q7, at most 255 << 7, to fit int16
+ * lanes. The vertical pass keeps the high half of the products with its
+ * Q15 weights, the sums are then Q6.
+ */
+#define RESIZE_SUM_BITS		7
+#define RESIZE_H_SHIFT		(RESIZE_H_BITS - RESIZE_SUM_BITS)
+#define RESIZE_SHIFT		(RESIZE_SUM_BITS + RESIZE_V_BITS - 16)
+
+/* largest number of source lines per output line */
+#define RESIZE_MAX_TAPS		(VLIB_RESIZE_MAX_DOWNSCALE + 1)
+
+/* weights of one axis, shared by all resizers of the same sizes */
+struct resize_axis {
+	struct resize_axis *next;
+	size_t refs;
+	size_t src;
+	size_t dst;
+	enum vlib_resize_interp interp;
+	size_t taps;				/* source pixels per output pixel */
+	int32_t *first;				/* first source pixel per output pixel */
+	int16_t *wh;				/* taps weights per output pixel, Q14 */
+	int16_t *wv;				/* the same in Q15 */
+};
+
+static struct resize_axis *resize_axes;
+static pthread_mutex_t resize_axes_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct vlib_resize {
+	size_t src_width;
+	size_t src_height;
+	size_t width;
+	size_t height;
+	size_t channels;
+	size_t pitch;
+	enum vlib_resize_interp interp;
+	struct resize_axis *x;
+	struct resize_axis *y;
+};
+
+struct resize_job {
+	const struct vlib_resize *rs;
+	const uint8_t *src;
+	size_t stride_src;
+	uint8_t *dst;
+	size_t stride_dst;
+	int ret;
+};
+
+/* round to @one, keeping the sum exact on the largest weight */
+static void resize_quantize(const double *w, size_t taps, int one, int16_t *q)
+{
+	int v[RESIZE_MAX_TAPS];
+	int sum = 0;
+	size_t big = 0;
+
+	for (size_t k=0; k<taps; k++) {
+		v[k] = lround(w[k] * one);
+		sum += v[k];
+		if (w[k] > w[big]) {
+			big = k;
+		}
+	}
+	v[big] += one - sum;
+
+	for (size_t k=0; k<taps; k++) {
+		q[k] = v[k] > INT16_MAX ? INT16_MAX : v[k];
+	}
+}
+
+/*
+ * Source pixels [*lo, *lo + n) and their weights for output pixel @d.
+ * Area weights are the overlaps of the output pixel with the source
+ * pixels, in exact integer units of 1 / dst.
+ */
+static size_t resize_axis_pixel(const struct resize_axis *ax, size_t d,
+								long *lo, double *w)
+{
+	size_t src = ax->src, dst = ax->dst;
+	double f, a;
+
+	switch (ax->interp) {
+		case VLIB_RESIZE_NEAREST:
+			*lo = (2 * d + 1) * src / (2 * dst);
+			w[0] = 1;
+			return 1;
+		case VLIB_RESIZE_AREA:
+			{
+				size_t s = d * src, e = (d + 1) * src;
+				size_t n;
+
+				*lo = s / dst;
+				n = (e + dst - 1) / dst - *lo;
+				for (size_t i=0; i<n; i++) {
+					size_t c0 = (*lo + i) * dst, c1 = c0 + dst;
+
+					w[i] = (double)((c1 < e ? c1 : e) - (c0 > s ? c0 : s)) / src;
+				}
+				return n;
+			}
+		default:
+			break;
+	}
+
+	f = (d + 0.5) * src / dst - 0.5;
+	*lo = floor(f);
+	a = f - *lo;
+	if (f < 0) {
+		*lo = 0;
+		a = 0;
+	}
+	if (*lo >= (long)src - 1) {
+		*lo = src - 1;
+		a = 0;
+	}
+
+	w[0] = 1 - a;
+	w[1] = a;
+
+	return a > 0 ? 2 : 1;
+}
+
+static void resize_axis_free(struct resize_axis *ax)
+{
+	free(ax->first);
+	free(ax->wh);
+	free(ax->wv);
+	free(ax);
+}
+
+static struct resize_axis *resize_axis_create(size_t src, size_t dst,
+								enum vlib_resize_interp interp)
+{
+	struct resize_axis *ax = calloc(1, sizeof(*ax));
+	double *w = NULL;
+	long *lo = NULL;
+	size_t *n = NULL;
+
+	if (!ax) {
+		return NULL;
+	}
+
+	ax->refs = 1;
+	ax->src = src;
+	ax->dst = dst;
+	ax->interp = interp;
+	ax->taps = 1;
+
+	w = malloc(dst * RESIZE_MAX_TAPS * sizeof(*w));
+	lo = malloc(dst * sizeof(*lo));
+	n = malloc(dst * sizeof(*n));
+	if (!w || !lo || !n) {
+		goto err;
+	}
+
+	/* only the first n[d] weights of each output pixel are set */
+	for (size_t d=0; d<dst; d++) {
+		n[d] = resize_axis_pixel(ax, d, &lo[d], w + d * RESIZE_MAX_TAPS);
+
+		if (n[d] > ax->taps) {
+			ax->taps = n[d];
+		}
+	}
+
+	/* every output pixel reads the same number of source pixels */
+	ax->first = malloc(dst * sizeof(*ax->first));
+	ax->wh = malloc(dst * ax->taps * sizeof(*ax->wh));
+	ax->wv = malloc(dst * ax->taps * sizeof(*ax->wv));
+	if (!ax->first || !ax->wh || !ax->wv) {
+		goto err;
+	}
+
+	for (size_t d=0; d<dst; d++) {
+		const double *wd = w + d * RESIZE_MAX_TAPS;
+		double pw[RESIZE_MAX_TAPS];
+		long first = lo[d];
+
+		if (first > (long)(src - ax->taps)) {
+			first = src - ax->taps;
+		}
+
+		for (size_t k=0; k<ax->taps; k++) {
+			long i = first + k - lo[d];
+
+			pw[k] = i >= 0 && i < (long)n[d] ? wd[i] : 0;
+		}
+
+		ax->first[d] = first;
+		resize_quantize(pw, ax->taps, 1 << RESIZE_H_BITS, ax->wh + d * ax->taps);
+		resize_quantize(pw, ax->taps, 1 << RESIZE_V_BITS, ax->wv + d * ax->taps);
+	}
+
+	free(w);
+	free(lo);
+	free(n);
+
+	return ax;
+
+err:
+	free(w);
+	free(lo);
+	free(n);
+	resize_axis_free(ax);
+	return NULL;
+}
+
+/* look up the weights of an axis, computing them on first use */
+static struct resize_axis *resize_axis_get(size_t src, size_t dst,
+								enum vlib_resize_interp interp)
+{
+	struct resize_axis *ax;
+
+	/* area upscaling is bilinear */
+	if (interp == VLIB_RESIZE_AREA && src <= dst) {
+		interp = VLIB_RESIZE_BILINEAR;
+	}
+
+	pthread_mutex_lock(&resize_axes_lock);
+	for (ax=resize_axes; ax; ax=ax->next) {
+		if (ax->src == src && ax->dst == dst && ax->interp == interp) {
+			ax->refs++;
+			break;
+		}
+	}
+
+	if (!ax) {
+		ax = resize_axis_create(src, dst, interp);
+		if (ax) {
+			ax->next = resize_axes;
+			resize_axes = ax;
+		}
+	}
+	pthread_mutex_unlock(&resize_axes_lock);
+
+	return ax;
+}
+
+static void resize_axis_put(struct resize_axis *ax)
+{
+	if (!ax) {
+		return;
+	}
+
+	pthread_mutex_lock(&resize_axes_lock);
+	if (!--ax->refs) {
+		struct resize_axis **p = &resize_axes;
+
+		while (*p != ax) {
+			p = &(*p)->next;
+		}
+		*p = ax->next;
+		resize_axis_free(ax);
+	}
+	pthread_mutex_unlock(&resize_axes_lock);
+}
+
+/* horizontal pass of one source line into @width * channels sums */
+static void resize_line_h(const struct vlib_resize *rs, const uint8_t *src,
+						int16_t *dst)
+{
+	const struct resize_axis *ax = rs->x;
+	size_t ch = rs->channels, pitch = rs->pitch, step = pitch / ch;
+
+	if (ax->taps == 2) {
+		for (size_t d=0; d<rs->width; d++) {
+			const uint8_t *p = src + ax->first[d] * pitch;
+			int w0 = ax->wh[2 * d], w1 = ax->wh[2 * d + 1];
+
+			for (size_t c=0; c<ch; c++) {
+				dst[c] = (w0 * p[c * step] + w1 * p[pitch + c * step] +
+						(1 << (RESIZE_H_SHIFT - 1))) >> RESIZE_H_SHIFT;
+			}
+			dst += ch;
+		}
+		return;
+	}
+
+	for (size_t d=0; d<rs->width; d++) {
+		const uint8_t *p = src + ax->first[d] * pitch;
+		const int16_t *w = ax->wh + d * ax->taps;
+
+		for (size_t c=0; c<ch; c++) {
+			int s = 1 << (RESIZE_H_SHIFT - 1);
+
+			for (size_t k=0; k<ax->taps; k++) {
+				s += w[k] * p[k * pitch + c * step];
+			}
+			dst[c] = s >> RESIZE_H_SHIFT;
+		}
+		dst += ch;
+	}
+}
+
+/* vertical pass, combines @taps horizontal sums into @n output values */
+static void resize_line_v(const int16_t *const *rows, const int16_t *w,
+						size_t taps, uint8_t *dst, size_t n)
+{
+	v_s16 round = v_setall_s16(1 << (RESIZE_SHIFT - 1));
+	size_t i = 0;
+
+	for (; i+16<=n; i+=16) {
+		v_s16 a = round, b = round;
+
+		for (size_t k=0; k<taps; k++) {
+			v_s16 wk = v_setall_s16(w[k]);
+
+			a = v_add_s16(a, v_mulhi_s16(v_load_s16(rows[k] + i), wk));
+			b = v_add_s16(b, v_mulhi_s16(v_load_s16(rows[k] + i + 8), wk));
+		}
+
+		v_store_u8(dst + i, v_packus_s16(v_shr_s16(a, RESIZE_SHIFT),
+										v_shr_s16(b, RESIZE_SHIFT)));
+	}
+
+	for (; i<n; i++) {
+		int s = 1 << (RESIZE_SHIFT - 1);
+
+		for (size_t k=0; k<taps; k++) {
+			s += (rows[k][i] * w[k]) >> 16;
+		}
+		dst[i] = s >> RESIZE_SHIFT;
+	}
+}
+
+static void resize_lines_nearest(const struct vlib_resize *rs,
+						const uint8_t *src, size_t stride_src,
+						uint8_t *dst, size_t stride_dst,
+						size_t start, size_t end)
+{
+	const int32_t *fx = rs->x->first;
+	size_t ch = rs->channels, pitch = rs->pitch, step = pitch / ch;
+
+	for (size_t y=start; y<end; y++) {
+		const uint8_t *s = src + rs->y->first[y] * stride_src;
+		uint8_t *d = dst + (y - start) * stride_dst;
+
+		if (pitch == 1) {
+			for (size_t x=0; x<rs->width; x++) {
+				d[x] = s[fx[x]];
+			}
+			continue;
+		}
+
+		for (size_t x=0; x<rs->width; x++) {
+			for (size_t c=0; c<ch; c++) {
+				d[x * pitch + c * step] = s[fx[x] * pitch + c * step];
+			}
+		}
+	}
+}
+
+/* output lines [start, end), @dst points to line @start */
+static int resize_lines(const struct vlib_resize *rs,
+						const uint8_t *src, size_t stride_src,
+						uint8_t *dst, size_t stride_dst,
+						size_t start, size_t end)
+{
+	const int16_t *rows[RESIZE_MAX_TAPS];
+	size_t n, len, taps, next;
+	int16_t *ring;
+	uint8_t *tmp = NULL;
+
+	if (rs->interp == VLIB_RESIZE_NEAREST) {
+		resize_lines_nearest(rs, src, stride_src, dst, stride_dst,
+							start, end);
+		return VLIB_SUCCESS;
+	}
+
+	/* a ring of the horizontal sums of the last taps source lines */
+	n = rs->width * rs->channels;
+	len = (n + 15) & ~(size_t)15;
+	taps = rs->y->taps;
+	ring = malloc(taps * len * sizeof(*ring) + n);
+	if (!ring) {
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	/* pixels with gaps are combined into a line first, then spread */
+	if (rs->pitch != rs->channels) {
+		tmp = (uint8_t *)(ring + taps * len);
+	}
+
+	next = rs->y->first[start];
+	for (size_t y=start; y<end; y++) {
+		size_t first = rs->y->first[y];
+		uint8_t *d = dst + (y - start) * stride_dst;
+
+		if (next < first) {
+			next = first;
+		}
+		for (; next<first+taps; next++) {
+			resize_line_h(rs, src + next * stride_src,
+						ring + (next % taps) * len);
+		}
+
+		for (size_t k=0; k<taps; k++) {
+			rows[k] = ring + ((first + k) % taps) * len;
+		}
+
+		resize_line_v(rows, rs->y->wv + y * taps, taps, tmp ? tmp : d, n);
+
+		if (tmp) {
+			size_t ch = rs->channels, step = rs->pitch / ch;
+
+			for (size_t x=0; x<rs->width; x++) {
+				for (size_t c=0; c<ch; c++) {
+					d[x * rs->pitch + c * step] = tmp[x * ch + c];
+				}
+			}
+		}
+	}
+
+	free(ring);
+
+	return VLIB_SUCCESS;
+}
+
+/**
+ * vlib_resize_lines - resize a range of output lines
+ * @rs: resizer
+ * @src: source image
+ * @stride_src: line stride of @src in bytes
+ * @dst: output image
+ * @stride_dst: line stride of @dst in bytes
+ * @start: first output line
+ * @end: last output line (exclusive)
+ *
+ * Only the bytes of the channels are written, the other bytes of a pixel
+ * are left as they are. Horizontal sums of a source line are computed
+ * once per call and reused by all output lines reading it.
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_resize_lines(const struct vlib_resize *rs,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst,
+				size_t start, size_t end)
+{
+	if (!rs || !src || !dst || end > rs->height || start > end) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (start == end) {
+		return VLIB_SUCCESS;
+	}
+
+	return resize_lines(rs, src, stride_src, dst + start * stride_dst,
+						stride_dst, start, end);
+}
+
+static void resize_band(void *arg, size_t start, size_t end)
+{
+	struct resize_job *job = arg;
+
+	if (vlib_resize_lines(job->rs, job->src, job->stride_src, job->dst,
+						job->stride_dst, start, end)) {
+		job->ret = VLIB_ERROR_NO_MEM;
+	}
+}
+
+/**
+ * vlib_resize - resize an image on all cores
+ * @rs: resizer
+ * @src: source image of the size given at creation
+ * @stride_src: line stride of @src in bytes
+ * @dst: output image of the size given at creation
+ * @stride_dst: line stride of @dst in bytes
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_resize(const struct vlib_resize *rs,
+				const uint8_t *src, size_t stride_src,
+				uint8_t *dst, size_t stride_dst)
+{
+	struct resize_job job = {
+		.rs = rs,
+		.src = src,
+		.stride_src = stride_src,
+		.dst = dst,
+		.stride_dst = stride_dst,
+		.ret = VLIB_SUCCESS,
+	};
+	int ret;
+
+	if (!rs || !src || !dst) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	ret = vlib_parallel_for(rs->height, RESIZE_GRAIN, resize_band, &job);
+
+	return ret ? ret : job.ret;
+}
+
+/**
+ * vlib_resize_src_lines - source lines needed for a range of output lines
+ * @rs: resizer
+ * @end: last output line (exclusive)
+ *
+ * Return: number of source lines from the top needed to resize output
+ * lines [0, @end).
+ */
+size_t vlib_resize_src_lines(const struct vlib_resize *rs, size_t end)
+{
+	if (!end) {
+		return 0;
+	}
+
+	if (end > rs->height) {
+		end = rs->height;
+	}
+
+	return rs->y->first[end - 1] + rs->y->taps;
+}
+
+/**
+ * vlib_resize_create - set up a resizer
+ * @src_width: source width in pixels
+ * @src_height: source height in lines
+ * @width: output width in pixels
+ * @height: output height in lines
+ * @channels: values per pixel
+ * @pitch: bytes per pixel, a multiple of @channels
+ * @interp: interpolation
+ *
+ * Filtering interpolations downscale by at most VLIB_RESIZE_MAX_DOWNSCALE
+ * per axis.
+ *
+ * Return: Pointer to the resizer on success, NULL otherwise.
+ */
+struct vlib_resize *vlib_resize_create(size_t src_width, size_t src_height,
+				size_t width, size_t height, size_t channels, size_t pitch,
+				enum vlib_resize_interp interp)
+{
+	struct vlib_resize *rs;
+
+	if (!src_width || !src_height || !width || !height || !channels ||
+		pitch % channels || interp > VLIB_RESIZE_AREA ||
+		width > INT32_MAX || height > INT32_MAX) {
+		return NULL;
+	}
+
+	if (interp != VLIB_RESIZE_NEAREST &&
+		(src_width > VLIB_RESIZE_MAX_DOWNSCALE * width ||
+		 src_height > VLIB_RESIZE_MAX_DOWNSCALE * height)) {
+		VLIB_REPORT_ERR("resize: %zux%zu -> %zux%zu exceeds %d:1",
+						src_width, src_height, width, height,
+						VLIB_RESIZE_MAX_DOWNSCALE);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	rs = calloc(1, sizeof(*rs));
+	if (!rs) {
+		return NULL;
+	}
+
+	rs->src_width = src_width;
+	rs->src_height = src_height;
+	rs->width = width;
+	rs->height = height;
+	rs->channels = channels;
+	rs->pitch = pitch;
+	rs->interp = interp;
+	rs->x = resize_axis_get(src_width, width, interp);
+	rs->y = resize_axis_get(src_height, height, interp);
+	if (!rs->x || !rs->y) {
+		vlib_resize_destroy(rs);
+		return NULL;
+	}
+
+	return rs;
+}
+
+void vlib_resize_destroy(struct vlib_resize *rs)
+{
+	if (!rs) {
+		return;
+	}
+
+	resize_axis_put(rs->x);
+	resize_axis_put(rs->y);
+	free(rs);
+}
+
+/* interpolation of each filter mode */
+static const enum vlib_resize_interp resize_mode_interp[] = {
+	VLIB_RESIZE_AREA,
+	VLIB_RESIZE_BILINEAR,
+	VLIB_RESIZE_NEAREST,
+};
+
+static const char *resize_modes[] = {
+	"Area",
+	"Bilinear",
+	"Nearest",
+};
+
+/* pixels of one plane, or of one set of values of a packed format */
+struct resize_comp {
+	uint8_t plane;
+	uint8_t offset;				/* of the first value in the line */
+	uint8_t channels;
+	uint8_t pitch;
+	uint8_t xsub;				/* log2 of the subsampling */
+	uint8_t ysub;
+};
+
+struct resize_format {
+	uint32_t fourcc;
+	size_t num_comps;
+	struct resize_comp comps[VLIB_IMAGE_MAX_PLANES];
+};
+
+static const struct resize_format resize_formats[] = {
+	{ V4L2_PIX_FMT_YUYV, 2, { { 0, 0, 1, 2, 0, 0 }, { 0, 1, 2, 4, 1, 0 } } },
+	{ V4L2_PIX_FMT_YVYU, 2, { { 0, 0, 1, 2, 0, 0 }, { 0, 1, 2, 4, 1, 0 } } },
+	{ V4L2_PIX_FMT_UYVY, 2, { { 0, 1, 1, 2, 0, 0 }, { 0, 0, 2, 4, 1, 0 } } },
+	{ V4L2_PIX_FMT_VYUY, 2, { { 0, 1, 1, 2, 0, 0 }, { 0, 0, 2, 4, 1, 0 } } },
+	{ V4L2_PIX_FMT_NV12, 2, { { 0, 0, 1, 1, 0, 0 }, { 1, 0, 2, 2, 1, 1 } } },
+	{ V4L2_PIX_FMT_NV21, 2, { { 0, 0, 1, 1, 0, 0 }, { 1, 0, 2, 2, 1, 1 } } },
+	{ V4L2_PIX_FMT_YUV420, 3, { { 0, 0, 1, 1, 0, 0 }, { 1, 0, 1, 1, 1, 1 },
+								{ 2, 0, 1, 1, 1, 1 } } },
+	{ V4L2_PIX_FMT_YVU420, 3, { { 0, 0, 1, 1, 0, 0 }, { 1, 0, 1, 1, 1, 1 },
+								{ 2, 0, 1, 1, 1, 1 } } },
+	{ DRM_FORMAT_YUV444, 3, { { 0, 0, 1, 1, 0, 0 }, { 1, 0, 1, 1, 0, 0 },
+								{ 2, 0, 1, 1, 0, 0 } } },
+	{ V4L2_PIX_FMT_YUV444M, 3, { { 0, 0, 1, 1, 0, 0 }, { 1, 0, 1, 1, 0, 0 },
+								{ 2, 0, 1, 1, 0, 0 } } },
+	{ V4L2_PIX_FMT_GREY, 1, { { 0, 0, 1, 1, 0, 0 } } },
+	{ V4L2_PIX_FMT_RGB24, 1, { { 0, 0, 3, 3, 0, 0 } } },
+	{ V4L2_PIX_FMT_BGR24, 1, { { 0, 0, 3, 3, 0, 0 } } },
+	{ DRM_FORMAT_RGB888, 1, { { 0, 0, 3, 3, 0, 0 } } },
+	{ DRM_FORMAT_BGR888, 1, { { 0, 0, 3, 3, 0, 0 } } },
+	{ DRM_FORMAT_ABGR8888, 1, { { 0, 0, 4, 4, 0, 0 } } },
+	{ DRM_FORMAT_XBGR8888, 1, { { 0, 0, 4, 4, 0, 0 } } },
+	{ DRM_FORMAT_ARGB8888, 1, { { 0, 0, 4, 4, 0, 0 } } },
+	{ DRM_FORMAT_XRGB8888, 1, { { 0, 0, 4, 4, 0, 0 } } },
+};
+
+struct resize_data {
+	const struct resize_format *fmt;
+	const struct resize_format *out_fmt;
+	size_t in_width;
+	size_t in_height;
+	size_t out_width;
+	size_t out_height;
+	/* region of the input that is scaled, zero size for all of it */
+	size_t crop_x;
+	size_t crop_y;
+	size_t crop_width;
+	size_t crop_height;
+	struct vlib_resize *rs[ARRAY_SIZE(resize_modes)][VLIB_IMAGE_MAX_PLANES];
+};
+
+struct resize_filter_job {
+	const struct resize_data *data;
+	struct vlib_resize *const *rs;
+	struct vlib_image in;
+	const uint8_t *src[VLIB_IMAGE_MAX_PLANES];	/* first value per comp */
+	struct vlib_image out;
+	size_t line_start;
+	int ret;
+};
+
+static const struct resize_format *resize_get_format(uint32_t fourcc)
+{
+	for (size_t i=0; i<ARRAY_SIZE(resize_formats); i++) {
+		if (resize_formats[i].fourcc == fourcc) {
+			return &resize_formats[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void resize_free_buffers(struct resize_data *data)
+{
+	for (size_t m=0; m<ARRAY_SIZE(resize_modes); m++) {
+		for (size_t c=0; c<VLIB_IMAGE_MAX_PLANES; c++) {
+			vlib_resize_destroy(data->rs[m][c]);
+			data->rs[m][c] = NULL;
+		}
+	}
+
+	data->fmt = NULL;
+	data->out_fmt = NULL;
+	data->in_width = 0;
+	data->in_height = 0;
+	data->out_width = 0;
+	data->out_height = 0;
+}
+
+static int resize_init(struct filter_s *fs, const struct filter_init_data *fid)
+{
+	struct resize_data *data = fs->data;
+	const struct resize_format *fmt = resize_get_format(fid->in_fourcc);
+	const struct resize_format *out_fmt = resize_get_format(fid->out_fourcc);
+	size_t cw = data->crop_width ? data->crop_width : fid->in_width;
+	size_t ch = data->crop_height ? data->crop_height : fid->in_height;
+
+	if (!fmt || !out_fmt || data->crop_x + cw > fid->in_width ||
+		data->crop_y + ch > fid->in_height) {
+		return -1;
+	}
+
+	/* other output formats are converted from strips of the input format */
+	if (out_fmt != fmt &&
+		(!vlib_cvt_color_supported(fid->in_fourcc, fid->out_fourcc) ||
+		 (fid->out_width & 1) || (fid->out_height & 1))) {
+		return -1;
+	}
+
+	if (data->fmt == fmt && data->out_fmt == out_fmt &&
+		data->in_width == fid->in_width &&
+		data->in_height == fid->in_height &&
+		data->out_width == fid->out_width &&
+		data->out_height == fid->out_height) {
+		return 0;
+	}
+
+	resize_free_buffers(data);
+
+	for (size_t c=0; c<fmt->num_comps; c++) {
+		const struct resize_comp *cp = &fmt->comps[c];
+		size_t xm = (1 << cp->xsub) - 1, ym = (1 << cp->ysub) - 1;
+
+		if ((fid->in_width & xm) || (fid->in_height & ym) ||
+			(fid->out_width & xm) || (fid->out_height & ym) ||
+			(data->crop_x & xm) || (data->crop_y & ym) || (cw & xm) ||
+			(ch & ym)) {
+			return -1;
+		}
+
+		for (size_t m=0; m<ARRAY_SIZE(resize_modes); m++) {
+			data->rs[m][c] = vlib_resize_create(cw >> cp->xsub, ch >> cp->ysub,
+								fid->out_width >> cp->xsub,
+								fid->out_height >> cp->ysub,
+								cp->channels, cp->pitch,
+								resize_mode_interp[m]);
+			if (!data->rs[m][c]) {
+				vlib_warn("resize: failed to set up %zux%zu -> %zux%zu\n",
+						fid->in_width, fid->in_height, fid->out_width,
+						fid->out_height);
+				resize_free_buffers(data);
+				return -1;
+			}
+		}
+	}
+
+	data->fmt = fmt;
+	data->out_fmt = out_fmt;
+	data->in_width = fid->in_width;
+	data->in_height = fid->in_height;
+	data->out_width = fid->out_width;
+	data->out_height = fid->out_height;
+
+	return 0;
+}
+
+/* lines [start, end) of @img, as an image of their own */
+static void resize_image_lines(const struct vlib_image *img,
+							const struct resize_format *fmt,
+							size_t start, size_t end, struct vlib_image *lines)
+{
+	*lines = *img;
+	lines->height = end - start;
+	for (size_t c=0; c<fmt->num_comps; c++) {
+		const struct resize_comp *cp = &fmt->comps[c];
+
+		lines->plane[cp->plane] = img->plane[cp->plane] +
+								(start >> cp->ysub) * img->stride[cp->plane];
+	}
+}
+
+/* resize output lines [start, end) into @dst, which starts at line @start */
+static int resize_filter_lines(const struct resize_filter_job *job,
+							const struct vlib_image *dst,
+							size_t start, size_t end)
+{
+	const struct resize_format *fmt = job->data->fmt;
+
+	for (size_t c=0; c<fmt->num_comps; c++) {
+		const struct resize_comp *cp = &fmt->comps[c];
+
+		if (resize_lines(job->rs[c], job->src[c], job->in.stride[cp->plane],
+						dst->plane[cp->plane] + cp->offset,
+						dst->stride[cp->plane],
+						start >> cp->ysub, end >> cp->ysub)) {
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	return VLIB_SUCCESS;
+}
+
+static void resize_filter_band(void *arg, size_t start, size_t end)
+{
+	struct resize_filter_job *job = arg;
+	const struct resize_data *data = job->data;
+	struct vlib_image strip, lines;
+	size_t stride;
+	unsigned char *buf;
+
+	start += job->line_start;
+	end += job->line_start;
+
+	if (data->out_fmt == data->fmt) {
+		resize_image_lines(&job->out, data->fmt, start, end, &lines);
+		if (resize_filter_lines(job, &lines, start, end)) {
+			job->ret = VLIB_ERROR_NO_MEM;
+		}
+		return;
+	}
+
+	/* convert strips while they are in the cache */
+	stride = vlib_image_stride(data->fmt->fourcc, data->out_width);
+	buf = malloc(vlib_image_size(data->fmt->fourcc, RESIZE_STRIP, stride));
+	if (!buf) {
+		job->ret = VLIB_ERROR_NO_MEM;
+		return;
+	}
+
+	for (size_t s=start; s<end; s+=RESIZE_STRIP) {
+		size_t e = end - s < RESIZE_STRIP ? end : s + RESIZE_STRIP;
+
+		vlib_image_init(&strip, data->fmt->fourcc, data->out_width, e - s,
+						stride, buf);
+		resize_image_lines(&job->out, data->out_fmt, s, e, &lines);
+		if (resize_filter_lines(job, &strip, s, e) ||
+			vlib_cvt_color_lines(&strip, &lines, 0, e - s)) {
+			job->ret = VLIB_ERROR_NO_MEM;
+			break;
+		}
+	}
+
+	free(buf);
+}
+
+static void resize_func_lines(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out,
+						int line_start, int line_end)
+{
+	struct resize_data *data = fs->data;
+	struct resize_filter_job job = {
+		.data = data,
+		.line_start = line_start,
+		.ret = 0,
+	};
+
+	if (!data->fmt || (size_t)width_in != data->in_width ||
+		(size_t)height_in != data->in_height ||
+		(size_t)width_out != data->out_width ||
+		(size_t)height_out != data->out_height) {
+		return;
+	}
+
+	if (vlib_image_init(&job.in, data->fmt->fourcc, width_in, height_in,
+						stride_in, frm_data_in) ||
+		vlib_image_init(&job.out, data->out_fmt->fourcc, width_out,
+						height_out, stride_out, frm_data_out)) {
+		return;
+	}
+
+	for (size_t c=0; c<data->fmt->num_comps; c++) {
+		const struct resize_comp *cp = &data->fmt->comps[c];
+
+		job.src[c] = job.in.plane[cp->plane] + cp->offset +
+					(data->crop_y >> cp->ysub) * job.in.stride[cp->plane] +
+					(data->crop_x >> cp->xsub) * cp->pitch;
+	}
+
+	job.rs = data->rs[fs->mode];
+	vlib_parallel_for(line_end - line_start, RESIZE_GRAIN, resize_filter_band,
+					&job);
+	if (job.ret) {
+		vlib_warn("resize: out of memory\n");
+	}
+}
+
+static void resize_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	resize_func_lines(fs, frm_data_in, frm_data_out, height_in, width_in,
+					stride_in, height_out, width_out, stride_out,
+					0, height_out);
+}
+
+static int resize_lines_required(struct filter_s *fs, int line_end,
+								int height_in, int height_out)
+{
+	struct resize_data *data = fs->data;
+	int lines = 0;
+
+	(void)height_out;
+
+	if (!data->fmt) {
+		return height_in;
+	}
+
+	for (size_t c=0; c<data->fmt->num_comps; c++) {
+		const struct resize_comp *cp = &data->fmt->comps[c];
+		size_t end = ((size_t)line_end + (1 << cp->ysub) - 1) >> cp->ysub;
+		int n = vlib_resize_src_lines(data->rs[fs->mode][c], end) << cp->ysub;
+
+		if (n > lines) {
+			lines = n;
+		}
+	}
+
+	return data->crop_y + lines;
+}
+
+static struct filter_ops resize_ops = {
+	.init = resize_init,
+	.func = resize_func,
+	.func_lines = resize_func_lines,
+	.lines_required = resize_lines_required,
+};
+
+static const struct filter_s resize_fs = {
+	.display_text = "Resize",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = 0,
+	.ops = &resize_ops,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(resize_modes),
+	.modes = resize_modes,
+};
+
+/**
+ * vlib_resize_filter_create - Create a resize pipeline stage
+ *
+ * The stage accepts any input and output size, so that the capture
+ * resolution can differ from the display plane.
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_resize_filter_create(void)
+{
+	struct filter_s *fs;
+	struct resize_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	*fs = resize_fs;
+	fs->data = data;
+
+	return fs;
+}
+
+/**
+ * vlib_resize_filter_set_crop - Scale a region of the input only
+ * @fs: Stage created by vlib_resize_filter_create()
+ * @x: Left edge of the region
+ * @y: Top edge of the region
+ * @width: Width of the region, 0 for the whole input
+ * @height: Height of the region, 0 for the whole input
+ *
+ * The region takes effect with the next init, which fails if it does not
+ * fit the input or is not aligned to the chroma subsampling.
+ */
+void vlib_resize_filter_set_crop(struct filter_s *fs, size_t x, size_t y,
+								size_t width, size_t height)
+{
+	struct resize_data *data = fs->data;
+
+	resize_free_buffers(data);
+	data->crop_x = x;
+	data->crop_y = y;
+	data->crop_width = width;
+	data->crop_height = height;
+}
+
+/**
+ * vlib_resize_filter_destroy - Free a resize pipeline stage
+ * @fs: Stage created by vlib_resize_filter_create()
+ */
+void vlib_resize_filter_destroy(struct filter_s *fs)
+{
+	if (!fs) {
+		return;
+	}
+
+	resize_free_buffers(fs->data);
+	free(fs->data);
+	free(fs);
+}
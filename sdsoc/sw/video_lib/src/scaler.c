@@ -0,0 +1,224 @@
+#include <stdlib.h>
+
+#include "filter.h"
+#include "filter_graph.h"
+#include "helper.h"
+#include "resize.h"
+#include "scaler.h"
+#include "video_int.h"
+
+/*
+ * A registered filter run at another size than the pipeline. The graph
+ * takes the place of the filter in the pipeline, so the filter itself is
+ * its stage and keeps its mode.
+ */
+struct scaler_stage {
+	struct filter_s *fs;
+	struct filter_s *graph;
+	struct filter_s *resize;
+};
+
+struct vlib_scaler {
+	struct filter_init_data fid;
+	struct vlib_crop crop;
+	struct filter_s *direct;	/* pass through, NULL if not supported */
+	GPtrArray *stages;
+};
+
+static void scaler_stage_free(gpointer data)
+{
+	struct scaler_stage *st = data;
+
+	filter_graph_destroy(st->graph);
+	vlib_resize_filter_destroy(st->resize);
+	free(st);
+}
+
+static struct filter_s *scaler_resize_create(const struct vlib_scaler *sc)
+{
+	struct filter_s *fs = vlib_resize_filter_create();
+
+	if (fs) {
+		vlib_resize_filter_set_crop(fs, sc->crop.xoffs, sc->crop.yoffs,
+									sc->crop.width, sc->crop.height);
+	}
+
+	return fs;
+}
+
+/* filter @fs behind (@pre) or in front of a resize stage */
+static int scaler_stage_init(const struct vlib_scaler *sc,
+							struct scaler_stage *st, int pre)
+{
+	const struct filter_init_data *fid = &sc->fid;
+	int ret;
+
+	st->graph = filter_graph_create(filter_type_get_display_text(st->fs));
+	st->resize = scaler_resize_create(sc);
+	if (!st->graph || !st->resize) {
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	if (pre) {
+		ret = filter_graph_add_stage(st->graph, st->resize, fid->in_fourcc,
+									fid->out_width, fid->out_height);
+		ret = ret ? ret : filter_graph_add_stage(st->graph, st->fs, 0, 0, 0);
+	} else {
+		ret = filter_graph_add_stage(st->graph, st->fs, fid->out_fourcc,
+									fid->in_width, fid->in_height);
+		ret = ret ? ret : filter_graph_add_stage(st->graph, st->resize,
+												0, 0, 0);
+	}
+	if (ret) {
+		return ret;
+	}
+
+	if (st->graph->ops->init(st->graph, fid)) {
+		return VLIB_ERROR_NOT_SUPPORTED;
+	}
+
+	return VLIB_SUCCESS;
+}
+
+/**
+ * vlib_scaler_create - Create the scaler of a pipeline
+ * @fid: Capture and display geometry of the pipeline
+ * @crop: Region of the capture to display, NULL for all of it
+ *
+ * Return: Pointer to the scaler on success, NULL otherwise.
+ */
+struct vlib_scaler *vlib_scaler_create(const struct filter_init_data *fid,
+										const struct vlib_crop *crop)
+{
+	struct vlib_scaler *sc = calloc(1, sizeof(*sc));
+	if (!sc) {
+		return NULL;
+	}
+
+	sc->fid = *fid;
+	if (crop && crop->width && crop->height) {
+		sc->crop = *crop;
+	}
+	sc->stages = g_ptr_array_new_with_free_func(scaler_stage_free);
+
+	sc->direct = scaler_resize_create(sc);
+	if (sc->direct && sc->direct->ops->init(sc->direct, fid)) {
+		vlib_warn("scaler: no pass through for %zux%zu '%.4s' -> %zux%zu '%.4s'\n",
+				fid->in_width, fid->in_height, (const char *)&fid->in_fourcc,
+				fid->out_width, fid->out_height,
+				(const char *)&fid->out_fourcc);
+		vlib_resize_filter_destroy(sc->direct);
+		sc->direct = NULL;
+	}
+
+	return sc;
+}
+
+/**
+ * vlib_scaler_destroy - Free a scaler and the filter graphs it created
+ * @sc: Scaler created by vlib_scaler_create()
+ *
+ * The registered filters are owned by the caller and not freed.
+ */
+void vlib_scaler_destroy(struct vlib_scaler *sc)
+{
+	if (!sc) {
+		return;
+	}
+
+	g_ptr_array_free(sc->stages, TRUE);
+	vlib_resize_filter_destroy(sc->direct);
+	free(sc);
+}
+
+/**
+ * vlib_scaler_add_filter - Run a filter through the scaler
+ * @sc: Scaler
+ * @fs: Registered filter which does not support the pipeline geometry
+ *
+ * Filters run at the smaller of the crop region and display sizes if they
+ * support it, at the other size otherwise. Two input filters are always
+ * scaled behind, as they have to be the first stage of a filter graph.
+ * From then on the pipeline runs the graph returned by
+ * vlib_scaler_get_filter() in place of @fs.
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_scaler_add_filter(struct vlib_scaler *sc, struct filter_s *fs)
+{
+	const struct filter_init_data *fid;
+	struct scaler_stage *st;
+	size_t src_pixels;
+	int pre;
+	int ret;
+
+	if (!sc || !fs) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	fid = &sc->fid;
+	src_pixels = sc->crop.width ? sc->crop.width * sc->crop.height :
+				fid->in_width * fid->in_height;
+	pre = !fs->ops->func2 && fid->out_width * fid->out_height <= src_pixels;
+
+	for (int i=0; i<2; i++, pre=!pre) {
+		if (pre && fs->ops->func2) {
+			continue;
+		}
+
+		st = calloc(1, sizeof(*st));
+		if (!st) {
+			return VLIB_ERROR_NO_MEM;
+		}
+
+		st->fs = fs;
+		ret = scaler_stage_init(sc, st, pre);
+		if (!ret) {
+			g_ptr_array_add(sc->stages, st);
+			vlib_dbg("scaler: '%s' %s resize\n",
+					filter_type_get_display_text(fs),
+					pre ? "behind" : "in front of");
+			return VLIB_SUCCESS;
+		}
+
+		scaler_stage_free(st);
+	}
+
+	VLIB_REPORT_ERR("scaler: '%s' does not support %zux%zu or %zux%zu",
+					filter_type_get_display_text(fs), fid->in_width,
+					fid->in_height, fid->out_width, fid->out_height);
+	vlib_dbg("%s\n", vlib_errstr);
+
+	return VLIB_ERROR_NOT_SUPPORTED;
+}
+
+/**
+ * vlib_scaler_get_filter - Stage to run in place of a filter
+ * @sc: Scaler
+ * @fs: Registered filter, NULL for pass through
+ *
+ * Return: The filter graph of @fs, @fs itself if it was not added to the
+ * scaler or @sc is NULL, or for pass through the resize stage, which is
+ * NULL if not supported.
+ */
+struct filter_s *vlib_scaler_get_filter(const struct vlib_scaler *sc,
+										struct filter_s *fs)
+{
+	if (!sc) {
+		return fs;
+	}
+
+	if (!fs) {
+		return sc->direct;
+	}
+
+	for (size_t i=0; i<sc->stages->len; i++) {
+		struct scaler_stage *st = g_ptr_array_index(sc->stages, i);
+
+		if (st->fs == fs) {
+			return st->graph;
+		}
+	}
+
+	return fs;
+}
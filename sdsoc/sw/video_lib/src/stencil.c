@@ -0,0 +1,799 @@
+#include <drm/drm_fourcc.h>
+#include <linux/videodev2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+#include "helper.h"
+#include "simd.h"
+#include "stencil.h"
+#include "video_int.h"
+
+/* replicated border columns on each side of a ring line */
+#define STENCIL_PAD			16
+/* L2 budget for the rings of all stages */
+#define STENCIL_STRIP_BYTES	(256 * 1024)
+#define STENCIL_STRIP_MIN	8
+
+struct stencil_ring {
+	uint8_t *buf;
+	size_t rows;
+};
+
+struct vlib_stencil_chain {
+	size_t width;
+	size_t height;
+	size_t pitch;
+	size_t num_stages;
+	struct vlib_stencil_stage stages[VLIB_STENCIL_MAX_STAGES];
+	unsigned int radius[VLIB_STENCIL_MAX_STAGES];
+	size_t halo;
+	size_t strip_lines;
+	/* level 0 holds source lines, level i+1 the output of stage i */
+	struct stencil_ring ring[VLIB_STENCIL_MAX_STAGES + 1];
+	size_t done[VLIB_STENCIL_MAX_STAGES + 1];
+	/* scratch line for the vertical pass of separable kernels */
+	uint16_t *tmp;
+};
+
+static inline uint8_t *stencil_line(const struct vlib_stencil_chain *sc,
+									size_t level, size_t y)
+{
+	const struct stencil_ring *r = &sc->ring[level];
+
+	return r->buf + (y % r->rows) * sc->pitch + STENCIL_PAD;
+}
+
+static inline void stencil_pad(uint8_t *line, size_t width)
+{
+	memset(line - STENCIL_PAD, line[0], STENCIL_PAD);
+	memset(line + width, line[width - 1], STENCIL_PAD);
+}
+
+static inline v_u16 v_lo_u16(v_u8 a)
+{
+	return v_reinterpret_u16_s16(v_expand_lo_u8(a));
+}
+
+static inline v_u16 v_hi_u16(v_u8 a)
+{
+	return v_reinterpret_u16_s16(v_expand_hi_u8(a));
+}
+
+/*
+ * The kernels below walk [0, n) in blocks of 16 pixels. Instead of a scalar
+ * tail the last block is moved back to end at n, which recomputes a few
+ * pixels but keeps every kernel a single vector loop. Requires n >= 16.
+ */
+
+static void stencil_gaussian(struct vlib_stencil_chain *sc,
+							const uint8_t *const *rows, uint8_t *dst,
+							unsigned int ksize)
+{
+	int r = ksize / 2;
+	size_t n = sc->width + 2 * r;
+	uint16_t *t = sc->tmp + STENCIL_PAD;
+	uint16_t *tv = t - r;
+
+	/* vertical pass, including r columns of border on each side */
+	for (size_t x=0; x<n; x+=16) {
+		v_u16 lo, hi;
+
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		if (ksize == 3) {
+			v_u8 a = v_load_u8(rows[0] - r + x);
+			v_u8 b = v_load_u8(rows[1] - r + x);
+			v_u8 c = v_load_u8(rows[2] - r + x);
+
+			lo = v_add_u16(v_add_u16(v_lo_u16(a), v_lo_u16(c)),
+						v_add_u16(v_lo_u16(b), v_lo_u16(b)));
+			hi = v_add_u16(v_add_u16(v_hi_u16(a), v_hi_u16(c)),
+						v_add_u16(v_hi_u16(b), v_hi_u16(b)));
+		} else {
+			const v_u16 c4 = v_setall_u16(4);
+			const v_u16 c6 = v_setall_u16(6);
+			v_u8 a = v_load_u8(rows[0] - r + x);
+			v_u8 b = v_load_u8(rows[1] - r + x);
+			v_u8 c = v_load_u8(rows[2] - r + x);
+			v_u8 d = v_load_u8(rows[3] - r + x);
+			v_u8 e = v_load_u8(rows[4] - r + x);
+
+			lo = v_add_u16(v_add_u16(v_lo_u16(a), v_lo_u16(e)),
+						v_add_u16(v_mul_u16(v_add_u16(v_lo_u16(b), v_lo_u16(d)), c4),
+								v_mul_u16(v_lo_u16(c), c6)));
+			hi = v_add_u16(v_add_u16(v_hi_u16(a), v_hi_u16(e)),
+						v_add_u16(v_mul_u16(v_add_u16(v_hi_u16(b), v_hi_u16(d)), c4),
+								v_mul_u16(v_hi_u16(c), c6)));
+		}
+
+		v_store_u16(tv + x, lo);
+		v_store_u16(tv + x + 8, hi);
+	}
+
+	/* horizontal pass */
+	n = sc->width;
+	for (size_t x=0; x<n; x+=16) {
+		v_u16 s[2];
+
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		for (int i=0; i<2; i++) {
+			const uint16_t *p = t + x + 8 * i;
+
+			if (ksize == 3) {
+				v_u16 c = v_load_u16(p);
+
+				s[i] = v_add_u16(v_add_u16(v_load_u16(p - 1), v_load_u16(p + 1)),
+								v_add_u16(c, c));
+				s[i] = v_shr_u16(v_add_u16(s[i], v_setall_u16(8)), 4);
+			} else {
+				s[i] = v_add_u16(v_add_u16(v_load_u16(p - 2), v_load_u16(p + 2)),
+								v_add_u16(v_mul_u16(v_add_u16(v_load_u16(p - 1),
+															v_load_u16(p + 1)),
+													v_setall_u16(4)),
+										v_mul_u16(v_load_u16(p), v_setall_u16(6))));
+				s[i] = v_shr_u16(v_add_u16(s[i], v_setall_u16(128)), 8);
+			}
+		}
+
+		v_store_u8(dst + x, v_pack_u16(s[0], s[1]));
+	}
+}
+
+static void stencil_sobel(struct vlib_stencil_chain *sc,
+						const uint8_t *const *rows, uint8_t *dst)
+{
+	size_t n = sc->width + 2;
+	int16_t *s = (int16_t *)sc->tmp + STENCIL_PAD;
+	int16_t *d = s + sc->pitch;
+
+	/* vertical smoothing and difference */
+	for (size_t x=0; x<n; x+=16) {
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		v_u8 a = v_load_u8(rows[0] - 1 + x);
+		v_u8 b = v_load_u8(rows[1] - 1 + x);
+		v_u8 c = v_load_u8(rows[2] - 1 + x);
+		v_s16 al = v_expand_lo_u8(a), ah = v_expand_hi_u8(a);
+		v_s16 bl = v_expand_lo_u8(b), bh = v_expand_hi_u8(b);
+		v_s16 cl = v_expand_lo_u8(c), ch = v_expand_hi_u8(c);
+
+		v_store_s16(s - 1 + x, v_add_s16(v_add_s16(al, cl), v_add_s16(bl, bl)));
+		v_store_s16(s - 1 + x + 8, v_add_s16(v_add_s16(ah, ch), v_add_s16(bh, bh)));
+		v_store_s16(d - 1 + x, v_sub_s16(cl, al));
+		v_store_s16(d - 1 + x + 8, v_sub_s16(ch, ah));
+	}
+
+	/* |dx| + |dy| */
+	n = sc->width;
+	for (size_t x=0; x<n; x+=16) {
+		v_s16 g[2];
+
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		for (int i=0; i<2; i++) {
+			const int16_t *ps = s + x + 8 * i;
+			const int16_t *pd = d + x + 8 * i;
+			v_s16 c = v_load_s16(pd);
+			v_s16 gx = v_sub_s16(v_load_s16(ps + 1), v_load_s16(ps - 1));
+			v_s16 gy = v_add_s16(v_add_s16(v_load_s16(pd - 1), v_load_s16(pd + 1)),
+								v_add_s16(c, c));
+
+			g[i] = v_add_s16(v_abs_s16(gx), v_abs_s16(gy));
+		}
+
+		v_store_u8(dst + x, v_packus_s16(g[0], g[1]));
+	}
+}
+
+static void stencil_morph(struct vlib_stencil_chain *sc,
+						const uint8_t *const *rows, uint8_t *dst,
+						unsigned int ksize, int dilate)
+{
+	int r = ksize / 2;
+	size_t n = sc->width + 2 * r;
+	uint8_t *m = (uint8_t *)sc->tmp + STENCIL_PAD;
+
+	/* separable rectangle: vertical extremum, then horizontal */
+	for (size_t x=0; x<n; x+=16) {
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		v_u8 a = v_load_u8(rows[0] - r + x);
+		for (unsigned int k=1; k<ksize; k++) {
+			v_u8 b = v_load_u8(rows[k] - r + x);
+			a = dilate ? v_max_u8(a, b) : v_min_u8(a, b);
+		}
+		v_store_u8(m - r + x, a);
+	}
+
+	n = sc->width;
+	for (size_t x=0; x<n; x+=16) {
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		v_u8 a = v_load_u8(m + x - r);
+		for (int k=1-r; k<=r; k++) {
+			v_u8 b = v_load_u8(m + x + k);
+			a = dilate ? v_max_u8(a, b) : v_min_u8(a, b);
+		}
+		v_store_u8(dst + x, a);
+	}
+}
+
+#define V_SORT(a, b) \
+	do { v_u8 t_ = v_min_u8(a, b); b = v_max_u8(a, b); a = t_; } while (0)
+
+static void stencil_median3(struct vlib_stencil_chain *sc,
+							const uint8_t *const *rows, uint8_t *dst)
+{
+	size_t n = sc->width;
+
+	for (size_t x=0; x<n; x+=16) {
+		v_u8 p0, p1, p2, p3, p4, p5, p6, p7, p8;
+
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		p0 = v_load_u8(rows[0] + x - 1);
+		p1 = v_load_u8(rows[0] + x);
+		p2 = v_load_u8(rows[0] + x + 1);
+		p3 = v_load_u8(rows[1] + x - 1);
+		p4 = v_load_u8(rows[1] + x);
+		p5 = v_load_u8(rows[1] + x + 1);
+		p6 = v_load_u8(rows[2] + x - 1);
+		p7 = v_load_u8(rows[2] + x);
+		p8 = v_load_u8(rows[2] + x + 1);
+
+		/* 19 exchange median network */
+		V_SORT(p1, p2); V_SORT(p4, p5); V_SORT(p7, p8);
+		V_SORT(p0, p1); V_SORT(p3, p4); V_SORT(p6, p7);
+		V_SORT(p1, p2); V_SORT(p4, p5); V_SORT(p7, p8);
+		V_SORT(p0, p3); V_SORT(p5, p8); V_SORT(p4, p7);
+		V_SORT(p3, p6); V_SORT(p1, p4); V_SORT(p2, p5);
+		V_SORT(p4, p7); V_SORT(p4, p2); V_SORT(p6, p4);
+		V_SORT(p4, p2);
+
+		v_store_u8(dst + x, p4);
+	}
+}
+
+static void stencil_run_stage(struct vlib_stencil_chain *sc, size_t i, size_t y)
+{
+	const struct vlib_stencil_stage *st = &sc->stages[i];
+	int r = sc->radius[i];
+	const uint8_t *rows[5];
+	uint8_t *dst = stencil_line(sc, i + 1, y);
+
+	for (int k=-r; k<=r; k++) {
+		ptrdiff_t yy = (ptrdiff_t)y + k;
+
+		if (yy < 0) {
+			yy = 0;
+		} else if (yy >= (ptrdiff_t)sc->height) {
+			yy = sc->height - 1;
+		}
+		rows[k + r] = stencil_line(sc, i, yy);
+	}
+
+	switch (st->op) {
+		case VLIB_STENCIL_GAUSSIAN:
+			stencil_gaussian(sc, rows, dst, st->ksize);
+			break;
+		case VLIB_STENCIL_SOBEL:
+			stencil_sobel(sc, rows, dst);
+			break;
+		case VLIB_STENCIL_ERODE:
+			stencil_morph(sc, rows, dst, st->ksize, 0);
+			break;
+		case VLIB_STENCIL_DILATE:
+			stencil_morph(sc, rows, dst, st->ksize, 1);
+			break;
+		case VLIB_STENCIL_MEDIAN:
+			stencil_median3(sc, rows, dst);
+			break;
+	}
+
+	stencil_pad(dst, sc->width);
+}
+
+/* luma byte offset of packed 4:2:2 formats, -1 for planar luma */
+static int stencil_luma_offset(uint32_t fourcc)
+{
+	switch (fourcc) {
+		case V4L2_PIX_FMT_YUYV:
+			return 0;
+		case V4L2_PIX_FMT_UYVY:
+			return 1;
+		case V4L2_PIX_FMT_GREY:
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+		case V4L2_PIX_FMT_YUV420:
+		case V4L2_PIX_FMT_YVU420:
+			return -1;
+		default:
+			return -2;
+	}
+}
+
+static void stencil_load(struct vlib_stencil_chain *sc,
+						const struct vlib_image *src, int yoff, size_t y)
+{
+	uint8_t *d = stencil_line(sc, 0, y);
+	const uint8_t *s = vlib_image_line(src, 0, y);
+	size_t n = sc->width;
+
+	if (yoff < 0) {
+		memcpy(d, s, n);
+	} else {
+		for (size_t x=0; x<n; x+=16) {
+			v_u8 e, o;
+
+			if (x + 16 > n) {
+				x = n - 16;
+			}
+
+			v_load_deinterleave2_u8(s + 2 * x, &e, &o);
+			v_store_u8(d + x, yoff ? o : e);
+		}
+	}
+
+	stencil_pad(d, n);
+}
+
+static void stencil_store(struct vlib_stencil_chain *sc,
+						const struct vlib_image *src, struct vlib_image *dst,
+						int yoff, size_t y)
+{
+	const uint8_t *l = stencil_line(sc, sc->num_stages, y);
+	uint8_t *d = vlib_image_line(dst, 0, y);
+	const uint8_t *s = vlib_image_line(src, 0, y);
+	size_t n = sc->width;
+
+	if (yoff < 0) {
+		memcpy(d, l, n);
+		return;
+	}
+
+	/* merge filtered luma with the source chroma */
+	for (size_t x=0; x<n; x+=16) {
+		v_u8 e, o, luma;
+
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		v_load_deinterleave2_u8(s + 2 * x, &e, &o);
+		luma = v_load_u8(l + x);
+		if (yoff) {
+			v_store_interleave2_u8(d + 2 * x, e, luma);
+		} else {
+			v_store_interleave2_u8(d + 2 * x, luma, o);
+		}
+	}
+}
+
+static void stencil_copy_chroma(const struct vlib_image *src,
+								struct vlib_image *dst,
+								size_t line_start, size_t line_end)
+{
+	size_t bytes;
+
+	switch (src->fourcc) {
+		case V4L2_PIX_FMT_NV12:
+		case V4L2_PIX_FMT_NV21:
+			bytes = src->width;
+			break;
+		case V4L2_PIX_FMT_YUV420:
+		case V4L2_PIX_FMT_YVU420:
+			bytes = src->width / 2;
+			break;
+		default:
+			return;
+	}
+
+	for (size_t p=1; p<src->num_planes; p++) {
+		for (size_t y=(line_start+1)/2; y<(line_end+1)/2; y++) {
+			memcpy(vlib_image_line(dst, p, y), vlib_image_line(src, p, y),
+					bytes);
+		}
+	}
+}
+
+static size_t stencil_calc_strip(const struct vlib_stencil_chain *sc,
+								size_t strip_lines)
+{
+	size_t lines = strip_lines;
+
+	if (!lines) {
+		lines = STENCIL_STRIP_BYTES / (sc->pitch * (sc->num_stages + 1));
+		lines = lines > sc->halo + STENCIL_STRIP_MIN ?
+				lines - sc->halo : STENCIL_STRIP_MIN;
+		lines = (lines + 1) & ~1;
+	}
+
+	return lines < sc->height ? lines : sc->height;
+}
+
+/**
+ * vlib_stencil_chain_create - Create a chain of stencil stages
+ * @stages: Stage descriptions
+ * @num_stages: Number of entries in @stages
+ * @width: Frame width, at least 16
+ * @height: Frame height
+ * @strip_lines: Output lines per strip, 0 to derive from the L2 budget,
+ *               @height or more for stage by stage execution
+ *
+ * Return: Pointer to the chain on success, NULL otherwise.
+ */
+struct vlib_stencil_chain *vlib_stencil_chain_create(
+				const struct vlib_stencil_stage *stages, size_t num_stages,
+				size_t width, size_t height, size_t strip_lines)
+{
+	struct vlib_stencil_chain *sc;
+
+	if (!stages || !num_stages || num_stages > VLIB_STENCIL_MAX_STAGES ||
+		width < 16 || !height) {
+		VLIB_REPORT_ERR("invalid stencil chain");
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	sc = calloc(1, sizeof(*sc));
+	if (!sc) {
+		return NULL;
+	}
+
+	sc->width = width;
+	sc->height = height;
+	sc->pitch = (width + 2 * STENCIL_PAD + 15) & ~15;
+	sc->num_stages = num_stages;
+
+	for (size_t i=0; i<num_stages; i++) {
+		const struct vlib_stencil_stage *st = &stages[i];
+		int valid;
+
+		switch (st->op) {
+			case VLIB_STENCIL_GAUSSIAN:
+			case VLIB_STENCIL_ERODE:
+			case VLIB_STENCIL_DILATE:
+				valid = st->ksize == 3 || st->ksize == 5;
+				break;
+			case VLIB_STENCIL_SOBEL:
+			case VLIB_STENCIL_MEDIAN:
+				valid = st->ksize == 3;
+				break;
+			default:
+				valid = 0;
+				break;
+		}
+
+		if (!valid) {
+			VLIB_REPORT_ERR("stencil stage %zu: unsupported kernel size %u",
+							i, st->ksize);
+			vlib_dbg("%s\n", vlib_errstr);
+			goto err;
+		}
+
+		sc->stages[i] = *st;
+		sc->radius[i] = st->ksize / 2;
+		sc->halo += sc->radius[i];
+	}
+
+	sc->strip_lines = stencil_calc_strip(sc, strip_lines);
+
+	/*
+	 * A ring has to hold the lines its consumer reads in one strip plus
+	 * the lines written ahead for it, the output ring only the current line.
+	 */
+	for (size_t l=0; l<=num_stages; l++) {
+		struct stencil_ring *r = &sc->ring[l];
+
+		if (l == num_stages) {
+			r->rows = 1;
+		} else {
+			r->rows = sc->strip_lines + sc->halo + 2 * sc->radius[l] + 1;
+			if (r->rows > height) {
+				r->rows = height;
+			}
+		}
+
+		r->buf = malloc(r->rows * sc->pitch);
+		if (!r->buf) {
+			goto err;
+		}
+	}
+
+	sc->tmp = malloc(2 * sc->pitch * sizeof(*sc->tmp));
+	if (!sc->tmp) {
+		goto err;
+	}
+
+	return sc;
+
+err:
+	vlib_stencil_chain_destroy(sc);
+	return NULL;
+}
+
+void vlib_stencil_chain_destroy(struct vlib_stencil_chain *sc)
+{
+	if (!sc) {
+		return;
+	}
+
+	for (size_t l=0; l<=sc->num_stages; l++) {
+		free(sc->ring[l].buf);
+	}
+	free(sc->tmp);
+	free(sc);
+}
+
+size_t vlib_stencil_chain_get_strip_lines(const struct vlib_stencil_chain *sc)
+{
+	return sc->strip_lines;
+}
+
+/**
+ * vlib_stencil_chain_get_halo - Get the number of lines the chain looks ahead
+ * @sc: Stencil chain
+ *
+ * Return: Source lines beyond an output line needed to compute it.
+ */
+size_t vlib_stencil_chain_get_halo(const struct vlib_stencil_chain *sc)
+{
+	return sc->halo;
+}
+
+/**
+ * vlib_stencil_chain_run_lines - Produce a range of output lines
+ * @sc: Stencil chain
+ * @src: Source image
+ * @dst: Destination image, same format and size as @src
+ * @line_start: First output line, 0 or the end of the previous call
+ * @line_end: Last output line (exclusive)
+ *
+ * Source lines up to @line_end plus the chain halo have to be valid.
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_stencil_chain_run_lines(struct vlib_stencil_chain *sc,
+				const struct vlib_image *src, struct vlib_image *dst,
+				size_t line_start, size_t line_end)
+{
+	size_t need[VLIB_STENCIL_MAX_STAGES + 1];
+	size_t n = sc->num_stages;
+	int yoff;
+
+	if (!src || !dst || src->fourcc != dst->fourcc ||
+		src->width != sc->width || src->height != sc->height ||
+		dst->width != sc->width || dst->height != sc->height ||
+		line_end > sc->height) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	yoff = stencil_luma_offset(src->fourcc);
+	if (yoff < -1) {
+		VLIB_REPORT_ERR("stencil: unsupported pixel format '%.4s'",
+						(const char *)&src->fourcc);
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_NOT_SUPPORTED;
+	}
+
+	if (!line_start) {
+		memset(sc->done, 0, sizeof(sc->done));
+	} else if (line_start != sc->done[n]) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	for (size_t s=line_start; s<line_end; ) {
+		size_t e = s + sc->strip_lines < line_end ?
+					s + sc->strip_lines : line_end;
+
+		/* lines every level has to provide for this strip */
+		need[n] = e;
+		for (size_t l=n; l-->0; ) {
+			need[l] = need[l + 1] + sc->radius[l];
+			if (need[l] > sc->height) {
+				need[l] = sc->height;
+			}
+		}
+
+		for (size_t y=sc->done[0]; y<need[0]; y++) {
+			stencil_load(sc, src, yoff, y);
+		}
+		sc->done[0] = need[0] > sc->done[0] ? need[0] : sc->done[0];
+
+		for (size_t l=1; l<=n; l++) {
+			for (size_t y=sc->done[l]; y<need[l]; y++) {
+				stencil_run_stage(sc, l - 1, y);
+				if (l == n) {
+					stencil_store(sc, src, dst, yoff, y);
+				}
+			}
+			sc->done[l] = need[l] > sc->done[l] ? need[l] : sc->done[l];
+		}
+
+		s = e;
+	}
+
+	stencil_copy_chroma(src, dst, line_start, line_end);
+
+	return VLIB_SUCCESS;
+}
+
+/**
+ * vlib_stencil_chain_run - Run a stencil chain on a whole frame
+ * @sc: Stencil chain
+ * @src: Source image
+ * @dst: Destination image, same format and size as @src
+ *
+ * Return: 0 on success, error code otherwise.
+ */
+int vlib_stencil_chain_run(struct vlib_stencil_chain *sc,
+				const struct vlib_image *src, struct vlib_image *dst)
+{
+	return vlib_stencil_chain_run_lines(sc, src, dst, 0, sc->height);
+}
+
+/* Pipeline stage */
+
+enum stencil_filter_mode {
+	STENCIL_FILTER_MODE_FUSED,
+	STENCIL_FILTER_MODE_FRAME,
+};
+
+struct stencil_filter_data {
+	struct vlib_stencil_stage stages[VLIB_STENCIL_MAX_STAGES];
+	size_t num_stages;
+	uint32_t fourcc;
+	struct vlib_stencil_chain *chain[2];
+};
+
+static const char *stencil_filter_modes[] = {
+	"Fused",
+	"Frame",
+};
+
+static int stencil_filter_init(struct filter_s *fs,
+							const struct filter_init_data *fid)
+{
+	struct stencil_filter_data *data = fs->data;
+
+	if (fid->in_fourcc != fid->out_fourcc ||
+		fid->in_width != fid->out_width ||
+		fid->in_height != fid->out_height ||
+		stencil_luma_offset(fid->in_fourcc) < -1) {
+		return -1;
+	}
+
+	for (int i=0; i<2; i++) {
+		vlib_stencil_chain_destroy(data->chain[i]);
+		data->chain[i] = vlib_stencil_chain_create(data->stages,
+						data->num_stages, fid->in_width, fid->in_height,
+						i == STENCIL_FILTER_MODE_FUSED ? 0 : fid->in_height);
+		if (!data->chain[i]) {
+			return -1;
+		}
+	}
+
+	data->fourcc = fid->in_fourcc;
+
+	return 0;
+}
+
+static void stencil_filter_func_lines(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out,
+						int line_start, int line_end)
+{
+	struct stencil_filter_data *data = fs->data;
+	struct vlib_image src, dst;
+
+	if (vlib_image_init(&src, data->fourcc, width_in, height_in, stride_in,
+						frm_data_in) ||
+		vlib_image_init(&dst, data->fourcc, width_out, height_out,
+						stride_out, frm_data_out)) {
+		return;
+	}
+
+	if (vlib_stencil_chain_run_lines(data->chain[fs->mode], &src, &dst,
+									line_start, line_end)) {
+		vlib_warn("%s: stencil chain failed\n", fs->display_text);
+	}
+}
+
+static void stencil_filter_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	stencil_filter_func_lines(fs, frm_data_in, frm_data_out, height_in,
+							width_in, stride_in, height_out, width_out,
+							stride_out, 0, height_out);
+}
+
+static int stencil_filter_lines_required(struct filter_s *fs, int line_end,
+										int height_in, int height_out)
+{
+	struct stencil_filter_data *data = fs->data;
+	int lines = line_end + vlib_stencil_chain_get_halo(data->chain[0]);
+
+	(void)height_out;
+
+	return lines < height_in ? lines : height_in;
+}
+
+static struct filter_ops stencil_filter_ops = {
+	.init = stencil_filter_init,
+	.func = stencil_filter_func,
+	.func_lines = stencil_filter_func_lines,
+	.lines_required = stencil_filter_lines_required,
+};
+
+static const struct filter_s stencil_filter_fs = {
+	.display_text = "Stencil Chain",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = STENCIL_FILTER_MODE_FUSED,
+	.ops = &stencil_filter_ops,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(stencil_filter_modes),
+	.modes = stencil_filter_modes,
+};
+
+/**
+ * vlib_stencil_filter_create - Create a pipeline stage running a stencil chain
+ * @display_text: Name shown in the filter list, NULL for a default
+ * @stages: Stage descriptions, copied
+ * @num_stages: Number of entries in @stages
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_stencil_filter_create(const char *display_text,
+				const struct vlib_stencil_stage *stages, size_t num_stages)
+{
+	struct filter_s *fs;
+	struct stencil_filter_data *data;
+
+	if (!stages || !num_stages || num_stages > VLIB_STENCIL_MAX_STAGES) {
+		return NULL;
+	}
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		return NULL;
+	}
+
+	data = calloc(1, sizeof(*data));
+	if (!data) {
+		free(fs);
+		return NULL;
+	}
+
+	memcpy(data->stages, stages, num_stages * sizeof(*stages));
+	data->num_stages = num_stages;
+
+	*fs = stencil_filter_fs;
+	if (display_text) {
+		fs->display_text = display_text;
+	}
+	fs->data = data;
+
+	return fs;
+}
@@ -0,0 +1,534 @@
+#include <drm/drm_fourcc.h>
+#include <errno.h>
+#include <linux/videodev2.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cvt_color.h"
+#include "filter.h"
+#include "helper.h"
+#include "image.h"
+#include "parallel.h"
+#include "remap.h"
+#include "stereo.h"
+#include "video_int.h"
+
+/* rows per band boundary of the parallel passes, even for 4:2:0 formats */
+#define STEREO_GRAIN		16
+
+struct stereo_data {
+	struct vlib_stereo_cam_params cam;
+	int rectify;				/* camera parameters loaded */
+	struct vlib_stereo_bm_params bm_params;
+	struct vlib_stereo_bm *bm;
+	uint32_t in_fourcc;
+	uint32_t out_fourcc;
+	size_t width;				/* size of one view */
+	size_t height;
+	size_t out_width;
+	struct vlib_remap *map[2];	/* rectification maps */
+	uint8_t *luma;				/* side-by-side luma, stride 2 * width */
+	uint8_t *rect[2];			/* rectified views, stride width */
+	int16_t *disp;				/* Q4 disparity, stride width */
+	uint8_t *yuv;				/* YUV 4:4:4 output staging */
+	uint8_t lut[3][256];		/* color map in Y, U, V */
+	struct vlib_stereo_stats stats;
+};
+
+struct stereo_job {
+	struct stereo_data *data;
+	const uint8_t *src;			/* input frame or side-by-side luma */
+	size_t stride;
+	const uint8_t *left;		/* left view shown next to the disparity */
+	size_t left_stride;
+	struct vlib_image in;		/* input frame */
+	struct vlib_image staging;	/* colorized disparity */
+	struct vlib_image out;		/* output frame */
+	int ret;
+};
+
+static struct filter_ops stereo_ops;
+
+/**
+ * vlib_stereo_load_cam_params - read a stereo camera parameter file
+ * @file: path of the file
+ * @params: parameters to populate
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_stereo_load_cam_params(const char *file,
+				struct vlib_stereo_cam_params *params)
+{
+	double *arrays[] = {
+		params->camera_matrix[0], params->camera_matrix[1],
+		params->dist_coeffs[0], params->dist_coeffs[1],
+		params->ir[0], params->ir[1],
+	};
+	const size_t sizes[] = {
+		VLIB_STEREO_CAMERA_MATRIX_SIZE, VLIB_STEREO_CAMERA_MATRIX_SIZE,
+		VLIB_STEREO_DIST_COEFF_SIZE, VLIB_STEREO_DIST_COEFF_SIZE,
+		VLIB_STEREO_CAMERA_MATRIX_SIZE, VLIB_STEREO_CAMERA_MATRIX_SIZE,
+	};
+	size_t a = 0, i = 0;
+	char tok[64];
+	FILE *fp;
+	int ret = VLIB_SUCCESS;
+
+	fp = fopen(file, "r");
+	if (!fp) {
+		VLIB_REPORT_ERR("failed to open '%s': %s", file, strerror(errno));
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_FILE_IO;
+	}
+
+	while (a < ARRAY_SIZE(arrays) && fscanf(fp, " %63s", tok) == 1) {
+		char *end;
+
+		if (tok[0] == '#') {
+			int c;
+
+			do {
+				c = fgetc(fp);
+			} while (c != '\n' && c != EOF);
+			continue;
+		}
+
+		arrays[a][i] = strtod(tok, &end);
+		if (*end) {
+			VLIB_REPORT_ERR("'%s': invalid number '%s'", file, tok);
+			vlib_dbg("%s\n", vlib_errstr);
+			ret = VLIB_ERROR_INVALID_PARAM;
+			break;
+		}
+
+		if (++i == sizes[a]) {
+			a++;
+			i = 0;
+		}
+	}
+
+	if (!ret && a < ARRAY_SIZE(arrays)) {
+		VLIB_REPORT_ERR("'%s': too few camera parameters", file);
+		vlib_dbg("%s\n", vlib_errstr);
+		ret = VLIB_ERROR_INVALID_PARAM;
+	}
+
+	fclose(fp);
+
+	return ret;
+}
+
+/*
+ * Source position of rectified pixel (x, y), the computation of
+ * xFComputeUndistortCoordinates in double precision.
+ */
+static void stereo_undistort_coords(const struct vlib_stereo_cam_params *cam,
+									int view, int x, int y,
+									double *u, double *v)
+{
+	const double *cm = cam->camera_matrix[view];
+	const double *dc = cam->dist_coeffs[view];
+	const double *ir = cam->ir[view];
+	double k1 = dc[0], k2 = dc[1], p1 = dc[2], p2 = dc[3], k3 = dc[4];
+	double w = y * ir[7] + x * ir[6] + ir[8];
+	double xn = (y * ir[1] + x * ir[0] + ir[2]) / w;
+	double yn = (y * ir[4] + x * ir[3] + ir[5]) / w;
+	double x2 = xn * xn, y2 = yn * yn, xy2 = 2 * xn * yn;
+	double r2 = x2 + y2;
+	double kr = 1 + ((k3 * r2 + k2) * r2 + k1) * r2;
+
+	*u = cm[0] * (xn * kr + p1 * xy2 + p2 * (r2 + 2 * x2)) + cm[2];
+	*v = cm[4] * (yn * kr + p1 * (r2 + 2 * y2) + p2 * xy2) + cm[5];
+}
+
+static int stereo_init_map(struct stereo_data *data, int view)
+{
+	size_t w = data->width, h = data->height;
+	float *mapx = malloc(2 * w * h * sizeof(*mapx));
+	float *mapy = mapx + w * h;
+
+	if (!mapx) {
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	for (size_t y=0; y<h; y++) {
+		for (size_t x=0; x<w; x++) {
+			double u, v;
+
+			stereo_undistort_coords(&data->cam, view, x, y, &u, &v);
+			mapx[y * w + x] = u;
+			mapy[y * w + x] = v;
+		}
+	}
+
+	data->map[view] = vlib_remap_create(mapx, mapy, w * sizeof(*mapx), w, h,
+										w, h);
+	free(mapx);
+
+	return data->map[view] ? VLIB_SUCCESS : VLIB_ERROR_NO_MEM;
+}
+
+/* luma of the side-by-side input frame */
+static void stereo_luma_band(void *arg, size_t start, size_t end)
+{
+	struct stereo_job *job = arg;
+	struct stereo_data *data = job->data;
+	struct vlib_image luma;
+
+	vlib_image_init(&luma, V4L2_PIX_FMT_GREY, 2 * data->width, data->height,
+					2 * data->width, data->luma);
+	if (vlib_cvt_color_lines(&job->in, &luma, start, end)) {
+		job->ret = VLIB_ERROR_OTHER;
+	}
+}
+
+/* colorize the disparity and convert to the output format */
+static void stereo_post_band(void *arg, size_t start, size_t end)
+{
+	struct stereo_job *job = arg;
+	struct stereo_data *data = job->data;
+	const int mind = data->bm_params.min_disparity * 16;
+	const int range = (data->bm_params.num_disparities - 1) * 16;
+	size_t w = data->width, ow = data->out_width;
+	size_t plane = ow * data->height;
+	/* disparity in the right half if the left view is shown */
+	size_t dx = ow - w;
+
+	for (size_t y=start; y<end; y++) {
+		const int16_t *d = data->disp + y * w;
+		uint8_t *py = data->yuv + y * ow;
+		uint8_t *pu = py + plane;
+		uint8_t *pv = pu + plane;
+
+		if (dx) {
+			memcpy(py, job->left + y * job->left_stride, w);
+			memset(pu, 128, w);
+			memset(pv, 128, w);
+		}
+
+		for (size_t x=0; x<w; x++) {
+			int v = d[x] - mind;
+
+			if (v < 0) {
+				py[dx + x] = 16;
+				pu[dx + x] = 128;
+				pv[dx + x] = 128;
+				continue;
+			}
+
+			v = v >= range ? 255 : v * 255 / range;
+			py[dx + x] = data->lut[0][v];
+			pu[dx + x] = data->lut[1][v];
+			pv[dx + x] = data->lut[2][v];
+		}
+	}
+
+	if (vlib_cvt_color_lines(&job->staging, &job->out, start, end)) {
+		job->ret = VLIB_ERROR_OTHER;
+	}
+}
+
+/* jet color map, far is blue and near is red */
+static void stereo_init_lut(struct stereo_data *data)
+{
+	for (int i=0; i<256; i++) {
+		float t = i / 255.0f;
+		float c[3] = {
+			1.5f - fabsf(4 * t - 3),
+			1.5f - fabsf(4 * t - 2),
+			1.5f - fabsf(4 * t - 1),
+		};
+		uint8_t rgb[3], yuv[3];
+
+		for (int k=0; k<3; k++) {
+			rgb[k] = c[k] < 0 ? 0 : c[k] > 1 ? 255 : lroundf(c[k] * 255);
+		}
+
+		vlib_cvt_color_rgb2yuv(rgb[0], rgb[1], rgb[2], yuv);
+		for (int k=0; k<3; k++) {
+			data->lut[k][i] = yuv[k];
+		}
+	}
+}
+
+static void stereo_free_buffers(struct stereo_data *data)
+{
+	vlib_stereo_bm_destroy(data->bm);
+	data->bm = NULL;
+
+	for (int i=0; i<2; i++) {
+		vlib_remap_destroy(data->map[i]);
+		free(data->rect[i]);
+		data->map[i] = NULL;
+		data->rect[i] = NULL;
+	}
+
+	free(data->luma);
+	free(data->disp);
+	free(data->yuv);
+	data->luma = NULL;
+	data->disp = NULL;
+	data->yuv = NULL;
+	data->width = 0;
+	data->height = 0;
+	data->out_width = 0;
+}
+
+static int stereo_alloc_buffers(struct stereo_data *data, size_t width,
+								size_t height, size_t out_width)
+{
+	size_t n = width * height;
+
+	data->width = width;
+	data->height = height;
+	data->out_width = out_width;
+
+	data->bm = vlib_stereo_bm_create(&data->bm_params, width, height);
+	data->luma = malloc(2 * n);
+	data->disp = malloc(n * sizeof(*data->disp));
+	data->yuv = malloc(vlib_image_size(DRM_FORMAT_YUV444, height, out_width));
+	if (!data->bm || !data->luma || !data->disp || !data->yuv) {
+		return VLIB_ERROR_NO_MEM;
+	}
+
+	if (!data->rectify) {
+		return VLIB_SUCCESS;
+	}
+
+	for (int i=0; i<2; i++) {
+		data->rect[i] = malloc(n);
+		if (!data->rect[i] || stereo_init_map(data, i)) {
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	return VLIB_SUCCESS;
+}
+
+static int stereo_init(struct filter_s *fs, const struct filter_init_data *fid)
+{
+	struct stereo_data *data = fs->data;
+	size_t width = fid->in_width / 2;
+
+	if ((fid->in_width & 3) || (fid->in_height & 1) ||
+		fid->out_height != fid->in_height ||
+		(fid->out_width != width && fid->out_width != fid->in_width)) {
+		return -1;
+	}
+
+	if ((fid->in_fourcc != V4L2_PIX_FMT_GREY &&
+		 !vlib_cvt_color_supported(fid->in_fourcc, V4L2_PIX_FMT_GREY)) ||
+		!vlib_cvt_color_supported(DRM_FORMAT_YUV444, fid->out_fourcc)) {
+		return -1;
+	}
+
+	data->in_fourcc = fid->in_fourcc;
+	data->out_fourcc = fid->out_fourcc;
+
+	/* maps and buffers are kept as long as the resolution does not change */
+	if (data->width == width && data->height == fid->in_height &&
+		data->out_width == fid->out_width) {
+		return 0;
+	}
+
+	stereo_free_buffers(data);
+	if (stereo_alloc_buffers(data, width, fid->in_height, fid->out_width)) {
+		vlib_warn("stereo: failed to set up %zux%zu\n", width, fid->in_height);
+		stereo_free_buffers(data);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void stereo_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	struct stereo_data *data = fs->data;
+	struct stereo_job job = {
+		.data = data,
+		.src = frm_data_in,
+		.stride = stride_in,
+	};
+	struct vlib_stereo_bm_stats bm_stats;
+	const uint8_t *views[2];
+	size_t stride;
+	struct timespec t;
+
+	if (!data->bm || (size_t)width_in != 2 * data->width ||
+		(size_t)height_in != data->height || (size_t)width_out != data->out_width) {
+		return;
+	}
+
+	if (vlib_image_init(&job.in, data->in_fourcc, width_in, height_in,
+						stride_in, frm_data_in)) {
+		return;
+	}
+
+	/* rectify */
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	if (data->in_fourcc != V4L2_PIX_FMT_GREY) {
+		vlib_parallel_for(data->height, STEREO_GRAIN, stereo_luma_band, &job);
+		job.src = data->luma;
+		job.stride = 2 * data->width;
+	}
+	for (int view=0; view<2 && data->rectify && !job.ret; view++) {
+		job.ret = vlib_remap(data->map[view], job.src + view * data->width,
+							job.stride, data->rect[view], data->width);
+	}
+	data->stats.rectify_ms = vlib_ms_since(&t);
+	if (job.ret) {
+		return;
+	}
+
+	if (data->rectify) {
+		views[0] = data->rect[0];
+		views[1] = data->rect[1];
+		stride = data->width;
+	} else {
+		views[0] = job.src;
+		views[1] = job.src + data->width;
+		stride = job.stride;
+	}
+	job.left = views[0];
+	job.left_stride = stride;
+
+	/* prefilter and match */
+	if (vlib_stereo_bm_compute(data->bm, views[0], stride, views[1], stride,
+							data->disp, data->width * sizeof(*data->disp))) {
+		return;
+	}
+	vlib_stereo_bm_get_stats(data->bm, &bm_stats);
+	data->stats.prefilter_ms = bm_stats.prefilter_ms;
+	data->stats.match_ms = bm_stats.match_ms;
+
+	/* post-filter */
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	vlib_image_init(&job.staging, DRM_FORMAT_YUV444, data->out_width,
+					data->height, data->out_width, data->yuv);
+	if (vlib_image_init(&job.out, data->out_fourcc, width_out, height_out,
+						stride_out, frm_data_out)) {
+		return;
+	}
+	vlib_parallel_for(data->height, STEREO_GRAIN, stereo_post_band, &job);
+	data->stats.postfilter_ms = vlib_ms_since(&t);
+	data->stats.frames++;
+}
+
+static struct filter_ops stereo_ops = {
+	.init = stereo_init,
+	.func = stereo_func,
+};
+
+static const char *stereo_modes[] = {
+	"SW",
+};
+
+static const struct filter_s stereo_fs = {
+	.display_text = "Stereo",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = 0,
+	.ops = &stereo_ops,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(stereo_modes),
+	.modes = stereo_modes,
+};
+
+/**
+ * vlib_stereo_create - Create a stereo depth pipeline stage
+ * @cam_params_file: camera parameter file, NULL for rectified input
+ *
+ * The camera parameters are read once here, the rectification maps are
+ * computed by the first init for a resolution and reused afterwards.
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_stereo_create(const char *cam_params_file)
+{
+	struct filter_s *fs;
+	struct stereo_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	if (cam_params_file) {
+		if (vlib_stereo_load_cam_params(cam_params_file, &data->cam)) {
+			vlib_warn("stereo: %s\n", vlib_errstr);
+			free(data);
+			return NULL;
+		}
+		data->rectify = 1;
+	}
+
+	vlib_stereo_bm_default_params(&data->bm_params);
+	stereo_init_lut(data);
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	*fs = stereo_fs;
+	fs->data = data;
+
+	return fs;
+}
+
+/**
+ * vlib_stereo_set_bm_params - change the block matching parameters
+ * @fs: stereo filter
+ * @params: new parameters
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_stereo_set_bm_params(struct filter_s *fs,
+				const struct vlib_stereo_bm_params *params)
+{
+	struct stereo_data *data;
+	int ret = VLIB_SUCCESS;
+
+	if (!fs || fs->ops != &stereo_ops || !params) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	data = fs->data;
+	if (data->bm) {
+		ret = vlib_stereo_bm_set_params(data->bm, params);
+	}
+	if (!ret) {
+		data->bm_params = *params;
+	}
+
+	return ret;
+}
+
+/**
+ * vlib_stereo_get_stats - get the stage timing of the last frame
+ * @fs: stereo filter
+ * @stats: populated with the timing
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_stereo_get_stats(const struct filter_s *fs,
+				struct vlib_stereo_stats *stats)
+{
+	const struct stereo_data *data;
+
+	if (!fs || fs->ops != &stereo_ops || !stats) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	data = fs->data;
+	*stats = data->stats;
+
+	return VLIB_SUCCESS;
+}
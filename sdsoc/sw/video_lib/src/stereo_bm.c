@@ -0,0 +1,452 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "helper.h"
+#include "parallel.h"
+#include "simd.h"
+#include "stereo_bm.h"
+#include "video_int.h"
+
+/* rows per band boundary of the parallel passes */
+#define STEREO_BM_GRAIN		16
+
+struct vlib_stereo_bm {
+	struct vlib_stereo_bm_params p;
+	size_t width;
+	size_t height;
+	/* prefiltered left and right image, stride width */
+	uint8_t *pre[2];
+	struct vlib_stereo_bm_stats stats;
+};
+
+struct stereo_bm_job {
+	struct vlib_stereo_bm *bm;
+	const uint8_t *src[2];
+	size_t stride[2];
+	int16_t *disp;
+	size_t stride_disp;
+};
+
+static const uint16_t stereo_bm_lane[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+/*
+ * x-Sobel clipped to [-cap, cap] and offset by cap, as xFStereoPreProcess.
+ * The outermost rows and columns are set to cap.
+ */
+static void stereo_bm_prefilter_row(const uint8_t *up, const uint8_t *cur,
+									const uint8_t *dn, uint8_t *dst,
+									size_t width, int cap)
+{
+	v_s16 vcap = v_setall_s16(cap);
+	v_s16 vneg = v_setall_s16(-cap);
+	size_t n = width - 2;
+
+	for (size_t x=0; x<n; x+=16) {
+		v_s16 r[2];
+
+		if (x + 16 > n) {
+			x = n - 16;
+		}
+
+		for (int i=0; i<2; i++) {
+			size_t o = x + 8 * i;
+			v_s16 a = v_sub_s16(v_load_expand_u8(up + o + 2),
+								v_load_expand_u8(up + o));
+			v_s16 b = v_sub_s16(v_load_expand_u8(cur + o + 2),
+								v_load_expand_u8(cur + o));
+			v_s16 c = v_sub_s16(v_load_expand_u8(dn + o + 2),
+								v_load_expand_u8(dn + o));
+			v_s16 s = v_add_s16(v_add_s16(a, c), v_add_s16(b, b));
+
+			r[i] = v_add_s16(v_min_s16(v_max_s16(s, vneg), vcap), vcap);
+		}
+
+		v_store_u8(dst + 1 + x, v_packus_s16(r[0], r[1]));
+	}
+
+	dst[0] = dst[width - 1] = cap;
+}
+
+static void stereo_bm_prefilter_band(void *arg, size_t start, size_t end)
+{
+	struct stereo_bm_job *job = arg;
+	struct vlib_stereo_bm *bm = job->bm;
+	size_t w = bm->width, h = bm->height;
+	int cap = bm->p.pre_filter_cap;
+
+	for (int i=0; i<2; i++) {
+		const uint8_t *src = job->src[i];
+		size_t stride = job->stride[i];
+
+		for (size_t y=start; y<end; y++) {
+			uint8_t *dst = bm->pre[i] + y * w;
+
+			if (y == 0 || y == h - 1) {
+				memset(dst, cap, w);
+				continue;
+			}
+
+			stereo_bm_prefilter_row(src + (y - 1) * stride, src + y * stride,
+									src + (y + 1) * stride, dst, w, cap);
+		}
+	}
+}
+
+/*
+ * Add the absolute differences of row ya and subtract those of row ys (if
+ * any) from the column SADs. Disparity index k is stored reversed, k = 0 is
+ * the largest disparity, so the right pixels of all k are contiguous.
+ */
+static void stereo_bm_update_cols(const struct vlib_stereo_bm *bm,
+								uint16_t *colsad, uint16_t *tex,
+								size_t xa, size_t xb, long ya, long ys)
+{
+	const int D = bm->p.num_disparities;
+	const int off = bm->p.min_disparity + D - 1;
+	const int cap = bm->p.pre_filter_cap;
+	const uint8_t *la = bm->pre[0] + ya * bm->width;
+	const uint8_t *ra = bm->pre[1] + ya * bm->width - off;
+	const uint8_t *ls = ys >= 0 ? bm->pre[0] + ys * bm->width : NULL;
+	const uint8_t *rs = ys >= 0 ? bm->pre[1] + ys * bm->width - off : NULL;
+
+	for (size_t x=xa; x<xb; x++) {
+		uint16_t *cs = colsad + (x - xa) * D;
+		v_u8 lva = v_setall_u8(la[x]);
+
+		if (ls) {
+			v_u8 lvs = v_setall_u8(ls[x]);
+
+			for (int k=0; k<D; k+=16) {
+				v_u8 da = v_absdiff_u8(lva, v_load_u8(ra + x + k));
+				v_u8 ds = v_absdiff_u8(lvs, v_load_u8(rs + x + k));
+				v_u16 d0 = v_reinterpret_u16_s16(v_expand_lo_u8(da));
+				v_u16 d1 = v_reinterpret_u16_s16(v_expand_hi_u8(da));
+				v_u16 s0 = v_reinterpret_u16_s16(v_expand_lo_u8(ds));
+				v_u16 s1 = v_reinterpret_u16_s16(v_expand_hi_u8(ds));
+
+				v_store_u16(cs + k, v_sub_u16(v_add_u16(v_load_u16(cs + k), d0), s0));
+				v_store_u16(cs + k + 8, v_sub_u16(v_add_u16(v_load_u16(cs + k + 8), d1), s1));
+			}
+			tex[x - xa] += abs(la[x] - cap) - abs(ls[x] - cap);
+		} else {
+			for (int k=0; k<D; k+=16) {
+				v_u8 da = v_absdiff_u8(lva, v_load_u8(ra + x + k));
+				v_u16 d0 = v_reinterpret_u16_s16(v_expand_lo_u8(da));
+				v_u16 d1 = v_reinterpret_u16_s16(v_expand_hi_u8(da));
+
+				v_store_u16(cs + k, v_add_u16(v_load_u16(cs + k), d0));
+				v_store_u16(cs + k + 8, v_add_u16(v_load_u16(cs + k + 8), d1));
+			}
+			tex[x - xa] += abs(la[x] - cap);
+		}
+	}
+}
+
+/* best disparity index of one pixel, -1 if not unique */
+static int stereo_bm_select(const struct vlib_stereo_bm *bm,
+							const uint16_t *sad, unsigned int *minsad)
+{
+	const int D = bm->p.num_disparities;
+	v_u16 lane = v_load_u16(stereo_bm_lane);
+	v_u16 vmin = v_setall_u16(0xffff);
+	v_u16 vidx = v_setall_u16(0);
+	v_u16 ones = v_setall_u16(0xffff);
+	v_u16 key, bad;
+	unsigned int m, thresh;
+	int best;
+
+	/* per lane minimum, ties go to the larger k (smaller disparity) */
+	for (int k=0; k<D; k+=8) {
+		v_u16 s = v_load_u16(sad + k);
+		v_u16 gt = v_cmpgt_u16(s, vmin);
+
+		vidx = v_select_u16(gt, vidx, v_add_u16(lane, v_setall_u16(k)));
+		vmin = v_min_u16(vmin, s);
+	}
+
+	m = v_reduce_min_u16(vmin);
+	key = v_select_u16(v_cmpgt_u16(vmin, v_setall_u16(m)), ones,
+						v_sub_u16(ones, vidx));
+	best = 0xffff - v_reduce_min_u16(key);
+	*minsad = m;
+
+	if (bm->p.uniqueness_ratio <= 0) {
+		return best;
+	}
+
+	/* reject if any SAD but the neighbours of the best is within thresh */
+	thresh = m + m * bm->p.uniqueness_ratio / 100;
+	if (thresh > 0xfffe) {
+		thresh = 0xfffe;
+	}
+
+	bad = v_setall_u16(0);
+	for (int k=0; k<D; k+=8) {
+		v_s16 dk = v_sub_s16(v_reinterpret_s16_u16(v_add_u16(lane, v_setall_u16(k))),
+							v_setall_s16(best));
+		v_u16 far = v_cmpgt_s16(v_abs_s16(dk), v_setall_s16(1));
+		v_u16 le = v_cmpgt_u16(v_setall_u16(thresh + 1), v_load_u16(sad + k));
+
+		bad = v_or_u16(bad, v_and_u16(far, le));
+	}
+
+	return v_any_u16(bad) ? -1 : best;
+}
+
+static void stereo_bm_match_band(void *arg, size_t start, size_t end)
+{
+	struct stereo_bm_job *job = arg;
+	const struct vlib_stereo_bm *bm = job->bm;
+	const int D = bm->p.num_disparities;
+	const int mind = bm->p.min_disparity;
+	const long r = bm->p.sad_window_size / 2;
+	const long w = bm->width, h = bm->height;
+	const int16_t filtered = (mind - 1) * 16;
+	/* columns whose window and search range are inside the image */
+	long x0 = r + (mind + D - 1 > 0 ? mind + D - 1 : 0);
+	long x1 = w - r + (mind < 0 ? mind : 0);
+	long ys = (long)start > r ? (long)start : r;
+	long ye = (long)end < h - r ? (long)end : h - r;
+	uint16_t *colsad, *tex, *sad;
+	size_t nx;
+
+	for (size_t y=start; y<end; y++) {
+		int16_t *d = (int16_t *)((uint8_t *)job->disp + y * job->stride_disp);
+
+		for (long x=0; x<w; x++) {
+			d[x] = filtered;
+		}
+	}
+
+	if (x1 <= x0 || ye <= ys) {
+		return;
+	}
+
+	nx = x1 - x0 + 2 * r;
+	colsad = calloc(nx * D + nx + D, sizeof(*colsad));
+	if (!colsad) {
+		vlib_warn("stereo block matching: out of memory\n");
+		return;
+	}
+	tex = colsad + nx * D;
+	sad = tex + nx;
+
+	for (long y=ys-r; y<=ys+r; y++) {
+		stereo_bm_update_cols(bm, colsad, tex, x0 - r, x1 + r, y, -1);
+	}
+
+	for (long y=ys; y<ye; y++) {
+		int16_t *d = (int16_t *)((uint8_t *)job->disp + y * job->stride_disp);
+		unsigned int tsum = 0;
+
+		if (y > ys) {
+			stereo_bm_update_cols(bm, colsad, tex, x0 - r, x1 + r,
+								y + r, y - r - 1);
+		}
+
+		/* box sum of the first window */
+		memset(sad, 0, D * sizeof(*sad));
+		for (long j=0; j<=2*r; j++) {
+			for (int k=0; k<D; k+=8) {
+				v_store_u16(sad + k, v_add_u16(v_load_u16(sad + k),
+									v_load_u16(colsad + j * D + k)));
+			}
+			tsum += tex[j];
+		}
+
+		for (long x=x0; x<x1; x++) {
+			unsigned int minsad;
+			int k;
+
+			if (x > x0) {
+				const uint16_t *ca = colsad + (x - x0 + 2 * r) * D;
+				const uint16_t *cs = colsad + (x - x0 - 1) * D;
+
+				for (int i=0; i<D; i+=8) {
+					v_store_u16(sad + i, v_sub_u16(v_add_u16(v_load_u16(sad + i),
+										v_load_u16(ca + i)), v_load_u16(cs + i)));
+				}
+				tsum += tex[x - x0 + 2 * r] - tex[x - x0 - 1];
+			}
+
+			if ((int)tsum < bm->p.texture_threshold) {
+				continue;
+			}
+
+			k = stereo_bm_select(bm, sad, &minsad);
+			if (k < 0) {
+				continue;
+			}
+
+			/* parabolic subpixel refinement as in xFSADBlockMatching */
+			if (k > 0 && k < D - 1) {
+				int p = sad[k + 1], n = sad[k - 1];
+				int c = p + n - 2 * minsad + abs(p - n);
+
+				d[x] = ((D - k - 1 + mind) * 256 + (c ? (p - n) * 256 / c : 0)
+						+ 15) >> 4;
+			} else {
+				d[x] = (D - k - 1 + mind) * 16;
+			}
+		}
+	}
+
+	free(colsad);
+}
+
+static int stereo_bm_check_params(const struct vlib_stereo_bm_params *p)
+{
+	if (p->pre_filter_cap < 1 || p->pre_filter_cap > 63) {
+		VLIB_REPORT_ERR("preFilterCap %d not in 1..63", p->pre_filter_cap);
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	/* column and window SADs must fit 16 bits */
+	if (p->sad_window_size < 5 || p->sad_window_size > 21 ||
+			!(p->sad_window_size & 1)) {
+		VLIB_REPORT_ERR("SAD window size %d not odd and in 5..21",
+						p->sad_window_size);
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (p->num_disparities < 16 || p->num_disparities % 16) {
+		VLIB_REPORT_ERR("number of disparities %d not a multiple of 16",
+						p->num_disparities);
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (p->uniqueness_ratio < 0 || p->texture_threshold < 0) {
+		VLIB_REPORT_ERR("uniqueness ratio and texture threshold must be non-negative");
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return VLIB_SUCCESS;
+}
+
+void vlib_stereo_bm_default_params(struct vlib_stereo_bm_params *params)
+{
+	params->pre_filter_cap = 31;
+	params->sad_window_size = 15;
+	params->min_disparity = 0;
+	params->num_disparities = 64;
+	params->texture_threshold = 10;
+	params->uniqueness_ratio = 15;
+}
+
+struct vlib_stereo_bm *vlib_stereo_bm_create(
+				const struct vlib_stereo_bm_params *params,
+				size_t width, size_t height)
+{
+	struct vlib_stereo_bm *bm;
+
+	if (width < 18 || height < 3) {
+		VLIB_REPORT_ERR("stereo block matching: %zux%zu too small",
+						width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	if (stereo_bm_check_params(params)) {
+		return NULL;
+	}
+
+	bm = calloc(1, sizeof(*bm));
+	if (!bm) {
+		return NULL;
+	}
+
+	bm->p = *params;
+	bm->width = width;
+	bm->height = height;
+
+	for (int i=0; i<2; i++) {
+		bm->pre[i] = malloc(width * height);
+		if (!bm->pre[i]) {
+			vlib_stereo_bm_destroy(bm);
+			return NULL;
+		}
+	}
+
+	return bm;
+}
+
+void vlib_stereo_bm_destroy(struct vlib_stereo_bm *bm)
+{
+	if (!bm) {
+		return;
+	}
+
+	free(bm->pre[0]);
+	free(bm->pre[1]);
+	free(bm);
+}
+
+int vlib_stereo_bm_set_params(struct vlib_stereo_bm *bm,
+				const struct vlib_stereo_bm_params *params)
+{
+	int ret = stereo_bm_check_params(params);
+
+	if (!ret) {
+		bm->p = *params;
+	}
+
+	return ret;
+}
+
+/**
+ * vlib_stereo_bm_compute - compute the disparity of a rectified image pair
+ * @bm: block matcher
+ * @left: left 8-bit image
+ * @stride_left: line stride of @left in bytes
+ * @right: right 8-bit image
+ * @stride_right: line stride of @right in bytes
+ * @disp: Q4 disparity output
+ * @stride_disp: line stride of @disp in bytes
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_stereo_bm_compute(struct vlib_stereo_bm *bm,
+				const uint8_t *left, size_t stride_left,
+				const uint8_t *right, size_t stride_right,
+				int16_t *disp, size_t stride_disp)
+{
+	struct stereo_bm_job job = {
+		.bm = bm,
+		.src = { left, right },
+		.stride = { stride_left, stride_right },
+		.disp = disp,
+		.stride_disp = stride_disp,
+	};
+	struct timespec t;
+	int ret;
+
+	if (!left || !right || !disp) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(bm->height, STEREO_BM_GRAIN,
+							stereo_bm_prefilter_band, &job);
+	bm->stats.prefilter_ms = vlib_ms_since(&t);
+	if (ret) {
+		return ret;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	ret = vlib_parallel_for(bm->height, STEREO_BM_GRAIN,
+							stereo_bm_match_band, &job);
+	bm->stats.match_ms = vlib_ms_since(&t);
+
+	return ret;
+}
+
+void vlib_stereo_bm_get_stats(const struct vlib_stereo_bm *bm,
+				struct vlib_stereo_bm_stats *stats)
+{
+	*stats = bm->stats;
+}
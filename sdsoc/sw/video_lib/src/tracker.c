@@ -0,0 +1,929 @@
+#include <drm/drm_fourcc.h>
+#include <linux/videodev2.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "corners.h"
+#include "cvt_color.h"
+#include "fast.h"
+#include "filter.h"
+#include "harris.h"
+#include "helper.h"
+#include "image.h"
+#include "parallel.h"
+#include "pyramid.h"
+#include "tracker.h"
+#include "video_int.h"
+
+/* rows per band boundary of the image passes, even for 4:2:0 formats */
+#define TRACKER_GRAIN		8
+
+/* points per band boundary of the tracking pass */
+#define TRACKER_GRAIN_POINTS	16
+
+/* levels are not reduced below this width or height */
+#define TRACKER_MIN_SIZE	32
+
+#define TRACKER_MAX_WINDOW	31
+
+/* patch with a one pixel border for the gradients */
+#define TRACKER_MAX_PATCH	(TRACKER_MAX_WINDOW + 2)
+
+/* detector grid cell edge in pixels */
+#define TRACKER_CELL_SIZE	32
+
+/* smaller eigenvalue of the gradient tensor per window pixel */
+#define TRACKER_MIN_EIG		1.0f
+
+/* iterations stop once the update is below this many pixels */
+#define TRACKER_EPS			0.01f
+
+struct tracker_level {
+	size_t width;				/* also the stride */
+	size_t height;
+	uint8_t *img;
+};
+
+struct vlib_tracker {
+	struct vlib_tracker_params p;
+	size_t width;
+	size_t height;
+	int levels;
+	struct tracker_level pyr[2][VLIB_TRACKER_MAX_LEVELS];
+	int cur;					/* pyramid of the last frame */
+	int valid;					/* pyr[cur] holds a frame */
+	unsigned int since_detect;	/* frames since the last detection */
+	/* point list, one array per field */
+	size_t count;
+	float *x;
+	float *y;
+	float *nx;					/* position in the new frame */
+	float *ny;
+	float *px;
+	float *py;
+	uint32_t *id;
+	uint32_t *age;
+	int32_t *cell_next;			/* next point in the same grid cell */
+	uint8_t *status;			/* tracked into the new frame */
+	uint32_t next_id;
+	/* candidates, their order by score and the min_distance grid */
+	struct vlib_fast *fast;
+	struct vlib_harris *harris;
+	struct vlib_corners cand;
+	uint32_t *order;			/* twice the capacity of cand */
+	int32_t *cell_head;
+	size_t grid_width;
+	size_t grid_height;
+	struct vlib_tracker_stats stats;
+};
+
+struct tracker_job {
+	struct vlib_tracker *tr;
+	const struct tracker_level *prev;
+	const struct tracker_level *next;
+	const uint8_t *frame;
+	size_t stride;
+};
+
+/* level 0 is a copy of the frame, which may be requeued after the call */
+static void tracker_copy_band(void *arg, size_t start, size_t end)
+{
+	struct tracker_job *job = arg;
+	const struct tracker_level *lv = job->next;
+
+	for (size_t y=start; y<end; y++) {
+		memcpy(lv->img + y * lv->width, job->frame + y * job->stride,
+				lv->width);
+	}
+}
+
+static void tracker_build_pyramid(struct vlib_tracker *tr,
+								struct tracker_level *pyr,
+								const uint8_t *frame, size_t stride)
+{
+	struct tracker_job job = {
+		.tr = tr,
+		.next = pyr,
+		.frame = frame,
+		.stride = stride,
+	};
+
+	vlib_parallel_for(pyr->height, TRACKER_GRAIN, tracker_copy_band, &job);
+	for (int l=1; l<tr->levels; l++) {
+		vlib_pyr_down(pyr[l - 1].img, pyr[l - 1].width, pyr[l - 1].width,
+					pyr[l - 1].height, pyr[l].img, pyr[l].width);
+	}
+}
+
+/* a window of half size @m around (x, y) and its bilinear neighbours fit */
+static inline int tracker_inside(const struct tracker_level *lv,
+								float x, float y, int m)
+{
+	return x >= m && y >= m && x <= (float)lv->width - 2 - m &&
+			y <= (float)lv->height - 2 - m;
+}
+
+/* bilinear n x n patch with its top left corner at (x, y), inside */
+static void tracker_patch(const struct tracker_level *lv, float x, float y,
+						int n, float *dst)
+{
+	const size_t w = lv->width;
+	int ix = x, iy = y;
+	float ax = x - ix, ay = y - iy;
+	float w00 = (1 - ax) * (1 - ay), w01 = ax * (1 - ay);
+	float w10 = (1 - ax) * ay, w11 = ax * ay;
+
+	for (int j=0; j<n; j++) {
+		const uint8_t *s = lv->img + (iy + j) * w + ix;
+
+		for (int i=0; i<n; i++) {
+			dst[j * n + i] = w00 * s[i] + w01 * s[i + 1] +
+							w10 * s[i + w] + w11 * s[i + w + 1];
+		}
+	}
+}
+
+/*
+ * Lucas-Kanade iterations of one level for the point (x, y) of the level,
+ * starting at the displacement (*dx, *dy). Returns -1 if the window is not
+ * textured or leaves the image.
+ */
+static int tracker_track_level(const struct vlib_tracker *tr,
+							const struct tracker_level *p,
+							const struct tracker_level *q,
+							float x, float y, float *dx, float *dy)
+{
+	const int r = tr->p.window_size / 2, ws = 2 * r + 1, n = ws + 2;
+	float patch[TRACKER_MAX_PATCH * TRACKER_MAX_PATCH];
+	float ix[TRACKER_MAX_WINDOW * TRACKER_MAX_WINDOW];
+	float iy[TRACKER_MAX_WINDOW * TRACKER_MAX_WINDOW];
+	float it[TRACKER_MAX_WINDOW * TRACKER_MAX_WINDOW];
+	float gxx = 0, gxy = 0, gyy = 0, det, d, eig;
+
+	if (!tracker_inside(p, x, y, r + 1)) {
+		return -1;
+	}
+
+	tracker_patch(p, x - r - 1, y - r - 1, n, patch);
+	for (int j=0; j<ws; j++) {
+		for (int i=0; i<ws; i++) {
+			const float *c = patch + (j + 1) * n + i + 1;
+			float gx = (c[1] - c[-1]) * 0.5f, gy = (c[n] - c[-n]) * 0.5f;
+
+			ix[j * ws + i] = gx;
+			iy[j * ws + i] = gy;
+			gxx += gx * gx;
+			gxy += gx * gy;
+			gyy += gy * gy;
+		}
+	}
+
+	det = gxx * gyy - gxy * gxy;
+	d = gxx - gyy;
+	eig = 0.5f * (gxx + gyy - sqrtf(d * d + 4 * gxy * gxy));
+	if (eig < TRACKER_MIN_EIG * ws * ws || det <= 0) {
+		return -1;
+	}
+
+	for (int k=0; k<tr->p.iterations; k++) {
+		float qx = x + *dx, qy = y + *dy;
+		float bx = 0, by = 0, ux, uy;
+
+		if (!tracker_inside(q, qx, qy, r)) {
+			return -1;
+		}
+
+		tracker_patch(q, qx - r, qy - r, ws, it);
+		for (int j=0; j<ws; j++) {
+			for (int i=0; i<ws; i++) {
+				float t = it[j * ws + i] - patch[(j + 1) * n + i + 1];
+
+				bx += t * ix[j * ws + i];
+				by += t * iy[j * ws + i];
+			}
+		}
+
+		ux = -(gyy * bx - gxy * by) / det;
+		uy = -(gxx * by - gxy * bx) / det;
+		*dx += ux;
+		*dy += uy;
+		if (ux * ux + uy * uy < TRACKER_EPS * TRACKER_EPS) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/* coarse to fine, coarse levels the window does not fit are skipped */
+static int tracker_track_point(const struct vlib_tracker *tr,
+							const struct tracker_level *prev,
+							const struct tracker_level *next,
+							float x, float y, float *nx, float *ny)
+{
+	float dx = 0, dy = 0;
+
+	for (int l=tr->levels-1; l>=0; l--) {
+		float s = 1.0f / (1 << l);
+		float vx = dx, vy = dy;
+
+		if (!tracker_track_level(tr, &prev[l], &next[l], x * s, y * s,
+								&vx, &vy)) {
+			dx = vx;
+			dy = vy;
+		} else if (!l) {
+			return -1;
+		}
+
+		if (l) {
+			dx *= 2;
+			dy *= 2;
+		}
+	}
+
+	*nx = x + dx;
+	*ny = y + dy;
+
+	return tracker_inside(next, *nx, *ny, 0) ? 0 : -1;
+}
+
+static void tracker_track_band(void *arg, size_t start, size_t end)
+{
+	struct tracker_job *job = arg;
+	struct vlib_tracker *tr = job->tr;
+
+	for (size_t i=start; i<end; i++) {
+		tr->status[i] = !tracker_track_point(tr, job->prev, job->next,
+									tr->x[i], tr->y[i], &tr->nx[i], &tr->ny[i]);
+	}
+}
+
+/* keep the tracked points, in order */
+static void tracker_compact(struct vlib_tracker *tr)
+{
+	size_t n = 0;
+
+	for (size_t i=0; i<tr->count; i++) {
+		if (!tr->status[i]) {
+			continue;
+		}
+
+		tr->px[n] = tr->x[i];
+		tr->py[n] = tr->y[i];
+		tr->x[n] = tr->nx[i];
+		tr->y[n] = tr->ny[i];
+		tr->id[n] = tr->id[i];
+		tr->age[n] = tr->age[i] + 1;
+		n++;
+	}
+
+	tr->stats.tracked = n;
+	tr->stats.lost = tr->count - n;
+	tr->count = n;
+}
+
+static size_t tracker_cell(const struct vlib_tracker *tr, float x, float y)
+{
+	size_t cx = x / tr->p.min_distance, cy = y / tr->p.min_distance;
+
+	cx = cx < tr->grid_width ? cx : tr->grid_width - 1;
+	cy = cy < tr->grid_height ? cy : tr->grid_height - 1;
+
+	return cy * tr->grid_width + cx;
+}
+
+static void tracker_grid_insert(struct vlib_tracker *tr, size_t i)
+{
+	size_t c = tracker_cell(tr, tr->x[i], tr->y[i]);
+
+	tr->cell_next[i] = tr->cell_head[c];
+	tr->cell_head[c] = i;
+}
+
+/* no point within min_distance, only the 3x3 cells around have to be seen */
+static int tracker_grid_free(const struct vlib_tracker *tr, float x, float y)
+{
+	const float md2 = (float)tr->p.min_distance * tr->p.min_distance;
+	size_t c = tracker_cell(tr, x, y);
+	long cx = c % tr->grid_width, cy = c / tr->grid_width;
+
+	for (long j=cy-1; j<=cy+1; j++) {
+		for (long i=cx-1; i<=cx+1; i++) {
+			if (i < 0 || j < 0 || i >= (long)tr->grid_width ||
+				j >= (long)tr->grid_height) {
+				continue;
+			}
+
+			for (int32_t k=tr->cell_head[j * tr->grid_width + i]; k>=0;
+				k=tr->cell_next[k]) {
+				float dx = tr->x[k] - x, dy = tr->y[k] - y;
+
+				if (dx * dx + dy * dy < md2) {
+					return 0;
+				}
+			}
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Candidates by descending score, ties in list order: a counting sort per
+ * byte of the scores, from the lowest byte up to the highest one in use.
+ * FAST scores are below 256 and take one pass, Harris responses up to four.
+ */
+static const uint32_t *tracker_sort(struct vlib_tracker *tr)
+{
+	const struct vlib_corners *c = &tr->cand;
+	uint32_t *src = tr->order, *dst = tr->order + c->capacity, *t;
+	uint32_t max = 0;
+	int shift = 0;
+
+	for (size_t i=0; i<c->count; i++) {
+		uint32_t s = c->score[i] > 0 ? c->score[i] : 0;
+
+		src[i] = i;
+		max = s > max ? s : max;
+	}
+
+	do {
+		size_t hist[256] = { 0 }, pos[256], start = 0;
+
+		for (size_t i=0; i<c->count; i++) {
+			hist[((uint32_t)c->score[src[i]] >> shift) & 255]++;
+		}
+		for (int s=255; s>=0; s--) {
+			pos[s] = start;
+			start += hist[s];
+		}
+		for (size_t i=0; i<c->count; i++) {
+			dst[pos[((uint32_t)c->score[src[i]] >> shift) & 255]++] = src[i];
+		}
+
+		t = src;
+		src = dst;
+		dst = t;
+		shift += 8;
+	} while (shift < 32 && (max >> shift));
+
+	return src;
+}
+
+/* top up the point list with the strongest corners that keep the spacing */
+static void tracker_detect(struct vlib_tracker *tr, const struct tracker_level *lv)
+{
+	struct vlib_corners *c = &tr->cand;
+	const uint32_t *order;
+	int ret;
+
+	tr->stats.detected = 0;
+
+	if (tr->count >= (size_t)tr->p.max_corners) {
+		return;
+	}
+
+	if (tr->harris) {
+		ret = vlib_harris_detect(tr->harris, lv->img, lv->width, c);
+	} else {
+		ret = vlib_fast_detect_grid(tr->fast, lv->img, lv->width, c);
+	}
+	if (ret) {
+		return;
+	}
+
+	order = tracker_sort(tr);
+
+	for (size_t i=0; i<tr->grid_width*tr->grid_height; i++) {
+		tr->cell_head[i] = -1;
+	}
+	for (size_t i=0; i<tr->count; i++) {
+		tracker_grid_insert(tr, i);
+	}
+
+	for (size_t k=0; k<c->count && tr->count<(size_t)tr->p.max_corners; k++) {
+		size_t i = order[k], n = tr->count;
+		float x = c->x[i], y = c->y[i];
+
+		if (!tracker_grid_free(tr, x, y)) {
+			continue;
+		}
+
+		tr->x[n] = x;
+		tr->y[n] = y;
+		tr->px[n] = x;
+		tr->py[n] = y;
+		tr->id[n] = tr->next_id++;
+		tr->age[n] = 0;
+		tracker_grid_insert(tr, n);
+		tr->count++;
+		tr->stats.detected++;
+	}
+}
+
+void vlib_tracker_default_params(struct vlib_tracker_params *params)
+{
+	params->max_corners = 500;
+	params->detect_interval = 5;
+	params->detector = VLIB_TRACKER_FAST;
+	params->fast_threshold = 20;
+	params->harris_threshold = 1000;
+	params->min_distance = 10;
+	params->levels = 3;
+	params->window_size = 15;
+	params->iterations = 10;
+}
+
+static int tracker_check_params(const struct vlib_tracker_params *p)
+{
+	if (p->max_corners < 1 || p->detect_interval < 1 ||
+		(p->detector != VLIB_TRACKER_FAST &&
+		 p->detector != VLIB_TRACKER_HARRIS) ||
+		p->fast_threshold < 1 || p->fast_threshold > 254 ||
+		p->harris_threshold < 0 ||
+		p->min_distance < 1 ||
+		p->levels < 1 || p->levels > VLIB_TRACKER_MAX_LEVELS ||
+		p->window_size < 5 || p->window_size > TRACKER_MAX_WINDOW ||
+		!(p->window_size & 1) || p->iterations < 1) {
+		VLIB_REPORT_ERR("tracker: invalid parameters");
+		vlib_dbg("%s\n", vlib_errstr);
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	return VLIB_SUCCESS;
+}
+
+struct vlib_tracker *vlib_tracker_create(
+				const struct vlib_tracker_params *params,
+				size_t width, size_t height)
+{
+	struct vlib_tracker *tr;
+	struct vlib_fast_params fp;
+	struct vlib_harris_params hp;
+	size_t w = width, h = height, n, per_cell;
+
+	if (tracker_check_params(params)) {
+		return NULL;
+	}
+
+	if (width < TRACKER_MIN_SIZE || height < TRACKER_MIN_SIZE ||
+		width > UINT16_MAX || height > UINT16_MAX) {
+		VLIB_REPORT_ERR("tracker: %zux%zu not supported", width, height);
+		vlib_dbg("%s\n", vlib_errstr);
+		return NULL;
+	}
+
+	tr = calloc(1, sizeof(*tr));
+	if (!tr) {
+		return NULL;
+	}
+
+	tr->p = *params;
+	tr->width = width;
+	tr->height = height;
+
+	for (int l=0; l<params->levels; l++) {
+		if (w < TRACKER_MIN_SIZE || h < TRACKER_MIN_SIZE) {
+			break;
+		}
+
+		for (int i=0; i<2; i++) {
+			struct tracker_level *lv = &tr->pyr[i][l];
+
+			lv->width = w;
+			lv->height = h;
+			lv->img = malloc(w * h);
+			if (!lv->img) {
+				vlib_tracker_destroy(tr);
+				return NULL;
+			}
+		}
+
+		tr->levels++;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+
+	n = params->max_corners;
+	tr->x = malloc(n * (6 * sizeof(float) + 3 * sizeof(uint32_t) + 1));
+	if (!tr->x) {
+		vlib_tracker_destroy(tr);
+		return NULL;
+	}
+	tr->y = tr->x + n;
+	tr->nx = tr->y + n;
+	tr->ny = tr->nx + n;
+	tr->px = tr->ny + n;
+	tr->py = tr->px + n;
+	tr->id = (uint32_t *)(tr->py + n);
+	tr->age = tr->id + n;
+	tr->cell_next = (int32_t *)(tr->age + n);
+	tr->status = (uint8_t *)(tr->cell_next + n);
+
+	tr->grid_width = (width + params->min_distance - 1) / params->min_distance;
+	tr->grid_height = (height + params->min_distance - 1) / params->min_distance;
+	tr->cell_head = malloc(tr->grid_width * tr->grid_height *
+							sizeof(*tr->cell_head));
+
+	/* candidates spread over the frame, about four per point */
+	n = ((width + TRACKER_CELL_SIZE - 1) / TRACKER_CELL_SIZE) *
+		((height + TRACKER_CELL_SIZE - 1) / TRACKER_CELL_SIZE);
+	per_cell = (4 * params->max_corners + n - 1) / n;
+	per_cell = per_cell > 2 ? per_cell : 2;
+	per_cell = per_cell < UINT16_MAX ? per_cell : UINT16_MAX;
+
+	if (params->detector == VLIB_TRACKER_HARRIS) {
+		vlib_harris_default_params(&hp);
+		hp.threshold = params->harris_threshold;
+		hp.cell_size = TRACKER_CELL_SIZE;
+		hp.max_per_cell = per_cell;
+		tr->harris = vlib_harris_create(&hp, width, height);
+		n = tr->harris ? vlib_harris_capacity(tr->harris) : 0;
+	} else {
+		fp.threshold = params->fast_threshold;
+		fp.nms = 1;
+		fp.cell_size = TRACKER_CELL_SIZE;
+		fp.max_per_cell = per_cell;
+		tr->fast = vlib_fast_create(&fp, width, height);
+		n = tr->fast ? vlib_fast_capacity(tr->fast) : 0;
+	}
+	if (!tr->fast && !tr->harris) {
+		vlib_tracker_destroy(tr);
+		return NULL;
+	}
+
+	tr->order = malloc(2 * n * sizeof(*tr->order));
+	if (!tr->cell_head || !tr->order || vlib_corners_init(&tr->cand, n)) {
+		vlib_tracker_destroy(tr);
+		return NULL;
+	}
+
+	return tr;
+}
+
+void vlib_tracker_destroy(struct vlib_tracker *tr)
+{
+	if (!tr) {
+		return;
+	}
+
+	for (int l=0; l<VLIB_TRACKER_MAX_LEVELS; l++) {
+		free(tr->pyr[0][l].img);
+		free(tr->pyr[1][l].img);
+	}
+
+	free(tr->x);
+	free(tr->cell_head);
+	free(tr->order);
+	vlib_fast_destroy(tr->fast);
+	vlib_harris_destroy(tr->harris);
+	vlib_corners_free(&tr->cand);
+	free(tr);
+}
+
+/* drop all points and the last frame, e.g. after a scene cut */
+void vlib_tracker_reset(struct vlib_tracker *tr)
+{
+	tr->valid = 0;
+	tr->count = 0;
+	tr->since_detect = 0;
+}
+
+/**
+ * vlib_tracker_process - push a frame and track the points into it
+ * @tr: tracker state
+ * @frame: 8-bit image
+ * @stride: line stride of @frame in bytes
+ *
+ * Return: VLIB_SUCCESS on success, or an error code.
+ */
+int vlib_tracker_process(struct vlib_tracker *tr,
+				const uint8_t *frame, size_t stride)
+{
+	int next = tr->valid ? !tr->cur : tr->cur;
+	struct tracker_job job = {
+		.tr = tr,
+		.prev = tr->pyr[tr->cur],
+		.next = tr->pyr[next],
+	};
+	struct timespec t;
+
+	if (!frame) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	tracker_build_pyramid(tr, tr->pyr[next], frame, stride);
+	tr->stats.pyramid_ms = vlib_ms_since(&t);
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	if (tr->valid) {
+		vlib_parallel_for(tr->count, TRACKER_GRAIN_POINTS, tracker_track_band,
+						&job);
+	} else {
+		tr->count = 0;
+	}
+	tracker_compact(tr);
+	tr->stats.track_ms = vlib_ms_since(&t);
+
+	tr->stats.detect_ms = 0;
+	tr->stats.detected = 0;
+	if (tr->since_detect++ % tr->p.detect_interval == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		tracker_detect(tr, tr->pyr[next]);
+		tr->stats.detect_ms = vlib_ms_since(&t);
+	}
+
+	tr->cur = next;
+	tr->valid = 1;
+
+	return VLIB_SUCCESS;
+}
+
+void vlib_tracker_get_points(const struct vlib_tracker *tr,
+				struct vlib_tracker_points *points)
+{
+	points->count = tr->count;
+	points->x = tr->x;
+	points->y = tr->y;
+	points->prev_x = tr->px;
+	points->prev_y = tr->py;
+	points->id = tr->id;
+	points->age = tr->age;
+}
+
+void vlib_tracker_get_stats(const struct vlib_tracker *tr,
+				struct vlib_tracker_stats *stats)
+{
+	*stats = tr->stats;
+}
+
+/* Pipeline stage */
+
+/* indexed by enum vlib_tracker_detector */
+static const char *tracker_modes[] = {
+	"FAST",
+	"Harris",
+};
+
+struct tracker_data {
+	struct vlib_tracker_params params;
+	struct vlib_tracker *trs[ARRAY_SIZE(tracker_modes)];
+	struct vlib_tracker *tr;	/* of the mode of the last frame */
+	uint32_t in_fourcc;
+	uint32_t out_fourcc;
+	size_t width;
+	size_t height;
+	uint8_t *luma;
+	uint8_t *yuv;				/* YUV 4:4:4 output staging */
+	uint8_t color_new[3];
+	uint8_t color_tracked[3];
+};
+
+struct tracker_post_job {
+	struct tracker_data *data;
+	const uint8_t *luma;
+	size_t luma_stride;
+	struct vlib_image staging;
+	struct vlib_image out;
+	int ret;
+};
+
+/* the frame in gray */
+static void tracker_gray_band(void *arg, size_t start, size_t end)
+{
+	struct tracker_post_job *job = arg;
+	struct tracker_data *data = job->data;
+	size_t w = data->width, plane = w * data->height;
+
+	for (size_t y=start; y<end; y++) {
+		uint8_t *py = data->yuv + y * w;
+
+		memcpy(py, job->luma + y * job->luma_stride, w);
+		memset(py + plane, 128, w);
+		memset(py + 2 * plane, 128, w);
+	}
+}
+
+static void tracker_out_band(void *arg, size_t start, size_t end)
+{
+	struct tracker_post_job *job = arg;
+
+	if (vlib_cvt_color_lines(&job->staging, &job->out, start, end)) {
+		job->ret = VLIB_ERROR_OTHER;
+	}
+}
+
+static void tracker_put(struct tracker_data *data, long x, long y,
+						const uint8_t *color)
+{
+	size_t plane = data->width * data->height;
+	uint8_t *p;
+
+	if (x < 0 || y < 0 || x >= (long)data->width || y >= (long)data->height) {
+		return;
+	}
+
+	p = data->yuv + y * data->width + x;
+	p[0] = color[0];
+	p[plane] = color[1];
+	p[2 * plane] = color[2];
+}
+
+static void tracker_draw_line(struct tracker_data *data, float x0, float y0,
+							float x1, float y1, const uint8_t *color)
+{
+	int n = lroundf(fmaxf(fabsf(x1 - x0), fabsf(y1 - y0)));
+
+	for (int i=0; i<=n; i++) {
+		float a = n ? (float)i / n : 0;
+
+		tracker_put(data, lroundf(x0 + a * (x1 - x0)),
+					lroundf(y0 + a * (y1 - y0)), color);
+	}
+}
+
+static void tracker_draw(struct tracker_data *data)
+{
+	struct vlib_tracker_points pts;
+
+	vlib_tracker_get_points(data->tr, &pts);
+
+	for (size_t i=0; i<pts.count; i++) {
+		const uint8_t *color = pts.age[i] ? data->color_tracked :
+							data->color_new;
+		long x = lroundf(pts.x[i]), y = lroundf(pts.y[i]);
+
+		tracker_draw_line(data, pts.prev_x[i], pts.prev_y[i], pts.x[i],
+						pts.y[i], color);
+		for (long j=-1; j<=1; j++) {
+			for (long k=-1; k<=1; k++) {
+				tracker_put(data, x + k, y + j, color);
+			}
+		}
+	}
+}
+
+static void tracker_free_buffers(struct tracker_data *data)
+{
+	for (size_t i=0; i<ARRAY_SIZE(data->trs); i++) {
+		vlib_tracker_destroy(data->trs[i]);
+		data->trs[i] = NULL;
+	}
+	free(data->luma);
+	free(data->yuv);
+	data->tr = NULL;
+	data->luma = NULL;
+	data->yuv = NULL;
+	data->width = 0;
+	data->height = 0;
+}
+
+static int tracker_init(struct filter_s *fs, const struct filter_init_data *fid)
+{
+	struct tracker_data *data = fs->data;
+	size_t w = fid->in_width, h = fid->in_height;
+
+	if (fid->out_width != w || fid->out_height != h || (w & 1) || (h & 1)) {
+		return -1;
+	}
+
+	if ((fid->in_fourcc != V4L2_PIX_FMT_GREY &&
+		 !vlib_cvt_color_supported(fid->in_fourcc, V4L2_PIX_FMT_GREY)) ||
+		!vlib_cvt_color_supported(DRM_FORMAT_YUV444, fid->out_fourcc)) {
+		return -1;
+	}
+
+	data->in_fourcc = fid->in_fourcc;
+	data->out_fourcc = fid->out_fourcc;
+
+	if (data->width == w && data->height == h) {
+		data->tr = NULL;
+		return 0;
+	}
+
+	tracker_free_buffers(data);
+	for (size_t i=0; i<ARRAY_SIZE(data->trs); i++) {
+		struct vlib_tracker_params p = data->params;
+
+		p.detector = i;
+		data->trs[i] = vlib_tracker_create(&p, w, h);
+		if (!data->trs[i]) {
+			break;
+		}
+	}
+	data->luma = malloc(w * h);
+	data->yuv = malloc(vlib_image_size(DRM_FORMAT_YUV444, h, w));
+	if (!data->trs[ARRAY_SIZE(data->trs) - 1] || !data->luma || !data->yuv) {
+		vlib_warn("tracker: failed to set up %zux%zu\n", w, h);
+		tracker_free_buffers(data);
+		return -1;
+	}
+
+	data->width = w;
+	data->height = h;
+
+	return 0;
+}
+
+static void tracker_func(struct filter_s *fs,
+						unsigned char *frm_data_in, unsigned char *frm_data_out,
+						int height_in, int width_in, int stride_in,
+						int height_out, int width_out, int stride_out)
+{
+	struct tracker_data *data = fs->data;
+	struct tracker_post_job job = {
+		.data = data,
+		.luma = frm_data_in,
+		.luma_stride = stride_in,
+	};
+
+	if (!data->trs[fs->mode] || (size_t)width_in != data->width ||
+		(size_t)height_in != data->height) {
+		return;
+	}
+
+	/* the points of the other detector are stale */
+	if (data->tr != data->trs[fs->mode]) {
+		data->tr = data->trs[fs->mode];
+		vlib_tracker_reset(data->tr);
+	}
+
+	if (data->in_fourcc != V4L2_PIX_FMT_GREY) {
+		struct vlib_image in, out;
+
+		if (vlib_image_init(&in, data->in_fourcc, data->width, data->height,
+							stride_in, frm_data_in) ||
+			vlib_image_init(&out, V4L2_PIX_FMT_GREY, data->width,
+							data->height, data->width, data->luma) ||
+			vlib_cvt_color(&in, &out)) {
+			return;
+		}
+		job.luma = data->luma;
+		job.luma_stride = data->width;
+	}
+
+	if (vlib_tracker_process(data->tr, job.luma, job.luma_stride)) {
+		return;
+	}
+
+	vlib_image_init(&job.staging, DRM_FORMAT_YUV444, data->width, data->height,
+					data->width, data->yuv);
+	if (vlib_image_init(&job.out, data->out_fourcc, width_out, height_out,
+						stride_out, frm_data_out)) {
+		return;
+	}
+
+	vlib_parallel_for(data->height, TRACKER_GRAIN, tracker_gray_band, &job);
+	tracker_draw(data);
+	vlib_parallel_for(data->height, TRACKER_GRAIN, tracker_out_band, &job);
+}
+
+static struct filter_ops tracker_ops = {
+	.init = tracker_init,
+	.func = tracker_func,
+};
+
+static const struct filter_s tracker_fs = {
+	.display_text = "Feature Tracker",
+	.dt_comp_string = "",
+	.pr_file_name = "",
+	.pr_buf = NULL,
+	.fd = -1,
+	.mode = 0,
+	.ops = &tracker_ops,
+	.data = NULL,
+	.num_modes = ARRAY_SIZE(tracker_modes),
+	.modes = tracker_modes,
+};
+
+/**
+ * vlib_tracker_filter_create - Create a sparse feature tracking stage
+ *
+ * Return: Pointer to the filter on success, NULL otherwise.
+ */
+struct filter_s *vlib_tracker_filter_create(void)
+{
+	struct filter_s *fs;
+	struct tracker_data *data = calloc(1, sizeof(*data));
+	if (!data) {
+		return NULL;
+	}
+
+	vlib_tracker_default_params(&data->params);
+	vlib_cvt_color_rgb2yuv(255, 0, 0, data->color_new);
+	vlib_cvt_color_rgb2yuv(0, 255, 0, data->color_tracked);
+
+	fs = malloc(sizeof(*fs));
+	if (!fs) {
+		free(data);
+		return NULL;
+	}
+
+	*fs = tracker_fs;
+	fs->data = data;
+
+	return fs;
+}
@@ -8,13 +8,16 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "analytics.h"
 #include "common.h"
 #include "helper.h"
 #include "video_int.h"
 #include "log_events.h"
+#include "luma_stage.h"
 #include "m2m_sw_pipeline.h"
 #include "mediactl_helper.h"
 #include "s2m_pipeline.h"
+#include "scaler.h"
 #include "filter.h"
 
 /* Maximum number of bytes in a log line */
@@ -29,6 +32,14 @@ char vlib_errstr[VLIB_ERRSTR_SIZE];
 
 static struct video_pipeline *video_setup;
 
+/* capture and display sizes differ, or a region of the capture is shown */
+static int vlib_pipeline_scaled(const struct video_pipeline *vp)
+{
+	return vp->w != vp->drm.overlay_plane.vlib_plane.width ||
+		vp->h != vp->drm.overlay_plane.vlib_plane.height ||
+		vp->crop.width;
+}
+
 static int vlib_filter_init(struct video_pipeline *vp)
 {
 	int ret;
@@ -49,8 +60,15 @@ static int vlib_filter_init(struct video_pipeline *vp)
 			return VLIB_ERROR_OTHER;
 		}
 
-		/* Initialize filter */
-		ret = fs->ops->init(fs, &fid);
+		/*
+		 * Initialize filter, at another size if it cannot scale itself.
+		 * Filters do not crop, with a crop region all run in a graph.
+		 */
+		ret = vp->crop.width ? VLIB_ERROR_NOT_SUPPORTED :
+			fs->ops->init(fs, &fid);
+		if (ret && vp->scaler) {
+			ret = vlib_scaler_add_filter(vp->scaler, fs);
+		}
 		if (ret) {
 			vlib_warn("initializing filter '%s' failed\n",
 					filter_type_get_display_text(fs));
@@ -208,6 +226,8 @@ int vlib_init(struct vlib_config_data *cfg)
 	video_setup->flags = cfg->flags;
 	video_setup->ft = cfg->ft;
 	video_setup->buffer_cnt = cfg->buffer_cnt;
+	pthread_mutex_init(&video_setup->analytics_run_lock, NULL);
+	pthread_mutex_init(&video_setup->analytics_lock, NULL);
 
 	for (size_t i=0; i<NUM_EVENTS; i++) {
 		const char *event_name[] = {
@@ -233,6 +253,21 @@ int vlib_init(struct vlib_config_data *cfg)
 	video_setup->fps.numerator = cfg->fps.numerator;
 	video_setup->fps.denominator = cfg->fps.denominator;
 
+	/* Set crop region */
+	if (cfg->crop.width || cfg->crop.height) {
+		if (!cfg->crop.width || !cfg->crop.height ||
+			cfg->crop.xoffs + cfg->crop.width > video_setup->w ||
+			cfg->crop.yoffs + cfg->crop.height > video_setup->h) {
+			VLIB_REPORT_ERR("crop region %zux%zu+%zu+%zu outside of %ux%u input",
+							cfg->crop.width, cfg->crop.height,
+							cfg->crop.xoffs, cfg->crop.yoffs,
+							video_setup->w, video_setup->h);
+			vlib_dbg("%s\n", vlib_errstr);
+			return VLIB_ERROR_INVALID_PARAM;
+		}
+		video_setup->crop = cfg->crop;
+	}
+
 	ret = vlib_drm_init(cfg);
 	if (ret) {
 		return ret;
@@ -253,6 +288,23 @@ int vlib_init(struct vlib_config_data *cfg)
 				strerror(errno));
 	}
 
+	/* Crop and scale between capture and display resolution */
+	if (vlib_pipeline_scaled(video_setup)) {
+		struct filter_init_data fid = {
+			.in_width = video_setup->w,
+			.in_height = video_setup->h,
+			.in_fourcc = video_setup->in_fourcc,
+			.out_width = video_setup->drm.overlay_plane.vlib_plane.width,
+			.out_height = video_setup->drm.overlay_plane.vlib_plane.height,
+			.out_fourcc = video_setup->out_fourcc,
+		};
+
+		video_setup->scaler = vlib_scaler_create(&fid, &video_setup->crop);
+		if (!video_setup->scaler) {
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
 	/* Initialize filters */
 	if (video_setup->ft) {
 		ret = vlib_filter_init(video_setup);
@@ -373,11 +425,18 @@ int vlib_uninit(void)
 		}
 	}
 
+	vlib_scaler_destroy(video_setup->scaler);
+	vlib_analytics_destroy(video_setup->analytics);
+	free(video_setup->analytics_cells);
+	pthread_mutex_destroy(&video_setup->analytics_run_lock);
+	pthread_mutex_destroy(&video_setup->analytics_lock);
+
 	for (size_t i=0; i<NUM_EVENTS; i++) {
 		levents_counter_destroy(video_setup->events[i]);
 	}
 
 	free(video_setup);
+	video_setup = NULL;
 
 	return ret;
 }
@@ -439,10 +498,9 @@ int vlib_change_mode(struct vlib_config *config)
 		return VLIB_ERROR_INVALID_PARAM;
 	}
 
-	/* filter is required when output resolution != input resolution */
-	if ((video_setup->w != video_setup->drm.overlay_plane.vlib_plane.width ||
-		video_setup->h != video_setup->drm.overlay_plane.vlib_plane.height) &&
-		!config->type) {
+	/* pass through needs the scaler when output resolution != input resolution */
+	if (vlib_pipeline_scaled(video_setup) && !config->type &&
+		!vlib_scaler_get_filter(video_setup->scaler, NULL)) {
 		VLIB_REPORT_ERR("invalid filter 'pass through' for selected input/output resolutions");
 		vlib_dbg("%s\n", vlib_errstr);
 		return VLIB_ERROR_INVALID_PARAM;
@@ -486,23 +544,26 @@ int vlib_change_mode(struct vlib_config *config)
 		config->mode = 0;
 	}
 
+	if (fs) {
+		filter_type_set_mode(fs, config->mode); /* 0 is pass through */
+	}
+
+	/* pass through and filters at another size run through the scaler */
+	fs = vlib_scaler_get_filter(video_setup->scaler, fs);
+
 	const struct stream_handle *sh;
-	switch(config->type) {
-		case 0:
-			sh = s2m_pipeline_init(video_setup);
-			if (!sh) {
-				return VLIB_ERROR_CAPTURE;
-			}
-			process_thread_fptr = s2m_process_event_loop;
-			break;
-		default:
-			filter_type_set_mode(fs, config->mode); /* 0 is pass through */
-			sh = m2m_sw_pipeline_init(video_setup, fs);
-			if (!sh) {
-				return VLIB_ERROR_CAPTURE;
-			}
-			process_thread_fptr = m2m_sw_process_event_loop;
-			break;
+	if (!fs) {
+		sh = s2m_pipeline_init(video_setup);
+		if (!sh) {
+			return VLIB_ERROR_CAPTURE;
+		}
+		process_thread_fptr = s2m_process_event_loop;
+	} else {
+		sh = m2m_sw_pipeline_init(video_setup, fs);
+		if (!sh) {
+			return VLIB_ERROR_CAPTURE;
+		}
+		process_thread_fptr = m2m_sw_process_event_loop;
 	}
 
 	/* start fps counter thread */
@@ -570,6 +631,136 @@ float vlib_get_event_cnt(pipeline_event event)
 	return VLIB_ERROR_OTHER;
 }
 
+/**
+ * vlib_analytics_enable - Gather statistics of every captured frame
+ * @flags: VLIB_ANALYTICS_* statistics to gather, 0 to stop
+ * @grid_cols: Grid columns with VLIB_ANALYTICS_GRID
+ * @grid_rows: Grid rows with VLIB_ANALYTICS_GRID
+ *
+ * Only frames through the software pipeline are seen.
+ *
+ * Return: 0 on success, VLIB_ERROR_INVALID_PARAM outside of vlib_init() and
+ * vlib_uninit(), error code otherwise.
+ */
+int vlib_analytics_enable(unsigned int flags, size_t grid_cols,
+				size_t grid_rows)
+{
+	const struct luma_stage_format *fmt = NULL;
+	struct vlib_analytics *an = NULL, *old;
+	struct vlib_analytics_cell *cells = NULL, *old_cells;
+	size_t num_cells = 0;
+
+	if (!video_setup) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	if (flags) {
+		/* the capture formats the luma stages read */
+		fmt = luma_stage_find_format(video_setup->in_fourcc);
+		if (!fmt) {
+			VLIB_REPORT_ERR("analytics: unsupported pixel format '%.4s'",
+							(const char *)&video_setup->in_fourcc);
+			vlib_dbg("%s\n", vlib_errstr);
+			return VLIB_ERROR_NOT_SUPPORTED;
+		}
+
+		an = vlib_analytics_create(video_setup->w, video_setup->h,
+								fmt->pitch, flags, grid_cols, grid_rows);
+		if (!an) {
+			return VLIB_ERROR_INVALID_PARAM;
+		}
+
+		num_cells = vlib_analytics_get_num_cells(an);
+		cells = calloc(num_cells, sizeof(*cells));
+		if (!cells) {
+			vlib_analytics_destroy(an);
+			return VLIB_ERROR_NO_MEM;
+		}
+	}
+
+	/* waits for a pass in flight on the old engine */
+	pthread_mutex_lock(&video_setup->analytics_run_lock);
+	pthread_mutex_lock(&video_setup->analytics_lock);
+	old = video_setup->analytics;
+	old_cells = video_setup->analytics_cells;
+	video_setup->analytics = an;
+	video_setup->analytics_offset = fmt ? fmt->offset : 0;
+	video_setup->analytics_frames = 0;
+	video_setup->analytics_cells = cells;
+	video_setup->analytics_num_cells = num_cells;
+	pthread_mutex_unlock(&video_setup->analytics_lock);
+	pthread_mutex_unlock(&video_setup->analytics_run_lock);
+
+	vlib_analytics_destroy(old);
+	free(old_cells);
+
+	return VLIB_SUCCESS;
+}
+
+/**
+ * vlib_analytics_get - Statistics of the last captured frame
+ * @stats: Frame statistics
+ * @cells: Grid cells, may be NULL
+ * @num_cells: Number of cells at @cells, set to the number of cells copied,
+ *             may be NULL if @cells is
+ *
+ * At most grid_cols * grid_rows cells are copied, one if the grid is off.
+ *
+ * Return: 0 on success, VLIB_ERROR_OTHER if no frame was gathered yet,
+ * VLIB_ERROR_INVALID_PARAM outside of vlib_init() and vlib_uninit().
+ */
+int vlib_analytics_get(struct vlib_analytics_stats *stats,
+				struct vlib_analytics_cell *cells, size_t *num_cells)
+{
+	int ret = VLIB_ERROR_OTHER;
+	size_t n = 0;
+
+	if (!video_setup || (cells && !num_cells)) {
+		return VLIB_ERROR_INVALID_PARAM;
+	}
+
+	pthread_mutex_lock(&video_setup->analytics_lock);
+	if (video_setup->analytics_frames) {
+		*stats = video_setup->analytics_stats;
+		if (cells) {
+			n = video_setup->analytics_num_cells;
+			n = *num_cells < n ? *num_cells : n;
+			memcpy(cells, video_setup->analytics_cells, n * sizeof(*cells));
+		}
+		ret = VLIB_SUCCESS;
+	}
+	pthread_mutex_unlock(&video_setup->analytics_lock);
+
+	if (num_cells) {
+		*num_cells = n;
+	}
+
+	return ret;
+}
+
+/*
+ * Statistics of a captured frame, called by the processing loop. The pass
+ * fills the engine's own results, vlib_analytics_get() only waits for
+ * them to be published.
+ */
+void vlib_analytics_frame(struct video_pipeline *vp, const uint8_t *frame,
+				size_t stride)
+{
+	struct vlib_analytics *an;
+
+	pthread_mutex_lock(&vp->analytics_run_lock);
+	an = vp->analytics;
+	if (an && !vlib_analytics_run(an, frame + vp->analytics_offset, stride)) {
+		pthread_mutex_lock(&vp->analytics_lock);
+		vp->analytics_stats = *vlib_analytics_get_stats(an);
+		memcpy(vp->analytics_cells, vlib_analytics_get_cells(an),
+				vp->analytics_num_cells * sizeof(*vp->analytics_cells));
+		vp->analytics_frames++;
+		pthread_mutex_unlock(&vp->analytics_lock);
+	}
+	pthread_mutex_unlock(&vp->analytics_run_lock);
+}
+
 /** This function returns a constant NULL-terminated string with the ASCII name of a vlib
  *  error. The caller must not free() the returned string.
  *
@@ -706,6 +897,7 @@ size_t vlib_fourcc2bpp(uint32_t fourcc)
 		case V4L2_PIX_FMT_RGB332:
 		case V4L2_PIX_FMT_HI240:
 		case V4L2_PIX_FMT_HM12:
+		case V4L2_PIX_FMT_GREY:
 		case DRM_FORMAT_RGB332:
 		case DRM_FORMAT_BGR233:
 			bpp = 8;
@@ -766,6 +958,11 @@ size_t vlib_fourcc2bpp(uint32_t fourcc)
 		case DRM_FORMAT_BGR888:
 			bpp = 24;
 			break;
+		case DRM_FORMAT_YUV444:
+		case V4L2_PIX_FMT_YUV444M:
+			/* planar, bits per pixel of the luma plane */
+			bpp = 8;
+			break;
 		case V4L2_PIX_FMT_BGR32:
 		case V4L2_PIX_FMT_ABGR32:
 		case V4L2_PIX_FMT_XBGR32: